@@ -0,0 +1,816 @@
+/*******************************************************************************
+File:         tmModelBenchmark.cpp
+Project:      TreeMaker 5.x
+Purpose:      Console benchmark of the TreeMaker model (no GUI)
+Author:       TreeMaker contributors
+Modified by:
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+/*
+This file times the expensive operations of the tmTree model -- reading and
+writing, cleanup, crease pattern construction, and the three optimizers -- in
+a console-based format, so that performance can be tracked from one build to
+the next without building the GUI.
+
+Trees come either from a corpus of .tmd5 files (a directory, or individual
+files, given on the command line) or from a random tree generator that is
+run for a list of leaf counts (tmTree::MakeTreeRandom()). Each tree is converted to its text form once;
+every trial then starts from a fresh tree read from that text, so trials are
+independent of one another. Each stage is run for the requested number of
+trials and the wall-clock times are reduced to summary statistics (min,
+median, and several percentiles), which are written as CSV or JSON for
+consumption by scripts.
+
+Usage:
+  tmModelBenchmark [options] [file.tmd5 | directory] ...
+
+Options:
+  -t N          number of trials per stage (default 5)
+  -g N,N,...    generate random trees with the given numbers of leaves
+  -s N          seed for the random tree generator (default 1)
+  -sym          generate symmetric trees (mirrored halves, paired leaves)
+  -opt          scale-optimize generated trees and build their crease
+                patterns before benchmarking them
+  -save DIR     also write generated trees to DIR as .tmd5 files
+  -lbfgs K      optimize with ALM using L-BFGS with a history of K pairs
+  -portfolio    optimize by racing ALM and wnlib, taking whichever converges
+                first
+  -threads N    evaluate ALM constraints with up to N threads (default one
+                per processor)
+  -noscreen     keep all ALM inequality constraints in every iteration
+  -noblocks     evaluate ALM constraints one at a time rather than in blocks
+  -simd UNIT    vector instructions for blocks of path constraints: none,
+                sse2, or avx2 (default the best the processor has)
+  -nopresolve   don't eliminate fixed and tied variables before optimizing
+  -nosymmetry   don't optimize just one half of symmetric trees
+  -budget SEC   stop each optimization after SEC seconds, keeping the best
+                feasible point found (tmOptimizer::OptimizeWithin())
+  -capture DIR  write the problem of each optimizer stage to DIR as a .nlco
+                file for tmNLCOReplay
+  -stages LIST  comma-separated subset of
+                read,write,cleanup,cp,scale,edge,strain (default all)
+  -f csv|json   output format (default csv)
+  -o FILE       write results to FILE rather than stdout
+  -q            don't write progress messages to stderr
+
+In profiling builds (TMPROFILE), the cleanup stage is also broken down into
+the individual stages of tmTree::CleanupAfterEdit(), reported as
+"cleanup:<stage name>".
+*/
+
+// standard libraries
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <dirent.h>
+  #include <sys/stat.h>
+#endif // _WIN32
+
+using namespace std;
+
+// TreeMaker model classes
+#include "tmModel.h"
+#include "tmNLCO.h"
+
+
+/**********
+Benchmark stages
+**********/
+enum Stage {
+  STAGE_READ,
+  STAGE_WRITE,
+  STAGE_CLEANUP,
+  STAGE_CP,
+  STAGE_SCALE,
+  STAGE_EDGE,
+  STAGE_STRAIN,
+  NUM_STAGES
+};
+
+static const char* const STAGE_NAMES[NUM_STAGES] = {
+  "read", "write", "cleanup", "cp", "scale", "edge", "strain"
+};
+
+
+/**********
+struct BenchOptions
+Settings collected from the command line
+**********/
+struct BenchOptions {
+  size_t mNumTrials;            // trials per stage
+  unsigned long mSeed;          // seed for generated trees
+  vector<size_t> mLeafCounts;   // sizes of generated trees
+  bool mSymmetric;              // generate symmetric trees
+  bool mOptimize;               // scale-optimize generated trees
+  string mSaveDir;              // where to save generated trees, if anywhere
+  string mCaptureDir;           // where to write optimizer problems, if any
+  double mBudget;               // seconds per optimization, or 0 for none
+  vector<string> mPaths;        // files and directories of the corpus
+  bool mStages[NUM_STAGES];     // which stages to run
+  bool mJSON;                   // JSON output rather than CSV
+  string mOutFile;              // output file, or empty for stdout
+  bool mQuiet;                  // suppress progress messages
+
+  BenchOptions() : mNumTrials(5), mSeed(1), mSymmetric(false), 
+    mOptimize(false), mBudget(0), mJSON(false), mQuiet(false) {
+    for (size_t i = 0; i < NUM_STAGES; ++i) mStages[i] = true;
+  };
+};
+
+
+/**********
+struct CorpusEntry
+A single tree to benchmark, held in its .tmd5 text form
+**********/
+struct CorpusEntry {
+  string mName;                 // file name or description of generated tree
+  string mText;                 // contents of the .tmd5 file
+};
+
+
+/**********
+struct StageResult
+Collected timings for one stage of one tree
+**********/
+struct StageResult {
+  Stage mStage;                 // which stage
+  string mName;                 // name of the stage in the output
+  vector<double> mTimes;        // wall-clock time of each trial, in seconds
+  size_t mNumFailures;          // trials that failed (see RunTrial())
+  size_t mNumFuncCalls;         // objective+constraint calls, last trial
+  size_t mNumGradCalls;         // objective+constraint gradients, last trial
+
+  StageResult(Stage aStage, const string& aName) : mStage(aStage), 
+    mName(aName), mNumFailures(0), mNumFuncCalls(0), mNumGradCalls(0) {};
+};
+
+
+/**********
+struct TreeResult
+All results for one tree
+**********/
+struct TreeResult {
+  string mName;                 // name of the tree
+  size_t mNumLeafNodes;         // number of leaf nodes
+  size_t mNumNodes;             // number of nodes
+  size_t mNumPaths;             // number of paths
+  size_t mNumConditions;        // number of conditions
+  vector<StageResult> mStages;  // one entry per stage that was run
+};
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Return true if the file name ends with the TreeMaker 5 extension.
+*****/
+bool IsTreeFile(const string& filename)
+{
+  const string ext = ".tmd5";
+  return filename.size() > ext.size() &&
+    filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+
+/*****
+Append the names of all .tmd5 files in the directory to the list, sorted so
+that the order of results doesn't depend on the file system. Return false if
+the path isn't a directory.
+*****/
+bool GetDirectoryTreeFiles(const string& dirname, vector<string>& filenames)
+{
+  vector<string> found;
+  string prefix = dirname;
+#ifdef _WIN32
+  if (prefix.empty() || prefix[prefix.size() - 1] != '\\') prefix += '\\';
+  WIN32_FIND_DATAA findData;
+  HANDLE h = FindFirstFileA((dirname + "\\*").c_str(), &findData);
+  if (h == INVALID_HANDLE_VALUE) return false;
+  do {
+    if (IsTreeFile(findData.cFileName))
+      found.push_back(prefix + findData.cFileName);
+  } while (FindNextFileA(h, &findData));
+  FindClose(h);
+#else
+  if (prefix.empty() || prefix[prefix.size() - 1] != '/') prefix += '/';
+  struct stat st;
+  if (stat(dirname.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+  DIR* dir = opendir(dirname.c_str());
+  if (!dir) return false;
+  while (dirent* entry = readdir(dir))
+    if (IsTreeFile(entry->d_name))
+      found.push_back(prefix + entry->d_name);
+  closedir(dir);
+#endif // _WIN32
+  sort(found.begin(), found.end());
+  filenames.insert(filenames.end(), found.begin(), found.end());
+  return true;
+}
+
+
+/*****
+Read the entire contents of a file into a string. Return false if the file
+couldn't be opened.
+*****/
+bool ReadFileText(const string& filename, string& text)
+{
+  ifstream fin(filename.c_str(), ios_base::in | ios_base::binary);
+  if (!fin.good()) return false;
+  stringstream ss;
+  ss << fin.rdbuf();
+  text = ss.str();
+  return true;
+}
+
+
+/*****
+Assemble the corpus from the files and directories on the command line and
+from the requested generated trees.
+*****/
+void BuildCorpus(const BenchOptions& opts, vector<CorpusEntry>& corpus)
+{
+  vector<string> filenames;
+  for (size_t i = 0; i < opts.mPaths.size(); ++i)
+    if (!GetDirectoryTreeFiles(opts.mPaths[i], filenames))
+      filenames.push_back(opts.mPaths[i]);
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    CorpusEntry entry;
+    entry.mName = filenames[i];
+    if (!ReadFileText(filenames[i], entry.mText)) {
+      cerr << "Unable to read file " << filenames[i] << endl;
+      exit(1);
+    }
+    corpus.push_back(entry);
+  }
+  for (size_t i = 0; i < opts.mLeafCounts.size(); ++i) {
+    if (!opts.mQuiet)
+      cerr << "Generating tree with " << opts.mLeafCounts[i] << 
+        " leaves" << endl;
+    tmTree::RandomTreeSpec spec(opts.mLeafCounts[i], opts.mSeed + i);
+    spec.mSymmetric = opts.mSymmetric;
+    spec.mOptimizeScale = opts.mOptimize;
+    spec.mBuildCreasePattern = opts.mOptimize;
+    tmTree* theTree = tmTree::MakeTreeRandom(spec);
+    stringstream ss;
+    ss << (opts.mSymmetric ? "random_sym_" : "random_") << 
+      opts.mLeafCounts[i] << "_seed" << (opts.mSeed + i);
+    CorpusEntry entry;
+    entry.mName = ss.str();
+    stringstream tss;
+    theTree->PutSelf(tss);
+    entry.mText = tss.str();
+    corpus.push_back(entry);
+    if (!opts.mSaveDir.empty()) {
+      string filename = opts.mSaveDir;
+      if (filename[filename.size() - 1] != '/') filename += '/';
+      filename += entry.mName + ".tmd5";
+      ofstream fout(filename.c_str(), ios_base::out | ios_base::binary);
+      fout << entry.mText;
+      if (!fout.good()) {
+        cerr << "Unable to write file " << filename << endl;
+        exit(1);
+      }
+    }
+    delete theTree;
+  }
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Create a new tree from its text form. Return NULL if the text couldn't be
+parsed.
+*****/
+tmTree* MakeTreeFromText(const string& text)
+{
+  tmTree* theTree = new tmTree();
+  try {
+    istringstream is(text);
+    theTree->GetSelf(is);
+  }
+  catch(...) {
+    delete theTree;
+    return 0;
+  }
+  return theTree;
+}
+
+
+/*****
+Record the number of function and gradient calls made by an optimizer. Only
+available when the optimizers are compiled with call counters.
+*****/
+void RecordCalls(tmOptimizer* theOptimizer, StageResult& result)
+{
+#if TM_PROFILE_OPTIMIZERS
+  tmNLCO* theNLCO = theOptimizer->GetNLCO();
+  result.mNumFuncCalls = theNLCO->GetObjective()->GetNumFuncCalls();
+  result.mNumGradCalls = theNLCO->GetObjective()->GetNumGradCalls();
+  const vector<tmDifferentiableFn*>& flist = theNLCO->GetConstraints();
+  for (size_t i = 0; i < flist.size(); ++i) {
+    result.mNumFuncCalls += flist[i]->GetNumFuncCalls();
+    result.mNumGradCalls += flist[i]->GetNumGradCalls();
+  }
+#endif // TM_PROFILE_OPTIMIZERS
+}
+
+
+/*****
+Create the optimizer for an optimizer stage and initialize it with the whole
+tree: all nodes can move and, for the edge and strain optimizers, all edges
+can stretch. Client owns the optimizer.
+*****/
+tmOptimizer* MakeOptimizer(Stage stage, tmTree* theTree, tmNLCO* theNLCO)
+{
+  if (stage == STAGE_SCALE) {
+    tmScaleOptimizer* scaleOptimizer = new tmScaleOptimizer(theTree, theNLCO);
+    scaleOptimizer->Initialize();
+    return scaleOptimizer;
+  }
+  tmDpptrArray<tmNode> movingNodes = theTree->GetOwnedNodes();
+  tmDpptrArray<tmEdge> stretchyEdges = theTree->GetOwnedEdges();
+  if (stage == STAGE_EDGE) {
+    tmEdgeOptimizer* edgeOptimizer = new tmEdgeOptimizer(theTree, theNLCO);
+    edgeOptimizer->Initialize(movingNodes, stretchyEdges);
+    return edgeOptimizer;
+  }
+  TMASSERT(stage == STAGE_STRAIN);
+  tmStrainOptimizer* strainOptimizer = new tmStrainOptimizer(theTree, theNLCO);
+  strainOptimizer->Initialize(movingNodes, stretchyEdges);
+  return strainOptimizer;
+}
+
+
+/*****
+Run one trial of one stage on a fresh copy of the tree and return the elapsed
+wall-clock time. Only the operation itself is timed, not the creation of the
+tree. Increments the failure count if the operation threw, if an optimizer
+didn't converge to a feasible configuration (including running out of its
+budget, if there is one), or if the crease pattern build didn't produce a full
+crease pattern (which is expected for trees that haven't been optimized).
+*****/
+double RunTrial(const BenchOptions& opts, const CorpusEntry& entry, 
+  StageResult& result, vector<StageResult>& cleanupResults)
+{
+  double startTime = 0, stopTime = 0;
+  if (result.mStage == STAGE_READ) {
+    tmTree* theTree = new tmTree();
+    istringstream is(entry.mText);
+    startTime = tmGetWallTime();
+    try {
+      theTree->GetSelf(is);
+    }
+    catch(...) {
+      ++result.mNumFailures;
+    }
+    stopTime = tmGetWallTime();
+    delete theTree;
+    return stopTime - startTime;
+  }
+  tmTree* theTree = MakeTreeFromText(entry.mText);
+  if (!theTree) {
+    ++result.mNumFailures;
+    return 0;
+  }
+  switch (result.mStage) {
+    case STAGE_WRITE: {
+      ostringstream os;
+      startTime = tmGetWallTime();
+      theTree->PutSelf(os);
+      stopTime = tmGetWallTime();
+      break;
+    }
+    case STAGE_CLEANUP: {
+      // A tmTreeCleaner on a clean tree runs a full CleanupAfterEdit() when
+      // it goes out of scope.
+      startTime = tmGetWallTime();
+      {
+        tmTreeCleaner tc(theTree);
+      }
+      stopTime = tmGetWallTime();
+#if TM_PROFILE_CLEANUP
+      // Profiling builds also report the time of each stage of the cleanup.
+      for (size_t i = 0; i < cleanupResults.size(); ++i)
+        cleanupResults[i].mTimes.push_back(theTree->GetLastCleanupStats(
+          tmTree::CleanupStage(i)).mTime);
+#endif // TM_PROFILE_CLEANUP
+      break;
+    }
+    case STAGE_CP: {
+      startTime = tmGetWallTime();
+      theTree->BuildPolysAndCreasePattern();
+      stopTime = tmGetWallTime();
+      if (!theTree->HasFullCP()) ++result.mNumFailures;
+      break;
+    }
+    case STAGE_SCALE:
+    case STAGE_EDGE:
+    case STAGE_STRAIN: {
+      tmNLCO* theNLCO = tmNLCO::MakeNLCO();
+      tmOptimizer* theOptimizer = 0;
+      bool failed = false;
+      startTime = tmGetWallTime();
+      try {
+        theOptimizer = MakeOptimizer(result.mStage, theTree, theNLCO);
+        if (opts.mBudget > 0) {
+          tmNLCO::Result budgetResult = 
+            theOptimizer->OptimizeWithin(startTime + opts.mBudget);
+          failed = (budgetResult.mStatus != tmNLCO::CONVERGED);
+        }
+        else
+          theOptimizer->Optimize();
+      }
+      catch(...) {
+        failed = true;
+      }
+      // The optimizer is a tmTreeCleaner, so the tree gets cleaned up (and
+      // its feasibility computed) when the optimizer is deleted; that's part
+      // of the cost of the optimization.
+      if (theOptimizer) {
+        RecordCalls(theOptimizer, result);
+        delete theOptimizer;
+      }
+      stopTime = tmGetWallTime();
+      delete theNLCO;
+      if (failed || !theTree->IsFeasible()) ++result.mNumFailures;
+      break;
+    }
+    default:
+      TMFAIL("RunTrial(): bad stage");
+  }
+  delete theTree;
+  return stopTime - startTime;
+}
+
+
+/*****
+Write the problem of an optimizer stage, set up on a fresh copy of the tree,
+to a file in the capture directory named after the tree and the stage.
+*****/
+void CaptureProblem(const BenchOptions& opts, const CorpusEntry& entry, 
+  Stage stage)
+{
+  string name = entry.mName;
+  size_t slash = name.find_last_of("/\\");
+  if (slash != string::npos) name.erase(0, slash + 1);
+  if (IsTreeFile(name)) name.erase(name.size() - 5);
+  string filename = opts.mCaptureDir;
+  if (filename[filename.size() - 1] != '/') filename += '/';
+  filename += name + "_" + STAGE_NAMES[stage] + ".nlco";
+  tmTree* theTree = MakeTreeFromText(entry.mText);
+  tmNLCO* theNLCO = tmNLCO::MakeNLCO();
+  tmOptimizer* theOptimizer = 0;
+  ofstream fout(filename.c_str(), ios_base::out | ios_base::binary);
+  try {
+    theOptimizer = MakeOptimizer(stage, theTree, theNLCO);
+    theOptimizer->PutProblem(fout);
+  }
+  catch(...) {
+    fout.setstate(ios_base::failbit);
+  }
+  if (!fout.good()) cerr << "Unable to write file " << filename << endl;
+  delete theOptimizer;
+  delete theNLCO;
+  delete theTree;
+}
+
+
+/*****
+Run all of the requested stages on one tree.
+*****/
+void BenchmarkTree(const BenchOptions& opts, const CorpusEntry& entry,
+  TreeResult& treeResult)
+{
+  treeResult.mName = entry.mName;
+  tmTree* theTree = MakeTreeFromText(entry.mText);
+  if (!theTree) {
+    cerr << "Unable to parse tree " << entry.mName << endl;
+    exit(1);
+  }
+  treeResult.mNumLeafNodes = theTree->GetNumLeafNodes();
+  treeResult.mNumNodes = theTree->GetNumNodes();
+  treeResult.mNumPaths = theTree->GetNumPaths();
+  treeResult.mNumConditions = theTree->GetNumConditions();
+  delete theTree;
+  for (size_t i = 0; i < NUM_STAGES; ++i) {
+    if (!opts.mStages[i]) continue;
+    if (!opts.mQuiet)
+      cerr << entry.mName << ": " << STAGE_NAMES[i] << endl;
+    if (!opts.mCaptureDir.empty() && (i == STAGE_SCALE || i == STAGE_EDGE || 
+      i == STAGE_STRAIN))
+      CaptureProblem(opts, entry, Stage(i));
+    StageResult result(Stage(i), STAGE_NAMES[i]);
+    vector<StageResult> cleanupResults;
+#if TM_PROFILE_CLEANUP
+    if (i == STAGE_CLEANUP)
+      for (size_t k = 0; k < tmTree::NUM_CLEANUP_STAGES; ++k)
+        cleanupResults.push_back(StageResult(Stage(i), string("cleanup:") + 
+          tmTree::GetCleanupStageName(tmTree::CleanupStage(k))));
+#endif // TM_PROFILE_CLEANUP
+    for (size_t j = 0; j < opts.mNumTrials; ++j)
+      result.mTimes.push_back(RunTrial(opts, entry, result, 
+        cleanupResults));
+    treeResult.mStages.push_back(result);
+    treeResult.mStages.insert(treeResult.mStages.end(), 
+      cleanupResults.begin(), cleanupResults.end());
+  }
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Return the p-th percentile (0 <= p <= 100) of a sorted list of samples,
+interpolating linearly between adjacent samples.
+*****/
+double Percentile(const vector<double>& sorted, double p)
+{
+  if (sorted.empty()) return 0;
+  double r = 0.01 * p * (sorted.size() - 1);
+  size_t i = size_t(r);
+  if (i + 1 >= sorted.size()) return sorted.back();
+  double f = r - i;
+  return (1 - f) * sorted[i] + f * sorted[i + 1];
+}
+
+
+/*****
+Summary statistics of one stage
+*****/
+struct StageStats {
+  double mMin, mP10, mMedian, mP90, mP95, mMax, mMean;
+  
+  StageStats(const vector<double>& times) {
+    vector<double> sorted = times;
+    sort(sorted.begin(), sorted.end());
+    mMin = sorted.empty() ? 0 : sorted.front();
+    mP10 = Percentile(sorted, 10);
+    mMedian = Percentile(sorted, 50);
+    mP90 = Percentile(sorted, 90);
+    mP95 = Percentile(sorted, 95);
+    mMax = sorted.empty() ? 0 : sorted.back();
+    mMean = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) mMean += sorted[i];
+    if (!sorted.empty()) mMean /= sorted.size();
+  };
+};
+
+
+/*****
+Write the results as CSV, one line per tree and stage. Times are in seconds.
+*****/
+void WriteCSV(ostream& os, const vector<TreeResult>& results)
+{
+  os << "tree,leaves,nodes,paths,conditions,stage,trials,failures,"
+    "func_calls,grad_calls,min,p10,median,p90,p95,max,mean\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const TreeResult& tr = results[i];
+    for (size_t j = 0; j < tr.mStages.size(); ++j) {
+      const StageResult& sr = tr.mStages[j];
+      StageStats st(sr.mTimes);
+      os << tr.mName << "," << tr.mNumLeafNodes << "," << tr.mNumNodes << 
+        "," << tr.mNumPaths << "," << tr.mNumConditions << "," << 
+        sr.mName << "," << sr.mTimes.size() << "," << 
+        sr.mNumFailures << "," << sr.mNumFuncCalls << "," << 
+        sr.mNumGradCalls << "," << st.mMin << "," << st.mP10 << "," << 
+        st.mMedian << "," << st.mP90 << "," << st.mP95 << "," << st.mMax << 
+        "," << st.mMean << "\n";
+    }
+  }
+}
+
+
+/*****
+Return the string with JSON special characters escaped.
+*****/
+string JSONEscape(const string& s)
+{
+  string r;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') r += '\\';
+    r += s[i];
+  }
+  return r;
+}
+
+
+/*****
+Write the results as JSON, including the raw time of every trial.
+*****/
+void WriteJSON(ostream& os, const vector<TreeResult>& results)
+{
+  os << "{\n  \"trees\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const TreeResult& tr = results[i];
+    os << (i ? ",\n" : "\n") << "    {\"tree\": \"" << JSONEscape(tr.mName) <<
+      "\", \"leaves\": " << tr.mNumLeafNodes << ", \"nodes\": " << 
+      tr.mNumNodes << ", \"paths\": " << tr.mNumPaths << 
+      ", \"conditions\": " << tr.mNumConditions << ",\n     \"stages\": [";
+    for (size_t j = 0; j < tr.mStages.size(); ++j) {
+      const StageResult& sr = tr.mStages[j];
+      StageStats st(sr.mTimes);
+      os << (j ? "," : "") << "\n      {\"stage\": \"" << 
+        JSONEscape(sr.mName) << "\", \"trials\": " << sr.mTimes.size() << 
+        ", \"failures\": " << sr.mNumFailures << ", \"func_calls\": " << 
+        sr.mNumFuncCalls << ", \"grad_calls\": " << sr.mNumGradCalls << 
+        ",\n       \"min\": " << st.mMin << ", \"p10\": " << st.mP10 << 
+        ", \"median\": " << st.mMedian << ", \"p90\": " << st.mP90 << 
+        ", \"p95\": " << st.mP95 << ", \"max\": " << st.mMax << 
+        ", \"mean\": " << st.mMean << ",\n       \"times\": [";
+      for (size_t k = 0; k < sr.mTimes.size(); ++k)
+        os << (k ? ", " : "") << sr.mTimes[k];
+      os << "]}";
+    }
+    os << "\n     ]}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Report correct usage and exit.
+*****/
+void Usage()
+{
+  cerr << "usage: tmModelBenchmark [-t trials] [-g leaves,...] [-s seed]\n"
+    "         [-sym] [-opt] [-save dir] [-lbfgs history]\n"
+    "         [-threads n] [-noscreen] [-noblocks] [-nopresolve]\n"
+    "         [-simd none|sse2|avx2] [-nosymmetry] [-budget seconds]\n"
+    "         [-portfolio] [-capture dir]\n"
+    "         [-stages read,write,cleanup,cp,scale,edge,strain]\n"
+    "         [-f csv|json] [-o file] [-q] [file.tmd5 | directory] ...\n";
+  exit(1);
+}
+
+
+/*****
+Split a comma-separated list into its elements.
+*****/
+vector<string> SplitList(const string& s)
+{
+  vector<string> items;
+  string item;
+  istringstream is(s);
+  while (getline(is, item, ','))
+    if (!item.empty()) items.push_back(item);
+  return items;
+}
+
+
+/*****
+Parse the command line into the options structure.
+*****/
+void ParseArgs(int argc, char* argv[], BenchOptions& opts)
+{
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (arg == "-t" && hasValue) {
+      opts.mNumTrials = size_t(atol(argv[++i]));
+      if (opts.mNumTrials < 1) Usage();
+    }
+    else if (arg == "-g" && hasValue) {
+      vector<string> items = SplitList(argv[++i]);
+      for (size_t j = 0; j < items.size(); ++j) {
+        size_t n = size_t(atol(items[j].c_str()));
+        if (n < 2) Usage();
+        opts.mLeafCounts.push_back(n);
+      }
+    }
+    else if (arg == "-s" && hasValue)
+      opts.mSeed = strtoul(argv[++i], 0, 10);
+    else if (arg == "-sym")
+      opts.mSymmetric = true;
+    else if (arg == "-opt")
+      opts.mOptimize = true;
+    else if (arg == "-save" && hasValue)
+      opts.mSaveDir = argv[++i];
+    else if (arg == "-lbfgs" && hasValue) {
+      size_t history = size_t(atol(argv[++i]));
+      if (history < 1) Usage();
+      tmNLCO_alm::SetLBFGSHistory(history);
+      tmNLCO::SetAlgorithm(tmNLCO::ALM_LBFGS);
+    }
+    else if (arg == "-portfolio")
+      tmNLCO::SetAlgorithm(tmNLCO::PORTFOLIO);
+    else if (arg == "-threads" && hasValue) {
+      size_t numThreads = size_t(atol(argv[++i]));
+      if (numThreads < 1) Usage();
+      tmNLCO_alm::SetNumThreads(numThreads);
+    }
+    else if (arg == "-noscreen")
+      tmNLCO_alm::SetScreening(false);
+    else if (arg == "-noblocks")
+      tmNLCO_alm::SetBlocks(false);
+    else if (arg == "-simd" && hasValue) {
+      string unit = argv[++i];
+      if (unit == "none")
+        ConstraintFn::SetVectorUnit(ConstraintFn::VECTOR_NONE);
+      else if (unit == "sse2")
+        ConstraintFn::SetVectorUnit(ConstraintFn::VECTOR_SSE2);
+      else if (unit == "avx2")
+        ConstraintFn::SetVectorUnit(ConstraintFn::VECTOR_AVX2);
+      else Usage();
+    }
+    else if (arg == "-nopresolve")
+      tmOptimizer::SetPresolve(false);
+    else if (arg == "-nosymmetry")
+      tmOptimizer::SetSymmetry(false);
+    else if (arg == "-budget" && hasValue) {
+      opts.mBudget = atof(argv[++i]);
+      if (opts.mBudget <= 0) Usage();
+    }
+    else if (arg == "-capture" && hasValue)
+      opts.mCaptureDir = argv[++i];
+    else if (arg == "-stages" && hasValue) {
+      for (size_t j = 0; j < NUM_STAGES; ++j) opts.mStages[j] = false;
+      vector<string> items = SplitList(argv[++i]);
+      for (size_t j = 0; j < items.size(); ++j) {
+        size_t k = 0;
+        while (k < NUM_STAGES && items[j] != STAGE_NAMES[k]) ++k;
+        if (k == NUM_STAGES) Usage();
+        opts.mStages[k] = true;
+      }
+    }
+    else if (arg == "-f" && hasValue) {
+      string fmt = argv[++i];
+      if (fmt == "json") opts.mJSON = true;
+      else if (fmt == "csv") opts.mJSON = false;
+      else Usage();
+    }
+    else if (arg == "-o" && hasValue)
+      opts.mOutFile = argv[++i];
+    else if (arg == "-q")
+      opts.mQuiet = true;
+    else if (!arg.empty() && arg[0] == '-')
+      Usage();
+    else
+      opts.mPaths.push_back(arg);
+  }
+  if (opts.mPaths.empty() && opts.mLeafCounts.empty()) Usage();
+}
+
+
+/*****
+Main Program
+*****/
+int main(int argc, char* argv[])
+{
+  BenchOptions opts;
+  ParseArgs(argc, argv, opts);
+
+  // Initialize our dynamic type system
+  tmPart::InitTypes();
+  
+  vector<CorpusEntry> corpus;
+  BuildCorpus(opts, corpus);
+  
+  vector<TreeResult> results;
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    results.push_back(TreeResult());
+    BenchmarkTree(opts, corpus[i], results.back());
+  }
+  
+  ofstream fout;
+  if (!opts.mOutFile.empty()) {
+    fout.open(opts.mOutFile.c_str());
+    if (!fout.good()) {
+      cerr << "Unable to open output file " << opts.mOutFile << endl;
+      return 1;
+    }
+  }
+  ostream& os = opts.mOutFile.empty() ? cout : fout;
+  os.precision(9);
+  if (opts.mJSON)
+    WriteJSON(os, results);
+  else
+    WriteCSV(os, results);
+  return 0;
+}
@@ -0,0 +1,433 @@
+/*******************************************************************************
+File:         tmNLCOReplay.cpp
+Project:      TreeMaker 5.x
+Purpose:      Console replay of captured optimization problems (no tree, no GUI)
+Author:       TreeMaker contributors
+Modified by:
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+/*
+This file solves optimization problems that were captured from real trees by
+tmNLCOProblem (e.g., with tmModelBenchmark -capture) with any of the
+compiled-in nonlinear constrained optimizers, so that the optimizers can be
+timed and compared, and their results regression-tested, without the tree
+model or the GUI.
+
+Each problem is read into a fresh optimizer for every trial. For each problem
+and algorithm we report the number of trials and failures (an exception or a
+nonzero return from Minimize()), the return code, the objective value and the
+largest constraint or bound violation at the solution, the function and
+gradient calls of the last trial (in builds with TM_PROFILE_OPTIMIZERS), and
+the minimum, median, and maximum wall-clock time, as CSV. For the portfolio,
+the backend that won the last trial is given in parentheses after the name of
+the algorithm, e.g., portfolio(wnlib); when it races, its backends work on
+copies of the functions, whose calls aren't counted.
+
+Usage:
+  tmNLCOReplay [options] file.nlco ...
+
+Options:
+  -a LIST       comma-separated subset of alm,lbfgs,wnlib,portfolio (default
+                all that are compiled in)
+  -backends LIST  comma-separated algorithms raced by portfolio (default
+                alm,wnlib)
+  -t N          number of trials per problem and algorithm (default 1)
+  -lbfgs K      history length for the lbfgs algorithm
+  -threads N    evaluate ALM constraints with up to N threads (default one
+                per processor)
+  -noscreen     keep all ALM inequality constraints in every iteration
+  -nopresolve   don't eliminate fixed and tied variables before optimizing
+  -o FILE       write results to FILE rather than stdout
+  -q            don't write progress messages to stderr
+*/
+
+// standard libraries
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+// TreeMaker model classes
+#include "tmModel.h"
+#include "tmNLCO.h"
+
+
+/**********
+Algorithms that can be selected from the command line
+**********/
+struct AlgorithmName {
+  const char* mName;            // name on the command line and in the output
+  tmNLCO::Algorithm mAlgorithm; // the algorithm
+};
+
+static const AlgorithmName ALGORITHMS[] = {
+#ifdef tmUSE_ALM
+  {"alm", tmNLCO::ALM},
+  {"lbfgs", tmNLCO::ALM_LBFGS},
+#endif
+#ifdef tmUSE_WNLIB
+  {"wnlib", tmNLCO::WNLIB},
+#endif
+#ifdef tmUSE_PORTFOLIO
+  {"portfolio", tmNLCO::PORTFOLIO},
+#endif
+#ifdef tmUSE_CFSQP
+  {"cfsqp", tmNLCO::CFSQP},
+#endif
+#ifdef tmUSE_RFSQP
+  {"rfsqp", tmNLCO::RFSQP},
+#endif
+};
+
+static const size_t NUM_ALGORITHMS = 
+  sizeof(ALGORITHMS) / sizeof(ALGORITHMS[0]);
+
+
+/**********
+struct ReplayOptions
+Settings collected from the command line
+**********/
+struct ReplayOptions {
+  size_t mNumTrials;            // trials per problem and algorithm
+  vector<size_t> mAlgorithms;   // indices into ALGORITHMS
+  vector<string> mPaths;        // problem files
+  string mOutFile;              // output file, or empty for stdout
+  bool mQuiet;                  // suppress progress messages
+
+  ReplayOptions() : mNumTrials(1), mQuiet(false) {};
+};
+
+
+/**********
+struct ReplayResult
+Outcome of all trials of one problem with one algorithm
+**********/
+struct ReplayResult {
+  string mName;                 // file name of the problem
+  string mAlgorithm;            // name of the algorithm
+  size_t mNumVariables;         // size of the problem
+  size_t mNumConstraints;       // number of constraints
+  vector<double> mTimes;        // wall-clock time of each trial, in seconds
+  size_t mNumFailures;          // trials that threw or didn't converge
+  int mInform;                  // return from Minimize(), last trial
+  double mObjective;            // objective at the solution, last trial
+  double mViolation;            // largest violation at solution, last trial
+  size_t mNumFuncCalls;         // objective+constraint calls, last trial
+  size_t mNumGradCalls;         // objective+constraint gradients, last trial
+
+  ReplayResult() : mNumVariables(0), mNumConstraints(0), mNumFailures(0), 
+    mInform(0), mObjective(0), mViolation(0), mNumFuncCalls(0), 
+    mNumGradCalls(0) {};
+};
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Read the entire contents of a file into a string. Return false if the file
+couldn't be opened.
+*****/
+bool ReadFileText(const string& filename, string& text)
+{
+  ifstream fin(filename.c_str(), ios_base::in | ios_base::binary);
+  if (!fin.good()) return false;
+  stringstream ss;
+  ss << fin.rdbuf();
+  text = ss.str();
+  return true;
+}
+
+
+/*****
+Return the largest violation of any constraint or bound at x. Equalities are
+violated by |f|, inequalities f <= 0 by f.
+*****/
+double GetViolation(tmNLCO* theNLCO, const vector<double>& x)
+{
+  double violation = 0;
+  const vector<tmDifferentiableFn*>& flist = theNLCO->GetConstraints();
+  const vector<tmNLCO::ConstraintKind>& klist = 
+    theNLCO->GetConstraintKinds();
+  for (size_t i = 0; i < flist.size(); ++i) {
+    double f = flist[i]->Func(x);
+    if (klist[i] == tmNLCO::LINEAR_EQUALITY || 
+      klist[i] == tmNLCO::NONLINEAR_EQUALITY) f = fabs(f);
+    violation = max(violation, f);
+  }
+  const vector<double>& bl = theNLCO->GetLowerBounds();
+  const vector<double>& bu = theNLCO->GetUpperBounds();
+  for (size_t i = 0; i < x.size(); ++i) {
+    violation = max(violation, bl[i] - x[i]);
+    violation = max(violation, x[i] - bu[i]);
+  }
+  return violation;
+}
+
+
+/*****
+Record the number of function and gradient calls made during a trial. Only
+available when the optimizers are compiled with call counters.
+*****/
+void RecordCalls(tmNLCO* theNLCO, ReplayResult& result)
+{
+#if TM_PROFILE_OPTIMIZERS
+  result.mNumFuncCalls = theNLCO->GetObjective()->GetNumFuncCalls();
+  result.mNumGradCalls = theNLCO->GetObjective()->GetNumGradCalls();
+  const vector<tmDifferentiableFn*>& flist = theNLCO->GetConstraints();
+  for (size_t i = 0; i < flist.size(); ++i) {
+    result.mNumFuncCalls += flist[i]->GetNumFuncCalls();
+    result.mNumGradCalls += flist[i]->GetNumGradCalls();
+  }
+#endif // TM_PROFILE_OPTIMIZERS
+}
+
+
+/*****
+If theNLCO is a portfolio, put the name of the backend that won its last race
+(or "none") in parentheses after the name of the algorithm.
+*****/
+void RecordWinner(tmNLCO* theNLCO, ReplayResult& result)
+{
+#ifdef tmUSE_PORTFOLIO
+  tmNLCO_portfolio* thePortfolio = dynamic_cast<tmNLCO_portfolio*>(theNLCO);
+  if (!thePortfolio) return;
+  string winner = "none";
+  size_t k = thePortfolio->GetWinner();
+  if (k != size_t(tmNLCO_portfolio::NO_WINNER)) {
+    for (size_t i = 0; i < NUM_ALGORITHMS; ++i)
+      if (ALGORITHMS[i].mAlgorithm == thePortfolio->GetBackend(k))
+        winner = ALGORITHMS[i].mName;
+  }
+  string name = result.mAlgorithm.substr(0, result.mAlgorithm.find('('));
+  result.mAlgorithm = name + "(" + winner + ")";
+#endif // tmUSE_PORTFOLIO
+}
+
+
+/*****
+Run one trial: read the problem into a fresh optimizer and solve it, first
+eliminating fixed and tied variables as tmOptimizer does unless presolve is
+turned off. Only presolve and Minimize() are timed. The objective and
+violation are evaluated after the call counts are recorded, so they don't add
+to them.
+*****/
+void RunTrial(const string& text, ReplayResult& result)
+{
+  tmNLCO* theNLCO = tmNLCO::MakeNLCO();
+  vector<double> x;
+  try {
+    istringstream is(text);
+    tmNLCOProblem::Get(is, theNLCO, x);
+  }
+  catch(tmNLCOProblem::EX_BAD_PROBLEM& ex) {
+    cerr << "Bad problem file " << result.mName << " at \"" << ex.mToken << 
+      "\"" << endl;
+    exit(1);
+  }
+  result.mNumVariables = x.size();
+  result.mNumConstraints = theNLCO->GetConstraints().size();
+  bool failed = false;
+  double startTime = tmGetWallTime();
+  try {
+    tmNLCOPresolve presolve(theNLCO);
+    if (tmOptimizer::GetPresolve() && presolve.Reduce()) {
+      vector<double> y;
+      presolve.Restrict(x, y);
+      result.mInform = presolve.GetReducedNLCO()->Minimize(y);
+      presolve.Expand(y, x);
+      RecordWinner(presolve.GetReducedNLCO(), result);
+    }
+    else {
+      result.mInform = theNLCO->Minimize(x);
+      RecordWinner(theNLCO, result);
+    }
+  }
+  catch(...) {
+    failed = true;
+  }
+  double stopTime = tmGetWallTime();
+  result.mTimes.push_back(stopTime - startTime);
+  if (failed || result.mInform != 0) ++result.mNumFailures;
+  RecordCalls(theNLCO, result);
+  result.mObjective = theNLCO->GetObjective()->Func(x);
+  result.mViolation = GetViolation(theNLCO, x);
+  delete theNLCO;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Write the results as CSV, one line per problem and algorithm. Times are in
+seconds.
+*****/
+void WriteCSV(ostream& os, const vector<ReplayResult>& results)
+{
+  os << "problem,algorithm,variables,constraints,trials,failures,inform,"
+    "objective,violation,func_calls,grad_calls,min,median,max\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const ReplayResult& r = results[i];
+    vector<double> sorted = r.mTimes;
+    sort(sorted.begin(), sorted.end());
+    os << r.mName << "," << r.mAlgorithm << "," << r.mNumVariables << "," << 
+      r.mNumConstraints << "," << sorted.size() << "," << r.mNumFailures << 
+      "," << r.mInform << "," << r.mObjective << "," << r.mViolation << 
+      "," << r.mNumFuncCalls << "," << r.mNumGradCalls << "," << 
+      sorted.front() << "," << sorted[sorted.size() / 2] << "," << 
+      sorted.back() << "\n";
+  }
+}
+
+
+/*****
+Print the usage message and quit.
+*****/
+void Usage()
+{
+  cerr << "usage: tmNLCOReplay [-a ";
+  for (size_t i = 0; i < NUM_ALGORITHMS; ++i)
+    cerr << (i ? "," : "") << ALGORITHMS[i].mName;
+  cerr << "] [-t trials] [-lbfgs history]\n"
+    "         [-threads n] [-noscreen] [-nopresolve] [-backends list]\n"
+    "         [-o file] [-q]\n"
+    "         file.nlco ...\n";
+  exit(1);
+}
+
+
+/*****
+Split a comma-separated list into its elements.
+*****/
+vector<string> SplitList(const string& s)
+{
+  vector<string> items;
+  string item;
+  istringstream is(s);
+  while (getline(is, item, ','))
+    if (!item.empty()) items.push_back(item);
+  return items;
+}
+
+
+/*****
+Parse the command line into the options structure.
+*****/
+void ParseArgs(int argc, char* argv[], ReplayOptions& opts)
+{
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (arg == "-a" && hasValue) {
+      vector<string> items = SplitList(argv[++i]);
+      for (size_t j = 0; j < items.size(); ++j) {
+        size_t k = 0;
+        while (k < NUM_ALGORITHMS && items[j] != ALGORITHMS[k].mName) ++k;
+        if (k == NUM_ALGORITHMS) Usage();
+        opts.mAlgorithms.push_back(k);
+      }
+    }
+#ifdef tmUSE_PORTFOLIO
+    else if (arg == "-backends" && hasValue) {
+      vector<string> items = SplitList(argv[++i]);
+      vector<tmNLCO::Algorithm> backends;
+      for (size_t j = 0; j < items.size(); ++j) {
+        size_t k = 0;
+        while (k < NUM_ALGORITHMS && items[j] != ALGORITHMS[k].mName) ++k;
+        if (k == NUM_ALGORITHMS) Usage();
+        if (ALGORITHMS[k].mAlgorithm == tmNLCO::PORTFOLIO) Usage();
+        backends.push_back(ALGORITHMS[k].mAlgorithm);
+      }
+      if (backends.empty()) Usage();
+      tmNLCO_portfolio::SetBackends(backends);
+    }
+#endif // tmUSE_PORTFOLIO
+    else if (arg == "-t" && hasValue) {
+      opts.mNumTrials = size_t(atol(argv[++i]));
+      if (opts.mNumTrials < 1) Usage();
+    }
+#ifdef tmUSE_ALM
+    else if (arg == "-lbfgs" && hasValue) {
+      size_t history = size_t(atol(argv[++i]));
+      if (history < 1) Usage();
+      tmNLCO_alm::SetLBFGSHistory(history);
+    }
+    else if (arg == "-threads" && hasValue) {
+      size_t numThreads = size_t(atol(argv[++i]));
+      if (numThreads < 1) Usage();
+      tmNLCO_alm::SetNumThreads(numThreads);
+    }
+    else if (arg == "-noscreen")
+      tmNLCO_alm::SetScreening(false);
+#endif // tmUSE_ALM
+    else if (arg == "-nopresolve")
+      tmOptimizer::SetPresolve(false);
+    else if (arg == "-o" && hasValue)
+      opts.mOutFile = argv[++i];
+    else if (arg == "-q")
+      opts.mQuiet = true;
+    else if (!arg.empty() && arg[0] == '-')
+      Usage();
+    else
+      opts.mPaths.push_back(arg);
+  }
+  if (opts.mPaths.empty()) Usage();
+  if (opts.mAlgorithms.empty())
+    for (size_t k = 0; k < NUM_ALGORITHMS; ++k) opts.mAlgorithms.push_back(k);
+}
+
+
+/*****
+Main Program
+*****/
+int main(int argc, char* argv[])
+{
+  ReplayOptions opts;
+  ParseArgs(argc, argv, opts);
+  
+  vector<ReplayResult> results;
+  for (size_t i = 0; i < opts.mPaths.size(); ++i) {
+    string text;
+    if (!ReadFileText(opts.mPaths[i], text)) {
+      cerr << "Unable to read file " << opts.mPaths[i] << endl;
+      return 1;
+    }
+    for (size_t j = 0; j < opts.mAlgorithms.size(); ++j) {
+      const AlgorithmName& alg = ALGORITHMS[opts.mAlgorithms[j]];
+      if (!opts.mQuiet)
+        cerr << opts.mPaths[i] << ": " << alg.mName << endl;
+      tmNLCO::SetAlgorithm(alg.mAlgorithm);
+      ReplayResult result;
+      result.mName = opts.mPaths[i];
+      result.mAlgorithm = alg.mName;
+      for (size_t k = 0; k < opts.mNumTrials; ++k) RunTrial(text, result);
+      results.push_back(result);
+    }
+  }
+  
+  ofstream fout;
+  if (!opts.mOutFile.empty()) {
+    fout.open(opts.mOutFile.c_str());
+    if (!fout.good()) {
+      cerr << "Unable to open output file " << opts.mOutFile << endl;
+      return 1;
+    }
+  }
+  ostream& os = opts.mOutFile.empty() ? cout : fout;
+  os.precision(9);
+  WriteCSV(os, results);
+  return 0;
+}
@@ -100,6 +100,8 @@ Main program. Run all of our test routines.
 
 int main()
 {
+  int failures = 0;
+  
 #ifdef tmUSE_CFSQP
   cout << "\n\n";
   cout << "***************************************\n";
@@ -107,7 +109,7 @@ int main()
   cout << "***************************************\n";
   cout << "\n\n";
 
-  Test_all<tmNLCO_cfsqp>();
+  failures += Test_all<tmNLCO_cfsqp>();
 #endif // tmUSE_CFSQP
 
 #ifdef tmUSE_RFSQP
@@ -117,7 +119,7 @@ int main()
   cout << "***************************************\n";
   cout << "\n\n";
   
-  Test_all<tmNLCO_rfsqp>();
+  failures += Test_all<tmNLCO_rfsqp>();
 #endif // tmUSE_RFSQP
   
 #ifdef tmUSE_ALM
@@ -127,7 +129,7 @@ int main()
   cout << "***************************************\n";
   cout << "\n\n";
   
-  Test_all<tmNLCO_alm>();
+  failures += Test_all<tmNLCO_alm>();
 #endif // tmUSE_ALM
   
 #ifdef tmUSE_WNLIB
@@ -137,9 +139,19 @@ int main()
   cout << "***************************************\n";
   cout << "\n\n";
   
-  Test_all<tmNLCO_wnlib>();
+  failures += Test_all<tmNLCO_wnlib>();
 #endif // tmUSE_WNLIB
   
-  return 0;
+#ifdef tmUSE_PORTFOLIO
+  cout << "\n\n";
+  cout << "***************************************\n";
+  cout << "Testing class tmNLCO_portfolio.\n";
+  cout << "***************************************\n";
+  cout << "\n\n";
+  
+  failures += Test_all<tmNLCO_portfolio>();
+#endif // tmUSE_PORTFOLIO
+  
+  return (failures == 0) ? 0 : 1;
 }
 
@@ -532,8 +532,147 @@ int Test_circle_packing(std::size_t num_circles, bool report_vectors = true,
 }
 
 
+/***********************************************************
+Paired nodes problem
+***********************************************************/
+
+/*
+This is a miniature of the strain optimization of a symmetric tree: two nodes
+paired across the vertical midline of the square (H3 and H4, used here as
+linear equalities) and a path between them whose length may stretch by a
+strain s that we want to keep small. The variables are:
+
+u[0] = strain s
+u[1], u[2] = x and y coordinates of the first node
+u[3], u[4] = x and y coordinates of the second node
+
+We start from an optimal point, where the path is slack and s = 0, so every
+gradient in play vanishes. An optimizer should recognize that it's done; in
+particular, it mustn't wander off from a point it can't improve on.
+*/
+
+/**********
+class J1
+Objective function, the squared strain
+**********/
+class J1 : public tmDifferentiableFn {
+public:
+  double Func(const std::vector<double>& u) {
+    IncFuncCalls();
+    return u[0] * u[0];
+  };
+  void Grad(const std::vector<double>& u, std::vector<double>& du) {
+    IncGradCalls();
+    du.assign(du.size(), 0);
+    du[0] = 2 * u[0];
+  };
+};
+
+
+/**********
+class J2
+Constraint (nonlinear inequality) that the nodes be at least the strained
+length of the path apart, written in terms of squared distances
+**********/
+class J2 : public tmDifferentiableFn {
+public:
+  double Func(const std::vector<double>& u) {
+    IncFuncCalls();
+    double l = 0.25 * (1 + u[0]);
+    return l * l - std::pow(u[3] - u[1], 2) - std::pow(u[4] - u[2], 2);
+  };
+  void Grad(const std::vector<double>& u, std::vector<double>& du) {
+    IncGradCalls();
+    du.assign(du.size(), 0);
+    du[0] = 0.125 * (1 + u[0]);
+    du[1] = 2 * (u[3] - u[1]);
+    du[2] = 2 * (u[4] - u[2]);
+    du[3] = -du[1];
+    du[4] = -du[2];
+  };
+};
+
+
+/*****
+Routine for testing paired nodes started at the optimum. Returns nonzero if
+the optimizer didn't converge to a feasible point with no strain.
+*****/
+template <class T>
+int Test_paired_nodes()
+{
+  cout << "Paired nodes started at the optimum:" << endl;
+  
+  // Create and initialize the minimizer object
+  T testMinimizer;
+  testMinimizer.SetSize(5);
+  
+  // Set up the bounds for the problem
+  std::vector<double> bl(5, 0.);
+  std::vector<double> bu(5, 1.);
+  bl[0] = -0.5;
+  bu[0] = 0.5;
+  testMinimizer.SetBounds(bl, bu);
+  
+  // Create objective functions and constraints
+  J1* objective = new J1;
+  testMinimizer.SetObjective(objective);
+  std::vector<tmDifferentiableFn*> constraints;
+  std::vector<tmDifferentiableFn*> eq_constraints;
+  std::vector<tmDifferentiableFn*> ineq_constraints;
+  H3* constraint1 = new H3(0, 1);
+  H4* constraint2 = new H4(0, 1);
+  J2* constraint3 = new J2;
+  testMinimizer.AddLinearEquality(constraint1);
+  testMinimizer.AddLinearEquality(constraint2);
+  testMinimizer.AddNonlinearInequality(constraint3);
+  constraints.push_back(constraint1);
+  eq_constraints.push_back(constraint1);
+  constraints.push_back(constraint2);
+  eq_constraints.push_back(constraint2);
+  constraints.push_back(constraint3);
+  ineq_constraints.push_back(constraint3);
+  
+  // Set up initial solution, which is feasible and optimal
+  std::vector<double> x(5);
+  x[0] = 0.;
+  x[1] = 0.2;
+  x[2] = 0.6;
+  x[3] = 0.8;
+  x[4] = 0.6;
+  
+  // Run the calculation
+  clock_t start = clock();
+  int code = testMinimizer.Minimize(x);
+  clock_t stop = clock();
+  
+  // Display the result
+  cout.setf(ios_base::fixed);
+  cout.precision(6);
+  cout << "1 objective, 2 equality constraints, 1 inequality constraint" << 
+    endl;
+  ReportVector("x", x);
+  cout << "Result code = " << code << endl;
+  ReportCalls("objective", objective);
+  ReportCalls("constraint", constraints);
+  constraints.push_back(objective);
+  ReportCalls("total", constraints);
+  ReportFeasibility(x, eq_constraints, ineq_constraints);
+  cout << "time = " << (stop - start) / float(CLK_TCK) << " seconds" << endl;
+  cout << endl;
+  const double tol = 1.0e-6;
+  if (code != 0 || std::fabs(x[0]) > tol || 
+    std::fabs(constraint1->Func(x)) > tol || 
+    std::fabs(constraint2->Func(x)) > tol || constraint3->Func(x) > tol) {
+    cout << "FAILED: paired nodes didn't stay at the optimum" << endl << endl;
+    return 1;
+  }
+  return 0;
+}
+
+
 /*****
-Run all tests on the given optimizer
+Run all tests on the given optimizer. Returns the number of tests that failed
+their own checks.
 *****/
 template <class T>
 int Test_all()
@@ -546,7 +685,7 @@ int Test_all()
   Test_circle_packing<T>(10, false, true);
   Test_circle_packing<T>(20, false, false);
   Test_circle_packing<T>(20, false, true);
-  return 0;
+  return Test_paired_nodes<T>();
 }
 
 #endif // _TMNLCOTESTER_H_
@@ -203,3 +203,31 @@ Check for NaN in debug builds
     }
   }
 #endif // TMDEBUG
+
+
+/**********
+TIMING FUNCTIONS
+**********/
+
+/*****
+Return the wall-clock time in seconds, with the best resolution the platform
+offers.
+*****/
+#ifdef _WIN32
+  #include <windows.h>
+  double tmGetWallTime()
+  {
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return double(count.QuadPart) / double(freq.QuadPart);
+  }
+#else
+  #include <sys/time.h>
+  double tmGetWallTime()
+  {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return double(tv.tv_sec) + 1.0e-6 * double(tv.tv_usec);
+  }
+#endif // _WIN32
@@ -241,4 +241,15 @@ Checks for NaN in debugging builds in numbers and (in C++) std::vector<T>
 #endif /* TMDEBUG */
 
 
+/**********
+tmGetWallTime()
+Return elapsed wall-clock time in seconds from an arbitrary origin. Used for
+timing optimizers and tree cleanup in profile builds and benchmarks; unlike
+clock(), it isn't fooled by multiple threads or time spent waiting.
+**********/
+#ifdef __cplusplus
+  double tmGetWallTime();
+#endif /* __cplusplus */
+
+
 #endif /* _TMHEADER_H_ */
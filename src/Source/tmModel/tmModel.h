@@ -20,6 +20,8 @@ Copyright:    
 #include "tmTreeClasses.h"
 #include "tmNLCO.h"
 #include "tmConstraintFns.h"
+#include "tmNLCOProblem.h"
+#include "tmNLCOPresolve.h"
 #include "tmScaleOptimizer.h"
 #include "tmStrainOptimizer.h"
 #include "tmEdgeOptimizer.h"
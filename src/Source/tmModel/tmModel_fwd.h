@@ -51,6 +51,7 @@ class tmConditionPathAngleFixed;
 class tmConditionPathAngleQuant;
 
 class tmRootNetwork;
+class tmRandomTreeNode;
 
 class tmDifferentiableFn;
 class tmNLCO;
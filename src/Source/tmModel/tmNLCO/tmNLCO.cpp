@@ -10,8 +10,169 @@ Copyright:    
 
 #include "tmNLCO.h"
 
+#include <cmath>
+#include <map>
+#include <string>
+
 using namespace std;
 
+// Worst violation of a constraint or bound at which MinimizeWithin() considers
+// a point feasible; the same as the ALM optimizer's own tolerance.
+const double k_NLCO_Feasible_Tol = 1.0e-5;
+
+/**********
+class tmDifferentiableFn
+Object that computes a scalar-valued function of a vector and the vector-valued
+gradient.
+**********/
+
+/*****
+Add fac times the gradient to gradx. This default version computes the full
+gradient and adds all of it; functions that only depend on a few variables
+should override this (and IsSparse() and GetVars()) to do less work.
+*****/
+void tmDifferentiableFn::AddGrad(const vector<double>& x, double fac, 
+  vector<double>& gradx)
+{
+  vector<double> g(gradx.size());
+  Grad(x, g);
+  for (size_t i = 0; i < gradx.size(); ++i) gradx[i] += fac * g[i];
+}
+
+
+/*****
+Return the value of the function and put the gradient in gradx. This default
+version just calls Func() and Grad(); functions that can compute both more
+cheaply together should override it.
+*****/
+double tmDifferentiableFn::FuncGrad(const vector<double>& x, 
+  vector<double>& gradx)
+{
+  double f = Func(x);
+  Grad(x, gradx);
+  return f;
+}
+
+
+/*****
+Return the value of the function and add gw.GetWeight(f) times the gradient
+to gradx, skipping the gradient if the weight is zero. This default version
+calls Func() and AddGrad(); functions that can share work between the two
+should override it.
+*****/
+double tmDifferentiableFn::FuncAddGrad(const vector<double>& x, 
+  GradWeight& gw, vector<double>& gradx)
+{
+  double f = Func(x);
+  double fac = gw.GetWeight(f);
+  if (fac != 0) AddGrad(x, fac, gradx);
+  return f;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmConstraintBlockSet
+The blocks for a list of constraint functions.
+**********/
+
+/*****
+Destructor. Destroy the blocks.
+*****/
+tmConstraintBlockSet::~tmConstraintBlockSet()
+{
+  Clear();
+}
+
+
+/*****
+Put each function of fns that has a block form into the block for its tag, and
+record where it went. A function that passes its variables through to another
+goes in as that other function (see GetBlockFn()). Functions are appended to
+their blocks in list order, so a run of functions of one type occupies
+consecutive positions in its block.
+*****/
+void tmConstraintBlockSet::Build(const vector<tmDifferentiableFn*>& fns)
+{
+  Clear();
+  map<string, size_t> tagBlocks;    // block for each tag seen, or BAD_OFFSET
+  vector<size_t> counts;            // number of functions in each block
+  mBlockOf.resize(fns.size());
+  mPos.resize(fns.size());
+  for (size_t k = 0; k < fns.size(); ++k) {
+    mBlockOf[k] = BAD_OFFSET;
+    mPos[k] = 0;
+    tmDifferentiableFn* f = fns[k]->GetBlockFn();
+    const char* tag = f->GetTag();
+    if (!tag) continue;
+    map<string, size_t>::iterator t = tagBlocks.find(tag);
+    if (t == tagBlocks.end()) {
+      tmConstraintBlock* block = f->MakeBlock();
+      size_t b = BAD_OFFSET;
+      if (block) {
+        b = mBlocks.size();
+        mBlocks.push_back(block);
+        counts.push_back(0);
+        if (mWorkSize < block->GetWorkSize()) mWorkSize = block->GetWorkSize();
+      }
+      t = tagBlocks.insert(make_pair(string(tag), b)).first;
+    }
+    size_t b = t->second;
+    if (b == BAD_OFFSET) continue;
+    mBlocks[b]->Append(f);
+    mBlockOf[k] = b;
+    mPos[k] = counts[b]++;
+  }
+}
+
+
+/*****
+Destroy the blocks and forget the functions.
+*****/
+void tmConstraintBlockSet::Clear()
+{
+  for (size_t b = 0; b < mBlocks.size(); ++b) delete mBlocks[b];
+  mBlocks.clear();
+  mBlockOf.clear();
+  mPos.clear();
+  mWorkSize = 0;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCOWarmStart
+The state of an optimizer at the end of an optimization.
+**********/
+
+/*****
+Empty out the state, so that an optimizer given it starts cold.
+*****/
+void tmNLCOWarmStart::Clear()
+{
+  mMultipliers.clear();
+  mLowerMultipliers.clear();
+  mUpperMultipliers.clear();
+  mWeight = 0;
+  mHessInv.resize(0, 0);
+  mSteps.clear();
+  mGradSteps.clear();
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
 /**********
 class tmNLCO
 Abstract class for nonlinear constrained optimizer object used in TreeMaker.
@@ -22,7 +183,8 @@ Any constrained optimizer code must be adapted to this interface.
 Constructor
 *****/
 tmNLCO::tmNLCO()
-  : mSize(0), mUpdater(0), mObjective(0)
+  : mSize(0), mUpdater(0), mMaxThreads(0), mObjective(0), mBudgeted(false), 
+    mDeadline(0), mCancelToken(0), mBestObjective(0), mBestViolation(0)
 {
 }
 
@@ -77,15 +239,32 @@ object and is responsible for its eventual deletion.
 *****/
 tmNLCO* tmNLCO::MakeNLCO()
 {
-  switch(sAlgorithm) {
+  return MakeNLCO(sAlgorithm);
+}
+
+
+/*****
+STATIC
+Create a nonlinear constrained optimizer of the given type. Client owns the
+object and is responsible for its eventual deletion.
+*****/
+tmNLCO* tmNLCO::MakeNLCO(Algorithm algorithm)
+{
+  switch(algorithm) {
 #ifdef tmUSE_ALM
     case tmNLCO::ALM:
       return new tmNLCO_alm();
+    case tmNLCO::ALM_LBFGS:
+      return new tmNLCO_alm(tmNLCO_alm::GetLBFGSHistory());
 #endif
 #ifdef tmUSE_WNLIB
     case tmNLCO::WNLIB:
       return new tmNLCO_wnlib();
 #endif
+#ifdef tmUSE_PORTFOLIO
+    case tmNLCO::PORTFOLIO:
+      return new tmNLCO_portfolio();
+#endif
 #ifdef tmUSE_CFSQP
     case tmNLCO::CFSQP:
       return new tmNLCO_cfsqp();
@@ -116,6 +295,18 @@ void tmNLCO::SetUpdater(tmNLCOUpdater* updater)
 }
 
 
+/*****
+Limit the number of threads that Minimize() may use, including the calling
+thread, e.g., when several optimizers run at once and share the processors.
+0 (the default) means no limit beyond the optimizer's own. Optimizers that
+don't use threads ignore this.
+*****/
+void tmNLCO::SetMaxThreads(size_t maxThreads)
+{
+  mMaxThreads = maxThreads;
+}
+
+
 /*****
 Set the objective function. Subclasses should override but call the base routine
 *****/
@@ -127,11 +318,24 @@ void tmNLCO::SetObjective(tmDifferentiableFn* f)
 
 
 /*****
-Add any constraint. Subclasses should call this for each type of constraint.
+Add any constraint. Subclasses should call this for each type of constraint,
+passing the kind of constraint so that the problem can be captured.
 *****/
-void tmNLCO::AddConstraint(tmDifferentiableFn* f)
+void tmNLCO::AddConstraint(tmDifferentiableFn* f, ConstraintKind kind)
 {
   mConstraints.push_back(f);
+  mConstraintKinds.push_back(kind);
+}
+
+
+/*****
+Record the bounds on the variables. Subclasses should call this from
+SetBounds() so that the problem can be captured.
+*****/
+void tmNLCO::RecordBounds(const vector<double>& bl, const vector<double>& bu)
+{
+  mLowerBounds = bl;
+  mUpperBounds = bu;
 }
 
 
@@ -156,6 +360,134 @@ optimization.
 *****/
 void tmNLCO::ObjectiveUpdateUI()
 {
+  if (mBudgeted) CheckBudget();
   if (mUpdater) mUpdater->UpdateUI();
 }
 
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Return the worst violation of any constraint or bound at x; 0 if x is feasible.
+*****/
+double tmNLCO::GetViolation(const vector<double>& x) const
+{
+  double viol = 0;
+  for (size_t i = 0; i < mConstraints.size(); ++i) {
+    double f = mConstraints[i]->Func(x);
+    if (mConstraintKinds[i] == LINEAR_EQUALITY || 
+      mConstraintKinds[i] == NONLINEAR_EQUALITY) f = fabs(f);
+    if (f > viol) viol = f;
+  }
+  for (size_t i = 0; i < mLowerBounds.size(); ++i) {
+    if (mLowerBounds[i] - x[i] > viol) viol = mLowerBounds[i] - x[i];
+    if (x[i] - mUpperBounds[i] > viol) viol = x[i] - mUpperBounds[i];
+  }
+  return viol;
+}
+
+
+/*****
+Minimize as Minimize() does, but stop at the first check between iterations
+after the wall-clock time given by tmGetWallTime() passes deadline (if deadline
+> 0) or after token (if any) is cancelled. If Minimize() converges, x is its
+answer; otherwise x is the best point seen, i.e., the feasible point with the
+lowest objective, or if there were none, the point with the least violation.
+Failure to converge is reported in the result rather than thrown; any other
+exception (such as one thrown by the updater) still propagates, with x left at
+the best point seen.
+*****/
+tmNLCO::Result tmNLCO::MinimizeWithin(vector<double>& x, double deadline, 
+  const tmNLCOCancelToken* token)
+{
+  TMASSERT(!mBudgeted);
+  mDeadline = deadline;
+  mCancelToken = token;
+  mBestX.clear();
+  RecordIterate(x);
+  
+  Result result;
+  mBudgeted = true;
+  try {
+    CheckBudget();
+    result.mReason = Minimize(x);
+    result.mStatus = (result.mReason == 0) ? CONVERGED : NOT_CONVERGED;
+  }
+  catch(EX_STOPPED& ex) {
+    result.mStatus = ex.mStatus;
+  }
+  catch(EX_BAD_CONVERGENCE& ex) {
+    result.mStatus = NOT_CONVERGED;
+    result.mReason = ex.mReason;
+  }
+  catch(...) {
+    mBudgeted = false;
+    x = mBestX;
+    throw;
+  }
+  mBudgeted = false;
+  
+  // Unless we converged, the final point is just another candidate.
+  if (result.mStatus == CONVERGED) {
+    mBestX.clear();
+    RecordIterate(x);
+  }
+  else {
+    RecordIterate(x);
+    x = mBestX;
+  }
+  result.mFeasible = (mBestViolation < k_NLCO_Feasible_Tol);
+  result.mObjective = mBestObjective;
+  result.mViolation = mBestViolation;
+  return result;
+}
+
+
+/*****
+Throw EX_STOPPED if we're past the deadline or the cancellation token has been
+cancelled. Does nothing outside of MinimizeWithin().
+*****/
+void tmNLCO::CheckBudget()
+{
+  if (!mBudgeted) return;
+  if (mCancelToken && mCancelToken->IsCancelled()) throw EX_STOPPED(CANCELLED);
+  if (mDeadline > 0 && tmGetWallTime() > mDeadline) throw EX_STOPPED(TIMED_OUT);
+}
+
+
+/*****
+Make x the best point seen so far if it's better than the previous best: any
+feasible point beats an infeasible one, feasible points are compared by
+objective, and infeasible ones by violation. Subclasses should only call this
+when IsBudgeted() is true.
+*****/
+void tmNLCO::RecordIterate(const vector<double>& x)
+{
+  // Evaluating the objective calls ObjectiveUpdateUI(), which mustn't stop us
+  // or update the UI here.
+  bool budgeted = mBudgeted;
+  tmNLCOUpdater* updater = mUpdater;
+  mBudgeted = false;
+  mUpdater = 0;
+  double objective = mObjective->Func(x);
+  double violation = GetViolation(x);
+  mBudgeted = budgeted;
+  mUpdater = updater;
+  
+  bool feasible = (violation < k_NLCO_Feasible_Tol);
+  bool bestFeasible = (mBestViolation < k_NLCO_Feasible_Tol);
+  if (mBestX.size() > 0) {
+    if (bestFeasible && !feasible) return;
+    if (bestFeasible == feasible) {
+      if (feasible && objective >= mBestObjective) return;
+      if (!feasible && violation >= mBestViolation) return;
+    }
+  }
+  mBestX = x;
+  mBestObjective = objective;
+  mBestViolation = violation;
+}
+
@@ -12,7 +12,9 @@ Copyright:    
 #define _TMNLCO_H_
 
 #include "tmHeader.h"
+#include "tmMatrix.h"
 #include <vector>
+#include <iosfwd>
 
 /*
 This header file specifies which of the different optimizer classes are
@@ -29,7 +31,8 @@ code must be compiled as well or a link error will result.
 //#define tmUSE_CFSQP
 //#define tmUSE_RFSQP
 #define tmUSE_ALM
-//#define tmUSE_WNLIB
+#define tmUSE_WNLIB
+#define tmUSE_PORTFOLIO
 
 /*
 The TreeMaker nonlinear optimization classes include support for profiling and
@@ -46,25 +49,90 @@ during the optimization.
   #define TM_PROFILE_OPTIMIZERS 0
 #endif // defined(TMDEBUG) || defined(TMPROFILE)
 
+// Forward declarations
+class tmConstraintBlock;
+
 
 /**********
 class tmDifferentiableFn
 Object that computes a scalar-valued function of a vector and the vector-valued
-gradient.
+gradient. Functions that depend on only a few of the variables (e.g., most
+constraints) should also override the sparse interface: AddGrad() adds a
+multiple of the gradient into an existing vector, touching only the variables
+listed by GetVars(), so that the cost of accumulating many gradients is
+proportional to the number of nonzero entries rather than the problem size.
+
+FuncGrad() and FuncAddGrad() compute the value and the gradient together, so
+that functions can share the work (distances, square roots) between the two.
+In FuncAddGrad(), the multiple of the gradient to add depends on the value of
+the function, so it's supplied by a GradWeight object, which can return 0 to
+skip the gradient entirely.
+
+Functions that can be written to a captured problem (see tmNLCOProblem)
+override GetTag() to return the name of a function class that tmNLCOProblem
+can create and PutParams() to write that class's parameters; GetParams()
+reads them back. Functions that return a null tag can't be captured.
+
+Sparse functions also override SetVars(), which takes new indices for the
+variables listed by GetVars(), in the same order, so that the function can be
+evaluated on a different vector. Functions that are linear (a sum of constant
+multiples of the variables of GetVars(), plus a constant) can report it via
+GetLinear(), which appends the coefficients in the order of GetVars(), sets the
+constant part, and returns true. tmNLCOPresolve uses both.
+
+Functions of the hot constraint types also override MakeBlock(), which returns
+a new, empty tmConstraintBlock that can hold functions of their type, so that
+an optimizer can evaluate many of them without a virtual call apiece. A
+function that only passes its variables through to another function (such as
+the wrappers made by tmNLCOPresolve) overrides GetBlockFn() to return that
+function, which is the one that goes into a block; the default returns this.
+
+Functions that can be copied override MakeCopy(), which returns a new function
+that computes the same values as this one but shares no state with it, so
+that the two can be evaluated on different threads at once (see
+tmNLCO_portfolio). The copy only has to be the same function of the
+variables; side effects, such as updating the UI, needn't come along. The
+default returns NULL.
 **********/
 class tmDifferentiableFn {
 public:
+  class GradWeight {
+    // Supplies the multiple of the gradient to add given the function value
+    public:
+    virtual ~GradWeight() {};
+    virtual double GetWeight(double f) = 0;
+  };
+  
   virtual ~tmDifferentiableFn() {};
   virtual double Func(const std::vector<double>& x) = 0;
   virtual void Grad(const std::vector<double>& x, 
     std::vector<double>& gradx) = 0;
+  virtual void AddGrad(const std::vector<double>& x, double fac, 
+    std::vector<double>& gradx);
+  virtual double FuncGrad(const std::vector<double>& x, 
+    std::vector<double>& gradx);
+  virtual double FuncAddGrad(const std::vector<double>& x, GradWeight& gw, 
+    std::vector<double>& gradx);
+  virtual bool IsSparse() const {return false;};
+  virtual void GetVars(std::vector<std::size_t>&) {};
+  virtual void SetVars(const std::vector<std::size_t>&) {};
+  virtual bool GetLinear(std::vector<double>&, double&) const {return false;};
+  virtual const char* GetTag() const {return 0;};
+  virtual void PutParams(std::ostream&) const {};
+  virtual void GetParams(std::istream&) {};
+  virtual tmConstraintBlock* MakeBlock() const {return 0;};
+  virtual tmDifferentiableFn* GetBlockFn() {return this;};
+  virtual tmDifferentiableFn* MakeCopy() const {return 0;};
 #if TM_PROFILE_OPTIMIZERS
   tmDifferentiableFn() : mFuncCalls(0), mGradCalls(0) {};
   std::size_t GetNumFuncCalls() const {return mFuncCalls;};
   std::size_t GetNumGradCalls() const {return mGradCalls;};
   void ResetCalls() {mFuncCalls = 0; mGradCalls = 0;};
+  void AddCalls(std::size_t numFunc, std::size_t numGrad) {
+    mFuncCalls += numFunc; mGradCalls += numGrad;};
 #else
   void ResetCalls() {};
+  void AddCalls(std::size_t, std::size_t) {};
 #endif
 protected:
 #if TM_PROFILE_OPTIMIZERS
@@ -82,6 +150,77 @@ private:
 };
 
 
+/**********
+class tmConstraintBlock
+A group of constraint functions of a single type, whose parameters are copied
+into contiguous arrays (one per member variable) so that a tight loop can
+evaluate many of them with no virtual call or pointer chasing per function.
+Functions are referred to by their position in the block, in the order they
+were appended. Evaluation is split in two so that the caller can decide how
+much of each gradient to add from the values: Func() puts the values of the
+listed functions in f and whatever it will need to compute their gradients
+(GetWorkSize() doubles per function) in work; AddGrad() then adds fac[j] times
+the gradient of the j-th listed function to gradx, skipping those with fac[j]
+= 0. The results are identical to those of the functions themselves. Blocks
+copy the functions' parameters when they're appended, so a block must be
+rebuilt if the functions change (e.g., by SetVars()).
+**********/
+class tmConstraintBlock {
+public:
+  virtual ~tmConstraintBlock() {};
+  virtual std::size_t GetWorkSize() const = 0;
+  virtual void Append(tmDifferentiableFn* f) = 0;
+  virtual void Func(const std::vector<double>& x, const std::size_t* pos, 
+    std::size_t n, double* f, double* work) = 0;
+  virtual void AddGrad(const std::vector<double>& x, const std::size_t* pos,
+    std::size_t n, const double* fac, const double* work, 
+    std::vector<double>& gradx) = 0;
+};
+
+
+/**********
+class tmConstraintBlockSet
+The blocks for a list of constraint functions. Each function whose MakeBlock()
+returns a block goes into the block shared by all functions with the same tag;
+GetBlockIndex() and GetPos() say where the k-th function of the list went;
+GetBlockIndex() returns BAD_OFFSET for functions that aren't in a block.
+**********/
+class tmConstraintBlockSet {
+public:
+  enum {
+    BAD_OFFSET = std::size_t(-1)
+  };
+  
+  tmConstraintBlockSet() : mWorkSize(0) {};
+  ~tmConstraintBlockSet();
+  void Build(const std::vector<tmDifferentiableFn*>& fns);
+  void Clear();
+  std::size_t GetNumBlocks() const {
+    // Return the number of blocks.
+    return mBlocks.size();};
+  tmConstraintBlock* GetBlock(std::size_t b) const {
+    // Return the b-th block.
+    return mBlocks[b];};
+  std::size_t GetWorkSize() const {
+    // Return the most work space any block needs per function.
+    return mWorkSize;};
+  std::size_t GetBlockIndex(std::size_t k) const {
+    // Return the block of the k-th function, or BAD_OFFSET if none.
+    return mBlockOf[k];};
+  std::size_t GetPos(std::size_t k) const {
+    // Return the position of the k-th function in its block.
+    return mPos[k];};
+private:
+  std::vector<tmConstraintBlock*> mBlocks;  // blocks, which we own
+  std::vector<std::size_t> mBlockOf;        // block of each function
+  std::vector<std::size_t> mPos;            // position within its block
+  std::size_t mWorkSize;                    // largest GetWorkSize() of blocks
+  
+  tmConstraintBlockSet(const tmConstraintBlockSet&);
+  void operator=(const tmConstraintBlockSet&);
+};
+
+
 /**********
 class tmNLCOUpdater
 Abstract class for object that will perform UI updating. If you pass one of
@@ -96,10 +235,67 @@ public:
 };
 
 
+/**********
+class tmNLCOCancelToken
+Lets one thread ask an optimization running on another to stop at its next
+check between iterations (see tmNLCO::MinimizeWithin()). Once cancelled, a
+token stays cancelled; use a new one for each optimization. A token made with
+a parent is also cancelled whenever its parent is, which lets an optimizer
+stop the optimizations it runs itself without losing its caller's token.
+**********/
+class tmNLCOCancelToken {
+public:
+  tmNLCOCancelToken(const tmNLCOCancelToken* parent = 0) : 
+    mCancelled(false), mParent(parent) {};
+  void Cancel() {
+    // Ask the optimization to stop.
+    mCancelled = true;};
+  bool IsCancelled() const {
+    // Return true if the optimization has been asked to stop.
+    return mCancelled || (mParent && mParent->IsCancelled());};
+private:
+  volatile bool mCancelled;   // set by another thread, so always re-read
+  const tmNLCOCancelToken* mParent;   // token we also obey, or 0
+};
+
+
+/**********
+class tmNLCOWarmStart
+The internal state of an optimizer at the end of an optimization, which can be
+given to another optimizer of the same problem (or a slightly different one)
+so that it starts close to where the first one finished. Multipliers are listed
+per constraint in the order the constraints were added (which is the order of
+tmNLCO::GetConstraints()) and per variable for the bounds. Each algorithm uses
+what it can and ignores the rest; empty members are simply not used.
+**********/
+class tmNLCOWarmStart {
+public:
+  std::vector<double> mMultipliers;       // Lagrange multiplier per constraint
+  std::vector<double> mLowerMultipliers;  // multiplier per lower bound
+  std::vector<double> mUpperMultipliers;  // multiplier per upper bound
+  double mWeight;                         // penalty weight, 0 = none
+  tmMatrix<double> mHessInv;              // dense inverse Hessian
+  std::vector<std::vector<double> > mSteps;      // L-BFGS steps, oldest first
+  std::vector<std::vector<double> > mGradSteps;  // L-BFGS gradient changes
+  
+  tmNLCOWarmStart() : mWeight(0) {};
+  void Clear();
+};
+
+
 /**********
 class tmNLCO
 Abstract class for nonlinear constrained optimizer object used in TreeMaker.
 Any constrained optimizer code must be adapted to this interface.
+
+MinimizeWithin() is Minimize() with a limit on wall-clock time and a token by
+which another thread can cancel it; either stops the minimization at the next
+check between iterations. If Minimize() converges, the result is its answer;
+otherwise it's the best feasible point seen (or the least infeasible one, if
+none was), and the status says why it stopped. Subclasses that run their own
+iteration loop call CheckBudget() between iterations and RecordIterate() with
+each iterate; otherwise, the check happens in ObjectiveUpdateUI() and only the
+starting and final points are candidates.
 **********/
 class tmNLCO {
 public:
@@ -117,8 +313,42 @@ public:
 #endif
 #ifdef tmUSE_WNLIB
     WNLIB,
+#endif
+#ifdef tmUSE_ALM
+    ALM_LBFGS,  // ALM with limited-memory BFGS
+#endif
+#ifdef tmUSE_PORTFOLIO
+    PORTFOLIO,  // race others; new ones go last to keep saved prefs valid
 #endif
     NUM_ALGORITHMS };
+  
+  // Kinds of constraints, in the order they're added by the Add... routines
+  enum ConstraintKind {
+    LINEAR_EQUALITY,
+    NONLINEAR_EQUALITY,
+    LINEAR_INEQUALITY,
+    NONLINEAR_INEQUALITY
+  };
+  
+  // Ways a call to MinimizeWithin() can end
+  enum Status {
+    CONVERGED,      // Minimize() returned 0
+    NOT_CONVERGED,  // Minimize() returned or threw a reason for failure
+    TIMED_OUT,      // stopped at the deadline
+    CANCELLED       // stopped because the token was cancelled
+  };
+  
+  // The outcome of a call to MinimizeWithin()
+  class Result {
+  public:
+    Status mStatus;       // how the minimization ended
+    int mReason;          // reason for failure from Minimize(), or 0
+    bool mFeasible;       // true = the point returned is feasible
+    double mObjective;    // value of the objective at the point returned
+    double mViolation;    // worst violation of a constraint or bound there
+    Result() : mStatus(NOT_CONVERGED), mReason(0), mFeasible(false),
+      mObjective(0), mViolation(0) {};
+  };
 
   // Exception classes
   class EX_BAD_CONVERGENCE {
@@ -135,8 +365,17 @@ public:
   static Algorithm GetAlgorithm();
   static void SetAlgorithm(Algorithm algorithm);
   static tmNLCO* MakeNLCO();
+  static tmNLCO* MakeNLCO(Algorithm algorithm);
+  virtual tmNLCO* MakeEmpty() const = 0;
   
   void SetUpdater(tmNLCOUpdater* updater);
+  tmNLCOUpdater* GetUpdater() const {
+    // Return the object that shows progress, if any.
+    return mUpdater;};
+  void SetMaxThreads(std::size_t maxThreads);
+  std::size_t GetMaxThreads() const {
+    // Return the most threads Minimize() may use, or 0 for no limit.
+    return mMaxThreads;};
   virtual void SetSize(std::size_t);
 
   virtual std::size_t GetNumEqualities() = 0;
@@ -148,10 +387,17 @@ public:
   const std::vector<tmDifferentiableFn*>& GetConstraints() const {
     return mConstraints;
   };
+  const std::vector<ConstraintKind>& GetConstraintKinds() const {
+    return mConstraintKinds;
+  };
+  const std::vector<double>& GetLowerBounds() const {
+    return mLowerBounds;};
+  const std::vector<double>& GetUpperBounds() const {
+    return mUpperBounds;};
   
   // Setting up the problem
   virtual void SetObjective(tmDifferentiableFn* f);
-  void AddConstraint(tmDifferentiableFn* f);
+  void AddConstraint(tmDifferentiableFn* f, ConstraintKind kind);
   virtual void AddLinearEquality(tmDifferentiableFn* f) = 0;
   virtual void AddNonlinearEquality(tmDifferentiableFn* f) = 0;
   virtual void AddLinearInequality(tmDifferentiableFn* f) = 0;
@@ -161,6 +407,14 @@ public:
     
   // Performing the optimization
   virtual int Minimize(std::vector<double>& x) = 0;
+  Result MinimizeWithin(std::vector<double>& x, double deadline, 
+    const tmNLCOCancelToken* token = 0);
+  double GetViolation(const std::vector<double>& x) const;
+  
+  // Warm starting from the state of a previous optimization. The default
+  // doesn't support it, so always starts cold.
+  virtual void SetWarmStart(const tmNLCOWarmStart&) {};
+  virtual bool GetWarmStart(tmNLCOWarmStart&) {return false;};
   
   // UI updating from the objective function
   virtual void ObjectiveUpdateUI();
@@ -168,6 +422,23 @@ public:
 protected:
   std::size_t mSize;        // dimensionality of the problem
   tmNLCOUpdater* mUpdater;  // object that shows progress
+  std::size_t mMaxThreads;  // most threads Minimize() may use, 0 = no limit
+  
+  void RecordBounds(const std::vector<double>& bl, 
+    const std::vector<double>& bu);
+  
+  // Limits on time and cancellation in MinimizeWithin()
+  bool IsBudgeted() const {
+    // Return true if we're inside MinimizeWithin().
+    return mBudgeted;};
+  double GetDeadline() const {
+    // Return the deadline of MinimizeWithin(), or 0 if none.
+    return mBudgeted ? mDeadline : 0;};
+  const tmNLCOCancelToken* GetCancelToken() const {
+    // Return the token of MinimizeWithin(), if any.
+    return mBudgeted ? mCancelToken : 0;};
+  void CheckBudget();
+  void RecordIterate(const std::vector<double>& x);
 
   // Utility for copying between dimensioned vectors and C arrays in which size
   // is always taken from the vector.
@@ -177,9 +448,25 @@ protected:
     for (std::size_t i = 0; i < src.size(); ++i) dst[i] = src[i];};
 
 private:
+  // Thrown by CheckBudget() to stop the minimization
+  class EX_STOPPED {
+  public:
+    Status mStatus;   // TIMED_OUT or CANCELLED
+    EX_STOPPED(Status status) : mStatus(status) {};
+  };
+  
   static Algorithm sAlgorithm;                    // which algorithm to use
   tmDifferentiableFn* mObjective;                 // Objective to minimize
   std::vector<tmDifferentiableFn*> mConstraints;  // Ineq & eq constraints
+  std::vector<ConstraintKind> mConstraintKinds;   // kind of each constraint
+  std::vector<double> mLowerBounds;               // lower bound per variable
+  std::vector<double> mUpperBounds;               // upper bound per variable
+  bool mBudgeted;                                 // inside MinimizeWithin()
+  double mDeadline;                               // wall time to stop, or 0
+  const tmNLCOCancelToken* mCancelToken;          // token to check, or 0
+  std::vector<double> mBestX;                     // best point so far
+  double mBestObjective;                          // objective at mBestX
+  double mBestViolation;                          // violation at mBestX
 };
 
 
@@ -203,4 +490,8 @@ Include header files for the supported nonlinear constrained optimizer classes.
   #include "tmNLCO_wnlib.h"
 #endif
 
+#ifdef tmUSE_PORTFOLIO
+  #include "tmNLCO_portfolio.h"
+#endif
+
 #endif // _TMNLCO_H_
@@ -39,16 +39,300 @@ inline T1 MAX(const T1& t1, const T2& t2) {return (t1 < t2) ? t2 : t1; };
 template <class T>
 inline T SQR(const T& t) {return t * t;};
 
+// Most constraints of one block evaluated together by AugLagSlice()
+const size_t k_ALM_Max_Run = 256;
+
+/**********
+class AugLagWeight
+Gives the multiple of a constraint's gradient that goes into the gradient of
+the augmented Lagrangian, which depends on the constraint's value, so that
+constraints can compute value and gradient together. Returns 0 for inactive
+inequalities and for negligible multiples, so their gradient is skipped.
+**********/
+class AugLagWeight : public tmDifferentiableFn::GradWeight {
+public:
+  double mLagMul;       // Lagrangian multiplier of the current constraint
+  double mWeight;       // penalty weight
+  double mTol;          // multiples smaller than this are ignored
+  bool mIsInequality;   // true = inequality constraint
+  
+  AugLagWeight(double weight, double tol, bool isInequality) : 
+    mLagMul(0), mWeight(weight), mTol(tol), mIsInequality(isInequality) {};
+  double GetWeight(double f) {
+    // Return the multiple of the gradient, or 0 to skip it.
+    if (mIsInequality && f < -0.5 * mLagMul / mWeight) return 0;
+    double gmul = mLagMul + 2 * f * mWeight;
+    return (fabs(gmul) > mTol) ? gmul : 0;};
+};
+
+
+/**********
+class UnitWeight
+Gives a multiple of 1, so that FuncAddGrad() adds the plain gradient.
+**********/
+class UnitWeight : public tmDifferentiableFn::GradWeight {
+public:
+  double GetWeight(double) {
+    // Always add the whole gradient.
+    return 1.0;};
+};
+
+
+/**********
+class tmNLCO_alm::LBFGSHistory
+The limited-memory BFGS approximation to the inverse Hessian. Rather than
+storing the full inverse Hessian, we store the last few step and gradient-change
+pairs (s, y) and apply the inverse Hessian to a vector with the two-loop
+recursion, which takes O(k*n) memory and time for a history of length k.
+**********/
+class tmNLCO_alm::LBFGSHistory {
+public:
+  LBFGSHistory(size_t size, size_t history) : 
+    mS(history, vector<double>(size)), mY(history, vector<double>(size)),
+    mRho(history), mAlpha(history), mFirst(0), mCount(0) {};
+  void Clear() {
+    // Forget all pairs, which makes the inverse Hessian the identity.
+    mFirst = 0; mCount = 0;};
+  size_t GetNumPairs() const {
+    // Return the number of pairs stored.
+    return mCount;};
+  void GetPair(size_t j, vector<double>& s, vector<double>& y) const {
+    // Return the j-th pair, counting from the oldest.
+    size_t n = (mFirst + j) % mS.size(); s = mS[n]; y = mY[n];};
+  void Add(const vector<double>& s, const vector<double>& y, double sy);
+  void ApplyNegInverse(const vector<double>& g, vector<double>& dir);
+private:
+  vector< vector<double> > mS;  // recent steps, used as a ring buffer
+  vector< vector<double> > mY;  // recent changes in gradient
+  vector<double> mRho;          // 1 / (y . s) for each pair
+  vector<double> mAlpha;        // scratch for the two-loop recursion
+  size_t mFirst;                // index of the oldest pair
+  size_t mCount;                // number of pairs stored
+};
+
+
+/*****
+Add a step s and gradient change y with y.s = sy to the history, replacing the
+oldest pair if the history is full.
+*****/
+void tmNLCO_alm::LBFGSHistory::Add(const vector<double>& s,
+  const vector<double>& y, double sy)
+{
+  size_t k = mS.size();
+  size_t n;
+  if (mCount < k) n = (mFirst + mCount++) % k;
+  else {
+    n = mFirst;
+    mFirst = (mFirst + 1) % k;
+  }
+  mS[n] = s;
+  mY[n] = y;
+  mRho[n] = 1.0 / sy;
+}
+
+
+/*****
+Set dir = -H * g, where H is the current approximation to the inverse Hessian.
+With an empty history H is the identity, which gives steepest descent, as for
+the dense update. Otherwise the initial H is the identity scaled by s.y / y.y
+of the most recent pair.
+*****/
+void tmNLCO_alm::LBFGSHistory::ApplyNegInverse(const vector<double>& g, 
+  vector<double>& dir)
+{
+  size_t k = mS.size();
+  size_t size = g.size();
+  for (size_t i = 0; i < size; ++i) dir[i] = -g[i];
+  if (mCount == 0) return;
+  
+  // First loop, newest to oldest pair
+  for (size_t j = mCount; j > 0; --j) {
+    size_t n = (mFirst + j - 1) % k;
+    const vector<double>& s = mS[n];
+    double a = 0.0;
+    for (size_t i = 0; i < size; ++i) a += s[i] * dir[i];
+    a *= mRho[n];
+    mAlpha[n] = a;
+    const vector<double>& y = mY[n];
+    for (size_t i = 0; i < size; ++i) dir[i] -= a * y[i];
+  }
+  
+  // Scale by the initial inverse Hessian
+  size_t nl = (mFirst + mCount - 1) % k;
+  const vector<double>& yl = mY[nl];
+  double yy = 0.0;
+  for (size_t i = 0; i < size; ++i) yy += SQR(yl[i]);
+  double gamma = 1.0 / (mRho[nl] * yy);
+  for (size_t i = 0; i < size; ++i) dir[i] *= gamma;
+  
+  // Second loop, oldest to newest pair
+  for (size_t j = 0; j < mCount; ++j) {
+    size_t n = (mFirst + j) % k;
+    const vector<double>& y = mY[n];
+    double b = 0.0;
+    for (size_t i = 0; i < size; ++i) b += y[i] * dir[i];
+    b = mAlpha[n] - mRho[n] * b;
+    const vector<double>& s = mS[n];
+    for (size_t i = 0; i < size; ++i) dir[i] += b * s[i];
+  }
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCO_alm::AugLagTask
+Runs one thread's share of the constraint terms of the augmented Lagrangian
+(value alone or value and gradient), of the sum of the per-thread gradients, or
+of the screening of the inequalities.
+**********/
+class tmNLCO_alm::AugLagTask : public tmWorkerPool::Task {
+public:
+  enum Mode {
+    FUNC,
+    GRAD,
+    REDUCE,
+    SCREEN
+  };
+  tmNLCO_alm* mALM;         // the optimizer whose terms we're computing
+  Mode mMode;               // what to compute
+  const vector<double>* mX; // current point
+  vector<double>* mGrad;    // gradient of the augmented Lagrangian
+  
+  AugLagTask(tmNLCO_alm* alm, Mode mode, const vector<double>& x, 
+    vector<double>* grad) : mALM(alm), mMode(mode), mX(&x), mGrad(grad) {};
+  void Run(size_t i, size_t n) {
+    // Do slice i of n of the work.
+    if (mMode == REDUCE) mALM->ReduceSlice(i, n, *mGrad);
+    else if (mMode == SCREEN) mALM->ScreenSlice(i, n, *mX);
+    else mALM->AugLagSlice(i, n, *mX, (mMode == GRAD) ? mGrad : 0);};
+};
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
 /**********
 class tmNLCO_alm
 Nonlinear constrained optimizer using the Augmented Lagrangian Multiplier method
 **********/
 
 /*****
-Constructor
+Static variable initialization
+*****/
+size_t tmNLCO_alm::sLBFGSHistory = 10;
+size_t tmNLCO_alm::sNumThreads = 0;
+bool tmNLCO_alm::sScreening = true;
+bool tmNLCO_alm::sBlocks = true;
+
+
+/*****
+STATIC
+Return the history length used by optimizers created for the ALM_LBFGS
+algorithm.
 *****/
-tmNLCO_alm::tmNLCO_alm()
-  : mNumBnds(0), mWeight(0), mObjective(NULL)
+size_t tmNLCO_alm::GetLBFGSHistory()
+{
+  return sLBFGSHistory;
+}
+
+
+/*****
+STATIC
+Set the history length used by optimizers created for the ALM_LBFGS algorithm,
+which will affect all future optimizations. Must be nonzero.
+*****/
+void tmNLCO_alm::SetLBFGSHistory(size_t history)
+{
+  TMASSERT(history > 0);
+  sLBFGSHistory = history;
+}
+
+
+/*****
+STATIC
+Return the maximum number of threads used to evaluate constraints, or 0 if we
+use one per processor.
+*****/
+size_t tmNLCO_alm::GetNumThreads()
+{
+  return sNumThreads;
+}
+
+
+/*****
+STATIC
+Set the maximum number of threads used to evaluate constraints in future
+optimizations; 0 means one per processor. Results are reproducible for a given
+number of threads, but can differ in the last few bits from one number of
+threads to another, since sums are taken in a different order.
+*****/
+void tmNLCO_alm::SetNumThreads(size_t numThreads)
+{
+  sNumThreads = numThreads;
+}
+
+
+/*****
+STATIC
+Return true if inequality constraints that are slack by a wide margin are left
+out of the inner minimization.
+*****/
+bool tmNLCO_alm::GetScreening()
+{
+  return sScreening;
+}
+
+
+/*****
+STATIC
+Turn screening of slack inequality constraints on or off for future
+optimizations. Screening doesn't change which point we converge to (beyond
+roundoff) but it can greatly reduce the work per iteration when most
+inequalities are slack, as with the leaf paths of a large tree.
+*****/
+void tmNLCO_alm::SetScreening(bool screening)
+{
+  sScreening = screening;
+}
+
+
+/*****
+STATIC
+Return true if constraints of the types that have a block form (see
+tmConstraintBlock) are evaluated a block at a time.
+*****/
+bool tmNLCO_alm::GetBlocks()
+{
+  return sBlocks;
+}
+
+
+/*****
+STATIC
+Turn evaluation of blocks of constraints on or off for future optimizations.
+The results are the same either way; blocks are just faster.
+*****/
+void tmNLCO_alm::SetBlocks(bool blocks)
+{
+  sBlocks = blocks;
+}
+
+
+/*****
+Constructor. If history is nonzero, the inner minimization uses limited-memory
+BFGS with this many correction pairs; if zero, it uses the full (dense) BFGS
+inverse Hessian.
+*****/
+tmNLCO_alm::tmNLCO_alm(size_t history)
+  : mNumBnds(0), mWeight(0), mObjective(NULL), mHistory(history), mPool(0),
+  mDormantSum(0), mAllActive(false), mLBFGS(0),
+  mWarmHessian(false), mWarmWeight(0)
 {
 }
 
@@ -58,6 +342,8 @@ Destructor. Destroy owned constraint functions.
 *****/
 tmNLCO_alm::~tmNLCO_alm()
 {
+  if (mPool) delete mPool;
+  if (mLBFGS) delete mLBFGS;
   if (mObjective) delete mObjective;
   for (size_t i = 0; i < mEqns.size(); ++i) delete mEqns[i];
   for (size_t i = 0; i < mIneqns.size(); ++i) delete mIneqns[i];
@@ -81,7 +367,7 @@ Add a linear equality constraint
 *****/
 void tmNLCO_alm::AddLinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_EQUALITY);
   mEqns.push_back(f);
 }
 
@@ -91,7 +377,7 @@ Add a nonlinear equality constraint.
 *****/
 void tmNLCO_alm::AddNonlinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_EQUALITY);
   mEqns.push_back(f);
 }
 
@@ -101,7 +387,7 @@ Add a linear inequality constraint.
 *****/
 void tmNLCO_alm::AddLinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_INEQUALITY);
   mIneqns.push_back(f);
 }
 
@@ -111,7 +397,7 @@ Add a nonlinear inequality constraint
 *****/
 void tmNLCO_alm::AddNonlinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_INEQUALITY);
   mIneqns.push_back(f);
 }
 
@@ -140,6 +426,7 @@ Record lower and upper bounds in member variables
 void tmNLCO_alm::SetBounds(const vector<double>& bl, const vector<double>& bu)
 {
   TMASSERT(bl.size() == bu.size());
+  RecordBounds(bl, bu);
   mbl = bl;
   mbu = bu;
   mNumBnds = bl.size();
@@ -151,6 +438,118 @@ void tmNLCO_alm::SetBounds(const vector<double>& bl, const vector<double>& bu)
 #endif
 
 
+/*****
+Start the next call to Minimize() from the state at the end of an earlier
+optimization of a similar problem: its multipliers, penalty weight, and
+inverse Hessian approximation. This must be called after all constraints and
+bounds have been added. If the state doesn't fit this problem (different
+numbers of constraints or variables), we ignore it and start cold; an inverse
+Hessian of the wrong kind (dense vs. L-BFGS) is ignored on its own.
+*****/
+void tmNLCO_alm::SetWarmStart(const tmNLCOWarmStart& ws)
+{
+  mWarmLagMul.clear();
+  mWarmWeight = 0;
+  mWarmHessian = false;
+  
+  // Multipliers are given in the order the constraints were added; we keep
+  // them with equalities first, then inequalities, then the bounds.
+  const vector<tmDifferentiableFn*>& fns = GetConstraints();
+  size_t ne = mEqns.size();
+  size_t ni = mIneqns.size();
+  if (ws.mMultipliers.size() != fns.size() || ws.mWeight <= 0) return;
+  if (!ws.mLowerMultipliers.empty() && 
+    ws.mLowerMultipliers.size() != mNumBnds) return;
+  if (!ws.mUpperMultipliers.empty() && 
+    ws.mUpperMultipliers.size() != mNumBnds) return;
+  mWarmLagMul.assign(ne + ni + 2 * mNumBnds, 0.);
+  size_t ie = 0, ii = 0;
+  for (size_t k = 0; k < fns.size(); ++k) {
+    if (ie < ne && fns[k] == mEqns[ie]) mWarmLagMul[ie++] = ws.mMultipliers[k];
+    else if (ii < ni && fns[k] == mIneqns[ii]) 
+      mWarmLagMul[ne + ii++] = ws.mMultipliers[k];
+  }
+  TMASSERT(ie == ne && ii == ni);
+  for (size_t i = 0; i < ws.mLowerMultipliers.size(); ++i)
+    mWarmLagMul[ne + ni + i] = ws.mLowerMultipliers[i];
+  for (size_t i = 0; i < ws.mUpperMultipliers.size(); ++i)
+    mWarmLagMul[ne + ni + mNumBnds + i] = ws.mUpperMultipliers[i];
+  mWarmWeight = ws.mWeight;
+  
+  // Inverse Hessian, if it's of our kind. For L-BFGS, pairs that aren't
+  // sufficiently positive (which can happen if they were pieced together
+  // from a different problem) are dropped.
+  if (mHistory) {
+    if (ws.mSteps.empty() || ws.mSteps.size() != ws.mGradSteps.size()) return;
+    if (!mLBFGS) mLBFGS = new LBFGSHistory(mSize, mHistory);
+    mLBFGS->Clear();
+    const double EPS = numeric_limits<double>::epsilon();
+    for (size_t j = 0; j < ws.mSteps.size(); ++j) {
+      const vector<double>& s = ws.mSteps[j];
+      const vector<double>& y = ws.mGradSteps[j];
+      if (s.size() != mSize || y.size() != mSize) continue;
+      double sy(0.0), ss(0.0), yy(0.0);
+      for (size_t i = 0; i < mSize; ++i) {
+        sy += s[i] * y[i];
+        ss += SQR(s[i]);
+        yy += SQR(y[i]);
+      }
+      if (sy > sqrt(EPS * ss * yy)) mLBFGS->Add(s, y, sy);
+    }
+    mWarmHessian = (mLBFGS->GetNumPairs() > 0);
+  }
+  else {
+    if (ws.mHessInv.size() != mSize) return;
+    for (size_t i = 0; i < mSize; ++i)
+      if (ws.mHessInv[i].size() != mSize) return;
+    mHessInv = ws.mHessInv;
+    mWarmHessian = true;
+  }
+}
+
+
+/*****
+Return the state at the end of the last call to Minimize(), for warm-starting
+a later optimization. Return false if we haven't minimized anything yet.
+*****/
+bool tmNLCO_alm::GetWarmStart(tmNLCOWarmStart& ws)
+{
+  ws.Clear();
+  size_t ne = mEqns.size();
+  size_t ni = mIneqns.size();
+  if (mLagMul.size() != ne + ni + 2 * mNumBnds) return false;
+  const vector<tmDifferentiableFn*>& fns = GetConstraints();
+  ws.mMultipliers.resize(fns.size());
+  size_t ie = 0, ii = 0;
+  for (size_t k = 0; k < fns.size(); ++k) {
+    if (ie < ne && fns[k] == mEqns[ie]) ws.mMultipliers[k] = mLagMul[ie++];
+    else if (ii < ni && fns[k] == mIneqns[ii]) 
+      ws.mMultipliers[k] = mLagMul[ne + ii++];
+  }
+  ws.mLowerMultipliers.assign(mLagMul.begin() + ne + ni, 
+    mLagMul.begin() + ne + ni + mNumBnds);
+  ws.mUpperMultipliers.assign(mLagMul.begin() + ne + ni + mNumBnds, 
+    mLagMul.end());
+  ws.mWeight = mWeight;
+  if (mHistory) {
+    if (mLBFGS) {
+      size_t np = mLBFGS->GetNumPairs();
+      ws.mSteps.resize(np);
+      ws.mGradSteps.resize(np);
+      for (size_t j = 0; j < np; ++j) 
+        mLBFGS->GetPair(j, ws.mSteps[j], ws.mGradSteps[j]);
+    }
+  }
+  else ws.mHessInv = mHessInv;
+  return true;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
 /*****
 Override the default behavior of updating the screen every time the objective
 function is called because in ALM, we do our own screen updating in the
@@ -182,13 +581,55 @@ int tmNLCO_alm::Minimize(vector<double>& x)
   const double TOL_FEAS = 1.0e-5;      // tolerance on feasibility
   const double TOL_F = 1.0e-5;      // tolerance on objective function value
   const double ITER_OUTER_MAX = 50;    // maximum number of outer iterations
+  const size_t MIN_CONSTRAINTS_PER_THREAD = 256;  // less isn't worth a thread
+  const double SCREEN_RADIUS = 0.02;  // initial screening radius / mMaxStep
   
   size_t ne = mEqns.size();
   size_t ni = mIneqns.size();
   
+  // Set up the threads that evaluate the constraints, giving each thread
+  // enough constraints to be worth the cost of synchronization, and staying
+  // within our share of the processors. Each thread other than the first gets
+  // its own gradient buffer.
+  size_t numThreads = 
+    sNumThreads ? sNumThreads : tmWorkerPool::GetNumProcessors();
+  if (mMaxThreads && numThreads > mMaxThreads) numThreads = mMaxThreads;
+  size_t maxThreads = MAX((ne + ni) / MIN_CONSTRAINTS_PER_THREAD, size_t(1));
+  if (numThreads > maxThreads) numThreads = maxThreads;
+  if (!mPool || mPool->GetNumThreads() != numThreads) {
+    if (mPool) delete mPool;
+    mPool = new tmWorkerPool(numThreads);
+  }
+  numThreads = mPool->GetNumThreads();
+  mSliceVals.assign(numThreads, 0.);
+  mSliceGrads.assign(numThreads, vector<double>());
+  for (size_t i = 1; i < numThreads; ++i) mSliceGrads[i].resize(mSize);
+  
+  // Copy the constraints of the types that have a block form into blocks,
+  // indexed like mLagMul, and give each thread space to evaluate a run of
+  // them.
+  mBlockSet.Clear();
+  if (sBlocks) {
+    vector<tmDifferentiableFn*> fns(mEqns);
+    fns.insert(fns.end(), mIneqns.begin(), mIneqns.end());
+    mBlockSet.Build(fns);
+  }
+  mBlockRuns.assign(numThreads, BlockRun());
+  for (size_t i = 0; i < numThreads; ++i) {
+    BlockRun& run = mBlockRuns[i];
+    run.mCons.resize(k_ALM_Max_Run);
+    run.mPos.resize(k_ALM_Max_Run);
+    run.mVals.resize(k_ALM_Max_Run);
+    run.mFacs.resize(k_ALM_Max_Run);
+    run.mWork.resize(k_ALM_Max_Run * MAX(mBlockSet.GetWorkSize(), size_t(1)));
+  }
+  
   // Initialize Lagrangian multipliers. Note: mNumBnds = 0 if we haven't set
-  // bounds, = mSize if we have.
+  // bounds, = mSize if we have. A warm start supplies its own multipliers.
   mLagMul.assign(ne + ni + 2 * mNumBnds, 0.);
+  if (mWarmLagMul.size() == mLagMul.size()) mLagMul.swap(mWarmLagMul);
+  mWarmLagMul.clear();
+  if (mHistory && !mLBFGS) mLBFGS = new LBFGSHistory(mSize, mHistory);
   
   // Set the maximum step size for line searches to be the space diagonal of
   // the mNumBnds-dimensional box defined by the upper and lower bounds.
@@ -200,8 +641,26 @@ int tmNLCO_alm::Minimize(vector<double>& x)
     mMaxStep = 1;
   }
   
+  // Set up screening of the inequalities, which gives each thread its own
+  // scratch space for the gradients of the inequalities. Without screening
+  // radii, every constraint stays in the working set. The radii start out as
+  // a fraction of the longest line search step and adapt to how far each
+  // variable actually moves.
+  mScreenRadius.clear();
+  mScreenX.clear();
+  mDormant.assign(ni, false);
+  mActive.clear();
+  mDormantSum = 0;
+  if (sScreening) {
+    mScreenRadius.assign(mSize, SCREEN_RADIUS * mMaxStep);
+    mScreenMargin.resize(ni);
+    mScreenGrads.assign(numThreads, vector<double>(mSize, 0.));
+    mScreenVars.assign(numThreads, vector<size_t>());
+  }
+  
   size_t iter_outer = 1;
-  mWeight = WEIGHT_START;
+  mWeight = (mWarmWeight > 0) ? mWarmWeight : WEIGHT_START;
+  mWarmWeight = 0;
   double fval_old = 1.e30;
   while (iter_outer < ITER_OUTER_MAX) {
     size_t iter_inner = 0;
@@ -289,6 +748,9 @@ int tmNLCO_alm::Minimize(vector<double>& x)
 #endif
     // Get the value of the objective function (NOT the same as f_alm).
     double fval = mObjective->Func(x);
+    
+    // If we're running under a budget, this iterate might be the best so far.
+    if (IsBudgeted()) RecordIterate(x);
 
 #if DEBUG_SHOW_PROGRESS
     stringstream info;
@@ -337,6 +799,7 @@ int tmNLCO_alm::Minimize(vector<double>& x)
     // ALM handles updating a bit differently from the generic approach. Since
     // we have access to our outer loop, we update the screen here rather than
     // calling the updating function from our objective.
+    CheckBudget();
     if (mUpdater) mUpdater->UpdateUI();
   }
   // If we got here, we never found a feasible solution.
@@ -359,27 +822,41 @@ void tmNLCO_alm::MinimizeAugLag(vector<double>& x, size_t &iter_inner,
   const double EPS = numeric_limits<double>::epsilon();
   const double TOL_X = 4 * EPS;
   const double TOL_G = 1.0e-5;
+  const size_t SCREEN_INTERVAL = 20;  // iterations between screenings
 
-  // Calculate starting function value and gradient.
-  f_min = AugLagFn(x);
-  TM_CHECK_NAN(f_min);
+  // Choose the working set of constraints, then calculate starting function
+  // value and gradient.
+  Screen(x);
   vector<double> g(mSize);
-  AugLagGrad(x, g);
-  TM_CHECK_NAN(g);
+  f_min = AugLagGrad(x, g);
+  TM_CHECK_NAN(f_min);
   
-  // Initialize the inverse Hessian matrix and the search direction.
-  tmMatrix<double> hess_inv(mSize, mSize);
+  // Initialize the inverse Hessian matrix and the search direction. With a
+  // nonzero history we only keep the limited-memory approximation. After a
+  // warm start, the first minimization starts from the approximation we were
+  // given rather than from the identity.
   vector<double> srch_dir(mSize);
-  for (size_t i = 0; i < mSize; ++i) {
-    for (size_t j = 0; j < mSize; ++j) hess_inv[i][j] = 0.0;
-    hess_inv[i][i] = 1.0;
-    srch_dir[i] = -g[i];
+  if (mWarmHessian) {
+    SearchDirAugLag(g, srch_dir);
+    mWarmHessian = false;
+  }
+  else {
+    if (mHistory) mLBFGS->Clear();
+    else mHessInv.resize(mSize, mSize);
+    for (size_t i = 0; i < mSize; ++i) {
+      if (!mHistory) {
+        for (size_t j = 0; j < mSize; ++j) mHessInv[i][j] = 0.0;
+        mHessInv[i][i] = 1.0;
+      }
+      srch_dir[i] = -g[i];
+    }
   }
 
   // Enter the main iteration loop.
   vector<double> x_new(mSize), dg(mSize), hdg(mSize);
   for (size_t iter = 1; iter <= ITER_INNER_MAX; ++iter) {
     iter_inner = iter;
+    CheckBudget();
     LineSearchAugLag(x, f_min, g, srch_dir, x_new, f_min);
     
     // Update the search direction and current point
@@ -388,16 +865,36 @@ void tmNLCO_alm::MinimizeAugLag(vector<double>& x, size_t &iter_inner,
       x[i] = x_new[i];
     }
     
-    // Construct a test for convergence of step size
+    // Every so often, and whenever we've moved far enough that a dormant
+    // constraint might have come into play, choose the working set again.
+    // (The line search includes every constraint at such points, so f_min is
+    // still right.) If a dormant constraint turns out to be in play inside the
+    // screening radius, f_min was wrong, so we take the next step afresh.
+    if (!mScreenRadius.empty()) {
+      bool outside = IsOutsideScreen(x);
+      if ((outside || iter % SCREEN_INTERVAL == 0) && Screen(x) && !outside) {
+        f_min = AugLagGrad(x, g);
+        SearchDirAugLag(g, srch_dir);
+        continue;
+      }
+    }
+    
+    // Construct a test for convergence of step size. Before we declare
+    // convergence, we make sure the dormant constraints are still dormant.
     double xtest = 0.0;
     for (size_t i = 0; i < mSize; ++i) {
       double xtemp = fabs(srch_dir[i]) / MAX(fabs(x[i]), 1.0);
       if (xtemp > xtest) xtest = xtemp;
     }
-    if (xtest < TOL_X) return;
+    if (xtest < TOL_X) {
+      if (!Screen(x)) return;
+      f_min = AugLagGrad(x, g);
+      SearchDirAugLag(g, srch_dir);
+      continue;
+    }
     
     // Keep a copy of the old gradient and construct a new one at the
-    // (new) current point.
+    // (new) current point. (The line search already gave us the value.)
     for (size_t i = 0; i < mSize; ++i) dg[i] = g[i];
     AugLagGrad(x, g);
     TM_CHECK_NAN(g);
@@ -409,14 +906,35 @@ void tmNLCO_alm::MinimizeAugLag(vector<double>& x, size_t &iter_inner,
       double gtemp = fabs(g[i]) * MAX(fabs(x[i]), 1.0) / den;
       if (gtemp > gtest) gtest = gtemp;
     }
-    if (gtest < TOL_G) return;
+    if (gtest < TOL_G) {
+      if (!Screen(x)) return;
+      f_min = AugLagGrad(x, g);
+      SearchDirAugLag(g, srch_dir);
+      continue;
+    }
     
-    // Compute the difference between the previous and new gradient and
-    // its product with the current inverse Hessian matrix.
+    // Compute the difference between the previous and new gradient.
     for (size_t i = 0; i < mSize; ++i) dg[i] = g[i] - dg[i];
+    
+    // For limited-memory BFGS, record the new pair if it's sufficiently
+    // positive (the same test as below) and get the next search direction.
+    if (mHistory) {
+      double fac(0.0), sumdg(0.0), sumxi(0.0);
+      for (size_t i = 0; i < mSize; ++i) {
+        fac += dg[i] * srch_dir[i];
+        sumdg += SQR(dg[i]);
+        sumxi += SQR(srch_dir[i]);
+      }
+      if (fac > sqrt(EPS * sumdg * sumxi)) mLBFGS->Add(srch_dir, dg, fac);
+      SearchDirAugLag(g, srch_dir);
+      continue;
+    }
+    
+    // Compute the product of the gradient difference with the current
+    // inverse Hessian matrix.
     for (size_t i = 0; i < mSize; ++i) {
       hdg[i] = 0.0;
-      for (size_t j = 0; j < mSize; ++j) hdg[i] += hess_inv[i][j] * dg[j];
+      for (size_t j = 0; j < mSize; ++j) hdg[i] += mHessInv[i][j] * dg[j];
     }
     
     // Calculate dot products used in denominators
@@ -439,25 +957,40 @@ void tmNLCO_alm::MinimizeAugLag(vector<double>& x, size_t &iter_inner,
         dg[i] = fac * srch_dir[i] - fad * hdg[i];
       for (size_t i = 0; i < mSize; ++i) {
         for (size_t j = i; j < mSize; ++j) {
-          hess_inv[i][j] += fac * srch_dir[i] * srch_dir[j] - 
+          mHessInv[i][j] += fac * srch_dir[i] * srch_dir[j] - 
             fad * hdg[i] * hdg[j] + fae * dg[i] * dg[j];
-          hess_inv[j][i] = hess_inv[i][j];
+          mHessInv[j][i] = mHessInv[i][j];
         }
       }
     }
     
     // Finally, calculate the next search direction
-    for (size_t i = 0; i < mSize; ++i) {
-      srch_dir[i] = 0.0;
-      for (size_t j = 0; j < mSize; ++j) 
-        srch_dir[i] -= hess_inv[i][j] * g[j];
-    }
+    SearchDirAugLag(g, srch_dir);
   }
   // If we ended the loop without returning, we've exceeded the number of
   // iterations. Since our outer loop will try again, we can just keep going.
 }
 
 
+/*****
+Compute the quasi-Newton search direction -H*g from the gradient g, using
+the dense or the limited-memory inverse Hessian.
+*****/
+void tmNLCO_alm::SearchDirAugLag(const vector<double>& g, 
+  vector<double>& srch_dir)
+{
+  if (mHistory) {
+    mLBFGS->ApplyNegInverse(g, srch_dir);
+    return;
+  }
+  for (size_t i = 0; i < mSize; ++i) {
+    srch_dir[i] = 0.0;
+    for (size_t j = 0; j < mSize; ++j) 
+      srch_dir[i] -= mHessInv[i][j] * g[j];
+  }
+}
+
+
 /*****
 Perform a minimization of the Augmented Lagrangian along a line.
 x_old = the previous location
@@ -489,15 +1022,20 @@ void tmNLCO_alm::LineSearchAugLag(const vector<double>& x_old,
       srch_dir[i] *= mMaxStep / dir_mag;
   
   // Check the search direction against the old gradient. If we're going
-  // uphill, then we don't want to search any more. NR's version of this
-  // routine reports an error, but we'll just let the minimizer restart,
-  // hopefully, with a better search direction.
+  // uphill (or nowhere, as when the gradient vanishes), then we don't want to
+  // search any more. NR's version of this routine reports an error, but we'll
+  // just stay put and let the minimizer restart, hopefully, with a better
+  // search direction.
   double slope = 0.0;
   for (size_t i = 0; i < mSize; ++i) 
     slope += g_old[i] * srch_dir[i];
 
   // TBD, better check?
-  if (slope >= 0.0) return;
+  if (slope >= 0.0) {
+    x_new = x_old;
+    f_new = f_old;
+    return;
+  }
 
   // Compute the minimum step length
   double lmtest = 0.0;
@@ -567,23 +1105,20 @@ double tmNLCO_alm::AugLagFn(const vector<double>& x)
   size_t ni = mIneqns.size();
 
   // Compute objective function value
-  double fret = mObjective->Func(x);
-
-  // Accumulate contributions from equality constraints
-  for (size_t i = 0; i < ne; ++i) {
-    tmDifferentiableFn* eqn = mEqns[i];
-    const double& lm = mLagMul[i];
-    double f = eqn->Func(x);
-    fret += (lm + f * mWeight) * f;
-  }
-  // Contributions from inequality constraints
-  for (size_t i = 0; i < ni; ++i) {
-    tmDifferentiableFn* ineqn = mIneqns[i];
-    const double& lm = mLagMul[i + ne];
-    double f = ineqn->Func(x);
-    double mu = -0.5 * lm / mWeight;
-    fret += (f < mu) ? mu : (lm + f * mWeight) * f;
-  }
+  mSliceVals[0] = mObjective->Func(x);
+
+  // Accumulate contributions from the working set of constraints, split among
+  // our threads, then add up the threads' sums in order. The dormant
+  // constraints each contribute a constant, unless x is so far from where we
+  // chose the working set that we must include them all.
+  mAllActive = IsOutsideScreen(x);
+  AugLagTask task(this, AugLagTask::FUNC, x, 0);
+  mPool->Run(task);
+  double fret = mSliceVals[0];
+  for (size_t i = 1; i < mSliceVals.size(); ++i) fret += mSliceVals[i];
+  if (!mAllActive) fret += mDormantSum;
+  mAllActive = false;
+
   // Contributions from lower bounds
   for (size_t i = 0; i < mNumBnds; ++i) {
     const double& lm = mLagMul[i + ne + ni];
@@ -603,9 +1138,13 @@ double tmNLCO_alm::AugLagFn(const vector<double>& x)
 
 
 /*****
-Gradient of the augmented Lagrangian
+Value and gradient of the augmented Lagrangian. Each active constraint adds
+its own (sparse) gradient directly into g, so the cost is proportional to the
+number of nonzero gradient entries rather than to the number of constraints
+times the number of variables; and each constraint computes its value and
+gradient in a single pass. The returned value is identical to AugLagFn(x).
 *****/
-void tmNLCO_alm::AugLagGrad(const vector<double>& x, vector<double>& g)
+double tmNLCO_alm::AugLagGrad(const vector<double>& x, vector<double>& g)
 {
   TM_CHECK_NAN(mLagMul);
 
@@ -614,50 +1153,30 @@ void tmNLCO_alm::AugLagGrad(const vector<double>& x, vector<double>& g)
   size_t ni = mIneqns.size();
   const double tol_lm = 4.0 * numeric_limits<double>::epsilon();
 
-  // Create a scratch pad for individual constraint gradients
-  static vector<double> gscr;
-  gscr.resize(mSize);
-  
-  // compute gradient of objective
-  mObjective->Grad(x, g);
+  // compute value and gradient of objective
+  mSliceVals[0] = mObjective->FuncGrad(x, g);
   TM_CHECK_NAN(g);
 
-  // Accumulate contributions from equality constraints.
-  for (size_t i = 0; i < ne; ++i) {
-    tmDifferentiableFn* eqn = mEqns[i];
-    const double& lm = mLagMul[i];
-    double f = eqn->Func(x);
-    TM_CHECK_NAN(f);
-    double gmul = lm + 2 * f * mWeight;
-    if (fabs(gmul) > tol_lm) {
-      eqn->Grad(x, gscr);
-      TM_CHECK_NAN(gscr);
-      for (size_t j = 0; j < mSize; ++j) 
-        g[j] += gmul * gscr[j];
-    }
-  }
-  // Contributions from inequality constraints
-  for (size_t i = 0; i < ni; ++i) {
-    tmDifferentiableFn* ineqn = mIneqns[i];
-    const double& lm = mLagMul[i + ne];
-    double f = ineqn->Func(x);
-    TM_CHECK_NAN(f);
-    double mu = -0.5 * lm / mWeight;
-    if (f >= mu) {
-      double gmul = lm + 2 * f * mWeight;
-      if (fabs(gmul) > tol_lm) {
-        ineqn->Grad(x, gscr);
-          TM_CHECK_NAN(gscr);
-        for (size_t j = 0; j < mSize; ++j) 
-          g[j] += gmul * gscr[j];
-      }
-    }
+  // Accumulate contributions from the working set of constraints, split among
+  // our threads. Then add the other threads' gradients into g, and their sums
+  // into the total, in order. The dormant constraints each contribute a
+  // constant and no gradient.
+  AugLagTask task(this, AugLagTask::GRAD, x, &g);
+  mPool->Run(task);
+  if (mSliceVals.size() > 1) {
+    AugLagTask reduce(this, AugLagTask::REDUCE, x, &g);
+    mPool->Run(reduce);
   }
+  double fret = mSliceVals[0];
+  for (size_t i = 1; i < mSliceVals.size(); ++i) fret += mSliceVals[i];
+  fret += mDormantSum;
+
   // Contributions from lower bounds
   for (size_t i = 0; i < mNumBnds; ++i) {
     const double& lm = mLagMul[i + ne + ni];
     double f = mbl[i] - x[i];
     double mu = -0.5 * lm / mWeight;
+    fret += (f < mu) ? mu : (lm + f * mWeight) * f;
     if (f >= mu) {
       double gmul = lm + 2 * f * mWeight;
       if (fabs(gmul) > tol_lm) {
@@ -670,6 +1189,7 @@ void tmNLCO_alm::AugLagGrad(const vector<double>& x, vector<double>& g)
     const double& lm = mLagMul[i + ne + ni + mNumBnds];
     double f = x[i] - mbu[i];
     double mu = -0.5 * lm / mWeight;
+    fret += (f < mu) ? mu : (lm + f * mWeight) * f;
     if (f >= mu) {
       double gmul = lm + 2 * f * mWeight;
       if (fabs(gmul) > tol_lm) {
@@ -677,6 +1197,299 @@ void tmNLCO_alm::AugLagGrad(const vector<double>& x, vector<double>& g)
       }
     }
   }
+  TM_CHECK_NAN(g);
+  return fret;
+}
+
+
+/*****
+Compute slice i of n of the constraint terms of the augmented Lagrangian, and
+if gradx is non-null, their gradient. The working set of constraints (or all
+of them, if mAllActive is set) is split into n contiguous ranges. Slice 0
+continues the sum in mSliceVals[0] and adds its gradient directly to gradx;
+the other slices start from zero in mSliceVals[i] and mSliceGrads[i]. So with
+one thread, the terms are summed in exactly the same order as without threads.
+Only constraint functions and the slice's own entries are touched, so slices
+can run in parallel. Runs of constraints from the same block are evaluated by
+the block, which gives the same values and adds the same gradients in the same
+order as the constraints themselves would.
+*****/
+void tmNLCO_alm::AugLagSlice(size_t i, size_t n, const vector<double>& x, 
+  vector<double>* gradx)
+{
+  size_t ne = mEqns.size();
+  size_t na = mAllActive ? ne + mIneqns.size() : mActive.size();
+  size_t abeg = na * i / n;
+  size_t aend = na * (i + 1) / n;
+  double fret = (i == 0) ? mSliceVals[0] : 0.;
+  
+  // Value only
+  if (!gradx) {
+    for (size_t a = abeg; a < aend;) {
+      size_t k = mAllActive ? a : mActive[a];
+      if (IsBlocked(k)) {
+        BlockRun& run = GatherRun(i, a, aend);
+        mBlockSet.GetBlock(run.mBlock)->Func(x, &run.mPos[0], run.mSize, 
+          &run.mVals[0], &run.mWork[0]);
+        for (size_t j = 0; j < run.mSize; ++j) {
+          k = run.mCons[j];
+          const double& lm = mLagMul[k];
+          double f = run.mVals[j];
+          if (k < ne) fret += (lm + f * mWeight) * f;
+          else {
+            double mu = -0.5 * lm / mWeight;
+            fret += (f < mu) ? mu : (lm + f * mWeight) * f;
+          }
+        }
+        continue;
+      }
+      const double& lm = mLagMul[k];
+      if (k < ne) {
+        double f = mEqns[k]->Func(x);
+        fret += (lm + f * mWeight) * f;
+      }
+      else {
+        double f = mIneqns[k - ne]->Func(x);
+        double mu = -0.5 * lm / mWeight;
+        fret += (f < mu) ? mu : (lm + f * mWeight) * f;
+      }
+      ++a;
+    }
+    mSliceVals[i] = fret;
+    return;
+  }
+  
+  // Value and gradient
+  vector<double>& g = (i == 0) ? *gradx : mSliceGrads[i];
+  if (i != 0) g.assign(g.size(), 0.);
+  const double tol_lm = 4.0 * numeric_limits<double>::epsilon();
+  AugLagWeight eqWeight(mWeight, tol_lm, false);
+  AugLagWeight ineqWeight(mWeight, tol_lm, true);
+  for (size_t a = abeg; a < aend;) {
+    size_t k = mAllActive ? a : mActive[a];
+    if (IsBlocked(k)) {
+      BlockRun& run = GatherRun(i, a, aend);
+      tmConstraintBlock* block = mBlockSet.GetBlock(run.mBlock);
+      block->Func(x, &run.mPos[0], run.mSize, &run.mVals[0], &run.mWork[0]);
+      for (size_t j = 0; j < run.mSize; ++j) {
+        k = run.mCons[j];
+        const double& lm = mLagMul[k];
+        double f = run.mVals[j];
+        TM_CHECK_NAN(f);
+        if (k < ne) {
+          eqWeight.mLagMul = lm;
+          run.mFacs[j] = eqWeight.GetWeight(f);
+          fret += (lm + f * mWeight) * f;
+        }
+        else {
+          ineqWeight.mLagMul = lm;
+          run.mFacs[j] = ineqWeight.GetWeight(f);
+          double mu = -0.5 * lm / mWeight;
+          fret += (f < mu) ? mu : (lm + f * mWeight) * f;
+        }
+      }
+      block->AddGrad(x, &run.mPos[0], run.mSize, &run.mFacs[0], 
+        &run.mWork[0], g);
+      continue;
+    }
+    const double& lm = mLagMul[k];
+    if (k < ne) {
+      eqWeight.mLagMul = lm;
+      double f = mEqns[k]->FuncAddGrad(x, eqWeight, g);
+      TM_CHECK_NAN(f);
+      fret += (lm + f * mWeight) * f;
+    }
+    else {
+      ineqWeight.mLagMul = lm;
+      double f = mIneqns[k - ne]->FuncAddGrad(x, ineqWeight, g);
+      TM_CHECK_NAN(f);
+      double mu = -0.5 * lm / mWeight;
+      fret += (f < mu) ? mu : (lm + f * mWeight) * f;
+    }
+    ++a;
+  }
+  mSliceVals[i] = fret;
+}
+
+
+/*****
+Return true if the k-th constraint (indexed like mLagMul) is in a block.
+*****/
+bool tmNLCO_alm::IsBlocked(size_t k) const
+{
+  return mBlockSet.GetNumBlocks() != 0 && 
+    mBlockSet.GetBlockIndex(k) != tmConstraintBlockSet::BAD_OFFSET;
+}
+
+
+/*****
+Gather into thread i's run the constraints of the working set from position a
+(whose constraint must be in a block) up to the first that's in a different
+block or isn't in one, position aend, or the most that a run can hold. Advance
+a past them and return the run.
+*****/
+tmNLCO_alm::BlockRun& tmNLCO_alm::GatherRun(size_t i, size_t& a, size_t aend)
+{
+  BlockRun& run = mBlockRuns[i];
+  run.mBlock = mBlockSet.GetBlockIndex(mAllActive ? a : mActive[a]);
+  run.mSize = 0;
+  while (a < aend && run.mSize < k_ALM_Max_Run) {
+    size_t k = mAllActive ? a : mActive[a];
+    if (mBlockSet.GetBlockIndex(k) != run.mBlock) break;
+    run.mCons[run.mSize] = k;
+    run.mPos[run.mSize] = mBlockSet.GetPos(k);
+    ++run.mSize;
+    ++a;
+  }
+  return run;
+}
+
+
+/*****
+Add the gradients of slices 1..n-1 into gradx, for the i-th of n contiguous
+ranges of variables. The slices are always added in the same order.
+*****/
+void tmNLCO_alm::ReduceSlice(size_t i, size_t n, vector<double>& gradx)
+{
+  size_t jbeg = mSize * i / n;
+  size_t jend = mSize * (i + 1) / n;
+  for (size_t k = 1; k < mSliceGrads.size(); ++k) {
+    const vector<double>& gk = mSliceGrads[k];
+    for (size_t j = jbeg; j < jend; ++j) gradx[j] += gk[j];
+  }
+}
+
+
+
+/*****
+Return true if some variable has moved farther than its screening radius from
+where we last chose the working set, so that a dormant constraint might have
+come into play.
+*****/
+bool tmNLCO_alm::IsOutsideScreen(const vector<double>& x)
+{
+  if (mScreenRadius.empty()) return false;
+  for (size_t i = 0; i < mSize; ++i)
+    if (fabs(x[i] - mScreenX[i]) > mScreenReach[i]) return true;
+  return false;
+}
+
+
+/*****
+Choose the working set of constraints at the point x. Equalities are always in
+the working set. An inequality is left out (is dormant) if its slack is well
+over the most that it could change while each variable stays within its
+screening radius; a dormant inequality contributes a constant to the augmented
+Lagrangian and nothing to its gradient. The radii follow the variables: each
+one becomes four times the distance the variable moved since the last
+screening, or half of its old value, whichever is more (but never tiny).
+Return true if a constraint that was dormant is in play at x, in which case
+the values we've computed since the last screening were not those of the true
+augmented Lagrangian.
+*****/
+bool tmNLCO_alm::Screen(const vector<double>& x)
+{
+  const double SCREEN_SAFETY = 2.0;  // allowance for gradients that change
+  const double SCREEN_GROWTH = 4.0;  // radius relative to last move
+  const double SCREEN_DECAY = 0.5;   // shrinkage of radius without moves
+  const double SCREEN_MIN_RADIUS = 1.0e-4;  // smallest radius / mMaxStep
+  
+  size_t ne = mEqns.size();
+  size_t ni = mIneqns.size();
+  
+  // Without screening, everything is in the working set.
+  if (mScreenRadius.empty()) {
+    if (mActive.size() == ne + ni) return false;
+    mActive.resize(ne + ni);
+    for (size_t k = 0; k < ne + ni; ++k) mActive[k] = k;
+    return false;
+  }
+  
+  // Update the radii from the moves since last time.
+  if (!mScreenX.empty())
+    for (size_t i = 0; i < mSize; ++i) {
+      double& radius = mScreenRadius[i];
+      radius = MAX(SCREEN_GROWTH * fabs(x[i] - mScreenX[i]), 
+        SCREEN_DECAY * radius);
+      radius = MAX(radius, SCREEN_MIN_RADIUS * mMaxStep);
+    }
+  
+  // Find the margin by which each inequality is out of play, splitting the
+  // work among our threads.
+  AugLagTask task(this, AugLagTask::SCREEN, x, 0);
+  mPool->Run(task);
+  
+  // Rebuild the working set, and add up the constant terms of the rest. Each
+  // variable can go as far as its radius times the smallest margin of the
+  // dormant inequalities that depend on it (less our safety factor) without
+  // bringing any of them into play.
+  bool missed = false;
+  mActive.clear();
+  for (size_t k = 0; k < ne; ++k) mActive.push_back(k);
+  mDormantSum = 0;
+  mScreenReach.assign(mSize, numeric_limits<double>::max());
+  vector<size_t>& vars = mScreenVars[0];
+  for (size_t k = 0; k < ni; ++k) {
+    double r = mScreenMargin[k];
+    if (mDormant[k] && r <= 0) missed = true;
+    mDormant[k] = (r > SCREEN_SAFETY);
+    if (!mDormant[k]) {
+      mActive.push_back(k + ne);
+      continue;
+    }
+    mDormantSum += -0.5 * mLagMul[k + ne] / mWeight;
+    vars.clear();
+    mIneqns[k]->GetVars(vars);
+    for (size_t j = 0; j < vars.size(); ++j) {
+      double reach = mScreenRadius[vars[j]] * r / SCREEN_SAFETY;
+      if (mScreenReach[vars[j]] > reach) mScreenReach[vars[j]] = reach;
+    }
+  }
+  mScreenX = x;
+  return missed;
+}
+
+
+/*****
+Screen slice i of n of the inequality constraints at the point x, putting into
+mScreenMargin the ratio of each inequality's slack to the most it can change
+while the variables stay within their screening radii, or 0 if it's in play
+now. Functions that can't tell us which variables they depend on get a margin
+of 0, so they're always in the working set.
+*****/
+void tmNLCO_alm::ScreenSlice(size_t i, size_t n, const vector<double>& x)
+{
+  size_t ne = mEqns.size();
+  size_t ni = mIneqns.size();
+  size_t kbeg = ni * i / n;
+  size_t kend = ni * (i + 1) / n;
+  vector<double>& g = mScreenGrads[i];
+  vector<size_t>& vars = mScreenVars[i];
+  UnitWeight unitWeight;
+  for (size_t k = kbeg; k < kend; ++k) {
+    tmDifferentiableFn* fn = mIneqns[k];
+    if (!fn->IsSparse()) {
+      mScreenMargin[k] = 0;
+      continue;
+    }
+    
+    // The slack is the amount the function can grow before its term in the
+    // augmented Lagrangian is no longer constant. Moves within the radii
+    // change the function by at most the sum of the magnitudes of the
+    // gradient times the radii.
+    double slack = -0.5 * mLagMul[k + ne] / mWeight - 
+      fn->FuncAddGrad(x, unitWeight, g);
+    double bound = 0;
+    vars.clear();
+    fn->GetVars(vars);
+    for (size_t j = 0; j < vars.size(); ++j) {
+      bound += fabs(g[vars[j]]) * mScreenRadius[vars[j]];
+      g[vars[j]] = 0;
+    }
+    if (slack <= 0) mScreenMargin[k] = 0;
+    else mScreenMargin[k] = 
+      (bound > 0) ? slack / bound : numeric_limits<double>::max();
+  }
 }
 
 #endif // tmUSE_ALM
@@ -12,6 +12,7 @@ Copyright:    
 #define _TMNLCO_ALM_H_
 
 #include "tmNLCO.h"
+#include "tmWorkerPool.h"
 
 /**********
 class tmNLCO_alm
@@ -24,8 +25,20 @@ public:
     ERROR_TOO_MANY_ITERATIONS = 1
   };
 
-  tmNLCO_alm();
+  tmNLCO_alm(std::size_t history = 0);
   ~tmNLCO_alm();
+  tmNLCO* MakeEmpty() const {
+    // Return a new optimizer like this one, with no problem set up.
+    return new tmNLCO_alm(mHistory);};
+  
+  static std::size_t GetLBFGSHistory();
+  static void SetLBFGSHistory(std::size_t history);
+  static std::size_t GetNumThreads();
+  static void SetNumThreads(std::size_t numThreads);
+  static bool GetScreening();
+  static void SetScreening(bool screening);
+  static bool GetBlocks();
+  static void SetBlocks(bool blocks);
 
   void SetObjective(tmDifferentiableFn* f);
   void AddLinearEquality(tmDifferentiableFn* f);
@@ -39,6 +52,8 @@ public:
   void SetBounds(const std::vector<double>& bl, const std::vector<double>& bu);
   
   int Minimize(std::vector<double>& x);
+  void SetWarmStart(const tmNLCOWarmStart& ws);
+  bool GetWarmStart(tmNLCOWarmStart& ws);
   
   void ObjectiveUpdateUI();
   
@@ -52,13 +67,64 @@ private:
   std::vector<tmDifferentiableFn*> mEqns;    // equality constraints
   std::vector<tmDifferentiableFn*> mIneqns;  // inequality constraints
   double mMaxStep;              // maximum step size in line searches
+  std::size_t mHistory;         // L-BFGS history length, 0 = dense BFGS
+  static std::size_t sLBFGSHistory;  // history length for ALM_LBFGS
+  static std::size_t sNumThreads;    // max threads, 0 = one per processor
+  tmWorkerPool* mPool;          // threads for evaluating constraints
+  std::vector<double> mSliceVals;              // per-thread sums
+  std::vector< std::vector<double> > mSliceGrads;  // per-thread gradients
+  static bool sScreening;            // true = drop slack inequalities
+  std::vector<double> mScreenRadius; // expected move of each variable
+  std::vector<double> mScreenReach;  // how far each variable may move
+  std::vector<double> mScreenX;      // x at the last screening
+  std::vector<double> mScreenMargin; // slack over bound on change, per ineq.
+  std::vector<bool> mDormant;        // inequalities left out of working set
+  std::vector<std::size_t> mActive;  // constraints in the working set
+  double mDormantSum;                // sum of the dormant terms
+  bool mAllActive;                   // true = ignore the working set
+  std::vector< std::vector<double> > mScreenGrads;  // per-thread scratch
+  std::vector< std::vector<std::size_t> > mScreenVars;  // per-thread scratch
+  static bool sBlocks;               // true = evaluate blocks of constraints
+  tmConstraintBlockSet mBlockSet;    // blocks of mEqns, then mIneqns
+  
+  class BlockRun {
+  public:
+    std::size_t mBlock;              // block of the constraints in the run
+    std::size_t mSize;               // number of constraints in the run
+    std::vector<std::size_t> mCons;  // index of each into mLagMul
+    std::vector<std::size_t> mPos;   // position of each in the block
+    std::vector<double> mVals;       // value of each
+    std::vector<double> mFacs;       // multiple of the gradient of each
+    std::vector<double> mWork;       // work space for the block
+  };
+  std::vector<BlockRun> mBlockRuns;  // per-thread scratch
+  
+  class LBFGSHistory;
+  tmMatrix<double> mHessInv;    // dense inverse Hessian (if mHistory = 0)
+  LBFGSHistory* mLBFGS;         // L-BFGS inverse Hessian (if mHistory > 0)
+  bool mWarmHessian;            // true = inverse Hessian is from a warm start
+  std::vector<double> mWarmLagMul;  // warm start multipliers, or empty
+  double mWarmWeight;           // warm start penalty weight, or 0
+  
+  class AugLagTask;
+  friend class AugLagTask;
   
   void MinimizeAugLag(std::vector<double>& x, std::size_t &iter, double &f_min);
+  void SearchDirAugLag(const std::vector<double>& g, 
+    std::vector<double>& srch_dir);
   void LineSearchAugLag(const std::vector<double>& x_old, const double f_old, 
     const std::vector<double>& g_old, std::vector<double>& srch_dir, 
     std::vector<double>& x_new, double &f_new);
   double AugLagFn(const std::vector<double>& x);
-  void AugLagGrad(const std::vector<double>& x, std::vector<double>& gradx);
+  double AugLagGrad(const std::vector<double>& x, std::vector<double>& gradx);
+  void AugLagSlice(std::size_t i, std::size_t n, const std::vector<double>& x,
+    std::vector<double>* gradx);
+  void ReduceSlice(std::size_t i, std::size_t n, std::vector<double>& gradx);
+  bool IsBlocked(std::size_t k) const;
+  BlockRun& GatherRun(std::size_t i, std::size_t& a, std::size_t aend);
+  bool IsOutsideScreen(const std::vector<double>& x);
+  bool Screen(const std::vector<double>& x);
+  void ScreenSlice(std::size_t i, std::size_t n, const std::vector<double>& x);
 
 };
 
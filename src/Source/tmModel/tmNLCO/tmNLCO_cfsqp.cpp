@@ -114,7 +114,7 @@ Add a linear equality constraint to the problem.
 *****/
 void tmNLCO_cfsqp::AddLinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_EQUALITY);
   mLinEqns.push_back(f);
 }
 
@@ -124,7 +124,7 @@ Add an nonlinear equality constraint to the problem.
 *****/
 void tmNLCO_cfsqp::AddNonlinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_EQUALITY);
   mNonlinEqns.push_back(f);
 }
 
@@ -134,7 +134,7 @@ Add a linear inequality constraint to the problem.
 *****/
 void tmNLCO_cfsqp::AddLinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_INEQUALITY);
   mLinIneqns.push_back(f);
 }
 
@@ -144,7 +144,7 @@ Add an nonlinear inequality constraint to the problem.
 *****/
 void tmNLCO_cfsqp::AddNonlinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_INEQUALITY);
   mNonlinIneqns.push_back(f);
 }
 
@@ -174,6 +174,7 @@ than once.
 void tmNLCO_cfsqp::SetBounds(const vector<double>& abl, const vector<double>& abu)
 {
   TMASSERT(nb == 0);
+  RecordBounds(abl, abu);
   bl = abl;
   bu = abu;
   nb = 2 * mSize;
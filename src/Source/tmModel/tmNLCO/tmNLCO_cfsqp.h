@@ -32,6 +32,9 @@ public:
   };
   tmNLCO_cfsqp();
   ~tmNLCO_cfsqp();
+  tmNLCO* MakeEmpty() const {
+    // Return a new optimizer like this one, with no problem set up.
+    return new tmNLCO_cfsqp();};
   
   void SetObjective(tmDifferentiableFn* f);
   void AddLinearEquality(tmDifferentiableFn* f);
@@ -0,0 +1,604 @@
+/*******************************************************************************
+File:         tmNLCO_portfolio.cpp
+Project:      TreeMaker 5.x
+Purpose:      Implementation file for NLCO that races several other NLCOs
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#include "tmNLCO.h"
+#ifdef tmUSE_PORTFOLIO
+#include "tmNLCO_portfolio.h"
+#include "tmWorkerPool.h"
+
+using namespace std;
+
+/*
+Notes.
+Each backend is an ordinary tmNLCO, made by tmNLCO::MakeNLCO() on the thread
+that runs it (wnlib keeps its memory in per-thread groups, so its optimizers
+mustn't move between threads) and minimized with MinimizeWithin(), using our
+deadline and a cancellation token that is a child of our own. The first
+backend to come back converged and feasible cancels the token, so the others
+stop at their next check and report CANCELLED. The objective of every backend
+is wrapped in a BackendFn, which calls the backend's ObjectiveUpdateUI() on
+each evaluation, so that backends that check their budget there (wnlib) hear
+about the cancellation promptly.
+
+If two backends come back acceptable at nearly the same time, the one that
+finished first wins, so which one wins can vary from run to run; either
+answer is a converged, feasible point.
+*/
+
+/*****
+Return true if result a is better than result b: a feasible result beats an
+infeasible one, feasible ones are compared by objective, and infeasible ones
+by violation, as in tmNLCO::RecordIterate().
+*****/
+static bool IsBetterResult(const tmNLCO::Result& a, const tmNLCO::Result& b)
+{
+  if (a.mFeasible != b.mFeasible) return a.mFeasible;
+  if (a.mFeasible) return a.mObjective < b.mObjective;
+  return a.mViolation < b.mViolation;
+}
+
+
+/*****
+Return the backends used by default: every compiled-in optimizer that is
+robust enough to be worth racing.
+*****/
+static vector<tmNLCO::Algorithm> GetDefaultBackends()
+{
+  vector<tmNLCO::Algorithm> backends;
+#ifdef tmUSE_ALM
+  backends.push_back(tmNLCO::ALM);
+#endif
+#ifdef tmUSE_WNLIB
+  backends.push_back(tmNLCO::WNLIB);
+#endif
+  return backends;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCO_portfolio::BackendFn
+A function handed to a backend that evaluates another function, which we may
+or may not own. If it's the objective, each evaluation also lets the backend
+check its budget and, for the lead backend, evaluates the portfolio's own
+objective at the same point, so that whatever the caller sees through it
+(e.g., progress in the UI) follows the lead backend.
+**********/
+class tmNLCO_portfolio::BackendFn : public tmDifferentiableFn {
+public:
+  tmDifferentiableFn* mFn;    // the function we evaluate
+  bool mOwned;                // true = we delete mFn
+  tmNLCO* mNLCO;              // backend whose objective we are, or 0
+  tmDifferentiableFn* mLeadFn;  // function to call at each point, or 0
+
+  BackendFn(tmDifferentiableFn* aFn, bool owned) :
+    mFn(aFn), mOwned(owned), mNLCO(0), mLeadFn(0) {};
+  ~BackendFn() {
+    // Delete the function if it's ours.
+    if (mOwned) delete mFn;};
+  double Func(const vector<double>& x) {
+    // Report the point, then evaluate.
+    Report(x);
+    return mFn->Func(x);};
+  void Grad(const vector<double>& x, vector<double>& gradx) {
+    // Forward to the function.
+    mFn->Grad(x, gradx);};
+  void AddGrad(const vector<double>& x, double fac, vector<double>& gradx) {
+    // Forward to the function.
+    mFn->AddGrad(x, fac, gradx);};
+  double FuncGrad(const vector<double>& x, vector<double>& gradx) {
+    // Report the point, then evaluate.
+    Report(x);
+    return mFn->FuncGrad(x, gradx);};
+  double FuncAddGrad(const vector<double>& x, GradWeight& gw,
+    vector<double>& gradx) {
+    // Report the point, then evaluate.
+    Report(x);
+    return mFn->FuncAddGrad(x, gw, gradx);};
+  bool IsSparse() const {
+    // Forward to the function.
+    return mFn->IsSparse();};
+  void GetVars(vector<size_t>& vars) {
+    // Forward to the function.
+    mFn->GetVars(vars);};
+  bool GetLinear(vector<double>& coefs, double& constant) const {
+    // Forward to the function.
+    return mFn->GetLinear(coefs, constant);};
+private:
+  void Report(const vector<double>& x) {
+    // Pass the point to the lead function and let the backend check in.
+    if (mLeadFn) mLeadFn->Func(x);
+    if (mNLCO) mNLCO->ObjectiveUpdateUI();};
+};
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCO_portfolio::RaceTask
+Task that runs every n-th backend on each of n threads, on copies of the
+problem if MakeCopies() succeeded, otherwise on the portfolio's own functions
+(in which case it must be run as a single slice). Holds everything the
+backends produce besides their results and times.
+**********/
+class tmNLCO_portfolio::RaceTask : public tmWorkerPool::Task {
+public:
+  tmNLCO_portfolio* mOwner;             // the portfolio
+  vector<double> mStart;                // starting point
+  double mDeadline;                     // deadline for every backend, or 0
+  tmNLCOCancelToken mToken;             // cancelled by the first winner
+  double mStartTime;                    // wall time when the race began
+  vector<vector<tmDifferentiableFn*> > mCopies;  // objective, constraints
+  vector<vector<double> > mXs;          // point returned by each backend
+  vector<tmNLCOWarmStart> mWarmStarts;  // final state of acceptable backends
+  vector<char> mHasWarmStart;           // nonzero = mWarmStarts[k] is valid
+
+  RaceTask(tmNLCO_portfolio* owner, const vector<double>& x, double deadline,
+    const tmNLCOCancelToken* token);
+  ~RaceTask();
+  bool MakeCopies();
+  void Run(size_t i, size_t n);
+  void RunBackend(size_t k);
+  void DeleteCopies(size_t k);
+};
+
+
+/*****
+Constructor. The race stops early if token (if any) is cancelled.
+*****/
+tmNLCO_portfolio::RaceTask::RaceTask(tmNLCO_portfolio* owner,
+  const vector<double>& x, double deadline, const tmNLCOCancelToken* token)
+  : mOwner(owner),
+  mStart(x),
+  mDeadline(deadline),
+  mToken(token),
+  mStartTime(tmGetWallTime()),
+  mXs(owner->mBackends.size()),
+  mWarmStarts(owner->mBackends.size()),
+  mHasWarmStart(owner->mBackends.size(), 0)
+{
+}
+
+
+/*****
+Destructor. Delete any copies that weren't handed to a backend.
+*****/
+tmNLCO_portfolio::RaceTask::~RaceTask()
+{
+  for (size_t k = 0; k < mCopies.size(); ++k) DeleteCopies(k);
+}
+
+
+/*****
+Make a copy of the objective and every constraint for each backend. Return
+false, with no copies made, if any function can't be copied.
+*****/
+bool tmNLCO_portfolio::RaceTask::MakeCopies()
+{
+  const vector<tmDifferentiableFn*>& flist = mOwner->GetConstraints();
+  size_t nb = mOwner->mBackends.size();
+  mCopies.resize(nb);
+  for (size_t k = 0; k < nb; ++k) {
+    mCopies[k].reserve(1 + flist.size());
+    for (size_t j = 0; j <= flist.size(); ++j) {
+      tmDifferentiableFn* f = (j == 0) ? mOwner->GetObjective() : flist[j - 1];
+      tmDifferentiableFn* copy = f->MakeCopy();
+      if (!copy) {
+        for (size_t kk = 0; kk <= k; ++kk) DeleteCopies(kk);
+        mCopies.clear();
+        return false;
+      }
+      mCopies[k].push_back(copy);
+    }
+  }
+  return true;
+}
+
+
+/*****
+Run backends i, i + n, i + 2n, ... A worker slice mustn't throw, so a backend
+that throws on a worker thread just loses; on the calling thread (slice 0),
+the exception propagates to the caller.
+*****/
+void tmNLCO_portfolio::RaceTask::Run(size_t i, size_t n)
+{
+  for (size_t k = i; k < mOwner->mBackends.size(); k += n) {
+    if (i == 0) {
+      RunBackend(k);
+      continue;
+    }
+    try {
+      RunBackend(k);
+    }
+    catch(...) {
+      mOwner->mResults[k] = Result();
+      mXs[k].clear();
+      mHasWarmStart[k] = 0;
+    }
+  }
+}
+
+
+/*****
+Set up the k-th backend on its copy of the problem (or on the originals) and
+minimize it, recording its result, its finishing time, its point, and, if
+it's acceptable, its final state, and cancelling the rest of the race. A
+backend whose turn comes after the race is over doesn't run at all.
+*****/
+void tmNLCO_portfolio::RaceTask::RunBackend(size_t k)
+{
+  tmNLCO_portfolio* p = mOwner;
+  if (mToken.IsCancelled()) {
+    p->mResults[k].mStatus = CANCELLED;
+    if (!mCopies.empty()) DeleteCopies(k);
+    return;
+  }
+
+  // Hand the functions to the backend, which takes ownership of them.
+  bool copied = !mCopies.empty();
+  const vector<tmDifferentiableFn*>& flist = p->GetConstraints();
+  const vector<ConstraintKind>& klist = p->GetConstraintKinds();
+  tmNLCO* theNLCO = MakeNLCO(p->mBackends[k]);
+  try {
+    // Backends that race share our limit on threads.
+    if (p->GetMaxThreads()) {
+      size_t maxThreads = 
+        copied ? p->GetMaxThreads() / p->mBackends.size() : p->GetMaxThreads();
+      theNLCO->SetMaxThreads(maxThreads ? maxThreads : 1);
+    }
+    theNLCO->SetSize(p->GetNumVariables());
+    if (!p->GetLowerBounds().empty())
+      theNLCO->SetBounds(p->GetLowerBounds(), p->GetUpperBounds());
+    BackendFn* obj;
+    if (copied) {
+      obj = new BackendFn(mCopies[k][0], true);
+      mCopies[k][0] = 0;
+      if (k == 0) obj->mLeadFn = p->GetObjective();
+    }
+    else obj = new BackendFn(p->GetObjective(), false);
+    obj->mNLCO = theNLCO;
+    theNLCO->SetObjective(obj);
+    for (size_t j = 0; j < flist.size(); ++j) {
+      tmDifferentiableFn* f;
+      if (copied) {
+        f = mCopies[k][j + 1];
+        mCopies[k][j + 1] = 0;
+      }
+      else f = new BackendFn(flist[j], false);
+      switch (klist[j]) {
+        case LINEAR_EQUALITY:
+          theNLCO->AddLinearEquality(f);
+          break;
+        case NONLINEAR_EQUALITY:
+          theNLCO->AddNonlinearEquality(f);
+          break;
+        case LINEAR_INEQUALITY:
+          theNLCO->AddLinearInequality(f);
+          break;
+        case NONLINEAR_INEQUALITY:
+          theNLCO->AddNonlinearInequality(f);
+          break;
+      }
+    }
+    if (p->mHasWarmStartIn) theNLCO->SetWarmStart(p->mWarmStartIn);
+
+    // Race.
+    mXs[k] = mStart;
+    p->mResults[k] = theNLCO->MinimizeWithin(mXs[k], mDeadline, &mToken);
+    p->mTimes[k] = tmGetWallTime() - mStartTime;
+    if (p->IsAcceptable(k)) {
+      mToken.Cancel();
+      mHasWarmStart[k] = theNLCO->GetWarmStart(mWarmStarts[k]);
+    }
+  }
+  catch(...) {
+    delete theNLCO;
+    throw;
+  }
+  delete theNLCO;
+}
+
+
+/*****
+Delete the copies made for the k-th backend that it hasn't taken.
+*****/
+void tmNLCO_portfolio::RaceTask::DeleteCopies(size_t k)
+{
+  for (size_t j = 0; j < mCopies[k].size(); ++j) {
+    if (mCopies[k][j]) delete mCopies[k][j];
+    mCopies[k][j] = 0;
+  }
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCO_portfolio
+Nonlinear constrained optimizer that races several other optimizers
+**********/
+
+/*****
+Static member initialization
+*****/
+vector<tmNLCO::Algorithm> tmNLCO_portfolio::sBackends = GetDefaultBackends();
+
+
+/*****
+Constructor. We race the backends given by GetBackends().
+*****/
+tmNLCO_portfolio::tmNLCO_portfolio()
+  : mBackends(sBackends),
+  mSource(0),
+  mNumEqns(0),
+  mNumIneqns(0),
+  mHasWarmStartIn(false),
+  mHasWarmStartOut(false),
+  mWinner(NO_WINNER),
+  mResults(sBackends.size()),
+  mTimes(sBackends.size(), 0.),
+  mNumWins(sBackends.size(), 0)
+{
+  TMASSERT(!mBackends.empty());
+}
+
+
+/*****
+Destructor. Destroy owned functions.
+*****/
+tmNLCO_portfolio::~tmNLCO_portfolio()
+{
+  if (GetObjective()) delete GetObjective();
+  const vector<tmDifferentiableFn*>& flist = GetConstraints();
+  for (size_t i = 0; i < flist.size(); ++i) delete flist[i];
+}
+
+
+/*****
+Return a new optimizer with the same backends as this one and no problem set
+up. Its wins are also counted as ours.
+*****/
+tmNLCO* tmNLCO_portfolio::MakeEmpty() const
+{
+  tmNLCO_portfolio* theNLCO = new tmNLCO_portfolio();
+  theNLCO->mBackends = mBackends;
+  theNLCO->mSource = this;
+  theNLCO->mResults.assign(mBackends.size(), Result());
+  theNLCO->mTimes.assign(mBackends.size(), 0.);
+  theNLCO->mNumWins.assign(mBackends.size(), 0);
+  return theNLCO;
+}
+
+
+/*****
+STATIC
+Return the backends raced by portfolios constructed from now on.
+*****/
+const vector<tmNLCO::Algorithm>& tmNLCO_portfolio::GetBackends()
+{
+  return sBackends;
+}
+
+
+/*****
+STATIC
+Set the backends raced by portfolios constructed from now on. The list must
+not be empty and must not contain PORTFOLIO. The first one runs on the
+calling thread and drives the progress shown to the caller.
+*****/
+void tmNLCO_portfolio::SetBackends(const vector<Algorithm>& backends)
+{
+  TMASSERT(!backends.empty());
+  for (size_t k = 0; k < backends.size(); ++k)
+    TMASSERT(backends[k] != PORTFOLIO);
+  sBackends = backends;
+}
+
+
+/*****
+Set the objective function to minimize. We take ownership. This must be called
+exactly once.
+*****/
+void tmNLCO_portfolio::SetObjective(tmDifferentiableFn* f)
+{
+  TMASSERT(!GetObjective());
+  tmNLCO::SetObjective(f);
+}
+
+
+/*****
+Add a linear equality constraint
+*****/
+void tmNLCO_portfolio::AddLinearEquality(tmDifferentiableFn* f)
+{
+  AddConstraint(f, LINEAR_EQUALITY);
+  ++mNumEqns;
+}
+
+
+/*****
+Add a nonlinear equality constraint
+*****/
+void tmNLCO_portfolio::AddNonlinearEquality(tmDifferentiableFn* f)
+{
+  AddConstraint(f, NONLINEAR_EQUALITY);
+  ++mNumEqns;
+}
+
+
+/*****
+Add a linear inequality constraint
+*****/
+void tmNLCO_portfolio::AddLinearInequality(tmDifferentiableFn* f)
+{
+  AddConstraint(f, LINEAR_INEQUALITY);
+  ++mNumIneqns;
+}
+
+
+/*****
+Add a nonlinear inequality constraint
+*****/
+void tmNLCO_portfolio::AddNonlinearInequality(tmDifferentiableFn* f)
+{
+  AddConstraint(f, NONLINEAR_INEQUALITY);
+  ++mNumIneqns;
+}
+
+
+/*****
+Return the number of equality constraints
+*****/
+size_t tmNLCO_portfolio::GetNumEqualities()
+{
+  return mNumEqns;
+}
+
+
+/*****
+Return the number of inequality constraints
+*****/
+size_t tmNLCO_portfolio::GetNumInequalities()
+{
+  return mNumIneqns;
+}
+
+
+/*****
+Record lower and upper bounds, which are passed on to each backend
+*****/
+void tmNLCO_portfolio::SetBounds(const vector<double>& bl,
+  const vector<double>& bu)
+{
+  TMASSERT(bl.size() == bu.size());
+  RecordBounds(bl, bu);
+}
+
+
+/*****
+Start every backend of the next call to Minimize() from the given state.
+*****/
+void tmNLCO_portfolio::SetWarmStart(const tmNLCOWarmStart& ws)
+{
+  mHasWarmStartIn = true;
+  mWarmStartIn = ws;
+}
+
+
+/*****
+Return the final state of the backend that won the last call to Minimize(),
+if it supplied one.
+*****/
+bool tmNLCO_portfolio::GetWarmStart(tmNLCOWarmStart& ws)
+{
+  if (!mHasWarmStartOut) return false;
+  ws = mWarmStartOut;
+  return true;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Find the constrained minimum, starting with the value x and returning the
+optimum in the variable x. Returns 0 with the winner's answer if any backend
+converged to a feasible point; otherwise returns ERROR_NONE_CONVERGED with the
+best point any backend found in x.
+*****/
+int tmNLCO_portfolio::Minimize(vector<double>& x)
+{
+  TMASSERT(mSize != 0);
+  TMASSERT(x.size() == mSize);
+  size_t nb = mBackends.size();
+  mWinner = NO_WINNER;
+  mHasWarmStartOut = false;
+  mResults.assign(nb, Result());
+  mTimes.assign(nb, 0.);
+
+  // Race the backends on copies of the problem if we can. The first one runs
+  // on this thread, so that anything it throws (e.g., from the caller's
+  // objective) reaches our caller once the others have stopped. Otherwise
+  // run them one after another on the original problem.
+  RaceTask task(this, x, GetDeadline(), GetCancelToken());
+  if (nb > 1 && task.MakeCopies()) {
+    tmWorkerPool pool(nb);
+    pool.Start(task);
+    try {
+      task.Run(0, pool.GetNumThreads());
+    }
+    catch(...) {
+      task.mToken.Cancel();
+      pool.Finish();
+      throw;
+    }
+    pool.Finish();
+  }
+  else task.Run(0, 1);
+
+  // The winner is the acceptable backend that finished first.
+  for (size_t k = 0; k < nb; ++k) {
+    if (!IsAcceptable(k)) continue;
+    if (mWinner == NO_WINNER || mTimes[k] < mTimes[mWinner]) mWinner = k;
+  }
+  if (mWinner != NO_WINNER) {
+    x = task.mXs[mWinner];
+    mHasWarmStartOut = (task.mHasWarmStart[mWinner] != 0);
+    if (mHasWarmStartOut) mWarmStartOut = task.mWarmStarts[mWinner];
+    RecordWin(mWinner);
+    return 0;
+  }
+
+  // Otherwise, return the best point that any backend found. If the race was
+  // stopped by our own budget, say so.
+  size_t best = NO_WINNER;
+  for (size_t k = 0; k < nb; ++k) {
+    if (task.mXs[k].empty()) continue;
+    if (best == NO_WINNER || IsBetterResult(mResults[k], mResults[best]))
+      best = k;
+  }
+  if (best != NO_WINNER) x = task.mXs[best];
+  CheckBudget();
+  return ERROR_NONE_CONVERGED;
+}
+
+
+/*****
+Return true if the k-th backend converged to a feasible point in the last
+race.
+*****/
+bool tmNLCO_portfolio::IsAcceptable(size_t k) const
+{
+  return mResults[k].mStatus == CONVERGED && mResults[k].mFeasible;
+}
+
+
+/*****
+Count a win for the k-th backend, here and in the portfolio that made us.
+*****/
+void tmNLCO_portfolio::RecordWin(size_t k) const
+{
+  ++mNumWins[k];
+  if (mSource) mSource->RecordWin(k);
+}
+
+#endif // tmUSE_PORTFOLIO
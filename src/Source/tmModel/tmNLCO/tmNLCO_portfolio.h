@@ -0,0 +1,113 @@
+/*******************************************************************************
+File:         tmNLCO_portfolio.h
+Project:      TreeMaker 5.x
+Purpose:      Header file for NLCO that races several other NLCOs
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#ifndef _TMNLCO_PORTFOLIO_H_
+#define _TMNLCO_PORTFOLIO_H_
+
+#include "tmNLCO.h"
+
+/**********
+class tmNLCO_portfolio
+Nonlinear constrained optimizer that runs several of the other optimizers (its
+backends) on the same problem at once, each on its own thread and its own
+copy of the problem, and takes the answer of the first one to converge to a
+feasible point. Which optimizer is fastest depends on the design, so this gets
+close to the best time of all of them without having to pick one by hand.
+
+The backends are chosen by SetBackends() when the portfolio is constructed
+(by default, ALM and wnlib). Each answer is checked for feasibility as it
+arrives; the first acceptable one cancels the others, which stop at their next
+check between iterations. If none converges, the result is the best point any
+of them found. The backend that won the last call to Minimize() is reported by
+GetWinner(), and the number of times each backend has won by GetNumWins(),
+which also counts the wins of the problems MakeEmpty() made from this one
+(e.g., by tmNLCOPresolve), so that the default can be tuned.
+
+Racing needs a copy of every function for every backend (see
+tmDifferentiableFn::MakeCopy()). The first backend runs on the calling thread,
+and its objective also calls the original objective at each point it tries,
+so that the caller sees its progress. If any function can't be copied, the
+backends run one after another on the original problem until one succeeds.
+**********/
+class tmNLCO_portfolio : public virtual tmNLCO {
+public:
+  // Reasons for abnormal termination
+  enum {
+    ERROR_NONE_CONVERGED = 1
+  };
+  enum {NO_WINNER = std::size_t(-1)};
+
+  tmNLCO_portfolio();
+  ~tmNLCO_portfolio();
+  tmNLCO* MakeEmpty() const;
+
+  static const std::vector<Algorithm>& GetBackends();
+  static void SetBackends(const std::vector<Algorithm>& backends);
+
+  void SetObjective(tmDifferentiableFn* f);
+  void AddLinearEquality(tmDifferentiableFn* f);
+  void AddNonlinearEquality(tmDifferentiableFn* f);
+  void AddLinearInequality(tmDifferentiableFn* f);
+  void AddNonlinearInequality(tmDifferentiableFn* f);
+
+  std::size_t GetNumEqualities();
+  std::size_t GetNumInequalities();
+
+  void SetBounds(const std::vector<double>& bl, const std::vector<double>& bu);
+
+  int Minimize(std::vector<double>& x);
+  void SetWarmStart(const tmNLCOWarmStart& ws);
+  bool GetWarmStart(tmNLCOWarmStart& ws);
+
+  std::size_t GetNumBackends() const {
+    // Return the number of optimizers we race.
+    return mBackends.size();};
+  Algorithm GetBackend(std::size_t k) const {
+    // Return the algorithm of the k-th backend.
+    return mBackends[k];};
+  std::size_t GetWinner() const {
+    // Return the backend that won the last race, or NO_WINNER.
+    return mWinner;};
+  const Result& GetBackendResult(std::size_t k) const {
+    // Return how the k-th backend finished the last race.
+    return mResults[k];};
+  double GetBackendTime(std::size_t k) const {
+    // Return the seconds from the start of the last race until the k-th
+    // backend finished it, or 0 if it never started.
+    return mTimes[k];};
+  std::size_t GetNumWins(std::size_t k) const {
+    // Return the number of races the k-th backend has won.
+    return mNumWins[k];};
+
+private:
+  class BackendFn;
+  class RaceTask;
+  friend class RaceTask;
+
+  static std::vector<Algorithm> sBackends;  // backends of new portfolios
+
+  std::vector<Algorithm> mBackends;       // optimizers we race
+  const tmNLCO_portfolio* mSource;        // made us with MakeEmpty(), or 0
+  std::size_t mNumEqns;                   // number of equalities
+  std::size_t mNumIneqns;                 // number of inequalities
+  bool mHasWarmStartIn;                   // true = pass mWarmStartIn along
+  tmNLCOWarmStart mWarmStartIn;           // state to start the backends from
+  bool mHasWarmStartOut;                  // true = mWarmStartOut is valid
+  tmNLCOWarmStart mWarmStartOut;          // state at the end of the winner
+  std::size_t mWinner;                    // winner of the last race
+  std::vector<Result> mResults;           // result of each backend
+  std::vector<double> mTimes;             // finishing time of each backend
+  mutable std::vector<std::size_t> mNumWins;  // races won by each backend
+
+  bool IsAcceptable(std::size_t k) const;
+  void RecordWin(std::size_t k) const;
+};
+
+#endif // _TMNLCO_PORTFOLIO_H_
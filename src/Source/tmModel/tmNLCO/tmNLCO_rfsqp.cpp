@@ -124,7 +124,7 @@ Add a linear equality constraint to the problem.
 *****/
 void tmNLCO_rfsqp::AddLinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_EQUALITY);
   mLinEqns.push_back(f);
 }
 
@@ -135,7 +135,7 @@ Add an nonlinear equality constraint to the problem.
 *****/
 void tmNLCO_rfsqp::AddNonlinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_EQUALITY);
   mNonlinEqns.push_back(f);
 }
 
@@ -146,7 +146,7 @@ Add a linear inequality constraint to the problem.
 *****/
 void tmNLCO_rfsqp::AddLinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, LINEAR_INEQUALITY);
   mLinIneqns.push_back(f);
 }
 
@@ -157,7 +157,7 @@ Add an nonlinear inequality constraint to the problem.
 *****/
 void tmNLCO_rfsqp::AddNonlinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
+  AddConstraint(f, NONLINEAR_INEQUALITY);
   mNonlinIneqns.push_back(f);
 }
 
@@ -190,6 +190,7 @@ than once.
 void tmNLCO_rfsqp::SetBounds(const vector<double>& abl, const vector<double>& abu)
 {
   TMASSERT(abl.size() == abu.size());
+  RecordBounds(abl, abu);
   bl = abl;
   bu = abu;
 }
@@ -28,6 +28,9 @@ public:
   };
   tmNLCO_rfsqp();
   ~tmNLCO_rfsqp();
+  tmNLCO* MakeEmpty() const {
+    // Return a new optimizer like this one, with no problem set up.
+    return new tmNLCO_rfsqp();};
   
   void SetObjective(tmDifferentiableFn* f);
   void AddLinearEquality(tmDifferentiableFn* f);
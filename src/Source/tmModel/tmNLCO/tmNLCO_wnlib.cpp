@@ -12,6 +12,7 @@ Copyright:    
 #include "tmNLCO.h"
 #ifdef tmUSE_WNLIB
 #include "tmNLCO_wnlib.h"
+#include <algorithm>
 extern "C" { 
 #include "wnnlp.h" 
 #include "wnmem.h" 
@@ -32,17 +33,42 @@ where an exception may be thrown. But what we can do is to have wnlib get all
 its memory from a memory group that we create in the constructor; then if an
 exception is thrown, all we need to do is make sure that the exception catcher
 destroys the tmNLCO_wnlib object (which is typical behavior anyhow) and that
-the memory group is deallocated in the constructor.
-
-That creates a potential problem: if we instantiate two tmNLCO_wnlib objects,
-each will push a memory group onto wnlib's memory group stack. Freeing a memory
-group only frees the top group on the stack, so destroying one of two existing
-tmNLCO_wnlib objects could result in one object freeing up the other object's
-memory! Not good. To avoid this situation, we'll simply enforce the rule that
-there can never be more than one tmNLCO_wnlib object instantiated at one time,
-which we do with an assertion in the constructor.
+the memory group is deallocated in the destructor.
+
+wnlib allocates from whatever group is on top of its memory group stack, and
+an exception can leave wnlib's own groups pushed on top of ours. So rather than
+pushing our group onto the shared stack, each object gets its own group stack
+with its group at the bottom, and every routine that calls into wnlib switches
+to that stack for the duration of the call. Objects therefore don't disturb
+each other however their lifetimes overlap, and the destructor can free our
+group (and with it every group wnlib made inside it) no matter what was left on
+our stack.
+
+The rest of wnlib's state is either kept per-thread (the memory group stack
+pointer, the random number generator, the stop flag) or passed explicitly as
+context (wn_nlp_conj_method_r and the callbacks' client_data), so separate
+tmNLCO_wnlib objects can run on separate threads at the same time. A single
+object must be created, used, and destroyed on one thread, though, since its
+memory group hangs off that thread's default group.
 */
 
+/**********
+class GpStackSetter
+Makes a wnlib memory group stack current for the lifetime of the object, then
+restores the one that was current before, even if an exception is thrown.
+**********/
+class GpStackSetter {
+public:
+  GpStackSetter(wn_gpstack gpstack) {
+    wn_get_current_gpstack(&mSaved);
+    wn_set_current_gpstack(gpstack);};
+  ~GpStackSetter() {
+    wn_set_current_gpstack(mSaved);};
+private:
+  wn_gpstack mSaved;    // stack that was current on construction
+};
+
+
 /*****
 Constructor
 *****/
@@ -59,15 +85,15 @@ tmNLCO_wnlib::tmNLCO_wnlib()
   offset_iterations = 20;
   offset_adjust_rate = 1.;
   
-  // Do an assertion check that the default memory group is the current group.
-  // This assures that we don't have any other tmNLCO_wnlib objects
-  // instantiated, which creates the potential for memory woes if their
-  // destructors don't happen in the right order.
-  wn_memgp dgp = wn_defaultgp();
-  TMASSERT(dgp == wn_curgp());
-
-  // Create a new wnlib memory group.
+  // Create a new wnlib memory group and, inside it, our own group stack, then
+  // take the group back off the thread's stack and put it at the bottom of
+  // ours.
   wn_gpmake("no_free");
+  group = wn_curgp();
+  wn_make_gpstack(&gpstack);
+  wn_gppop();
+  GpStackSetter gs(gpstack);
+  wn_gppush(group);
 }
 
 
@@ -78,9 +104,12 @@ tmNLCO_wnlib::~tmNLCO_wnlib()
 {
   // Dispose of all tmDifferentiableFn objects we've taken ownership of.
   for (size_t i = 0; i < ownedDFs.size(); ++i) delete ownedDFs[i];
+  for (size_t i = 0; i < callbackData.size(); ++i) delete callbackData[i];
   
   // We don't need to worry about any memory allocated by wnlib because it
-  // goes away when we release the memory group, which we'll do now.
+  // goes away when we release the memory group, which we'll do now. That
+  // includes our group stack, so we free the group from the thread's stack.
+  wn_gppush(group);
   wn_gpfree();
 }
 
@@ -94,12 +123,8 @@ void tmNLCO_wnlib::SetObjective(tmDifferentiableFn* f)
   tmNLCO::SetObjective(f);
   TMASSERT(mSize != 0);
   TMASSERT(objective == NULL);
-  wn_make_nonlinear_constraint(&objective, int(mSize), WN_EQ_COMPARISON);
-  for (size_t i = 0; i < mSize; ++i) objective->vars[i] = int(i);
-  objective->pfunction = PFunction;
-  objective->pgradient = PGradient;
-  objective->client_data = f;
-  ownedDFs.push_back(f);
+  GpStackSetter gs(gpstack);
+  objective = MakeConstraint(f, WN_EQ_COMPARISON);
 }
 
 
@@ -113,15 +138,9 @@ ownership of the tmDifferentiableFn f.
 *****/
 void tmNLCO_wnlib::AddLinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
-  TMASSERT(mSize != 0);
-  wn_nonlinear_constraint_type nlc;
-  wn_make_nonlinear_constraint(&nlc, int(mSize), WN_EQ_COMPARISON);
-  for (size_t i = 0; i < mSize; ++i) nlc->vars[i] = int(i);
-  nlc->pfunction = PFunction;
-  nlc->pgradient = PGradient;
-  nlc->client_data = f;
-  ownedDFs.push_back(f);
+  AddConstraint(f, LINEAR_EQUALITY);
+  GpStackSetter gs(gpstack);
+  wn_nonlinear_constraint_type nlc = MakeConstraint(f, WN_EQ_COMPARISON);
   wn_sllins(&constraint_list, nlc);
   num_linEqns++;
 }
@@ -132,15 +151,9 @@ Create a nonlinear equality constraint.
 *****/
 void tmNLCO_wnlib::AddNonlinearEquality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
-  TMASSERT(mSize != 0);
-  wn_nonlinear_constraint_type nlc;
-  wn_make_nonlinear_constraint(&nlc, int(mSize), WN_EQ_COMPARISON);
-  for (size_t i = 0; i < mSize; ++i) nlc->vars[i] = int(i);
-  nlc->pfunction = PFunction;
-  nlc->pgradient = PGradient;
-  nlc->client_data = f;
-  ownedDFs.push_back(f);
+  AddConstraint(f, NONLINEAR_EQUALITY);
+  GpStackSetter gs(gpstack);
+  wn_nonlinear_constraint_type nlc = MakeConstraint(f, WN_EQ_COMPARISON);
   wn_sllins(&constraint_list, nlc);
   num_nonlinEqns++;
 }
@@ -151,15 +164,9 @@ Create a linear inequality constraint.
 *****/
 void tmNLCO_wnlib::AddLinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
-  TMASSERT(mSize != 0);
-  wn_nonlinear_constraint_type nlc;
-  wn_make_nonlinear_constraint(&nlc, int(mSize), WN_LT_COMPARISON);
-  for (size_t i = 0; i < mSize; ++i) nlc->vars[i] = int(i);
-  nlc->pfunction = PFunction;
-  nlc->pgradient = PGradient;
-  nlc->client_data = f;
-  ownedDFs.push_back(f);
+  AddConstraint(f, LINEAR_INEQUALITY);
+  GpStackSetter gs(gpstack);
+  wn_nonlinear_constraint_type nlc = MakeConstraint(f, WN_LT_COMPARISON);
   wn_sllins(&constraint_list, nlc);
   num_linIneqns++;
 }
@@ -170,15 +177,9 @@ Create a nonlinear inequality constraint.
 *****/
 void tmNLCO_wnlib::AddNonlinearInequality(tmDifferentiableFn* f)
 {
-  AddConstraint(f);
-  TMASSERT(mSize != 0);
-  wn_nonlinear_constraint_type nlc;
-  wn_make_nonlinear_constraint(&nlc, int(mSize), WN_LT_COMPARISON);
-  for (size_t i = 0; i < mSize; ++i) nlc->vars[i] = int(i);
-  nlc->pfunction = PFunction;
-  nlc->pgradient = PGradient;
-  nlc->client_data = f;
-  ownedDFs.push_back(f);
+  AddConstraint(f, NONLINEAR_INEQUALITY);
+  GpStackSetter gs(gpstack);
+  wn_nonlinear_constraint_type nlc = MakeConstraint(f, WN_LT_COMPARISON);
   wn_sllins(&constraint_list, nlc);
   num_nonlinIneqns++;
 }
@@ -203,6 +204,44 @@ size_t tmNLCO_wnlib::GetNumInequalities()
 }
 
 
+/*****
+Create a wnlib nonlinear constraint that calls the tmDifferentiableFn f, and
+take ownership of f. If f is sparse, the constraint lists only the variables
+that f depends on, so wnlib only passes those values to our callbacks and only
+accumulates those entries of the gradient. Our group stack must be current.
+*****/
+wn_nonlinear_constraint_type tmNLCO_wnlib::MakeConstraint(
+  tmDifferentiableFn* f, int comparison)
+{
+  TMASSERT(mSize != 0);
+  CallbackData* cd = new CallbackData;
+  cd->mNLCO = this;
+  cd->mFn = f;
+  if (f->IsSparse()) {
+    f->GetVars(cd->mVars);
+    sort(cd->mVars.begin(), cd->mVars.end());
+    cd->mVars.erase(unique(cd->mVars.begin(), cd->mVars.end()), 
+      cd->mVars.end());
+  }
+  else
+    for (size_t i = 0; i < mSize; ++i) cd->mVars.push_back(i);
+  TMASSERT(!cd->mVars.empty());
+  callbackData.push_back(cd);
+  ownedDFs.push_back(f);
+  xScratch.resize(mSize);
+  gScratch.assign(mSize, 0.);
+  
+  wn_nonlinear_constraint_type nlc;
+  wn_make_nonlinear_constraint(&nlc, int(cd->mVars.size()), comparison);
+  for (size_t i = 0; i < cd->mVars.size(); ++i) 
+    nlc->vars[i] = int(cd->mVars[i]);
+  nlc->pfunction = PFunction;
+  nlc->pgradient = PGradient;
+  nlc->client_data = cd;
+  return nlc;
+}
+
+
 /*****
 Set bounds on all of the variables. We will implement these bounds as linear
 inequality constraints.
@@ -210,6 +249,8 @@ inequality constraints.
 void tmNLCO_wnlib::SetBounds(const vector<double>& bl, const vector<double>& bu)
 {
   TMASSERT(mSize != 0);
+  RecordBounds(bl, bu);
+  GpStackSetter gs(gpstack);
   for (size_t i = 0; i < mSize; ++i) {
     // lower bound on ith variable
     wn_linear_constraint_type lcl;
@@ -238,18 +279,20 @@ int tmNLCO_wnlib::Minimize(vector<double>& x)
 {
   TMASSERT(mSize != 0);     // make sure we've set the size
   TMASSERT(objective != 0);     // and that we've set an objective
-  wn_nlp_verbose = 0;       // don't print any status information
+  GpStackSetter gs(gpstack);  // wnlib's working memory goes in our group
   
   int code;           // result code from wn_nlp_conj_method
   double val_min;         // minimum value of objective function
   double* solution_vect = &x[0];  // output result, written straight into x
   double* delta_vect = NULL;    // signifies nonlin cons have analytic gradients
 
+  int verbose = 0;          // don't print any status information
+
   // Call the optimization routine, which will return a success code and the
   // solution in variable x.
-  wn_nlp_conj_method(&code, &val_min, solution_vect, delta_vect, objective,
+  wn_nlp_conj_method_r(&code, &val_min, solution_vect, delta_vect, objective,
     constraint_list, int(mSize), conj_iterations, offset_iterations, 
-    offset_adjust_rate);
+    offset_adjust_rate, verbose);
   return code;
 }
 
@@ -258,44 +301,54 @@ int tmNLCO_wnlib::Minimize(vector<double>& x)
 STATIC
 Callback that invokes the Func(..) method for a tmDifferentiableFn. A pointer
 to this function is provided in each wn_nonlinear_constraint_type_struct.
-size = number of input variables
-values = ptr to first element of input array
-dfobj = ptr to tmDifferentiableFn object
+size = number of variables the function depends on
+values = ptr to first element of their values
+cbdata = ptr to the CallbackData for the function
 *****/
-double tmNLCO_wnlib::PFunction(int size, double* values, callbackptr dfobj)
+double tmNLCO_wnlib::PFunction(int size, double* values, callbackptr cbdata)
 {
-  TMASSERT(size > 0);
-  // x is a scratch pad that we reuse; static since PFunction isn't called
-  // recursively.
-  static vector<double> x;
-  x.resize(size_t(size));
-  for (size_t i = 0; i < size_t(size); ++i) x[i] = values[i];
-  return ((tmDifferentiableFn*)(dfobj))->Func(x);
+  CallbackData* cd = (CallbackData*)(cbdata);
+  TMASSERT(size_t(size) == cd->mVars.size());
+  // Scatter the values into the full-length point. Entries for variables the
+  // function doesn't depend on may be stale, but it doesn't look at them.
+  vector<double>& x = cd->mNLCO->xScratch;
+  for (size_t i = 0; i < size_t(size); ++i) x[cd->mVars[i]] = values[i];
+  return cd->mFn->Func(x);
 }
 
 
 /*****
 STATIC
-Callback that invokes the Grad(..) method for a tmDifferentiableFn. A pointer
-to this function is provided in each wn_nonlinear_constraint_type_struct.
-grad = ptr to first element of output array
-size = number of input variables
-values = ptr to first element of input array
-dfobj = ptr to tmDifferentiableFn object
+Callback that invokes the gradient of a tmDifferentiableFn. A pointer to this
+function is provided in each wn_nonlinear_constraint_type_struct.
+grad = ptr to first element of output array, one entry per variable
+size = number of variables the function depends on
+values = ptr to first element of their values
+cbdata = ptr to the CallbackData for the function
 *****/
 void tmNLCO_wnlib::PGradient(double* grad, int size, double* values, 
-  callbackptr dfobj)
+  callbackptr cbdata)
 {
-  TMASSERT(size > 0);
-  // x & g are scratch pads that we reuse; static since PGradient isn't called
-  // recursively.
-  static vector<double> x;
-  x.resize(size_t(size));
-  for (size_t i = 0; i < size_t(size); ++i) x[i] = values[i];
-  static vector<double> g;
-  g.resize(size_t(size));
-  ((tmDifferentiableFn*)(dfobj))->Grad(x, g);
-  for (size_t i = 0; i < size_t(size); ++i) grad[i] = g[i];
+  CallbackData* cd = (CallbackData*)(cbdata);
+  TMASSERT(size_t(size) == cd->mVars.size());
+  vector<double>& x = cd->mNLCO->xScratch;
+  vector<double>& g = cd->mNLCO->gScratch;
+  for (size_t i = 0; i < size_t(size); ++i) x[cd->mVars[i]] = values[i];
+  if (cd->mFn->IsSparse()) {
+    // Accumulate into the zeroed scratch gradient, then gather the entries
+    // and zero them again, which only touches the function's own variables.
+    cd->mFn->AddGrad(x, 1., g);
+    for (size_t i = 0; i < size_t(size); ++i) {
+      size_t j = cd->mVars[i];
+      grad[i] = g[j];
+      g[j] = 0.;
+    }
+  }
+  else {
+    cd->mFn->Grad(x, g);
+    for (size_t i = 0; i < size_t(size); ++i) grad[i] = g[cd->mVars[i]];
+    g.assign(g.size(), 0.);
+  }
 }
 
 #endif // tmUSE_WNLIB
@@ -14,6 +14,8 @@ Copyright:    
 #include "tmNLCO.h"
 
 // fwd declarations (wnlib types)
+typedef struct wn_memgp_struct *wn_memgp;
+typedef struct wn_gpstack_struct *wn_gpstack;
 typedef struct wn_sll_struct *wn_sll;
 typedef struct wn_nonlinear_constraint_type_struct 
   *wn_nonlinear_constraint_type;
@@ -29,6 +31,9 @@ class tmNLCO_wnlib : public virtual tmNLCO {
 public:
   tmNLCO_wnlib();
   ~tmNLCO_wnlib();
+  tmNLCO* MakeEmpty() const {
+    // Return a new optimizer like this one, with no problem set up.
+    return new tmNLCO_wnlib();};
 
   void SetObjective(tmDifferentiableFn* f);
   void AddLinearEquality(tmDifferentiableFn* f);
@@ -43,6 +48,8 @@ public:
   
   int Minimize(std::vector<double>& x);
 private:
+  wn_memgp group;             // memory group holding everything wnlib allocates
+  wn_gpstack gpstack;         // our own group stack, with group at bottom
   wn_nonlinear_constraint_type objective; // the sole objective function
   wn_sll constraint_list;     // singly linked list of constraints
   int conj_iterations;        // iterations in conjugate gradient algorithm
@@ -50,14 +57,27 @@ private:
   double offset_adjust_rate;  // aggressiveness in adjusting constraint offsets
 
   std::vector<tmDifferentiableFn*> ownedDFs;  // DF's we've taken ownership of
+  class CallbackData {
+    // What a constraint's callbacks need: the function and the variables
+    // (indices into the full problem) that wnlib passes to it.
+    public:
+    tmNLCO_wnlib* mNLCO;
+    tmDifferentiableFn* mFn;
+    std::vector<std::size_t> mVars;
+  };
+  std::vector<CallbackData*> callbackData;  // one per function, owned
+  std::vector<double> xScratch;   // full-length point passed to functions
+  std::vector<double> gScratch;   // full-length gradient, kept zeroed
   std::size_t num_nonlinIneqns;   // number of nonlinear inequality constraints
   std::size_t num_linIneqns;
   std::size_t num_nonlinEqns;
   std::size_t num_linEqns;
 
-  static double PFunction(int size, double* values, callbackptr dfobj);
+  wn_nonlinear_constraint_type MakeConstraint(tmDifferentiableFn* f, 
+    int comparison);
+  static double PFunction(int size, double* values, callbackptr cbdata);
   static void PGradient(double* grad, int size, double* values, 
-    callbackptr dfobj);
+    callbackptr cbdata);
 };
 
 #endif // _TMNLCO_WNLIB_H_
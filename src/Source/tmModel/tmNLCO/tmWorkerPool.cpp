@@ -0,0 +1,240 @@
+/*******************************************************************************
+File:         tmWorkerPool.cpp
+Project:      TreeMaker 5.x
+Purpose:      Implementation file for a pool of worker threads
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#include "tmWorkerPool.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <process.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+using namespace std;
+
+/**********
+class tmWorkerPool::Sync
+The lock and the two signals shared by the pool and its workers, in native
+form. mStart is signaled when a task has been posted (or the pool is quitting);
+mDone is signaled when the last slice of a task finishes.
+**********/
+class tmWorkerPool::Sync {
+public:
+#ifdef _WIN32
+  CRITICAL_SECTION mLock;
+  CONDITION_VARIABLE mStart;
+  CONDITION_VARIABLE mDone;
+  
+  Sync() {
+    InitializeCriticalSection(&mLock);
+    InitializeConditionVariable(&mStart);
+    InitializeConditionVariable(&mDone);};
+  ~Sync() {
+    DeleteCriticalSection(&mLock);};
+  void Lock() {EnterCriticalSection(&mLock);};
+  void Unlock() {LeaveCriticalSection(&mLock);};
+  void WaitStart() {SleepConditionVariableCS(&mStart, &mLock, INFINITE);};
+  void WaitDone() {SleepConditionVariableCS(&mDone, &mLock, INFINITE);};
+  void SignalStart() {WakeAllConditionVariable(&mStart);};
+  void SignalDone() {WakeConditionVariable(&mDone);};
+#else
+  pthread_mutex_t mLock;
+  pthread_cond_t mStart;
+  pthread_cond_t mDone;
+  
+  Sync() {
+    pthread_mutex_init(&mLock, 0);
+    pthread_cond_init(&mStart, 0);
+    pthread_cond_init(&mDone, 0);};
+  ~Sync() {
+    pthread_cond_destroy(&mDone);
+    pthread_cond_destroy(&mStart);
+    pthread_mutex_destroy(&mLock);};
+  void Lock() {pthread_mutex_lock(&mLock);};
+  void Unlock() {pthread_mutex_unlock(&mLock);};
+  void WaitStart() {pthread_cond_wait(&mStart, &mLock);};
+  void WaitDone() {pthread_cond_wait(&mDone, &mLock);};
+  void SignalStart() {pthread_cond_broadcast(&mStart);};
+  void SignalDone() {pthread_cond_signal(&mDone);};
+#endif // _WIN32
+};
+
+
+/**********
+class tmWorkerPool::Worker
+One worker thread, which runs slice mIndex of each task posted to the pool.
+**********/
+class tmWorkerPool::Worker {
+public:
+  tmWorkerPool* mPool;    // the owning pool
+  size_t mIndex;          // which slice this thread runs
+#ifdef _WIN32
+  HANDLE mThread;
+  static unsigned __stdcall ThreadProc(void* data) {
+    Worker* w = static_cast<Worker*>(data);
+    w->mPool->WorkerLoop(w->mIndex);
+    return 0;};
+#else
+  pthread_t mThread;
+  static void* ThreadProc(void* data) {
+    Worker* w = static_cast<Worker*>(data);
+    w->mPool->WorkerLoop(w->mIndex);
+    return 0;};
+#endif // _WIN32
+  
+  Worker(tmWorkerPool* pool, size_t index) : mPool(pool), mIndex(index) {};
+  bool Start() {
+    // Start the thread; return false if it couldn't be created.
+#ifdef _WIN32
+    mThread = (HANDLE) _beginthreadex(0, 0, ThreadProc, this, 0, 0);
+    return mThread != 0;
+#else
+    return pthread_create(&mThread, 0, ThreadProc, this) == 0;
+#endif // _WIN32
+  };
+  void Join() {
+#ifdef _WIN32
+    WaitForSingleObject(mThread, INFINITE);
+    CloseHandle(mThread);
+#else
+    pthread_join(mThread, 0);
+#endif // _WIN32
+  };
+};
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Constructor. Start up numThreads - 1 worker threads; the thread that calls
+Run() does the remaining share of the work. If the system won't give us that
+many threads, we use fewer.
+*****/
+tmWorkerPool::tmWorkerPool(size_t numThreads)
+  : mNumThreads(numThreads), mSync(0), mTask(0), mGeneration(0),
+  mNumPending(0), mQuit(false)
+{
+  TMASSERT(numThreads > 0);
+  if (mNumThreads < 1) mNumThreads = 1;
+  if (mNumThreads == 1) return;
+  mSync = new Sync();
+  for (size_t i = 1; i < mNumThreads; ++i) {
+    Worker* w = new Worker(this, i);
+    if (!w->Start()) {
+      // Out of threads; get by with the ones we have.
+      delete w;
+      mNumThreads = i;
+      break;
+    }
+    mWorkers.push_back(w);
+  }
+}
+
+
+/*****
+Destructor. Tell the workers to quit and wait for them to do so.
+*****/
+tmWorkerPool::~tmWorkerPool()
+{
+  if (!mSync) return;
+  mSync->Lock();
+  mQuit = true;
+  mSync->SignalStart();
+  mSync->Unlock();
+  for (size_t i = 0; i < mWorkers.size(); ++i) {
+    mWorkers[i]->Join();
+    delete mWorkers[i];
+  }
+  delete mSync;
+}
+
+
+/*****
+Run all slices of the task and return when they're finished.
+*****/
+void tmWorkerPool::Run(Task& task)
+{
+  Start(task);
+  task.Run(0, mNumThreads);
+  Finish();
+}
+
+
+/*****
+Post the task to the workers, which run slices 1..n-1 of it, and return
+without waiting for them. The caller is responsible for slice 0.
+*****/
+void tmWorkerPool::Start(Task& task)
+{
+  if (!mSync) return;
+  TMASSERT(mTask == 0);
+  mSync->Lock();
+  mTask = &task;
+  mNumPending = mNumThreads - 1;
+  ++mGeneration;
+  mSync->SignalStart();
+  mSync->Unlock();
+}
+
+
+/*****
+Wait for the workers to finish the slices of the task posted by Start().
+*****/
+void tmWorkerPool::Finish()
+{
+  if (!mSync) return;
+  mSync->Lock();
+  while (mNumPending > 0) mSync->WaitDone();
+  mTask = 0;
+  mSync->Unlock();
+}
+
+
+/*****
+The body of worker thread i, which runs slice i of each task posted until the
+pool is destroyed.
+*****/
+void tmWorkerPool::WorkerLoop(size_t i)
+{
+  size_t generation = 0;
+  mSync->Lock();
+  for (;;) {
+    while (!mQuit && mGeneration == generation) mSync->WaitStart();
+    if (mQuit) break;
+    generation = mGeneration;
+    Task* task = mTask;
+    mSync->Unlock();
+    task->Run(i, mNumThreads);
+    mSync->Lock();
+    if (--mNumPending == 0) mSync->SignalDone();
+  }
+  mSync->Unlock();
+}
+
+
+/*****
+STATIC
+Return the number of processors available, or 1 if we can't tell.
+*****/
+size_t tmWorkerPool::GetNumProcessors()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? size_t(n) : 1;
+#endif // _WIN32
+}
@@ -0,0 +1,73 @@
+/*******************************************************************************
+File:         tmWorkerPool.h
+Project:      TreeMaker 5.x
+Purpose:      Header file for a pool of worker threads
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#ifndef _TMWORKERPOOL_H_
+#define _TMWORKERPOOL_H_
+
+#include "tmHeader.h"
+#include <vector>
+
+/**********
+class tmWorkerPool
+A fixed set of threads that run the slices of a task in parallel. Run() calls
+task.Run(i, n) once for each i in 0..n-1, where n = GetNumThreads(); slice 0
+runs on the calling thread, and Run() doesn't return until all slices are done.
+Since each slice always runs the same i for a given n, a task that divides its
+work and combines its results by slice index gives the same answer every time
+for a given number of threads. The threads are created in the constructor and
+sleep between calls to Run(). A pool with one thread doesn't create any threads
+at all. Tasks must not throw exceptions, and only one thread at a time may call
+Run().
+
+Start() and Finish() split Run() in two, for callers that want to run slice 0
+themselves (e.g., because it may throw): Start() sets slices 1..n-1 going and
+returns at once, and Finish() waits for them. Every Start() must be followed by
+a Finish(), even if the caller's own work throws.
+**********/
+class tmWorkerPool {
+public:
+  class Task {
+  public:
+    virtual void Run(std::size_t i, std::size_t n) = 0;
+    virtual ~Task() {};
+  };
+  
+  tmWorkerPool(std::size_t numThreads);
+  ~tmWorkerPool();
+  
+  std::size_t GetNumThreads() const {
+    // Return the number of slices each task is divided into.
+    return mNumThreads;};
+  void Run(Task& task);
+  void Start(Task& task);
+  void Finish();
+  
+  static std::size_t GetNumProcessors();
+  
+private:
+  class Sync;
+  class Worker;
+  
+  std::size_t mNumThreads;          // number of slices, including the caller
+  Sync* mSync;                      // platform-specific lock and signals
+  std::vector<Worker*> mWorkers;    // threads that run slices 1..n-1
+  Task* mTask;                      // task being run
+  std::size_t mGeneration;          // incremented with each call to Run()
+  std::size_t mNumPending;          // number of slices not yet finished
+  bool mQuit;                       // true = workers should exit
+  
+  void WorkerLoop(std::size_t i);
+  
+  // Copying is not allowed
+  tmWorkerPool(const tmWorkerPool&);
+  tmWorkerPool& operator=(const tmWorkerPool&);
+};
+
+#endif // _TMWORKERPOOL_H_
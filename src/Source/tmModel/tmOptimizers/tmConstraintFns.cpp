@@ -9,14 +9,565 @@ Copyright:    
 *******************************************************************************/
 
 #include "tmConstraintFns.h"
+#include "tmNLCOProblem.h"
+
+#include <iostream>
+#include <algorithm>
+
+// Vector instructions for the batched path kernels. SSE2 is part of every
+// x86-64 processor; AVX2 is compiled in for gcc and clang and used only if the
+// processor has it. Other compilers and processors use the scalar kernels.
+#if defined(__GNUC__) && (defined(__x86_64__) || \
+  (defined(__i386__) && defined(__SSE2__)))
+  #define TM_PATH_SSE2 1
+  #define TM_PATH_AVX2 1
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define TM_PATH_SSE2 1
+  #define TM_PATH_AVX2 0
+#else
+  #define TM_PATH_SSE2 0
+  #define TM_PATH_AVX2 0
+#endif
+
+#if TM_PATH_SSE2
+  #include <emmintrin.h>
+#endif
+#if TM_PATH_AVX2
+  #include <immintrin.h>
+#endif
 
 using namespace std;
 
+// Number of path gradients computed at a time by PathFnBlock::AddGrad()
+const size_t k_Path_Chunk = 64;
+
 /*****************************************************************************
 This code implements all of the different types of constraint functions used in
 optimization.
 ******************************************************************************/
 
+/*****************************************************************************
+class ConstraintFn
+Base class for all of the constraint functions. Subclasses implement the
+sparse gradient AddGrad(), GetVars(), and SetVars(); the dense gradient is
+built from AddGrad().
+******************************************************************************/
+
+/*****
+PutVector - write the size of a vector and its elements, separated by spaces,
+for PutParams()
+*****/
+template <class T>
+static void PutVector(ostream& os, const vector<T>& v)
+{
+  os << v.size();
+  for (size_t i = 0; i < v.size(); ++i) os << " " << v[i];
+}
+
+
+/*****
+GetVector - read a vector written by PutVector()
+*****/
+template <class T>
+static void GetVector(istream& is, vector<T>& v)
+{
+  size_t n = 0;
+  is >> n;
+  if (!is) return;
+  v.resize(n);
+  for (size_t i = 0; i < n; ++i) is >> v[i];
+}
+
+
+/*****
+Grad - return the gradient of the constraint
+*****/
+void ConstraintFn::Grad(const vector<double>& u, vector<double>& du)
+{
+  du.assign(du.size(), 0.);
+  AddGrad(u, 1., du);
+}
+
+
+/*****
+Return a copy of the constraint, made by way of its parameters
+*****/
+tmDifferentiableFn* ConstraintFn::MakeCopy() const
+{
+  return tmNLCOProblem::CopyFn(this);
+}
+
+
+/*****
+STATIC
+Return the best vector instructions that this processor supports and that were
+compiled in.
+*****/
+ConstraintFn::VectorUnit ConstraintFn::GetBestVectorUnit()
+{
+#if TM_PATH_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return VECTOR_AVX2;
+#endif
+#if TM_PATH_SSE2
+  return VECTOR_SSE2;
+#else
+  return VECTOR_NONE;
+#endif
+}
+
+
+/*****
+Static variable initialization
+*****/
+ConstraintFn::VectorUnit ConstraintFn::sVectorUnit = 
+  ConstraintFn::GetBestVectorUnit();
+
+
+/*****
+STATIC
+Return the vector instructions used by the block forms of the path constraints.
+*****/
+ConstraintFn::VectorUnit ConstraintFn::GetVectorUnit()
+{
+  return sVectorUnit;
+}
+
+
+/*****
+STATIC
+Set the vector instructions used by the block forms of the path constraints in
+future evaluations, but no better than GetBestVectorUnit(). The results are the
+same for all of them.
+*****/
+void ConstraintFn::SetVectorUnit(VectorUnit unit)
+{
+  VectorUnit best = GetBestVectorUnit();
+  sVectorUnit = (unit < best) ? unit : best;
+}
+
+
+#ifdef __MWERKS__
+#pragma mark -
+#endif
+
+
+/*****************************************************************************
+Batched path kernels
+Every path constraint is a path length less the distance between two nodes.
+Given arrays of the x and y offsets (dx, dy) from the first node to the second,
+PathDist() computes the distances and PathGrad() computes fac times the
+gradient of the distance with respect to the second node's coordinates (which
+is also minus the gradient of the constraint with respect to the first node's
+coordinates), with the same arithmetic as the constraints' own functions, so
+the results are identical whichever instructions are used. A zero distance
+gets a zero gradient rather than a NaN.
+******************************************************************************/
+
+/*****
+PathDistScalar - distances, one at a time
+*****/
+static void PathDistScalar(size_t n, const double* dx, const double* dy,
+  double* dist)
+{
+  for (size_t j = 0; j < n; ++j) 
+    dist[j] = sqrt(pow(dx[j], 2) + pow(dy[j], 2));
+}
+
+
+/*****
+PathGradScalar - weighted gradients, one at a time
+*****/
+static void PathGradScalar(size_t n, const double* fac, const double* dx, 
+  const double* dy, const double* dist, double* gx, double* gy)
+{
+  for (size_t j = 0; j < n; ++j) {
+    double temp = (dist[j] != 0) ? 1. / dist[j] : 0.;  // 0 is better than NaN
+    gx[j] = fac[j] * (temp * dx[j]);
+    gy[j] = fac[j] * (temp * dy[j]);
+  }
+}
+
+
+#if TM_PATH_SSE2
+/*****
+PathDistSSE2 - distances, two at a time
+*****/
+static void PathDistSSE2(size_t n, const double* dx, const double* dy,
+  double* dist)
+{
+  size_t j = 0;
+  for (; j + 2 <= n; j += 2) {
+    __m128d x = _mm_loadu_pd(dx + j);
+    __m128d y = _mm_loadu_pd(dy + j);
+    __m128d r2 = _mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y));
+    _mm_storeu_pd(dist + j, _mm_sqrt_pd(r2));
+  }
+  PathDistScalar(n - j, dx + j, dy + j, dist + j);
+}
+
+
+/*****
+PathGradSSE2 - weighted gradients, two at a time
+*****/
+static void PathGradSSE2(size_t n, const double* fac, const double* dx, 
+  const double* dy, const double* dist, double* gx, double* gy)
+{
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d one = _mm_set1_pd(1.);
+  size_t j = 0;
+  for (; j + 2 <= n; j += 2) {
+    __m128d d = _mm_loadu_pd(dist + j);
+    __m128d temp = _mm_and_pd(_mm_div_pd(one, d), _mm_cmpneq_pd(d, zero));
+    __m128d f = _mm_loadu_pd(fac + j);
+    _mm_storeu_pd(gx + j,
+      _mm_mul_pd(f, _mm_mul_pd(temp, _mm_loadu_pd(dx + j))));
+    _mm_storeu_pd(gy + j,
+      _mm_mul_pd(f, _mm_mul_pd(temp, _mm_loadu_pd(dy + j))));
+  }
+  PathGradScalar(n - j, fac + j, dx + j, dy + j, dist + j, gx + j, gy + j);
+}
+#endif // TM_PATH_SSE2
+
+
+#if TM_PATH_AVX2
+/*****
+PathDistAVX2 - distances, four at a time
+*****/
+__attribute__((target("avx2")))
+static void PathDistAVX2(size_t n, const double* dx, const double* dy,
+  double* dist)
+{
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m256d x = _mm256_loadu_pd(dx + j);
+    __m256d y = _mm256_loadu_pd(dy + j);
+    __m256d r2 = _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y));
+    _mm256_storeu_pd(dist + j, _mm256_sqrt_pd(r2));
+  }
+  PathDistScalar(n - j, dx + j, dy + j, dist + j);
+}
+
+
+/*****
+PathGradAVX2 - weighted gradients, four at a time
+*****/
+__attribute__((target("avx2")))
+static void PathGradAVX2(size_t n, const double* fac, const double* dx, 
+  const double* dy, const double* dist, double* gx, double* gy)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.);
+  size_t j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m256d d = _mm256_loadu_pd(dist + j);
+    __m256d temp = _mm256_and_pd(_mm256_div_pd(one, d), 
+      _mm256_cmp_pd(d, zero, _CMP_NEQ_UQ));
+    __m256d f = _mm256_loadu_pd(fac + j);
+    _mm256_storeu_pd(gx + j, 
+      _mm256_mul_pd(f, _mm256_mul_pd(temp, _mm256_loadu_pd(dx + j))));
+    _mm256_storeu_pd(gy + j, 
+      _mm256_mul_pd(f, _mm256_mul_pd(temp, _mm256_loadu_pd(dy + j))));
+  }
+  PathGradScalar(n - j, fac + j, dx + j, dy + j, dist + j, gx + j, gy + j);
+}
+#endif // TM_PATH_AVX2
+
+
+/*****
+PathDist - distances, with the instructions of ConstraintFn::GetVectorUnit()
+*****/
+static void PathDist(size_t n, const double* dx, const double* dy, 
+  double* dist)
+{
+  switch (ConstraintFn::GetVectorUnit()) {
+#if TM_PATH_AVX2
+    case ConstraintFn::VECTOR_AVX2:
+      PathDistAVX2(n, dx, dy, dist);
+      return;
+#endif
+#if TM_PATH_SSE2
+    case ConstraintFn::VECTOR_SSE2:
+      PathDistSSE2(n, dx, dy, dist);
+      return;
+#endif
+    default:
+      PathDistScalar(n, dx, dy, dist);
+  }
+}
+
+
+/*****
+PathGrad - weighted gradients, with the instructions of
+ConstraintFn::GetVectorUnit()
+*****/
+static void PathGrad(size_t n, const double* fac, const double* dx, 
+  const double* dy, const double* dist, double* gx, double* gy)
+{
+  switch (ConstraintFn::GetVectorUnit()) {
+#if TM_PATH_AVX2
+    case ConstraintFn::VECTOR_AVX2:
+      PathGradAVX2(n, fac, dx, dy, dist, gx, gy);
+      return;
+#endif
+#if TM_PATH_SSE2
+    case ConstraintFn::VECTOR_SSE2:
+      PathGradSSE2(n, fac, dx, dy, dist, gx, gy);
+      return;
+#endif
+    default:
+      PathGradScalar(n, fac, dx, dy, dist, gx, gy);
+  }
+}
+
+
+#ifdef __MWERKS__
+#pragma mark -
+#endif
+
+
+/**********
+class PathFnBlock
+A block of the path constraints of one kind: PathFn1, PathFn2, StrainPathFn1,
+StrainPathFn2, MultiStrainPathFn1, or MultiStrainPathFn2. The second node is
+fixed at (mVx, mVy) for the kinds ending in 2 and movable at (mJx, mJy) for the
+others. The path length is u[0] * mLvar for the PathFns, mLfix + u[0] * mLvar
+for the StrainPathFns, and mLfix plus the strains times their coefficients for
+the MultiStrainPathFns, whose strain indices and coefficients are stored end to
+end; those of the constraint at position p start at mStart[p]. The work space
+of a run of n constraints is the n x offsets from the first node to the
+second, then the n y offsets, then the n distances, which are gathered and
+computed a run at a time by the batched path kernels.
+**********/
+class PathFnBlock : public tmConstraintBlock {
+public:
+  enum Kind {
+    PATH_1,
+    PATH_2,
+    STRAIN_1,
+    STRAIN_2,
+    MULTI_STRAIN_1,
+    MULTI_STRAIN_2
+  };
+  PathFnBlock(Kind kind) : mKind(kind), mStart(1, 0) {};
+  size_t GetWorkSize() const {
+    // Return the number of doubles of work space per function.
+    return 3;};
+  void Append(tmDifferentiableFn* f);
+  void Func(const vector<double>& u, const size_t* pos, size_t n, double* f,
+    double* work);
+  void AddGrad(const vector<double>& u, const size_t* pos, size_t n, 
+    const double* fac, const double* work, vector<double>& du);
+private:
+  Kind mKind;
+  vector<tmDifferentiableFn*> mFns;
+  vector<size_t> mIx;
+  vector<size_t> mIy;
+  vector<size_t> mJx;
+  vector<size_t> mJy;
+  vector<double> mVx;
+  vector<double> mVy;
+  vector<double> mLfix;
+  vector<double> mLvar;
+  vector<size_t> mStart;
+  vector<size_t> mVi;
+  vector<double> mVf;
+  
+  bool IsFixed() const {
+    // Return true if the second node is fixed.
+    return mKind == PATH_2 || mKind == STRAIN_2 || mKind == MULTI_STRAIN_2;};
+  void AppendNodes(size_t ix, size_t iy, size_t jx, size_t jy, double vx, 
+    double vy);
+  void AppendStrains(size_t ni, const vector<size_t>& vi, 
+    const vector<double>& vf);
+};
+
+
+/*****
+Append - copy the member variables of a path constraint of our kind
+*****/
+void PathFnBlock::Append(tmDifferentiableFn* f)
+{
+  mFns.push_back(f);
+  switch (mKind) {
+    case PATH_1: {
+      PathFn1* pf = dynamic_cast<PathFn1*>(f);
+      TMASSERT(pf);
+      AppendNodes(pf->ix, pf->iy, pf->jx, pf->jy, 0, 0);
+      mLfix.push_back(0);
+      mLvar.push_back(pf->lij);
+      break;
+    }
+    case PATH_2: {
+      PathFn2* pf = dynamic_cast<PathFn2*>(f);
+      TMASSERT(pf);
+      AppendNodes(pf->ix, pf->iy, 0, 0, pf->vx, pf->vy);
+      mLfix.push_back(0);
+      mLvar.push_back(pf->lij);
+      break;
+    }
+    case STRAIN_1: {
+      StrainPathFn1* sf = dynamic_cast<StrainPathFn1*>(f);
+      TMASSERT(sf);
+      AppendNodes(sf->ix, sf->iy, sf->jx, sf->jy, 0, 0);
+      mLfix.push_back(sf->lfix);
+      mLvar.push_back(sf->lvar);
+      break;
+    }
+    case STRAIN_2: {
+      StrainPathFn2* sf = dynamic_cast<StrainPathFn2*>(f);
+      TMASSERT(sf);
+      AppendNodes(sf->ix, sf->iy, 0, 0, sf->vx, sf->vy);
+      mLfix.push_back(sf->lfix);
+      mLvar.push_back(sf->lvar);
+      break;
+    }
+    case MULTI_STRAIN_1: {
+      MultiStrainPathFn1* mf = dynamic_cast<MultiStrainPathFn1*>(f);
+      TMASSERT(mf);
+      AppendNodes(mf->ix, mf->iy, mf->jx, mf->jy, 0, 0);
+      mLfix.push_back(mf->lfix);
+      mLvar.push_back(0);
+      AppendStrains(mf->ni, mf->vi, mf->vf);
+      break;
+    }
+    case MULTI_STRAIN_2: {
+      MultiStrainPathFn2* mf = dynamic_cast<MultiStrainPathFn2*>(f);
+      TMASSERT(mf);
+      AppendNodes(mf->ix, mf->iy, 0, 0, mf->vx, mf->vy);
+      mLfix.push_back(mf->lfix);
+      mLvar.push_back(0);
+      AppendStrains(mf->ni, mf->vi, mf->vf);
+      break;
+    }
+  }
+  mStart.push_back(mVi.size());
+}
+
+
+/*****
+AppendNodes - record the indices of the nodes and the fixed coordinates
+*****/
+void PathFnBlock::AppendNodes(size_t ix, size_t iy, size_t jx, size_t jy, 
+  double vx, double vy)
+{
+  mIx.push_back(ix);
+  mIy.push_back(iy);
+  mJx.push_back(jx);
+  mJy.push_back(jy);
+  mVx.push_back(vx);
+  mVy.push_back(vy);
+}
+
+
+/*****
+AppendStrains - record the strain indices and coefficients
+*****/
+void PathFnBlock::AppendStrains(size_t ni, const vector<size_t>& vi, 
+  const vector<double>& vf)
+{
+  mVi.insert(mVi.end(), vi.begin(), vi.begin() + ni);
+  mVf.insert(mVf.end(), vf.begin(), vf.begin() + ni);
+}
+
+
+/*****
+Func - put the values of the listed constraints in f, as their Func()
+*****/
+void PathFnBlock::Func(const vector<double>& u, const size_t* pos, size_t n,
+  double* f, double* work)
+{
+  double* dx = work;
+  double* dy = work + n;
+  double* dist = work + 2 * n;
+  
+  // Gather the offsets from the first node to the second.
+  if (IsFixed())
+    for (size_t j = 0; j < n; ++j) {
+      size_t p = pos[j];
+      dx[j] = mVx[p] - u[mIx[p]];
+      dy[j] = mVy[p] - u[mIy[p]];
+    }
+  else
+    for (size_t j = 0; j < n; ++j) {
+      size_t p = pos[j];
+      dx[j] = u[mJx[p]] - u[mIx[p]];
+      dy[j] = u[mJy[p]] - u[mIy[p]];
+    }
+  PathDist(n, dx, dy, dist);
+  
+  // Subtract the distances from the path lengths.
+  for (size_t j = 0; j < n; ++j) {
+    size_t p = pos[j];
+    mFns[p]->AddCalls(1, 0);
+    switch (mKind) {
+      case PATH_1:
+      case PATH_2:
+        f[j] = u[0] * mLvar[p] - dist[j];
+        break;
+      case STRAIN_1:
+      case STRAIN_2:
+        f[j] = mLfix[p] + u[0] * mLvar[p] - dist[j];
+        break;
+      case MULTI_STRAIN_1:
+      case MULTI_STRAIN_2: {
+        double pathlen = mLfix[p];
+        for (size_t i = mStart[p]; i < mStart[p + 1]; ++i) 
+          pathlen += u[mVi[i]] * mVf[i];
+        f[j] = pathlen - dist[j];
+        break;
+      }
+    }
+  }
+}
+
+
+/*****
+AddGrad - add fac[j] times the gradient of the j-th listed constraint to du,
+as their AddDistGrad()
+*****/
+void PathFnBlock::AddGrad(const vector<double>& u, const size_t* pos, 
+  size_t n, const double* fac, const double* work, vector<double>& du)
+{
+  const double* dx = work;
+  const double* dy = work + n;
+  const double* dist = work + 2 * n;
+  double gx[k_Path_Chunk];
+  double gy[k_Path_Chunk];
+  bool isFixed = IsFixed();
+  for (size_t j0 = 0; j0 < n; j0 += k_Path_Chunk) {
+    size_t m = min(n - j0, k_Path_Chunk);
+    PathGrad(m, fac + j0, dx + j0, dy + j0, dist + j0, gx, gy);
+    
+    // Scatter the gradients, in the same order as the constraints would.
+    for (size_t j = 0; j < m; ++j) {
+      double fj = fac[j0 + j];
+      if (fj == 0) continue;
+      size_t p = pos[j0 + j];
+      mFns[p]->AddCalls(0, 1);
+      if (mKind == MULTI_STRAIN_1 || mKind == MULTI_STRAIN_2)
+        for (size_t i = mStart[p]; i < mStart[p + 1]; ++i) 
+          du[mVi[i]] += fj * mVf[i];
+      else
+        du[0] += fj * mLvar[p];
+      du[mIx[p]] += gx[j];
+      if (isFixed)
+        du[mIy[p]] += gy[j];
+      else {
+        du[mJx[p]] -= gx[j];
+        du[mIy[p]] += gy[j];
+        du[mJy[p]] -= gy[j];
+      }
+    }
+  }
+}
+
+
+#ifdef __MWERKS__
+#pragma mark -
+#endif
+
+
 /*****************************************************************************
 class OneVarFn
 The OneVarFn implements a function of one variable  of the form
@@ -51,13 +602,59 @@ double OneVarFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void OneVarFn::Grad(const vector<double>&, vector<double>& du)
+void OneVarFn::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = a;
+  du[ix] += fac * a;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void OneVarFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void OneVarFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficient and constant part
+*****/
+bool OneVarFn::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(a);
+  constant = b;
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void OneVarFn::PutParams(ostream& os) const
+{
+  os << ix << " " << a << " " << b;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void OneVarFn::GetParams(istream& is)
+{
+  is >> ix >> a >> b;
 }
 
 
@@ -103,14 +700,63 @@ double TwoVarFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void TwoVarFn::Grad(const vector<double>&, vector<double>& du)
+void TwoVarFn::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = a;
-  du[iy] = b;
+  du[ix] += fac * a;
+  du[iy] += fac * b;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void TwoVarFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void TwoVarFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
+*****/
+bool TwoVarFn::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(a);
+  coefs.push_back(b);
+  constant = c;
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void TwoVarFn::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << a << " " << b << " " << c;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void TwoVarFn::GetParams(istream& is)
+{
+  is >> ix >> iy >> a >> b >> c;
 }
 
 
@@ -156,20 +802,103 @@ double PathFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PathFn1::Grad(const vector<double>& u, vector<double>& du)
+void PathFn1::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[0] = lij;
-  double temp = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (u[jx] - u[ix]);
-  du[jx] = -du[ix];
-  du[iy] = temp * (u[jy] - u[iy]);
-  du[jy] = -du[iy];
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double PathFn1::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  double f = u[0] * lij - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void PathFn1::AddDistGrad(const vector<double>& u, double dist, double fac, 
+  vector<double>& du)
+{
+  du[0] += fac * lij;
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  double dx = fac * (temp * (u[jx] - u[ix]));
+  double dy = fac * (temp * (u[jy] - u[iy]));
+  du[ix] += dx;
+  du[jx] -= dx;
+  du[iy] += dy;
+  du[jy] -= dy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PathFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(0);
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PathFn1::SetVars(const vector<size_t>& vars)
+{
+  TMASSERT(vars[0] == 0);
+  ix = vars[1];
+  iy = vars[2];
+  jx = vars[3];
+  jy = vars[4];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PathFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << lij;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PathFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> lij;
+}
+
+
+/*****
+MakeBlock - return a new, empty block of PathFn1s
+*****/
+tmConstraintBlock* PathFn1::MakeBlock() const
+{
+  return new PathFnBlock(PathFnBlock::PATH_1);
 }
 
 
@@ -214,18 +943,95 @@ double PathFn2::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PathFn2::Grad(const vector<double>& u, vector<double>& du)
+void PathFn2::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[0] = lij;
-  double temp = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (vx - u[ix]);
-  du[iy] = temp * (vy - u[iy]);
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double PathFn2::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  double f = u[0] * lij - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void PathFn2::AddDistGrad(const vector<double>& u, double dist, double fac, 
+  vector<double>& du)
+{
+  du[0] += fac * lij;
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  du[ix] += fac * (temp * (vx - u[ix]));
+  du[iy] += fac * (temp * (vy - u[iy]));
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PathFn2::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(0);
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PathFn2::SetVars(const vector<size_t>& vars)
+{
+  TMASSERT(vars[0] == 0);
+  ix = vars[1];
+  iy = vars[2];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PathFn2::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << lij;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PathFn2::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> lij;
+}
+
+
+/*****
+MakeBlock - return a new, empty block of PathFn2s
+*****/
+tmConstraintBlock* PathFn2::MakeBlock() const
+{
+  return new PathFnBlock(PathFnBlock::PATH_2);
 }
 
 
@@ -272,16 +1078,58 @@ double PathAngleFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PathAngleFn1::Grad(const vector<double>&, vector<double>& du)
+void PathAngleFn1::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = sa;
-  du[jx] = -sa;
-  du[iy] = -ca;
-  du[jy] = ca;
+  du[ix] += fac * sa;
+  du[jx] -= fac * sa;
+  du[iy] -= fac * ca;
+  du[jy] += fac * ca;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PathAngleFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PathAngleFn1::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PathAngleFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << ca << " " << sa;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PathAngleFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> ca >> sa;
 }
 
 
@@ -329,14 +1177,52 @@ double PathAngleFn2::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PathAngleFn2::Grad(const vector<double>&, vector<double>& du)
+void PathAngleFn2::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = sa;
-  du[iy] = -ca;
+  du[ix] += fac * sa;
+  du[iy] -= fac * ca;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PathAngleFn2::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PathAngleFn2::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PathAngleFn2::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << ca << " " << sa;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PathAngleFn2::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> ca >> sa;
 }
 
 
@@ -385,20 +1271,103 @@ double StrainPathFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void StrainPathFn1::Grad(const vector<double>& u, vector<double>& du)
+void StrainPathFn1::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[0] = lvar;
-  double temp = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (u[jx] - u[ix]);
-  du[jx] = - du[ix];
-  du[iy] = temp * (u[jy] - u[iy]);
-  du[jy] = - du[iy];
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double StrainPathFn1::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  double f = lfix + u[0] * lvar - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void StrainPathFn1::AddDistGrad(const vector<double>& u, double dist, 
+  double fac, vector<double>& du)
+{
+  du[0] += fac * lvar;
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  double dx = fac * (temp * (u[jx] - u[ix]));
+  double dy = fac * (temp * (u[jy] - u[iy]));
+  du[ix] += dx;
+  du[jx] -= dx;
+  du[iy] += dy;
+  du[jy] -= dy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void StrainPathFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(0);
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void StrainPathFn1::SetVars(const vector<size_t>& vars)
+{
+  TMASSERT(vars[0] == 0);
+  ix = vars[1];
+  iy = vars[2];
+  jx = vars[3];
+  jy = vars[4];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void StrainPathFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << lfix << " " << lvar;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void StrainPathFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> lfix >> lvar;
+}
+
+
+/*****
+MakeBlock - return a new, empty block of StrainPathFn1s
+*****/
+tmConstraintBlock* StrainPathFn1::MakeBlock() const
+{
+  return new PathFnBlock(PathFnBlock::STRAIN_1);
 }
 
 
@@ -407,58 +1376,135 @@ void StrainPathFn1::Grad(const vector<double>& u, vector<double>& du)
 #endif
 
 
-/*****************************************************************************
-class StrainPathFn2
-The StrainPathFn2 implements a function of two variables
-that is used to constrain the separation between one movable and one fixed tmNode
-when some of the edges are stretchable.
-member variables:
-ix is the index of the x component of the position of the movable tmNode
-iy is the index of the y component of the position of the movable tmNode
-vx is the value of the x component of the position of the fixed tmNode
-vy is the value of the y component of the position of the fixed tmNode
-lfix is the (scaled) fixed part of the path length
-lvar is the (scaled) variable part of the path length
-******************************************************************************/
+/*****************************************************************************
+class StrainPathFn2
+The StrainPathFn2 implements a function of two variables
+that is used to constrain the separation between one movable and one fixed tmNode
+when some of the edges are stretchable.
+member variables:
+ix is the index of the x component of the position of the movable tmNode
+iy is the index of the y component of the position of the movable tmNode
+vx is the value of the x component of the position of the fixed tmNode
+vy is the value of the y component of the position of the fixed tmNode
+lfix is the (scaled) fixed part of the path length
+lvar is the (scaled) variable part of the path length
+******************************************************************************/
+
+/*****
+Constructor - record constants and index into data array
+*****/
+StrainPathFn2::StrainPathFn2(
+  size_t aix, size_t aiy, double avx, double avy, double alfix, double alvar)
+{
+  ix = aix;
+  iy = aiy;
+  vx = avx;
+  vy = avy;
+  lfix = alfix;
+  lvar = alvar;
+}
+
+
+/*****
+Func - return the value of the constraint
+*****/
+double StrainPathFn2::Func(const vector<double>& u)
+{
+  IncFuncCalls();
+  return lfix + u[0] * lvar - sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+}
+
+
+/*****
+AddGrad - add fac times the gradient of the constraint to du
+*****/
+void StrainPathFn2::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
+{
+  IncGradCalls();
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double StrainPathFn2::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  double f = lfix + u[0] * lvar - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void StrainPathFn2::AddDistGrad(const vector<double>& u, double dist, 
+  double fac, vector<double>& du)
+{
+  du[0] += fac * lvar;
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  du[ix] += fac * (temp * (vx - u[ix]));
+  du[iy] += fac * (temp * (vy - u[iy]));
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void StrainPathFn2::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(0);
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void StrainPathFn2::SetVars(const vector<size_t>& vars)
+{
+  TMASSERT(vars[0] == 0);
+  ix = vars[1];
+  iy = vars[2];
+}
+
 
 /*****
-Constructor - record constants and index into data array
+PutParams - write the member variables
 *****/
-StrainPathFn2::StrainPathFn2(
-  size_t aix, size_t aiy, double avx, double avy, double alfix, double alvar)
+void StrainPathFn2::PutParams(ostream& os) const
 {
-  ix = aix;
-  iy = aiy;
-  vx = avx;
-  vy = avy;
-  lfix = alfix;
-  lvar = alvar;
+  os << ix << " " << iy << " " << vx << " " << vy << " " << lfix << " " << lvar;
 }
 
 
 /*****
-Func - return the value of the constraint
+GetParams - read the member variables written by PutParams()
 *****/
-double StrainPathFn2::Func(const vector<double>& u)
+void StrainPathFn2::GetParams(istream& is)
 {
-  IncFuncCalls();
-  return lfix + u[0] * lvar - sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  is >> ix >> iy >> vx >> vy >> lfix >> lvar;
 }
 
 
 /*****
-Grad - return the gradient of the constraint
+MakeBlock - return a new, empty block of StrainPathFn2s
 *****/
-void StrainPathFn2::Grad(const vector<double>& u, vector<double>& du)
+tmConstraintBlock* StrainPathFn2::MakeBlock() const
 {
-  IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[0] = lvar;
-  double temp = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (vx - u[ix]);
-  du[iy] = temp * (vy - u[iy]);
+  return new PathFnBlock(PathFnBlock::STRAIN_2);
 }
 
 
@@ -507,13 +1553,49 @@ double StrainPathFn3::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void StrainPathFn3::Grad(const vector<double>&, vector<double>& du)
+void StrainPathFn3::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[0] = lvar;
+  du[0] += fac * lvar;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void StrainPathFn3::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(0);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void StrainPathFn3::SetVars(const vector<size_t>& vars)
+{
+  TMASSERT(vars[0] == 0);
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void StrainPathFn3::PutParams(ostream& os) const
+{
+  os << ux << " " << uy << " " << vx << " " << vy << " " << lfix << " " << lvar;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void StrainPathFn3::GetParams(istream& is)
+{
+  is >> ux >> uy >> vx >> vy >> lfix >> lvar;
 }
 
 
@@ -558,14 +1640,52 @@ double StickToEdgeFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void StickToEdgeFn::Grad(const vector<double>& u, vector<double>& du)
+void StickToEdgeFn::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = StickToEdge_Weight * (2 * u[ix] - w) * u[iy] * (u[iy] - h);
-  du[iy] = StickToEdge_Weight * (2 * u[iy] - h) * u[ix] * (u[ix] - w);
+  du[ix] += fac * (StickToEdge_Weight * (2 * u[ix] - w) * u[iy] * (u[iy] - h));
+  du[iy] += fac * (StickToEdge_Weight * (2 * u[iy] - h) * u[ix] * (u[ix] - w));
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void StickToEdgeFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void StickToEdgeFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void StickToEdgeFn::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << w << " " << h;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void StickToEdgeFn::GetParams(istream& is)
+{
+  is >> ix >> iy >> w >> h;
 }
 
 
@@ -611,14 +1731,64 @@ double StickToLineFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void StickToLineFn::Grad(const vector<double>&, vector<double>& du)
+void StickToLineFn::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = -sa;
-  du[iy] = +ca;
+  du[ix] -= fac * sa;
+  du[iy] += fac * ca;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void StickToLineFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void StickToLineFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
+*****/
+bool StickToLineFn::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(-sa);
+  coefs.push_back(ca);
+  constant = p.x * sa - p.y * ca;
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void StickToLineFn::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << p.x << " " << p.y << " " << sa << " " << ca;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void StickToLineFn::GetParams(istream& is)
+{
+  is >> ix >> iy >> p.x >> p.y >> sa >> ca;
 }
 
 
@@ -671,16 +1841,72 @@ double PairFn1A::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PairFn1A::Grad(const vector<double>&, vector<double>& du)
+void PairFn1A::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = ca;
-  du[iy] = sa;
-  du[jx] = -ca;
-  du[jy] = -sa;
+  du[ix] += fac * ca;
+  du[iy] += fac * sa;
+  du[jx] -= fac * ca;
+  du[jy] -= fac * sa;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PairFn1A::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PairFn1A::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
+*****/
+bool PairFn1A::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(ca);
+  coefs.push_back(sa);
+  coefs.push_back(-ca);
+  coefs.push_back(-sa);
+  constant = 0.;
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PairFn1A::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << p.x << " " << p.y <<
+    " " << sa << " " << ca;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PairFn1A::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> p.x >> p.y >> sa >> ca;
 }
 
 
@@ -716,16 +1942,72 @@ double PairFn1B::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PairFn1B::Grad(const vector<double>&, vector<double>& du)
+void PairFn1B::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = -sa;
-  du[iy] = ca;
-  du[jx] = -sa;
-  du[jy] = ca;
+  du[ix] -= fac * sa;
+  du[iy] += fac * ca;
+  du[jx] -= fac * sa;
+  du[jy] += fac * ca;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PairFn1B::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PairFn1B::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
+*****/
+bool PairFn1B::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(-sa);
+  coefs.push_back(ca);
+  coefs.push_back(-sa);
+  coefs.push_back(ca);
+  constant = 2 * (p.x * sa - p.y * ca);
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PairFn1B::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << p.x << " " << p.y <<
+    " " << sa << " " << ca;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PairFn1B::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> p.x >> p.y >> sa >> ca;
 }
 
 
@@ -778,14 +2060,64 @@ double PairFn2A::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void PairFn2A::Grad(const vector<double>&, vector<double>& du)
+void PairFn2A::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = ca;
-  du[iy] = sa;
+  du[ix] += fac * ca;
+  du[iy] += fac * sa;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PairFn2A::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PairFn2A::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
+*****/
+bool PairFn2A::GetLinear(vector<double>& coefs, double& constant) const
+{
+  coefs.push_back(ca);
+  coefs.push_back(sa);
+  constant = -vx * ca - vy * sa;
+  return true;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void PairFn2A::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << p.x << " " << p.y <<
+    " " << sa << " " << ca;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void PairFn2A::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> p.x >> p.y >> sa >> ca;
 }
 
 
@@ -795,40 +2127,90 @@ void PairFn2A::Grad(const vector<double>&, vector<double>& du)
 
 
 /*****
-Constructor - record constants and index into data array
+Constructor - record constants and index into data array
+*****/
+PairFn2B::PairFn2B(size_t aix, size_t aiy, double avx, double avy, tmPoint ap, double aa)
+{
+  ix = aix;
+  iy = aiy;
+  vx = avx;
+  vy = avy;
+  p = ap;
+  aa *= DEGREES;
+  sa = sin(aa);
+  ca = cos(aa);
+}
+
+
+/*****
+Func - return the value of the constraint
+*****/
+double PairFn2B::Func(const vector<double>& u)
+{
+  IncFuncCalls();
+  return (-u[ix] - vx + 2 * p.x) * sa + (u[iy] + vy - 2 * p.y) * ca;
+}
+
+
+/*****
+AddGrad - add fac times the gradient of the constraint to du
+*****/
+void PairFn2B::AddGrad(const vector<double>&, double fac, vector<double>& du)
+{
+  IncGradCalls();
+  du[ix] -= fac * sa;
+  du[iy] += fac * ca;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void PairFn2B::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void PairFn2B::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+GetLinear - the constraint is linear; return its coefficients and constant part
 *****/
-PairFn2B::PairFn2B(size_t aix, size_t aiy, double avx, double avy, tmPoint ap, double aa)
+bool PairFn2B::GetLinear(vector<double>& coefs, double& constant) const
 {
-  ix = aix;
-  iy = aiy;
-  vx = avx;
-  vy = avy;
-  p = ap;
-  aa *= DEGREES;
-  sa = sin(aa);
-  ca = cos(aa);
+  coefs.push_back(-sa);
+  coefs.push_back(ca);
+  constant = (2 * p.x - vx) * sa + (vy - 2 * p.y) * ca;
+  return true;
 }
 
 
 /*****
-Func - return the value of the constraint
+PutParams - write the member variables
 *****/
-double PairFn2B::Func(const vector<double>& u)
+void PairFn2B::PutParams(ostream& os) const
 {
-  IncFuncCalls();
-  return (-u[ix] - vx + 2 * p.x) * sa + (u[iy] + vy - 2 * p.y) * ca;
+  os << ix << " " << iy << " " << vx << " " << vy << " " << p.x << " " << p.y <<
+    " " << sa << " " << ca;
 }
 
 
 /*****
-Grad - return the gradient of the constraint
+GetParams - read the member variables written by PutParams()
 *****/
-void PairFn2B::Grad(const vector<double>&, vector<double>& du)
+void PairFn2B::GetParams(istream& is)
 {
-  IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = -sa;
-  du[iy] = ca;
+  is >> ix >> iy >> vx >> vy >> p.x >> p.y >> sa >> ca;
 }
 
 
@@ -874,18 +2256,68 @@ double CollinearFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void CollinearFn1::Grad(const vector<double>& u, vector<double>& du)
+void CollinearFn1::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = (u[ky] - u[jy]);
-  du[kx] = (u[jy] - u[iy]);
-  du[jx] = -(du[ix] + du[kx]);
-  du[iy] = (u[jx] - u[kx]);
-  du[ky] = (u[ix] - u[jx]);
-  du[jy] = -(du[iy] + du[ky]);
+  double dix = (u[ky] - u[jy]);
+  double dkx = (u[jy] - u[iy]);
+  double diy = (u[jx] - u[kx]);
+  double dky = (u[ix] - u[jx]);
+  du[ix] += fac * dix;
+  du[kx] += fac * dkx;
+  du[jx] -= fac * (dix + dkx);
+  du[iy] += fac * diy;
+  du[ky] += fac * dky;
+  du[jy] -= fac * (diy + dky);
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void CollinearFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+  vars.push_back(kx);
+  vars.push_back(ky);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void CollinearFn1::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+  kx = vars[4];
+  ky = vars[5];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void CollinearFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << kx << " " << ky;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void CollinearFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> kx >> ky;
 }
 
 
@@ -931,16 +2363,60 @@ double CollinearFn2::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void CollinearFn2::Grad(const vector<double>& u, vector<double>& du)
+void CollinearFn2::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = (wy - u[jy]);
-  du[jx] = -du[ix];
-  du[iy] = (u[jx] - wx);
-  du[jy] = -du[iy];
+  double dix = fac * (wy - u[jy]);
+  double diy = fac * (u[jx] - wx);
+  du[ix] += dix;
+  du[jx] -= dix;
+  du[iy] += diy;
+  du[jy] -= diy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void CollinearFn2::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void CollinearFn2::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void CollinearFn2::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << wx << " " << wy;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void CollinearFn2::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> wx >> wy;
 }
 
 
@@ -986,14 +2462,52 @@ double CollinearFn3::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void CollinearFn3::Grad(const vector<double>&, vector<double>& du)
+void CollinearFn3::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = (wy - vy);
-  du[iy] = (vx - wx);
+  du[ix] += fac * (wy - vy);
+  du[iy] += fac * (vx - wx);
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void CollinearFn3::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void CollinearFn3::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void CollinearFn3::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << wx << " " << wy;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void CollinearFn3::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> wx >> wy;
 }
 
 
@@ -1044,14 +2558,52 @@ double BoundaryFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void BoundaryFn::Grad(const vector<double>&, vector<double>& du)
+void BoundaryFn::AddGrad(const vector<double>&, double fac, vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  du[ix] = t.x;
-  du[iy] = t.y;
+  du[ix] += fac * t.x;
+  du[iy] += fac * t.y;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void BoundaryFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void BoundaryFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void BoundaryFn::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << p1.x << " " << p1.y << " " << p2.x << " " <<
+    p2.y << " " << q.x << " " << q.y << " " << t.x << " " << t.y;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void BoundaryFn::GetParams(istream& is)
+{
+  is >> ix >> iy >> p1.x >> p1.y >> p2.x >> p2.y >> q.x >> q.y >> t.x >> t.y;
 }
 
 
@@ -1127,13 +2679,12 @@ double QuantizeAngleFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void QuantizeAngleFn1::Grad(const vector<double>& u, vector<double>& du)
+void QuantizeAngleFn1::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  
   // compute contributions to function value
   
   double r2 = pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2);
@@ -1147,18 +2698,54 @@ void QuantizeAngleFn1::Grad(const vector<double>& u, vector<double>& du)
     f2 *= fk;
   }
   
-  // compute terms and accumulate them in the gradient
+  AddTermsGrad(u, r2, f1, f2, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the terms of the function only once
+*****/
+double QuantizeAngleFn1::FuncAddGrad(const vector<double>& u, GradWeight& gw,
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double r2 = pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2);
+  
+  double f1 = pow(r2, -0.5 * n);
+  
+  double f2 = 1;
+  for (size_t k = 0; k < n; ++k) {
+    double ak = (k * da - oa);
+    double fk = (u[ix] - u[jx]) * sin(ak) - (u[iy] - u[jy]) * cos(ak);
+    f2 *= fk;
+  }  
+  
+  double f = wt * f1 * f2;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddTermsGrad(u, r2, f1, f2, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddTermsGrad - add fac times the gradient to du, given the squared distance
+r2 and the two factors of the function f1 and f2
+*****/
+void QuantizeAngleFn1::AddTermsGrad(const vector<double>& u, double r2, 
+  double f1, double f2, double fac, vector<double>& du)
+{
+  // compute terms and accumulate them in the gradient, scaled by the weight
 
   // contributions from gradient of f1
   
   double f3 = - f1 * n * f2 / r2;
   
-  double temp = f3 * (u[ix] - u[jx]);
-  du[ix] += temp;
-  du[jx] -= temp;
-  temp = f3 * (u[iy] - u[jy]);
-  du[iy] += temp;
-  du[jy] -= temp;
+  double gx = f3 * (u[ix] - u[jx]);
+  double gy = f3 * (u[iy] - u[jy]);
 
   // contributions from gradient of f2
   
@@ -1170,15 +2757,198 @@ void QuantizeAngleFn1::Grad(const vector<double>& u, vector<double>& du)
       dl *= (u[ix] - u[jx]) * sin(ak) - (u[iy] - u[jy]) * cos(ak);
     }
     double al = (l * da - oa);
-    temp = f1 * sin(al) * dl;
-    du[ix] += temp;
-    du[jx] -= temp;
-    temp = f1 * -cos(al) * dl;
-    du[iy] += temp;
-    du[jy] -= temp;    
+    gx += f1 * sin(al) * dl;
+    gy += f1 * -cos(al) * dl;
+  }
+  
+  gx = fac * (gx * wt);
+  gy = fac * (gy * wt);
+  du[ix] += gx;
+  du[jx] -= gx;
+  du[iy] += gy;
+  du[jy] -= gy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void QuantizeAngleFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void QuantizeAngleFn1::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void QuantizeAngleFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << n << " " << da <<
+    " " << oa << " " << wt;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void QuantizeAngleFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> n >> da >> oa >> wt;
+}
+
+
+/**********
+class QuantizeAngleFn1Block
+A block of QuantizeAngleFn1s, with the member variables of each in a separate
+array. The sines and cosines of the angles ak of all the constraints are
+computed once, when they're appended, and stored end to end; those of the
+constraint at position p start at mStart[p]. The work space of each constraint
+is r2, f1, and f2 of QuantizeAngleFn1::AddTermsGrad().
+**********/
+class QuantizeAngleFn1Block : public tmConstraintBlock {
+public:
+  QuantizeAngleFn1Block() : mStart(1, 0) {};
+  size_t GetWorkSize() const {
+    // Return the number of doubles of work space per function.
+    return 3;};
+  void Append(tmDifferentiableFn* f);
+  void Func(const vector<double>& u, const size_t* pos, size_t n, double* f,
+    double* work);
+  void AddGrad(const vector<double>& u, const size_t* pos, size_t n, 
+    const double* fac, const double* work, vector<double>& du);
+private:
+  vector<tmDifferentiableFn*> mFns;
+  vector<size_t> mIx;
+  vector<size_t> mIy;
+  vector<size_t> mJx;
+  vector<size_t> mJy;
+  vector<size_t> mN;
+  vector<double> mWt;
+  vector<size_t> mStart;
+  vector<double> mSin;
+  vector<double> mCos;
+};
+
+
+/*****
+Append - copy the member variables of a QuantizeAngleFn1
+*****/
+void QuantizeAngleFn1Block::Append(tmDifferentiableFn* f)
+{
+  QuantizeAngleFn1* qf = dynamic_cast<QuantizeAngleFn1*>(f);
+  TMASSERT(qf);
+  mFns.push_back(f);
+  mIx.push_back(qf->ix);
+  mIy.push_back(qf->iy);
+  mJx.push_back(qf->jx);
+  mJy.push_back(qf->jy);
+  mN.push_back(qf->n);
+  mWt.push_back(qf->wt);
+  for (size_t k = 0; k < qf->n; ++k) {
+    double ak = (k * qf->da - qf->oa);
+    mSin.push_back(sin(ak));
+    mCos.push_back(cos(ak));
+  }
+  mStart.push_back(mSin.size());
+}
+
+
+/*****
+Func - put the values of the listed constraints in f, as
+QuantizeAngleFn1::Func()
+*****/
+void QuantizeAngleFn1Block::Func(const vector<double>& u, const size_t* pos,
+  size_t n, double* f, double* work)
+{
+  for (size_t j = 0; j < n; ++j) {
+    size_t p = pos[j];
+    mFns[p]->AddCalls(1, 0);
+    double dx = u[mIx[p]] - u[mJx[p]];
+    double dy = u[mIy[p]] - u[mJy[p]];
+    double r2 = pow(dx, 2) + pow(dy, 2);
+    double f1 = pow(r2, -0.5 * mN[p]);
+    double f2 = 1;
+    for (size_t k = mStart[p]; k < mStart[p + 1]; ++k)
+      f2 *= dx * mSin[k] - dy * mCos[k];
+    work[3 * j] = r2;
+    work[3 * j + 1] = f1;
+    work[3 * j + 2] = f2;
+    f[j] = mWt[p] * f1 * f2;
   }
+}
+
+
+/*****
+AddGrad - add fac[j] times the gradient of the j-th listed constraint to du,
+as QuantizeAngleFn1::AddTermsGrad()
+*****/
+void QuantizeAngleFn1Block::AddGrad(const vector<double>& u, const size_t* pos,
+  size_t n, const double* fac, const double* work, vector<double>& du)
+{
+  for (size_t j = 0; j < n; ++j) {
+    if (fac[j] == 0) continue;
+    size_t p = pos[j];
+    mFns[p]->AddCalls(0, 1);
+    size_t ix = mIx[p];
+    size_t iy = mIy[p];
+    size_t jx = mJx[p];
+    size_t jy = mJy[p];
+    double dx = u[ix] - u[jx];
+    double dy = u[iy] - u[jy];
+    double r2 = work[3 * j];
+    double f1 = work[3 * j + 1];
+    double f2 = work[3 * j + 2];
+    size_t kbeg = mStart[p];
+    size_t kend = mStart[p + 1];
     
-  for (size_t i = 0; i < du.size(); ++i) du[i] *= wt;
+    // contributions from gradient of f1
+    double f3 = - f1 * mN[p] * f2 / r2;
+    double gx = f3 * dx;
+    double gy = f3 * dy;
+    
+    // contributions from gradient of f2
+    for (size_t l = kbeg; l < kend; ++l) {
+      double dl = 1;
+      for (size_t k = kbeg; k < kend; ++k) {
+        if (k == l) continue;
+        dl *= dx * mSin[k] - dy * mCos[k];
+      }
+      gx += f1 * mSin[l] * dl;
+      gy += f1 * -mCos[l] * dl;
+    }
+    
+    gx = fac[j] * (gx * mWt[p]);
+    gy = fac[j] * (gy * mWt[p]);
+    du[ix] += gx;
+    du[jx] -= gx;
+    du[iy] += gy;
+    du[jy] -= gy;
+  }
+}
+
+
+/*****
+MakeBlock - return a new, empty block of QuantizeAngleFn1s
+*****/
+tmConstraintBlock* QuantizeAngleFn1::MakeBlock() const
+{
+  return new QuantizeAngleFn1Block();
 }
 
 
@@ -1249,12 +3019,14 @@ double QuantizeAngleFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void QuantizeAngleFn1::Grad(const vector<double>& u, vector<double>& du)
+void QuantizeAngleFn1::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
+  double gx = 0;
+  double gy = 0;
   for (size_t k = 0; k < n; ++k) {
     double ak = (oa + k * da);
     double dk = 1;
@@ -1264,14 +3036,39 @@ void QuantizeAngleFn1::Grad(const vector<double>& u, vector<double>& du)
       double fl = (u[ix] - u[jx]) * sin(al) - (u[iy] - u[jy]) * cos(al);
       dk *= fl;
     }
-    double temp = sin(ak) * dk;
-    du[ix] += temp;
-    du[jx] -= temp;
-    temp = -cos(ak) * dk;
-    du[iy] += temp;
-    du[jy] -= temp;    
+    gx += sin(ak) * dk;
+    gy += -cos(ak) * dk;
   }
-  du *= wt;
+  gx = fac * (gx * wt);
+  gy = fac * (gy * wt);
+  du[ix] += gx;
+  du[jx] -= gx;
+  du[iy] += gy;
+  du[jy] -= gy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void QuantizeAngleFn1::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void QuantizeAngleFn1::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+  jx = vars[2];
+  jy = vars[3];
 }
 
 
@@ -1342,27 +3139,67 @@ double QuantizeAngleFn2::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
+*****/
+void QuantizeAngleFn2::AddGrad(const vector<double>& u, double fac,
+  vector<double>& du)
+{
+  IncGradCalls();
+  double gx = 0;
+  double gy = 0;
+  for (size_t k = 0; k < n; ++k) {
+    double ak = (oa + k * da);
+    double dk = 1;
+    for (size_t l = 0; l < n; l++) {
+      if (k == l) continue;
+      double al = (oa + l * da);
+      double fl = (u[ix] - vx) * sin(al) - (u[iy] - vy) * cos(al);
+      dk *= fl;
+    }
+    gx += sin(ak) * dk;
+    gy += -cos(ak) * dk;
+  }
+  du[ix] += fac * (gx * wt);
+  du[iy] += fac * (gy * wt);
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void QuantizeAngleFn2::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void QuantizeAngleFn2::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void QuantizeAngleFn2::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << n << " " << da <<
+    " " << oa << " " << wt;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
 *****/
-void QuantizeAngleFn2::Grad(const vector<double>& u, vector<double>& du)
+void QuantizeAngleFn2::GetParams(istream& is)
 {
-  IncGradCalls();
-  du.assign(du.size(), 0.);
-  for (size_t k = 0; k < n; ++k) {
-    double ak = (oa + k * da);
-    double dk = 1;
-    for (size_t l = 0; l < n; l++) {
-      if (k == l) continue;
-      double al = (oa + l * da);
-      double fl = (u[ix] - vx) * sin(al) - (u[iy] - vy) * cos(al);
-      dk *= fl;
-    }
-    double temp = sin(ak) * dk;
-    du[ix] += temp;
-    temp = -cos(ak) * dk;
-    du[iy] += temp;
-  }
-  for (size_t i = 0; i < du.size(); ++i) du[i] *= wt;
+  is >> ix >> iy >> vx >> vy >> n >> da >> oa >> wt;
 }
 
 
@@ -1411,18 +3248,84 @@ double LocalizeFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void LocalizeFn::Grad(const vector<double>& u, vector<double>& du)
+void LocalizeFn::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  double temp = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double LocalizeFn::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  double f = k_Localize_Weight * dist - r;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void LocalizeFn::AddDistGrad(const vector<double>& u, double dist, double fac, 
+  vector<double>& du)
+{
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
   temp = k_Localize_Weight * temp;
-  du[ix] = temp * (u[ix] - vx);
-  du[iy] = temp * (u[iy] - vy);
+  du[ix] += fac * (temp * (u[ix] - vx));
+  du[iy] += fac * (temp * (u[iy] - vy));
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void LocalizeFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void LocalizeFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+  iy = vars[1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void LocalizeFn::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << r;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void LocalizeFn::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> r;
 }
 
 
@@ -1479,20 +3382,111 @@ double MultiStrainPathFn1::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void MultiStrainPathFn1::Grad(const vector<double>& u, vector<double>& du)
+void MultiStrainPathFn1::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  for (size_t i = 0; i < ni; ++i) du[vi[i]] = vf[i];
-  double temp = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (u[jx] - u[ix]);
-  du[jx] = - du[ix];
-  du[iy] = temp * (u[jy] - u[iy]);
-  du[jy] = - du[iy];
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double MultiStrainPathFn1::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - u[jx], 2) + pow(u[iy] - u[jy], 2));
+  double pathlen = lfix;
+  for (size_t i = 0; i < ni; ++i) pathlen += u[vi[i]] * vf[i];  
+  double f = pathlen - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void MultiStrainPathFn1::AddDistGrad(const vector<double>& u, double dist, 
+  double fac, vector<double>& du)
+{
+  for (size_t i = 0; i < ni; ++i) du[vi[i]] += fac * vf[i];
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  double dx = fac * (temp * (u[jx] - u[ix]));
+  double dy = fac * (temp * (u[jy] - u[iy]));
+  du[ix] += dx;
+  du[jx] -= dx;
+  du[iy] += dy;
+  du[jy] -= dy;
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void MultiStrainPathFn1::GetVars(vector<size_t>& vars)
+{
+  vars.insert(vars.end(), vi.begin(), vi.end());
+  vars.push_back(ix);
+  vars.push_back(iy);
+  vars.push_back(jx);
+  vars.push_back(jy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void MultiStrainPathFn1::SetVars(const vector<size_t>& vars)
+{
+  copy(vars.begin(), vars.begin() + vi.size(), vi.begin());
+  ix = vars[vi.size()];
+  iy = vars[vi.size() + 1];
+  jx = vars[vi.size() + 2];
+  jy = vars[vi.size() + 3];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void MultiStrainPathFn1::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << jx << " " << jy << " " << lfix << 
+    " " << ni << " ";
+  PutVector(os, vi);
+  os << " ";
+  PutVector(os, vf);
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void MultiStrainPathFn1::GetParams(istream& is)
+{
+  is >> ix >> iy >> jx >> jy >> lfix >> ni;
+  GetVector(is, vi);
+  GetVector(is, vf);
+}
+
+
+/*****
+MakeBlock - return a new, empty block of MultiStrainPathFn1s
+*****/
+tmConstraintBlock* MultiStrainPathFn1::MakeBlock() const
+{
+  return new PathFnBlock(PathFnBlock::MULTI_STRAIN_1);
 }
 
 
@@ -1549,17 +3543,103 @@ double MultiStrainPathFn2::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void MultiStrainPathFn2::Grad(const vector<double>& u, vector<double>& du)
+void MultiStrainPathFn2::AddGrad(const vector<double>& u, double fac, 
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  for (size_t i = 0; i < ni; ++i) du[vi[i]] = vf[i];
-  double temp = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
-  if (temp != 0) 
-    temp = 1. / temp;  // setting temp to 0 is better than NaN
-  du[ix] = temp * (vx - u[ix]);
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  AddDistGrad(u, dist, fac, du);
+}
+
+
+/*****
+FuncAddGrad - return the value of the constraint and add a weighted gradient
+to du, computing the distance only once
+*****/
+double MultiStrainPathFn2::FuncAddGrad(const vector<double>& u, GradWeight& gw, 
+  vector<double>& du)
+{
+  IncFuncCalls();
+  double dist = sqrt(pow(u[ix] - vx, 2) + pow(u[iy] - vy, 2));
+  double pathlen = lfix;
+  for (size_t i = 0; i < ni; ++i) pathlen += u[vi[i]] * vf[i];  
+  double f = pathlen - dist;
+  double fac = gw.GetWeight(f);
+  if (fac != 0) {
+    IncGradCalls();
+    AddDistGrad(u, dist, fac, du);
+  }
+  return f;
+}
+
+
+/*****
+AddDistGrad - add fac times the gradient to du, given the current distance
+*****/
+void MultiStrainPathFn2::AddDistGrad(const vector<double>& u, double dist, 
+  double fac, vector<double>& du)
+{
+  for (size_t i = 0; i < ni; ++i) du[vi[i]] += fac * vf[i];
+  double temp = (dist != 0) ? 1. / dist : 0.;  // 0 is better than NaN
+  du[ix] += fac * (temp * (vx - u[ix]));
+  du[iy] += fac * (temp * (vy - u[iy]));
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void MultiStrainPathFn2::GetVars(vector<size_t>& vars)
+{
+  vars.insert(vars.end(), vi.begin(), vi.end());
+  vars.push_back(ix);
+  vars.push_back(iy);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void MultiStrainPathFn2::SetVars(const vector<size_t>& vars)
+{
+  copy(vars.begin(), vars.begin() + vi.size(), vi.begin());
+  ix = vars[vi.size()];
+  iy = vars[vi.size() + 1];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void MultiStrainPathFn2::PutParams(ostream& os) const
+{
+  os << ix << " " << iy << " " << vx << " " << vy << " " << lfix << 
+    " " << ni << " ";
+  PutVector(os, vi);
+  os << " ";
+  PutVector(os, vf);
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void MultiStrainPathFn2::GetParams(istream& is)
+{
+  is >> ix >> iy >> vx >> vy >> lfix >> ni;
+  GetVector(is, vi);
+  GetVector(is, vf);
+}
+
+
+/*****
+MakeBlock - return a new, empty block of MultiStrainPathFn2s
+*****/
+tmConstraintBlock* MultiStrainPathFn2::MakeBlock() const
+{
+  return new PathFnBlock(PathFnBlock::MULTI_STRAIN_2);
 }
 
 
@@ -1616,13 +3696,55 @@ double MultiStrainPathFn3::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
 *****/
-void MultiStrainPathFn3::Grad(const vector<double>&, vector<double>& du)
+void MultiStrainPathFn3::AddGrad(const vector<double>&, double fac,
+  vector<double>& du)
 {
   IncGradCalls();
-  du.assign(du.size(), 0.);
-  for (size_t i = 0; i < ni; ++i) du[vi[i]] = vf[i];
+  for (size_t i = 0; i < ni; ++i) du[vi[i]] += fac * vf[i];
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void MultiStrainPathFn3::GetVars(vector<size_t>& vars)
+{
+  vars.insert(vars.end(), vi.begin(), vi.end());
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
+*****/
+void MultiStrainPathFn3::SetVars(const vector<size_t>& vars)
+{
+  copy(vars.begin(), vars.begin() + vi.size(), vi.begin());
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void MultiStrainPathFn3::PutParams(ostream& os) const
+{
+  os << ux << " " << uy << " " << vx << " " << vy << " " << lfix << 
+    " " << ni << " ";
+  PutVector(os, vi);
+  os << " ";
+  PutVector(os, vf);
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void MultiStrainPathFn3::GetParams(istream& is)
+{
+  is >> ux >> uy >> vx >> vy >> lfix >> ni;
+  GetVector(is, vi);
+  GetVector(is, vf);
 }
 
 
@@ -1662,11 +3784,143 @@ double CornerFn::Func(const vector<double>& u)
 
 
 /*****
-Grad - return the gradient of the constraint
+AddGrad - add fac times the gradient of the constraint to du
+*****/
+void CornerFn::AddGrad(const vector<double>& u, double fac, vector<double>& du)
+{
+  IncGradCalls();
+  du[ix] += fac * (2 * u[ix] - w);
+}
+
+
+/*****
+GetVars - append the indices of the variables the constraint depends on
+*****/
+void CornerFn::GetVars(vector<size_t>& vars)
+{
+  vars.push_back(ix);
+}
+
+
+/*****
+SetVars - set the indices of the variables, given in the order of GetVars()
 *****/
-void CornerFn::Grad(const vector<double>& u, vector<double>& du)
+void CornerFn::SetVars(const vector<size_t>& vars)
+{
+  ix = vars[0];
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void CornerFn::PutParams(ostream& os) const
+{
+  os << ix << " " << w;
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void CornerFn::GetParams(istream& is)
+{
+  is >> ix >> w;
+}
+
+
+#ifdef __MWERKS__
+#pragma mark -
+#endif
+
+
+/*****************************************************************************
+class QuadraticFn
+The QuadraticFn implements a separable quadratic function of the form
+ sum over k of (va[k] * u[vi[k]] + vb[k] * u[vi[k]]^2)
+that stands in for the objective function of an optimizer in a captured
+problem.
+Member variables are:
+vi is the index of the variable of each term
+va is the linear coefficient of each term
+vb is the quadratic coefficient of each term
+******************************************************************************/
+
+/*****
+AddTerm - add a term to the sum
+*****/
+void QuadraticFn::AddTerm(size_t ai, double aa, double ab)
+{
+  vi.push_back(ai);
+  va.push_back(aa);
+  vb.push_back(ab);
+}
+
+
+/*****
+Func - return the value of the function
+*****/
+double QuadraticFn::Func(const vector<double>& u)
+{
+  IncFuncCalls();
+  double f = 0;
+  for (size_t k = 0; k < vi.size(); ++k) 
+    f += va[k] * u[vi[k]] + vb[k] * pow(u[vi[k]], 2);
+  return f;
+}
+
+
+/*****
+Grad - return the gradient of the function
+*****/
+void QuadraticFn::Grad(const vector<double>& u, vector<double>& du)
 {
   IncGradCalls();
   du.assign(du.size(), 0.);
-  du[ix] = 2 * u[ix] - w;
+  for (size_t k = 0; k < vi.size(); ++k) 
+    du[vi[k]] += va[k] + 2 * vb[k] * u[vi[k]];
+}
+
+
+/*****
+FuncGrad - return the value of the function and put the gradient in du
+*****/
+double QuadraticFn::FuncGrad(const vector<double>& u, vector<double>& du)
+{
+  double f = Func(u);
+  Grad(u, du);
+  return f;
+}
+
+
+/*****
+PutParams - write the member variables
+*****/
+void QuadraticFn::PutParams(ostream& os) const
+{
+  PutVector(os, vi);
+  os << " ";
+  PutVector(os, va);
+  os << " ";
+  PutVector(os, vb);
+}
+
+
+/*****
+GetParams - read the member variables written by PutParams()
+*****/
+void QuadraticFn::GetParams(istream& is)
+{
+  GetVector(is, vi);
+  GetVector(is, va);
+  GetVector(is, vb);
+}
+
+
+/*****
+MakeCopy - return a copy of the function, made by way of its parameters
+*****/
+tmDifferentiableFn* QuadraticFn::MakeCopy() const
+{
+  return tmNLCOProblem::CopyFn(this);
 }
@@ -16,15 +16,67 @@ Copyright:    
 #include "tmNLCO.h"
 #include "tmPoint.h"
 
+/**********
+class ConstraintFn
+Base class for the constraint functions below. Each constraint depends on only
+a handful of the optimization variables, so rather than writing a full-length
+gradient vector, it adds its gradient into the caller's gradient, touching
+only the variables that it depends on, which it reports through GetVars().
+SetVars() changes those indices (see tmNLCOPresolve). The dense Grad() is
+implemented in terms of AddGrad().
+
+Each constraint can write its member variables with PutParams() and read them
+back into a default-constructed object with GetParams(), which is how
+tmNLCOProblem captures and replays optimization problems, and how MakeCopy()
+copies a constraint.
+
+The types that are most numerous in large problems (the path constraints and
+QuantizeAngleFn1) also have a block form (see tmConstraintBlock), which the ALM
+optimizer uses to evaluate them in bulk. The blocks of path constraints compute
+their distances and gradients with vector instructions, chosen at run time from
+those the processor supports; SetVectorUnit() can choose lesser ones.
+**********/
+class ConstraintFn : public tmDifferentiableFn {
+public:
+  // Vector instructions for the block forms, from least to best
+  enum VectorUnit {
+    VECTOR_NONE,
+    VECTOR_SSE2,
+    VECTOR_AVX2
+  };
+  static VectorUnit GetBestVectorUnit();
+  static VectorUnit GetVectorUnit();
+  static void SetVectorUnit(VectorUnit unit);
+  
+  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  virtual void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du) = 0;
+  virtual void GetVars(std::vector<std::size_t>& vars) = 0;
+  virtual void SetVars(const std::vector<std::size_t>& vars) = 0;
+  bool IsSparse() const {return true;};
+  tmDifferentiableFn* MakeCopy() const;
+private:
+  static VectorUnit sVectorUnit;   // instructions used by the block forms
+};
+
+
 /**********
 class OneVarFn 
 Used to constrain a single variable, e.g., a coordinate of a single node.
 **********/
-class OneVarFn : public tmDifferentiableFn {
+class OneVarFn : public ConstraintFn {
 public:
   OneVarFn(std::size_t aix, double aa, double ab);
+  OneVarFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "OneVarFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   double a;
@@ -36,11 +88,19 @@ private:
 class TwoVarFn
 Used to constrain two variables, e.g., a pair of strains
 **********/
-class TwoVarFn : public tmDifferentiableFn {
+class TwoVarFn : public ConstraintFn {
 public:
   TwoVarFn(std::size_t aix, double aa, std::size_t aiy, double ab, double ac);
+  TwoVarFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "TwoVarFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -54,17 +114,30 @@ private:
 class PathFn1
 Used to constrain distances between two nodes when the scale is flexible.
 **********/
-class PathFn1 : public tmDifferentiableFn {
+class PathFn1 : public ConstraintFn {
 public:
   PathFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, double alij);
+  PathFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "PathFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   std::size_t jx;
   std::size_t jy;
   double lij;
+  friend class PathFnBlock;
 };
 
 
@@ -73,17 +146,30 @@ class PathFn2
 Used to fix the distance between a movable node and a fixed node when the 
 scale is flexible.
 **********/
-class PathFn2 : public tmDifferentiableFn {
+class PathFn2 : public ConstraintFn {
 public:
   PathFn2(std::size_t aix, std::size_t aiy, double avx, double avy, double alij);
+  PathFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "PathFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   double vx;
   double vy;
   double lij;
+  friend class PathFnBlock;
 };
 
 
@@ -91,11 +177,18 @@ private:
 class PathAngleFn1
 Used to fix the angle of a path between two movable nodes to a particular value.
 **********/
-class PathAngleFn1 : public tmDifferentiableFn {
+class PathAngleFn1 : public ConstraintFn {
 public:
   PathAngleFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, double aa);
+  PathAngleFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "PathAngleFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -111,11 +204,18 @@ class PathAngleFn2
 Used to fix the angle of a path between a movable and a fixed node to a 
 particular value.
 **********/
-class PathAngleFn2 : public tmDifferentiableFn {
+class PathAngleFn2 : public ConstraintFn {
 public:
   PathAngleFn2(std::size_t aix, std::size_t aiy, double avx, double avy, double aa);
+  PathAngleFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "PathAngleFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -131,18 +231,31 @@ class StrainPathFn1
 Used to constrain distances between two movable nodes when some 
 of the edges may be stretchable.
 **********/
-class StrainPathFn1 : public tmDifferentiableFn {
+class StrainPathFn1 : public ConstraintFn {
 public:
   StrainPathFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, double alfix, double alvar);
+  StrainPathFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "StrainPathFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   std::size_t jx;
   std::size_t jy;
   double lfix;
   double lvar;
+  friend class PathFnBlock;
 };
 
 
@@ -151,18 +264,31 @@ class StrainPathFn2
 Used to constrain distances between a movable node
 and a fixed node when some of the edges may be stretchable.
 **********/
-class StrainPathFn2 : public tmDifferentiableFn {
+class StrainPathFn2 : public ConstraintFn {
 public:
   StrainPathFn2(std::size_t aix, std::size_t aiy, double avx, double avy, double alfix, double alvar);
+  StrainPathFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "StrainPathFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   double vx;
   double vy;
   double lfix;
   double lvar;
+  friend class PathFnBlock;
 };
 
 
@@ -171,11 +297,18 @@ class StrainPathFn3
 Used to constrain distances between two fixed nodes when some of the edges 
 may be stretchable.
 **********/
-class StrainPathFn3 : public tmDifferentiableFn {
+class StrainPathFn3 : public ConstraintFn {
 public:
   StrainPathFn3(double aux, double auy, double avx, double avy, double alfix, double alvar);
+  StrainPathFn3() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);    
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "StrainPathFn3";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   double ux;
   double uy;
@@ -190,11 +323,18 @@ private:
 class StickToEdgeFn
 Used to constrain a coordinate to lie on the edge of the paper.
 **********/
-class StickToEdgeFn : public tmDifferentiableFn {
+class StickToEdgeFn : public ConstraintFn {
 public:
   StickToEdgeFn(std::size_t aix, std::size_t aiy, double aw, double ah);
+  StickToEdgeFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "StickToEdgeFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -208,11 +348,19 @@ class StickToLineFn
 Used to constrain a node to lie on a line (e.du., a line of symmetry). 
 The line is defined by a point on the line and the angle of the line.
 **********/
-class StickToLineFn : public tmDifferentiableFn {
+class StickToLineFn : public ConstraintFn {
 public:
   StickToLineFn(std::size_t aix, std::size_t aiy, tmPoint ap, double aa);
+  StickToLineFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "StickToLineFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -234,11 +382,19 @@ two points.
 class PairFn1A
 Used to constraint two movable nodes to be mirror-symmetric.
 **********/
-class PairFn1A : public tmDifferentiableFn {
+class PairFn1A : public ConstraintFn {
 public:
   PairFn1A(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, tmPoint ap, double aa);
+  PairFn1A() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "PairFn1A";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -254,11 +410,19 @@ private:
 class PairFn1B
 Used to constraint two movable nodes to be mirror-symmetric.
 **********/
-class PairFn1B : public tmDifferentiableFn {
+class PairFn1B : public ConstraintFn {
 public:
   PairFn1B(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, tmPoint ap, double aa);
+  PairFn1B() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "PairFn1B";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -281,11 +445,19 @@ must create BOTH a PairFn2A and a PairFn2B to fully constrain the two points.
 class PairFn2A
 Used to constrain a fixed and a movable node to be mirror-symmetric.
 **********/
-class PairFn2A : public tmDifferentiableFn {
+class PairFn2A : public ConstraintFn {
 public:
   PairFn2A(std::size_t aix, std::size_t aiy, double avx, double avy, tmPoint ap, double aa);
+  PairFn2A() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "PairFn2A";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -301,11 +473,19 @@ private:
 class PairFn2B
 Used to constrain a fixed and a movable node to be mirror-symmetric.
 **********/
-class PairFn2B : public tmDifferentiableFn {
+class PairFn2B : public ConstraintFn {
 public:
   PairFn2B(std::size_t aix, std::size_t aiy, double avx, double avy, tmPoint ap, double aa);
+  PairFn2B() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  bool GetLinear(std::vector<double>& coefs, double& constant) const;
+  const char* GetTag() const {return "PairFn2B";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -329,11 +509,18 @@ CollinearFn3 is used when 1 node is variable.
 class CollinearFn1
 Used to constrain 3 nodes to lie on the same line when 3 nodes are variable.
 **********/
-class CollinearFn1 : public tmDifferentiableFn {
+class CollinearFn1 : public ConstraintFn {
 public:
   CollinearFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, std::size_t akx, std::size_t aky);
+  CollinearFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "CollinearFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -348,11 +535,18 @@ private:
 class CollinearFn2
 Used to constrain 3 nodes to lie on the same line when 2 nodes are variable.
 **********/
-class CollinearFn2 : public tmDifferentiableFn {
+class CollinearFn2 : public ConstraintFn {
 public:
   CollinearFn2(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, double awx, double awy);
+  CollinearFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "CollinearFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -367,11 +561,18 @@ private:
 class CollinearFn3
 Used to constrain 3 nodes to lie on the same line when 1 node is variable.
 **********/
-class CollinearFn3 : public tmDifferentiableFn {
+class CollinearFn3 : public ConstraintFn {
 public:
   CollinearFn3(std::size_t aix, std::size_t aiy, double avx, double avy, double awx, double awy);
+  CollinearFn3() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "CollinearFn3";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -387,11 +588,18 @@ class BoundaryFn
 Used to force a point to lie on the same side of the line through
 points p1 and p2 as point q is on.
 **********/
-class BoundaryFn : public tmDifferentiableFn {
+class BoundaryFn : public ConstraintFn {
 public:
   BoundaryFn(std::size_t aix, std::size_t aiy, tmPoint ap1, tmPoint ap2, tmPoint aq);
+  BoundaryFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "BoundaryFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -406,13 +614,25 @@ private:
 class QuantizeAngleFn1
 Used to constrain the angle between two nodes to a quantized value.
 **********/
-class QuantizeAngleFn1 : public tmDifferentiableFn {
+class QuantizeAngleFn1 : public ConstraintFn {
 public:
   QuantizeAngleFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy,
     std::size_t an, double aoffset);
+  QuantizeAngleFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "QuantizeAngleFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddTermsGrad(const std::vector<double>& u, double r2, double f1, 
+    double f2, double fac, std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   std::size_t jx;
@@ -421,6 +641,7 @@ private:
   double da;
   double oa;
   double wt;
+  friend class QuantizeAngleFn1Block;
 };
 
 
@@ -428,12 +649,19 @@ private:
 class QuantizeAngleFn2
 Used to constrain the angle between a moving and a nonmoving node to a quantized value.
 **********/
-class QuantizeAngleFn2 : public tmDifferentiableFn {
+class QuantizeAngleFn2 : public ConstraintFn {
 public:
   QuantizeAngleFn2(std::size_t aix, std::size_t aiy, double avx, double avy,
     std::size_t an, double aoffset);
+  QuantizeAngleFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "QuantizeAngleFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   std::size_t iy;
@@ -450,12 +678,23 @@ private:
 class LocalizeFn
 Used to constrain the coordinates of a node to lie within a circle of a given radius.
 **********/
-class LocalizeFn : public tmDifferentiableFn {
+class LocalizeFn : public ConstraintFn {
 public:
   LocalizeFn(std::size_t aix, std::size_t aiy, double avx, double avy, double ar);
+  LocalizeFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "LocalizeFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   double vx;
@@ -469,13 +708,25 @@ class MultiStrainPathFn1
 Used to constrain distances between two movable nodes when some of the edges 
 may be stretchable.
 **********/
-class MultiStrainPathFn1 : public tmDifferentiableFn {
+class MultiStrainPathFn1 : public ConstraintFn {
 public:
   MultiStrainPathFn1(std::size_t aix, std::size_t aiy, std::size_t ajx, std::size_t ajy, double alfix,
     std::size_t ani, std::vector<std::size_t>& avi, std::vector<double>& avf);
+  MultiStrainPathFn1() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "MultiStrainPathFn1";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   std::size_t jx;
@@ -484,6 +735,7 @@ private:
   std::size_t ni;
   std::vector<std::size_t> vi;
   std::vector<double> vf;
+  friend class PathFnBlock;
 };
 
 
@@ -492,13 +744,25 @@ class MultiStrainPathFn2
 Used to constrain distances between a movable node and a fixed node when some 
 of the edges may be stretchable.
 **********/
-class MultiStrainPathFn2 : public tmDifferentiableFn {
+class MultiStrainPathFn2 : public ConstraintFn {
 public:
   MultiStrainPathFn2(std::size_t aix, std::size_t aiy, double avx, double avy, double alfix,
     std::size_t ani, std::vector<std::size_t>& avi, std::vector<double>& avf);
+  MultiStrainPathFn2() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);  
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "MultiStrainPathFn2";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmConstraintBlock* MakeBlock() const;
+  double FuncAddGrad(const std::vector<double>& u, GradWeight& gw, 
+    std::vector<double>& du);
 private:
+  void AddDistGrad(const std::vector<double>& u, double dist, double fac, 
+    std::vector<double>& du);
   std::size_t ix;
   std::size_t iy;
   double vx;
@@ -507,6 +771,7 @@ private:
   std::size_t ni;
   std::vector<std::size_t> vi;
   std::vector<double> vf;
+  friend class PathFnBlock;
 };
 
 
@@ -515,12 +780,19 @@ class MultiStrainPathFn3
 Used to constrain distances between two fixed nodes when some of the edges 
 may be stretchable.
 **********/
-class MultiStrainPathFn3 : public tmDifferentiableFn {
+class MultiStrainPathFn3 : public ConstraintFn {
 public:
   MultiStrainPathFn3(double aux, double auy, double avx, double avy, double alfix,
     std::size_t ani, std::vector<std::size_t>& avi, std::vector<double>& avf);
+  MultiStrainPathFn3() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "MultiStrainPathFn3";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   double ux;
   double uy;
@@ -537,14 +809,46 @@ private:
 class CornerFn
 Used (in pairs) to constrain nodes to lie on any corner of the paper.
 **********/
-class CornerFn : public tmDifferentiableFn {
+class CornerFn : public ConstraintFn {
 public:
   CornerFn(std::size_t aix, double aw);
+  CornerFn() {};
   double Func(const std::vector<double>& u);
-  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  void AddGrad(const std::vector<double>& u, double fac, 
+    std::vector<double>& du);
+  void GetVars(std::vector<std::size_t>& vars);
+  void SetVars(const std::vector<std::size_t>& vars);
+  const char* GetTag() const {return "CornerFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
 private:
   std::size_t ix;
   double w;
 };
 
+
+
+/**********
+class QuadraticFn
+A separable quadratic function of some of the variables, the sum over its
+terms of a * u[i] + b * u[i]^2. The objectives of the optimizers refer back to
+the optimizer, so they're captured (and copied) as the equivalent QuadraticFn.
+**********/
+class QuadraticFn : public tmDifferentiableFn {
+public:
+  QuadraticFn() {};
+  void AddTerm(std::size_t ai, double aa, double ab);
+  double Func(const std::vector<double>& u);
+  void Grad(const std::vector<double>& u, std::vector<double>& du);
+  double FuncGrad(const std::vector<double>& u, std::vector<double>& du);
+  const char* GetTag() const {return "QuadraticFn";};
+  void PutParams(std::ostream& os) const;
+  void GetParams(std::istream& is);
+  tmDifferentiableFn* MakeCopy() const;
+private:
+  std::vector<std::size_t> vi;
+  std::vector<double> va;
+  std::vector<double> vb;
+};
+
 #endif // _TMCONSTRAINTFNS_H_
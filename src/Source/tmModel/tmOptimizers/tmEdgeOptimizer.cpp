@@ -52,6 +52,8 @@ void tmEdgeOptimizer::Initialize(tmDpptrArray<tmNode>& movingNodes,
   mNLCO->SetSize(mNumVars);
   mCurrentStateVec.resize(mNumVars);
   TreeToData();
+  mVarKeys.push_back(MakeKey(KEY_STRAIN));
+  KeyNodeVars(mMovingNodes);
   
   // Set the bounds on the optimization
   std::vector<double> bl(mNumVars, 0);      // lower bounds = 0 for all nodes
@@ -71,69 +73,102 @@ void tmEdgeOptimizer::Initialize(tmDpptrArray<tmNode>& movingNodes,
     
   // Create our objective function
   mNLCO->SetObjective(new tmEdgeOptimizerObjective(this));
+  
+  // Map the positions of leaf nodes and edges in the tree's cached structure
+  // to our variables, so that looking up a part doesn't search our lists.
+  const tmTree::LeafPathCache& cache = theTree->GetLeafPathCache();
+  mNodeOffsets.assign(cache.mLeafNodes.size(), tmArray<tmNode*>::BAD_OFFSET);
+  for (size_t i = n; i > 0; --i) {
+    size_t pos = cache.GetLeafNodePos(mMovingNodes[i - 1]);
+    TMASSERT(pos != tmArray<tmNode*>::BAD_OFFSET);
+    mNodeOffsets[pos] = 2 * i - 1;
+  }
+  mEdgeIsStretchy.assign(cache.mEdges.size(), false);
+  for (size_t i = 0; i < mStretchyEdges.size(); ++i) {
+    size_t pos = cache.GetEdgePos(mStretchyEdges[i]);
+    TMASSERT(pos != tmArray<tmEdge*>::BAD_OFFSET);
+    mEdgeIsStretchy[pos] = true;
+  }
+  
+  // Sum the fixed and variable parts of the scaled edge lengths from the root
+  // of the tree down to each node, so that the lengths of any path can be
+  // found from the sums at its ends and at their common ancestor.
+  const tmTree::PathRoutes& routes = theTree->GetPathRoutes();
+  size_t nr = routes.mNodes.size();
+  mRootFixLen.assign(nr, 0.0);
+  mRootVarLen.assign(nr, 0.0);
+  for (size_t k = 1; k < nr; ++k) {
+    tmEdge* aEdge = routes.mEdges[k - 1];
+    size_t kp = routes.mParent[k];
+    double temp = aEdge->GetLength() * theTree->GetScale();
+    if (GetBaseOffset(aEdge) != tmArray<tmEdge>::BAD_OFFSET) {
+      mRootFixLen[k] = mRootFixLen[kp] + temp;
+      mRootVarLen[k] = mRootVarLen[kp] + temp;
+    }
+    else {
+      mRootFixLen[k] = mRootFixLen[kp] + (1 + aEdge->GetStrain()) * temp;
+      mRootVarLen[k] = mRootVarLen[kp];
+    }
+  }
 
   // Go through the leaf paths and add a constraint for each path that includes
-  // one or more moving nodes or stretchy edges.
-  {
-    tmArrayIterator<tmPath*> iOwnedPaths(theTree->GetOwnedPaths());
-    tmPath* aPath;
-    while (iOwnedPaths.Next(&aPath)) {
-      if (aPath->IsLeafPath()) {
-        
-        // If there's a path condition joining these nodes, then the
-        // standard path condition is unnecessary. So we won't apply it.
-        if (theTree->IsConditioned<tmConditionPathActive>(aPath)) 
-          continue;
-        
-        // Get nodes at each end of the path and their indices
-        tmNode* node1 = aPath->GetNodes().front();
-        size_t ix = GetBaseOffset(node1);
-        size_t iy = ix + 1;  
-        bool iMovable = (ix != tmArray<tmNode*>::BAD_OFFSET);      
-        
-        tmNode* node2 = aPath->GetNodes().back();
-        size_t jx = GetBaseOffset(node2);
-        size_t jy = jx + 1;
-        bool jMovable = (jx != tmArray<tmNode*>::BAD_OFFSET);
-        
-        // Note that GetBaseOffset returned 0 if node1 or node2 aren't in
-        // mMovingNodes; Thus, we can use the index as a check on whether it's
-        // moving.
-        
-        // Get the fixed and variable lengths for this path and multiply them
-        // by the scale of the tree. Note that we need constraints even if no
-        // nodes are moving; the edge length might be fixed by fixed nodes.
-        double lfix, lvar;
-        GetFixVarLengths(aPath, lfix, lvar);
-      
-        if (iMovable && jMovable)   // both nodes moving
-          mNLCO->AddNonlinearInequality(new StrainPathFn1(ix, iy, jx, jy, lfix, lvar));
-        
-        else if (iMovable)       // only tmNode 1 moving
-          mNLCO->AddNonlinearInequality(new StrainPathFn2(ix, iy,
-            node2->GetLocX(), node2->GetLocY(), lfix, lvar));
-        
-        else if (jMovable)       // only tmNode 2 moving
-          mNLCO->AddNonlinearInequality(new StrainPathFn2(jx, jy,
-            node1->GetLocX(), node1->GetLocY(), lfix, lvar));
-        
-        else {            // neither tmNode moving
-        
-          // make sure the path contains a stretchy edge (there's a nonzero
-          // variable part); if it doesn't, there's no point in adding a
-          // constraint.
-          if (lvar == 0) continue;
-          mNLCO->AddNonlinearInequality(new StrainPathFn3(node1->GetLocX(), node1->GetLocY(),
-            node2->GetLocX(), node2->GetLocY(), lfix, lvar));
-        }
-      }
+  // one or more moving nodes or stretchy edges. Leaf paths with a path
+  // condition joining their nodes don't need the standard path constraint, so
+  // they aren't in the cache.
+  for (size_t i = 0; i < cache.mPaths.size(); ++i) {
+    tmPath* aPath = cache.mPaths[i];
+    
+    // Get nodes at each end of the path and their indices
+    tmNode* node1 = aPath->GetFrontNode();
+    size_t ix = mNodeOffsets[cache.mNodes1[i]];
+    size_t iy = ix + 1;  
+    bool iMovable = (ix != tmArray<tmNode*>::BAD_OFFSET);      
+    
+    tmNode* node2 = aPath->GetBackNode();
+    size_t jx = mNodeOffsets[cache.mNodes2[i]];
+    size_t jy = jx + 1;
+    bool jMovable = (jx != tmArray<tmNode*>::BAD_OFFSET);
+    
+    // Note that the offset is BAD_OFFSET if node1 or node2 aren't in
+    // mMovingNodes; Thus, we can use the index as a check on whether it's
+    // moving.
+    
+    // Get the fixed and variable lengths for this path and multiply them
+    // by the scale of the tree. Note that we need constraints even if no
+    // nodes are moving; the edge length might be fixed by fixed nodes.
+    double lfix, lvar;
+    GetFixVarLengths(aPath, lfix, lvar);
+  
+    if (iMovable && jMovable)   // both nodes moving
+      mNLCO->AddNonlinearInequality(new StrainPathFn1(ix, iy, jx, jy, lfix, lvar));
+    
+    else if (iMovable)       // only tmNode 1 moving
+      mNLCO->AddNonlinearInequality(new StrainPathFn2(ix, iy,
+        node2->GetLocX(), node2->GetLocY(), lfix, lvar));
+    
+    else if (jMovable)       // only tmNode 2 moving
+      mNLCO->AddNonlinearInequality(new StrainPathFn2(jx, jy,
+        node1->GetLocX(), node1->GetLocY(), lfix, lvar));
+    
+    else {            // neither tmNode moving
+    
+      // make sure the path contains a stretchy edge (there's a nonzero
+      // variable part); if it doesn't, there's no point in adding a
+      // constraint.
+      if (lvar == 0) continue;
+      mNLCO->AddNonlinearInequality(new StrainPathFn3(node1->GetLocX(), node1->GetLocY(),
+        node2->GetLocX(), node2->GetLocY(), lfix, lvar));
     }
+    KeyNewConstraints(KEY_PATH, node1->GetIndex(), node2->GetIndex());
   }
   
   // Go through all Conditions and add constraints for each.
   tmArrayIterator<tmCondition*> iConditions(theTree->GetConditions());
   tmCondition* aCondition;
-  while (iConditions.Next(&aCondition)) aCondition->AddConstraints(this);
+  while (iConditions.Next(&aCondition)) {
+    aCondition->AddConstraints(this);
+    KeyNewConstraints(KEY_CONDITION, aCondition->GetIndex());
+  }
   
   // Ready to go. User should probably check whether the number of equalities
   // exceeds the number of variables.
@@ -148,9 +183,9 @@ Return tmArray<tmNode*>::BAD_OFFSET if it isn't a moving tmNode.
 
 size_t tmEdgeOptimizer::GetBaseOffset(tmNode* aNode)
 {
-  size_t i = mMovingNodes.GetOffset(aNode);
-  if (i == tmArray<tmNode*>::BAD_OFFSET) return tmArray<tmNode*>::BAD_OFFSET;
-  else return 1 + 2 * i;
+  size_t i = GetTree()->GetLeafPathCache().GetLeafNodePos(aNode);
+  if (i >= mNodeOffsets.size()) return tmArray<tmNode*>::BAD_OFFSET;
+  else return mNodeOffsets[i];
 }
 
 
@@ -160,30 +195,26 @@ tmArray<tmEdge>::BAD_OFFSET if it isn't a moving edge.
 *****/
 size_t tmEdgeOptimizer::GetBaseOffset(tmEdge* aEdge)
 {
-  size_t i = mStretchyEdges.GetOffset(aEdge);
-  if (i == tmArray<tmEdge>::BAD_OFFSET) return tmArray<tmEdge>::BAD_OFFSET;
+  size_t i = GetTree()->GetLeafPathCache().GetEdgePos(aEdge);
+  if (i >= mEdgeIsStretchy.size() || !mEdgeIsStretchy[i]) 
+    return tmArray<tmEdge>::BAD_OFFSET;
   else return 0;
 }
 
 
 /*****
-Return the fixed and variable parts of the length of this path
+Return the fixed and variable parts of the length of this path, which take
+constant time to find from the sums of lengths down from the root.
 *****/
 void tmEdgeOptimizer::GetFixVarLengths(tmPath* aPath, double& lfix, 
   double& lvar)
 {
-  lfix = 0;
-  lvar = 0;
-  tmEdge* aEdge;
-  tmArrayIterator<tmEdge*> iPathEdges(aPath->GetEdges());
-  while (iPathEdges.Next(&aEdge)) {
-    double temp = aEdge->GetLength() * GetTree()->GetScale();
-    if (mStretchyEdges.contains(aEdge)) {
-      lfix += temp;
-      lvar += temp;
-    }
-    else lfix += (1 + aEdge->GetStrain()) * temp;
-  }
+  const tmTree::PathRoutes& routes = GetTree()->GetPathRoutes();
+  size_t i1 = aPath->GetFrontNode()->GetRoutePos();
+  size_t i2 = aPath->GetBackNode()->GetRoutePos();
+  size_t a = routes.GetAncestor(i1, i2);
+  lfix = mRootFixLen[i1] + mRootFixLen[i2] - 2 * mRootFixLen[a];
+  lvar = mRootVarLen[i1] + mRootVarLen[i2] - 2 * mRootVarLen[a];
 }
 
 
@@ -252,7 +283,7 @@ double tmEdgeOptimizerObjective::Func(const std::vector<double>& u)
 {
   IncFuncCalls();
   mEdgeOptimizer->mCurrentStateVec = u;
-  mEdgeOptimizer->GetNLCO()->ObjectiveUpdateUI();
+  mEdgeOptimizer->ObjectiveUpdateUI();
   return -u[0];
 }
 
@@ -267,3 +298,39 @@ void tmEdgeOptimizerObjective::Grad(const std::vector<double>&,
   du.assign(du.size(), 0.);
   du[0] = -1;
 }
+
+
+/*****
+Return the value of the function and its gradient together
+*****/
+double tmEdgeOptimizerObjective::FuncGrad(const std::vector<double>& u, 
+  std::vector<double>& du)
+{
+  double f = Func(u);
+  IncGradCalls();
+  du.assign(du.size(), 0.);
+  du[0] = -1;
+  return f;
+}
+
+
+/*****
+Write the parameters of the equivalent QuadraticFn, -u[0], for a captured
+problem
+*****/
+void tmEdgeOptimizerObjective::PutParams(std::ostream& os) const
+{
+  QuadraticFn q;
+  q.AddTerm(0, -1, 0);
+  q.PutParams(os);
+}
+
+
+/*****
+Return the equivalent QuadraticFn, which computes the same values without
+recording the state or updating the UI
+*****/
+tmDifferentiableFn* tmEdgeOptimizerObjective::MakeCopy() const
+{
+  return tmNLCOProblem::CopyFn(this);
+}
@@ -38,6 +38,10 @@ private:
   std::size_t mNumVars;               // number of variables
   tmArray<tmNode*> mMovingNodes;      // list of moving nodes
   tmArray<tmEdge*> mStretchyEdges;    // list of stretchy edges
+  std::vector<std::size_t> mNodeOffsets;  // by leaf node position in cache
+  std::vector<bool> mEdgeIsStretchy;      // by edge position in cache
+  std::vector<double> mRootFixLen;    // fixed and variable path lengths from
+  std::vector<double> mRootVarLen;    //   the root, by position in the routes
   
   friend class tmEdgeOptimizerObjective;
 };
@@ -53,6 +57,10 @@ class tmEdgeOptimizerObjective : public tmDifferentiableFn
 public:
   double Func(const std::vector<double>& u);
   void Grad(const std::vector<double>& u, std::vector<double>& du);
+  double FuncGrad(const std::vector<double>& u, std::vector<double>& du);
+  const char* GetTag() const {return "QuadraticFn";};
+  void PutParams(std::ostream& os) const;
+  tmDifferentiableFn* MakeCopy() const;
 private:
   tmEdgeOptimizer* mEdgeOptimizer;
   tmEdgeOptimizerObjective(tmEdgeOptimizer* aEdgeOptimizer);
@@ -0,0 +1,833 @@
+/*******************************************************************************
+File:         tmNLCOPresolve.cpp
+Project:      TreeMaker 5.x
+Purpose:      Implementation file for eliminating fixed and tied variables from
+              an optimization problem
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#include "tmNLCOPresolve.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+/*
+Relative tolerance for treating a coefficient as zero, an equality with no
+free variables as satisfied, and a fixed value as within its bounds.
+*/
+const double k_Presolve_Tol = 1.0e-10;
+
+
+/**********
+class tmNLCOPresolve::SparseFn
+A sparse function of the full variables, evaluated on the reduced variables.
+If each of its variables is simply another name for a reduced variable, which
+is the usual case, the function is re-indexed to read the reduced variables
+directly. Otherwise it's re-indexed to read a short vector of slots of its
+own; slots of fixed variables are filled once, and the others are filled from
+their terms in the reduced variables before each call. Since each constraint
+is evaluated by only one thread at a time, the slots need no locking. Either
+way, the function gets its original indices back when we're destroyed. A copy
+(from MakeCopy()) has its own copy of the function, already re-indexed, and
+its own slots, and deletes the function when it's destroyed.
+**********/
+class tmNLCOPresolve::SparseFn : public tmDifferentiableFn {
+public:
+  SparseFn(tmNLCOPresolve* aPresolve, tmDifferentiableFn* aFn);
+  ~SparseFn();
+  double Func(const vector<double>& y);
+  void Grad(const vector<double>& y, vector<double>& dy);
+  void AddGrad(const vector<double>& y, double fac, vector<double>& dy);
+  double FuncAddGrad(const vector<double>& y, GradWeight& gw, 
+    vector<double>& dy);
+  bool IsSparse() const {return true;};
+  void GetVars(vector<size_t>& vars);
+  tmDifferentiableFn* MakeCopy() const;
+  tmDifferentiableFn* GetBlockFn() {
+    // When we read the reduced variables directly, blocks can skip us.
+    return mDirect ? mFn : this;};
+  bool IsConstant() const {
+    // Return true if all of our variables are fixed.
+    return mVars.empty();};
+private:
+  tmDifferentiableFn* mFn;    // the function
+  bool mOwned;                // true = mFn is a copy, which we own
+  vector<size_t> mFullVars;   // its original indices
+  bool mDirect;               // true = reads the reduced variables directly
+  vector<size_t> mSlots;      // slots of free variables
+  vector<size_t> mSlotStart;  // mSlots[j] = mSlotOffset[j] + sum of
+  vector<size_t> mSlotVars;   //   mSlotCoefs[t] * y[mSlotVars[t]] from
+  vector<double> mSlotCoefs;  //   mSlotStart[j] up to mSlotStart[j + 1]
+  vector<double> mSlotOffset;
+  vector<size_t> mVars;       // distinct reduced variables
+  vector<double> mX;          // value of each slot
+  vector<double> mG;          // gradient with respect to each slot
+  
+  void Load(const vector<double>& y);
+  void Store(vector<double>& dy) const;
+};
+
+
+/*****
+Constructor. Work out where each of the function's variables comes from and
+re-index the function to read them from the reduced variables or our slots.
+*****/
+tmNLCOPresolve::SparseFn::SparseFn(tmNLCOPresolve* aPresolve, 
+  tmDifferentiableFn* aFn)
+  : mFn(aFn), mOwned(false), mDirect(true)
+{
+  mFn->GetVars(mFullVars);
+  size_t n = mFullVars.size();
+  mX.resize(n);
+  mG.resize(n);
+  vector<size_t> slots(n);
+  mSlotStart.push_back(0);
+  for (size_t j = 0; j < n; ++j) {
+    size_t i = mFullVars[j];
+    size_t t0 = aPresolve->mTermStart[i];
+    size_t t1 = aPresolve->mTermStart[i + 1];
+    slots[j] = j;
+    if (t0 == t1) {
+      mX[j] = aPresolve->mConstant[i];
+      continue;
+    }
+    mSlots.push_back(j);
+    mSlotOffset.push_back(aPresolve->mConstant[i]);
+    for (size_t t = t0; t < t1; ++t) {
+      size_t k = aPresolve->mTermVars[t];
+      mSlotVars.push_back(k);
+      mSlotCoefs.push_back(aPresolve->mTermCoefs[t]);
+      if (find(mVars.begin(), mVars.end(), k) == mVars.end()) 
+        mVars.push_back(k);
+    }
+    mSlotStart.push_back(mSlotVars.size());
+  }
+  mDirect = (mSlots.size() == n && mSlotVars.size() == n);
+  for (size_t j = 0; mDirect && j < n; ++j)
+    mDirect = (mSlotCoefs[j] == 1. && mSlotOffset[j] == 0.);
+  mFn->SetVars(mDirect ? mSlotVars : slots);
+}
+
+
+/*****
+Destructor. Put the function's indices back the way they were, or if it's our
+own copy, delete it.
+*****/
+tmNLCOPresolve::SparseFn::~SparseFn()
+{
+  if (mOwned) delete mFn;
+  else mFn->SetVars(mFullVars);
+}
+
+
+/*****
+Fill the slots of free variables from the reduced variables.
+*****/
+void tmNLCOPresolve::SparseFn::Load(const vector<double>& y)
+{
+  for (size_t j = 0; j < mSlots.size(); ++j) {
+    double v = mSlotOffset[j];
+    for (size_t t = mSlotStart[j]; t < mSlotStart[j + 1]; ++t)
+      v += mSlotCoefs[t] * y[mSlotVars[t]];
+    mX[mSlots[j]] = v;
+  }
+}
+
+
+/*****
+Add the gradient with respect to the slots into the reduced gradient.
+*****/
+void tmNLCOPresolve::SparseFn::Store(vector<double>& dy) const
+{
+  for (size_t j = 0; j < mSlots.size(); ++j) {
+    double g = mG[mSlots[j]];
+    for (size_t t = mSlotStart[j]; t < mSlotStart[j + 1]; ++t)
+      dy[mSlotVars[t]] += mSlotCoefs[t] * g;
+  }
+}
+
+
+/*****
+Return the value of the function
+*****/
+double tmNLCOPresolve::SparseFn::Func(const vector<double>& y)
+{
+  if (mDirect) return mFn->Func(y);
+  Load(y);
+  return mFn->Func(mX);
+}
+
+
+/*****
+Return the gradient of the function
+*****/
+void tmNLCOPresolve::SparseFn::Grad(const vector<double>& y, 
+  vector<double>& dy)
+{
+  dy.assign(dy.size(), 0.);
+  AddGrad(y, 1., dy);
+}
+
+
+/*****
+Add fac times the gradient of the function to dy
+*****/
+void tmNLCOPresolve::SparseFn::AddGrad(const vector<double>& y, double fac, 
+  vector<double>& dy)
+{
+  if (mDirect) {
+    mFn->AddGrad(y, fac, dy);
+    return;
+  }
+  Load(y);
+  mG.assign(mG.size(), 0.);
+  mFn->AddGrad(mX, fac, mG);
+  Store(dy);
+}
+
+
+/*****
+Return the value of the function and add the weighted gradient to dy
+*****/
+double tmNLCOPresolve::SparseFn::FuncAddGrad(const vector<double>& y, 
+  GradWeight& gw, vector<double>& dy)
+{
+  if (mDirect) return mFn->FuncAddGrad(y, gw, dy);
+  Load(y);
+  mG.assign(mG.size(), 0.);
+  double f = mFn->FuncAddGrad(mX, gw, mG);
+  Store(dy);
+  return f;
+}
+
+
+/*****
+Append the reduced variables that the function depends on
+*****/
+void tmNLCOPresolve::SparseFn::GetVars(vector<size_t>& vars)
+{
+  vars.insert(vars.end(), mVars.begin(), mVars.end());
+}
+
+
+/*****
+Return a copy that evaluates a copy of the function, or NULL if the function
+can't be copied
+*****/
+tmDifferentiableFn* tmNLCOPresolve::SparseFn::MakeCopy() const
+{
+  tmDifferentiableFn* f = mFn->MakeCopy();
+  if (!f) return 0;
+  SparseFn* theCopy = new SparseFn(*this);
+  theCopy->mFn = f;
+  theCopy->mOwned = true;
+  return theCopy;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCOPresolve::DenseFn
+A dense function of the full variables (typically the objective), evaluated
+on the reduced variables by expanding them to the full variables. A copy (from
+MakeCopy()) owns its copy of the function.
+**********/
+class tmNLCOPresolve::DenseFn : public tmDifferentiableFn {
+public:
+  DenseFn(tmNLCOPresolve* aPresolve, tmDifferentiableFn* aFn, 
+    bool owned = false) :
+    mPresolve(aPresolve), mFn(aFn), mOwned(owned) {};
+  ~DenseFn() {
+    // Delete the function if it's ours.
+    if (mOwned) delete mFn;};
+  double Func(const vector<double>& y);
+  void Grad(const vector<double>& y, vector<double>& dy);
+  double FuncGrad(const vector<double>& y, vector<double>& dy);
+  tmDifferentiableFn* MakeCopy() const;
+private:
+  tmNLCOPresolve* mPresolve;  // the presolve that made us
+  tmDifferentiableFn* mFn;    // the function
+  bool mOwned;                // true = mFn is a copy, which we own
+  vector<double> mX;          // the full variables
+  vector<double> mG;          // gradient with respect to the full variables
+};
+
+
+/*****
+Return the value of the function
+*****/
+double tmNLCOPresolve::DenseFn::Func(const vector<double>& y)
+{
+  mPresolve->Expand(y, mX);
+  return mFn->Func(mX);
+}
+
+
+/*****
+Return the gradient of the function
+*****/
+void tmNLCOPresolve::DenseFn::Grad(const vector<double>& y, 
+  vector<double>& dy)
+{
+  mPresolve->Expand(y, mX);
+  mG.resize(mX.size());
+  mFn->Grad(mX, mG);
+  mPresolve->ReduceGrad(mG, dy);
+}
+
+
+/*****
+Return the value and gradient of the function
+*****/
+double tmNLCOPresolve::DenseFn::FuncGrad(const vector<double>& y, 
+  vector<double>& dy)
+{
+  mPresolve->Expand(y, mX);
+  mG.resize(mX.size());
+  double f = mFn->FuncGrad(mX, mG);
+  mPresolve->ReduceGrad(mG, dy);
+  return f;
+}
+
+
+/*****
+Return a copy that evaluates a copy of the function, or NULL if the function
+can't be copied
+*****/
+tmDifferentiableFn* tmNLCOPresolve::DenseFn::MakeCopy() const
+{
+  tmDifferentiableFn* f = mFn->MakeCopy();
+  if (!f) return 0;
+  return new DenseFn(mPresolve, f, true);
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmNLCOPresolve
+Eliminates fixed and tied variables from an optimization problem.
+**********/
+
+/*****
+Constructor
+*****/
+tmNLCOPresolve::tmNLCOPresolve(tmNLCO* aNLCO)
+  : mNLCO(aNLCO), mReducedNLCO(0)
+{
+  mSubStart.push_back(0);
+}
+
+
+/*****
+Destructor. Deleting the reduced problem restores the original constraints.
+*****/
+tmNLCOPresolve::~tmNLCOPresolve()
+{
+  Clear();
+}
+
+
+/*****
+Discard the reduced problem and the elimination. Substitutions, drops, and
+keeps are kept for the next call to Reduce().
+*****/
+void tmNLCOPresolve::Clear()
+{
+  if (mReducedNLCO) delete mReducedNLCO;
+  mReducedNLCO = 0;
+  mRoot.clear();
+  mScale.clear();
+  mOffset.clear();
+  mFixed.clear();
+  mValue.clear();
+  mReducedIndex.clear();
+  mVarMap.clear();
+  mConstraintMap.clear();
+  mLower.clear();
+  mUpper.clear();
+  mTermStart.clear();
+  mTermVars.clear();
+  mTermCoefs.clear();
+  mConstant.clear();
+}
+
+
+/*****
+Write variable i as sum(coefs[j] * x[vars[j]]) + constant in the reduced
+problem. None of vars may be substituted themselves. Call before Reduce().
+*****/
+void tmNLCOPresolve::Substitute(size_t i, const vector<size_t>& vars, 
+  const vector<double>& coefs, double constant)
+{
+  TMASSERT(vars.size() == coefs.size());
+  size_t n = mNLCO->GetNumVariables();
+  TMASSERT(i < n);
+  if (mSubIndex.size() != n) mSubIndex.assign(n, NO_VAR);
+  TMASSERT(mSubIndex[i] == NO_VAR);
+  mSubIndex[i] = mSubConstant.size();
+  mSubVars.insert(mSubVars.end(), vars.begin(), vars.end());
+  mSubCoefs.insert(mSubCoefs.end(), coefs.begin(), coefs.end());
+  mSubConstant.push_back(constant);
+  mSubStart.push_back(mSubVars.size());
+}
+
+
+/*****
+Leave constraint k out of the reduced problem if it turns out to be the same
+function of the reduced variables as constraint kSame, which is kept. Call
+before Reduce().
+*****/
+void tmNLCOPresolve::DropIfSame(size_t k, size_t kSame)
+{
+  TMASSERT(k != kSame);
+  mDrops.push_back(k);
+  mDropSames.push_back(kSame);
+}
+
+
+/*****
+Don't use constraint k to eliminate variables, even if it's a linear equality
+that could; it goes into the reduced problem like any other constraint. Call
+before Reduce().
+*****/
+void tmNLCOPresolve::Keep(size_t k)
+{
+  mKeeps.push_back(k);
+}
+
+
+/*****
+Set up the reduced problem. Return true if it's smaller than the full problem;
+return false, with no reduced problem, if there was nothing to eliminate or if
+the full problem can't be reduced consistently.
+*****/
+bool tmNLCOPresolve::Reduce()
+{
+  Clear();
+  size_t n = mNLCO->GetNumVariables();
+  const vector<double>& bl = mNLCO->GetLowerBounds();
+  const vector<double>& bu = mNLCO->GetUpperBounds();
+  if (n == 0 || bl.size() != n || bu.size() != n) return false;
+  if (mSubIndex.size() != n) mSubIndex.assign(n, NO_VAR);
+  for (size_t t = 0; t < mSubVars.size(); ++t)
+    if (mSubVars[t] >= n || mSubIndex[mSubVars[t]] != NO_VAR) return false;
+  mRoot.resize(n);
+  for (size_t i = 0; i < n; ++i) mRoot[i] = i;
+  mScale.assign(n, 1.);
+  mOffset.assign(n, 0.);
+  mFixed.assign(n, false);
+  mValue.assign(n, 0.);
+  
+  // Use each linear equality that's left with one or two free variables to
+  // fix or tie them.
+  const vector<tmDifferentiableFn*>& flist = mNLCO->GetConstraints();
+  const vector<tmNLCO::ConstraintKind>& klist = mNLCO->GetConstraintKinds();
+  vector<bool> used(flist.size(), false);
+  size_t numUsed = 0;
+  vector<size_t> vars;
+  vector<double> coefs;
+  for (size_t k = 0; k < flist.size(); ++k) {
+    if (klist[k] != tmNLCO::LINEAR_EQUALITY) continue;
+    if (find(mKeeps.begin(), mKeeps.end(), k) != mKeeps.end()) continue;
+    vars.clear();
+    coefs.clear();
+    double constant;
+    if (!flist[k]->GetLinear(coefs, constant)) continue;
+    flist[k]->GetVars(vars);
+    if (coefs.size() != vars.size()) continue;
+    EliminateResult result = Eliminate(vars, coefs, constant);
+    if (result == ELIMINATE_INCONSISTENT) {
+      Clear();
+      return false;
+    }
+    if (result == ELIMINATE_SKIPPED) continue;
+    used[k] = true;
+    ++numUsed;
+  }
+  if (numUsed == 0 && mSubConstant.empty()) {
+    Clear();
+    return false;
+  }
+  
+  // The free roots that aren't substituted are the reduced variables. Write
+  // every variable in terms of them and work out their bounds.
+  mReducedIndex.assign(n, NO_VAR);
+  for (size_t i = 0; i < n; ++i) {
+    if (mSubIndex[i] != NO_VAR || FindRoot(i) != i || mFixed[i]) continue;
+    mReducedIndex[i] = mVarMap.size();
+    mVarMap.push_back(i);
+  }
+  if (mVarMap.empty()) {
+    Clear();
+    return false;
+  }
+  MakeTerms();
+  if (!ReduceBounds()) {
+    Clear();
+    return false;
+  }
+  
+  // Wrap the constraints we didn't use.
+  vector<tmDifferentiableFn*> wrapped(flist.size(), 0);
+  for (size_t k = 0; k < flist.size(); ++k) {
+    if (used[k]) continue;
+    if (!flist[k]->IsSparse()) {
+      wrapped[k] = new DenseFn(this, flist[k]);
+      continue;
+    }
+    SparseFn* sf = new SparseFn(this, flist[k]);
+    if (!sf->IsConstant()) {
+      wrapped[k] = sf;
+      continue;
+    }
+    
+    // A constraint on fixed variables only is dropped if it's satisfied.
+    double v = sf->Func(mLower);
+    delete sf;
+    bool eq = (klist[k] == tmNLCO::LINEAR_EQUALITY || 
+      klist[k] == tmNLCO::NONLINEAR_EQUALITY);
+    if (eq ? fabs(v) <= k_Presolve_Tol : v <= k_Presolve_Tol) continue;
+    for (size_t j = 0; j < k; ++j) 
+      if (wrapped[j]) delete wrapped[j];
+    Clear();
+    return false;
+  }
+  
+  // Drop the constraints that duplicate others.
+  for (size_t d = 0; d < mDrops.size(); ++d) {
+    size_t k = mDrops[d];
+    size_t kSame = mDropSames[d];
+    if (k >= flist.size() || kSame >= flist.size()) continue;
+    if (!wrapped[k] || !wrapped[kSame] || klist[k] != klist[kSame]) continue;
+    if (!IsSameFn(wrapped[k], wrapped[kSame])) continue;
+    delete wrapped[k];
+    wrapped[k] = 0;
+  }
+  
+  // Set up the reduced problem.
+  mReducedNLCO = mNLCO->MakeEmpty();
+  mReducedNLCO->SetUpdater(mNLCO->GetUpdater());
+  mReducedNLCO->SetMaxThreads(mNLCO->GetMaxThreads());
+  mReducedNLCO->SetSize(mVarMap.size());
+  mReducedNLCO->SetBounds(mLower, mUpper);
+  tmDifferentiableFn* obj = mNLCO->GetObjective();
+  if (obj->IsSparse()) mReducedNLCO->SetObjective(new SparseFn(this, obj));
+  else mReducedNLCO->SetObjective(new DenseFn(this, obj));
+  for (size_t k = 0; k < flist.size(); ++k) {
+    tmDifferentiableFn* f = wrapped[k];
+    if (!f) continue;
+    switch (klist[k]) {
+      case tmNLCO::LINEAR_EQUALITY:
+        mReducedNLCO->AddLinearEquality(f);
+        break;
+      case tmNLCO::NONLINEAR_EQUALITY:
+        mReducedNLCO->AddNonlinearEquality(f);
+        break;
+      case tmNLCO::LINEAR_INEQUALITY:
+        mReducedNLCO->AddLinearInequality(f);
+        break;
+      case tmNLCO::NONLINEAR_INEQUALITY:
+        mReducedNLCO->AddNonlinearInequality(f);
+        break;
+    }
+    mConstraintMap.push_back(k);
+  }
+  return true;
+}
+
+
+/*****
+Return the root of variable i, first pointing every variable between i and
+the root directly at the root.
+*****/
+size_t tmNLCOPresolve::FindRoot(size_t i)
+{
+  vector<size_t> path;
+  while (mRoot[i] != i) {
+    path.push_back(i);
+    i = mRoot[i];
+  }
+  for (size_t j = path.size(); j > 1; --j) {
+    size_t p = path[j - 1];
+    size_t q = path[j - 2];
+    mOffset[q] += mScale[q] * mOffset[p];
+    mScale[q] *= mScale[p];
+    mRoot[q] = i;
+  }
+  return i;
+}
+
+
+/*****
+Use the equality sum(coefs[j] * x[vars[j]]) + constant = 0 to fix a root or
+tie one root to another. Equalities left with more than two free roots are
+skipped; equalities left with none are checked against the ones we've already
+used and the substitutions.
+*****/
+tmNLCOPresolve::EliminateResult tmNLCOPresolve::Eliminate(
+  const vector<size_t>& vars, const vector<double>& coefs, double constant)
+{
+  // Write substituted variables in terms of the variables they stand for.
+  vector<size_t> xvars;
+  vector<double> xcoefs;
+  double c = constant;
+  for (size_t j = 0; j < vars.size(); ++j) {
+    size_t s = mSubIndex[vars[j]];
+    if (s == NO_VAR) {
+      xvars.push_back(vars[j]);
+      xcoefs.push_back(coefs[j]);
+      continue;
+    }
+    c += coefs[j] * mSubConstant[s];
+    for (size_t t = mSubStart[s]; t < mSubStart[s + 1]; ++t) {
+      xvars.push_back(mSubVars[t]);
+      xcoefs.push_back(coefs[j] * mSubCoefs[t]);
+    }
+  }
+  
+  // Write the equality in terms of the free roots.
+  vector<size_t> roots;
+  vector<double> a;
+  double amax = 0.;
+  for (size_t j = 0; j < xvars.size(); ++j) {
+    size_t i = xvars[j];
+    size_t r = FindRoot(i);
+    double s = xcoefs[j] * mScale[i];
+    c += xcoefs[j] * mOffset[i];
+    amax = max(amax, fabs(s));
+    if (mFixed[r]) {
+      c += s * mValue[r];
+      continue;
+    }
+    size_t m = find(roots.begin(), roots.end(), r) - roots.begin();
+    if (m < roots.size()) a[m] += s;
+    else {
+      roots.push_back(r);
+      a.push_back(s);
+    }
+  }
+  size_t nz = 0;
+  for (size_t j = 0; j < roots.size(); ++j) {
+    if (fabs(a[j]) <= k_Presolve_Tol * amax) continue;
+    roots[nz] = roots[j];
+    a[nz] = a[j];
+    ++nz;
+  }
+  
+  // No free roots: the equality is redundant or contradictory. One: it fixes
+  // the root. Two: it ties the higher-numbered root to the lower.
+  if (nz == 0) return fabs(c) <= k_Presolve_Tol * max(1., amax) ? 
+    ELIMINATE_USED : ELIMINATE_INCONSISTENT;
+  if (nz > 2) return ELIMINATE_SKIPPED;
+  if (nz == 1) {
+    mFixed[roots[0]] = true;
+    mValue[roots[0]] = -c / a[0];
+    return ELIMINATE_USED;
+  }
+  size_t keep = 0, drop = 1;
+  if (roots[1] < roots[0]) swap(keep, drop);
+  size_t r = roots[drop];
+  mRoot[r] = roots[keep];
+  mScale[r] = -a[keep] / a[drop];
+  mOffset[r] = -c / a[drop];
+  return ELIMINATE_USED;
+}
+
+
+/*****
+Write each full variable as a constant plus a sum of terms in the reduced
+variables. Terms too small to matter, such as those a line of symmetry at a
+right angle leaves behind, are left out.
+*****/
+void tmNLCOPresolve::MakeTerms()
+{
+  size_t n = mRoot.size();
+  mTermStart.assign(1, 0);
+  mConstant.assign(n, 0.);
+  for (size_t i = 0; i < n; ++i) {
+    size_t s = mSubIndex[i];
+    size_t t0 = mTermVars.size();
+    size_t v0 = (s == NO_VAR) ? i : mSubStart[s];
+    size_t v1 = (s == NO_VAR) ? i + 1 : mSubStart[s + 1];
+    if (s != NO_VAR) mConstant[i] = mSubConstant[s];
+    for (size_t v = v0; v < v1; ++v) {
+      size_t iv = (s == NO_VAR) ? i : mSubVars[v];
+      double cv = (s == NO_VAR) ? 1. : mSubCoefs[v];
+      size_t r = mRoot[iv];
+      mConstant[i] += cv * mOffset[iv];
+      if (mFixed[r]) {
+        mConstant[i] += cv * mScale[iv] * mValue[r];
+        continue;
+      }
+      size_t k = mReducedIndex[r];
+      size_t t = find(mTermVars.begin() + t0, mTermVars.end(), k) - 
+        mTermVars.begin();
+      if (t < mTermVars.size()) mTermCoefs[t] += cv * mScale[iv];
+      else {
+        mTermVars.push_back(k);
+        mTermCoefs.push_back(cv * mScale[iv]);
+      }
+    }
+    double amax = 0.;
+    for (size_t t = t0; t < mTermVars.size(); ++t)
+      amax = max(amax, fabs(mTermCoefs[t]));
+    size_t t1 = t0;
+    for (size_t t = t0; t < mTermVars.size(); ++t) {
+      if (fabs(mTermCoefs[t]) <= k_Presolve_Tol * amax) continue;
+      mTermVars[t1] = mTermVars[t];
+      mTermCoefs[t1] = mTermCoefs[t];
+      ++t1;
+    }
+    mTermVars.resize(t1);
+    mTermCoefs.resize(t1);
+    mTermStart.push_back(t1);
+  }
+}
+
+
+/*****
+Set the bounds of the reduced variables to the intersection of the bounds of
+every variable that's a multiple of one of them. Return false if the bounds
+can't all be met: if a fixed variable is out of bounds, if the bounds of a
+reduced variable are empty, or if the bounds of a variable that's a
+combination of several reduced variables aren't implied by theirs.
+*****/
+bool tmNLCOPresolve::ReduceBounds()
+{
+  const vector<double>& bl = mNLCO->GetLowerBounds();
+  const vector<double>& bu = mNLCO->GetUpperBounds();
+  size_t n = mRoot.size();
+  mLower.assign(mVarMap.size(), -HUGE_VAL);
+  mUpper.assign(mVarMap.size(), HUGE_VAL);
+  for (size_t i = 0; i < n; ++i) {
+    size_t t0 = mTermStart[i];
+    if (mTermStart[i + 1] != t0 + 1) continue;
+    size_t k = mTermVars[t0];
+    double s = mTermCoefs[t0];
+    double lo = (bl[i] - mConstant[i]) / s;
+    double hi = (bu[i] - mConstant[i]) / s;
+    if (s < 0) swap(lo, hi);
+    if (mLower[k] < lo) mLower[k] = lo;
+    if (mUpper[k] > hi) mUpper[k] = hi;
+  }
+  for (size_t k = 0; k < mVarMap.size(); ++k) {
+    if (mLower[k] <= mUpper[k]) continue;
+    double tol = k_Presolve_Tol * max(1., fabs(mUpper[k]));
+    if (mLower[k] > mUpper[k] + tol) return false;
+    mUpper[k] = mLower[k];
+  }
+  for (size_t i = 0; i < n; ++i) {
+    size_t t0 = mTermStart[i];
+    size_t t1 = mTermStart[i + 1];
+    if (t1 == t0 + 1) continue;
+    double lo = mConstant[i];
+    double hi = mConstant[i];
+    for (size_t t = t0; t < t1; ++t) {
+      size_t k = mTermVars[t];
+      double s = mTermCoefs[t];
+      lo += s * (s > 0 ? mLower[k] : mUpper[k]);
+      hi += s * (s > 0 ? mUpper[k] : mLower[k]);
+    }
+    double tol = k_Presolve_Tol * max(1., max(fabs(lo), fabs(hi)));
+    if (lo < bl[i] - tol || hi > bu[i] + tol) return false;
+  }
+  return true;
+}
+
+
+/*****
+Return true if the two functions of the reduced variables take the same values
+at a few points spread through the bounds. Both are constraints built from the
+same kinds of geometric relations, so agreement at arbitrary points means the
+same function rather than coincidence. Sparse functions of different variables
+(e.g., mirror-image paths with strains of their own) can't be the same, so we
+don't bother evaluating them.
+*****/
+bool tmNLCOPresolve::IsSameFn(tmDifferentiableFn* f1, 
+  tmDifferentiableFn* f2) const
+{
+  if (f1->IsSparse() && f2->IsSparse()) {
+    vector<size_t> vars1, vars2;
+    f1->GetVars(vars1);
+    f2->GetVars(vars2);
+    sort(vars1.begin(), vars1.end());
+    sort(vars2.begin(), vars2.end());
+    if (vars1 != vars2) return false;
+  }
+  const double k_Golden = 0.6180339887498949;
+  size_t m = mVarMap.size();
+  vector<double> y(m);
+  for (size_t p = 1; p <= 3; ++p) {
+    for (size_t k = 0; k < m; ++k) {
+      double lo = mLower[k];
+      double hi = mUpper[k];
+      if (lo < -1.0e6) lo = min(hi, 0.) - 1.;
+      if (hi > lo + 1.0e6) hi = lo + 2.;
+      double t = fmod(double((k + 1) * p) * k_Golden, 1.);
+      y[k] = lo + t * (hi - lo);
+    }
+    double v1 = f1->Func(y);
+    double v2 = f2->Func(y);
+    if (fabs(v1 - v2) > k_Presolve_Tol * max(1., fabs(v1) + fabs(v2))) 
+      return false;
+  }
+  return true;
+}
+
+
+/*****
+Put the gradient g with respect to the full variables into dy, the gradient
+with respect to the reduced variables.
+*****/
+void tmNLCOPresolve::ReduceGrad(const vector<double>& g, 
+  vector<double>& dy) const
+{
+  dy.assign(mVarMap.size(), 0.);
+  for (size_t i = 0; i < g.size(); ++i)
+    for (size_t t = mTermStart[i]; t < mTermStart[i + 1]; ++t)
+      dy[mTermVars[t]] += mTermCoefs[t] * g[i];
+}
+
+
+/*****
+Put the reduced variables corresponding to the full variables x into y,
+moved within the bounds of the reduced problem if necessary.
+*****/
+void tmNLCOPresolve::Restrict(const vector<double>& x, 
+  vector<double>& y) const
+{
+  TMASSERT(mReducedNLCO);
+  y.resize(mVarMap.size());
+  for (size_t k = 0; k < y.size(); ++k)
+    y[k] = min(max(x[mVarMap[k]], mLower[k]), mUpper[k]);
+}
+
+
+/*****
+Put the full variables corresponding to the reduced variables y into x.
+*****/
+void tmNLCOPresolve::Expand(const vector<double>& y, vector<double>& x) const
+{
+  TMASSERT(mReducedNLCO);
+  size_t n = mRoot.size();
+  x.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    double v = mConstant[i];
+    for (size_t t = mTermStart[i]; t < mTermStart[i + 1]; ++t)
+      v += mTermCoefs[t] * y[mTermVars[t]];
+    x[i] = v;
+  }
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************
+File:         tmNLCOPresolve.h
+Project:      TreeMaker 5.x
+Purpose:      Header file for eliminating fixed and tied variables from an
+              optimization problem
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#ifndef _TMNLCOPRESOLVE_H_
+#define _TMNLCOPRESOLVE_H_
+
+#include "tmNLCO.h"
+
+/**********
+class tmNLCOPresolve
+Sets up a smaller problem equivalent to a fully set-up tmNLCO problem by
+substituting out the variables that its linear equalities fix or tie together.
+Conditions such as fixed nodes and edges of equal strain become equalities in
+one or two variables (OneVarFn, TwoVarFn), which the optimizer would otherwise
+have to enforce by penalties or multipliers at every iteration.
+
+Reduce() takes each linear equality in turn and, if it involves no more than
+two variables that are still free, uses it to fix a variable to a constant or
+to write one variable as a linear function of another. The free variables,
+with the intersection of the bounds of every variable tied to them, are the
+variables of the reduced problem, which is set up in a new tmNLCO of the same
+kind (MakeEmpty()). The other constraints and the objective go into the
+reduced problem wrapped in functions that compute the full variables from the
+reduced ones and apply the chain rule to gradients; sparse constraints are
+re-indexed for the duration (SetVars()), so evaluating them costs no more than
+before. Constraints whose variables all turn out to be fixed are dropped if
+they're satisfied.
+
+Before calling Reduce(), the caller can also supply what it knows about the
+structure of the problem. Substitute() writes a variable as a linear function
+of others, e.g., a node as the mirror image of its partner across a line of
+symmetry; equalities that then hold identically, such as the ones that pair
+the two nodes, are dropped. DropIfSame() names a constraint that's expected to
+be the same function of the reduced variables as another one, e.g., the
+mirror image of a path; it's dropped if spot checks at a few points bear that
+out. Keep() names a linear equality that Reduce() mustn't eliminate with, e.g.,
+one that a symmetry the caller has chosen not to exploit would fold away; it
+stays in the reduced problem as an ordinary constraint.
+
+Reduce() returns false, leaving the problem as it was, if there's nothing to
+eliminate or if the equalities are inconsistent with each other or with the
+bounds; in the latter case the full problem should be solved, so that the
+optimizer reports the failure in the usual way. Restrict() and Expand() map
+between full and reduced variables. The original problem must stay set up,
+unchanged, for the life of this object.
+**********/
+class tmNLCOPresolve {
+public:
+  enum {NO_VAR = std::size_t(-1)};
+  
+  tmNLCOPresolve(tmNLCO* aNLCO);
+  ~tmNLCOPresolve();
+  
+  void Substitute(std::size_t i, const std::vector<std::size_t>& vars, 
+    const std::vector<double>& coefs, double constant);
+  void DropIfSame(std::size_t k, std::size_t kSame);
+  void Keep(std::size_t k);
+  bool Reduce();
+  tmNLCO* GetReducedNLCO() const {
+    // Return the reduced problem, or 0 if Reduce() hasn't succeeded.
+    return mReducedNLCO;};
+  const std::vector<std::size_t>& GetVarMap() const {
+    // Return the full index of each variable of the reduced problem.
+    return mVarMap;};
+  const std::vector<std::size_t>& GetConstraintMap() const {
+    // Return the full index of each constraint of the reduced problem.
+    return mConstraintMap;};
+  void Restrict(const std::vector<double>& x, std::vector<double>& y) const;
+  void Expand(const std::vector<double>& y, std::vector<double>& x) const;
+  
+private:
+  class SparseFn;
+  class DenseFn;
+  
+  // Outcome of using an equality in Eliminate()
+  enum EliminateResult {
+    ELIMINATE_USED,
+    ELIMINATE_SKIPPED,
+    ELIMINATE_INCONSISTENT
+  };
+  
+  tmNLCO* mNLCO;                          // the full problem
+  tmNLCO* mReducedNLCO;                   // the reduced problem
+  std::vector<std::size_t> mSubIndex;     // substitution for each variable
+  std::vector<std::size_t> mSubStart;     // x[i] = mSubConstant[s] + sum of
+  std::vector<std::size_t> mSubVars;      //   mSubCoefs[t] * x[mSubVars[t]]
+  std::vector<double> mSubCoefs;          //   from mSubStart[s] up to
+  std::vector<double> mSubConstant;       //   mSubStart[s + 1]
+  std::vector<std::size_t> mDrops;        // constraints to drop if the same
+  std::vector<std::size_t> mDropSames;    //   as these ones
+  std::vector<std::size_t> mKeeps;        // equalities not to eliminate with
+  std::vector<std::size_t> mRoot;         // variable each variable is tied to
+  std::vector<double> mScale;             // x[i] = mScale[i] * x[mRoot[i]]
+  std::vector<double> mOffset;            //   + mOffset[i]
+  std::vector<bool> mFixed;               // true if mRoot[i] is fixed
+  std::vector<double> mValue;             // value of a fixed root
+  std::vector<std::size_t> mReducedIndex; // reduced index of each root
+  std::vector<std::size_t> mVarMap;       // full index of each reduced var
+  std::vector<std::size_t> mConstraintMap;// full index of each reduced constr
+  std::vector<double> mLower;             // bounds of the reduced variables
+  std::vector<double> mUpper;
+  std::vector<std::size_t> mTermStart;    // x[i] = mConstant[i] + sum of
+  std::vector<std::size_t> mTermVars;     //   mTermCoefs[t] * y[mTermVars[t]]
+  std::vector<double> mTermCoefs;         //   from mTermStart[i] up to
+  std::vector<double> mConstant;          //   mTermStart[i + 1]
+  
+  std::size_t FindRoot(std::size_t i);
+  EliminateResult Eliminate(const std::vector<std::size_t>& vars, 
+    const std::vector<double>& coefs, double constant);
+  void MakeTerms();
+  bool ReduceBounds();
+  bool IsSameFn(tmDifferentiableFn* f1, tmDifferentiableFn* f2) const;
+  void ReduceGrad(const std::vector<double>& g, std::vector<double>& dy) const;
+  void Clear();
+  
+  // Copying is not allowed
+  tmNLCOPresolve(const tmNLCOPresolve&);
+  tmNLCOPresolve& operator=(const tmNLCOPresolve&);
+  
+  friend class SparseFn;
+  friend class DenseFn;
+};
+
+#endif // _TMNLCOPRESOLVE_H_
@@ -0,0 +1,277 @@
+/*******************************************************************************
+File:         tmNLCOProblem.cpp
+Project:      TreeMaker 5.x
+Purpose:      Implementation file for capturing and replaying optimization
+              problems
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#include "tmNLCOProblem.h"
+#include "tmConstraintFns.h"
+
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+/*
+The format of a captured problem is
+
+  tmNLCOProblem 1
+  size n
+  x x[0] ... x[n-1]
+  lower bl[0] ... bl[n-1]
+  upper bu[0] ... bu[n-1]
+  objective tag params
+  constraints m
+  kind tag params        (m times)
+  end
+
+where tag is the class of a function, params are whatever its PutParams()
+writes, and kind is one of the tags returned by GetKindTag().
+*/
+
+/**********
+class tmNLCOProblem
+Captures and replays optimization problems.
+**********/
+
+/*****
+STATIC
+Write the problem set up in aNLCO, starting from x, to the stream.
+*****/
+void tmNLCOProblem::Put(ostream& os, tmNLCO* aNLCO, const vector<double>& x)
+{
+  streamsize oldPrecision = os.precision(17);
+  size_t n = aNLCO->GetNumVariables();
+  TMASSERT(x.size() == n);
+  os << "tmNLCOProblem 1\n";
+  os << "size " << n << "\n";
+  PutVector(os, "x", x);
+  PutVector(os, "lower", aNLCO->GetLowerBounds());
+  PutVector(os, "upper", aNLCO->GetUpperBounds());
+  os << "objective ";
+  PutFn(os, aNLCO->GetObjective());
+  const vector<tmDifferentiableFn*>& flist = aNLCO->GetConstraints();
+  const vector<tmNLCO::ConstraintKind>& klist = aNLCO->GetConstraintKinds();
+  os << "constraints " << flist.size() << "\n";
+  for (size_t i = 0; i < flist.size(); ++i) {
+    os << GetKindTag(klist[i]) << " ";
+    PutFn(os, flist[i]);
+  }
+  os << "end\n";
+  os.precision(oldPrecision);
+}
+
+
+/*****
+STATIC
+Read a problem from the stream, set it up in aNLCO, which should be freshly
+constructed, and put the starting point in x. The NLCO takes ownership of the
+functions as usual. Throws EX_BAD_PROBLEM if the stream doesn't hold a problem
+in the expected form.
+*****/
+void tmNLCOProblem::Get(istream& is, tmNLCO* aNLCO, vector<double>& x)
+{
+  GetTag(is, "tmNLCOProblem");
+  int version = 0;
+  is >> version;
+  if (version != 1) throw EX_BAD_PROBLEM("tmNLCOProblem");
+  GetTag(is, "size");
+  size_t n = 0;
+  is >> n;
+  if (!is || n == 0) throw EX_BAD_PROBLEM("size");
+  vector<double> bl, bu;
+  GetVector(is, "x", n, x);
+  GetVector(is, "lower", n, bl);
+  GetVector(is, "upper", n, bu);
+  aNLCO->SetSize(n);
+  aNLCO->SetBounds(bl, bu);
+  GetTag(is, "objective");
+  aNLCO->SetObjective(GetFn(is));
+  GetTag(is, "constraints");
+  size_t m = 0;
+  is >> m;
+  if (!is) throw EX_BAD_PROBLEM("constraints");
+  for (size_t i = 0; i < m; ++i) {
+    string kindTag;
+    is >> kindTag;
+    if (kindTag == GetKindTag(tmNLCO::LINEAR_EQUALITY)) 
+      aNLCO->AddLinearEquality(GetFn(is));
+    else if (kindTag == GetKindTag(tmNLCO::NONLINEAR_EQUALITY)) 
+      aNLCO->AddNonlinearEquality(GetFn(is));
+    else if (kindTag == GetKindTag(tmNLCO::LINEAR_INEQUALITY)) 
+      aNLCO->AddLinearInequality(GetFn(is));
+    else if (kindTag == GetKindTag(tmNLCO::NONLINEAR_INEQUALITY)) 
+      aNLCO->AddNonlinearInequality(GetFn(is));
+    else 
+      throw EX_BAD_PROBLEM(kindTag);
+  }
+  GetTag(is, "end");
+}
+
+
+/*****
+STATIC
+Create a default-constructed function of the class named by tag, ready for
+GetParams(). Return NULL if tag isn't the name of a capturable class. Client
+owns the object.
+*****/
+tmDifferentiableFn* tmNLCOProblem::MakeFn(const string& tag)
+{
+  if (tag == "OneVarFn") return new OneVarFn();
+  if (tag == "TwoVarFn") return new TwoVarFn();
+  if (tag == "PathFn1") return new PathFn1();
+  if (tag == "PathFn2") return new PathFn2();
+  if (tag == "PathAngleFn1") return new PathAngleFn1();
+  if (tag == "PathAngleFn2") return new PathAngleFn2();
+  if (tag == "StrainPathFn1") return new StrainPathFn1();
+  if (tag == "StrainPathFn2") return new StrainPathFn2();
+  if (tag == "StrainPathFn3") return new StrainPathFn3();
+  if (tag == "StickToEdgeFn") return new StickToEdgeFn();
+  if (tag == "StickToLineFn") return new StickToLineFn();
+  if (tag == "PairFn1A") return new PairFn1A();
+  if (tag == "PairFn1B") return new PairFn1B();
+  if (tag == "PairFn2A") return new PairFn2A();
+  if (tag == "PairFn2B") return new PairFn2B();
+  if (tag == "CollinearFn1") return new CollinearFn1();
+  if (tag == "CollinearFn2") return new CollinearFn2();
+  if (tag == "CollinearFn3") return new CollinearFn3();
+  if (tag == "BoundaryFn") return new BoundaryFn();
+  if (tag == "QuantizeAngleFn1") return new QuantizeAngleFn1();
+  if (tag == "QuantizeAngleFn2") return new QuantizeAngleFn2();
+  if (tag == "LocalizeFn") return new LocalizeFn();
+  if (tag == "MultiStrainPathFn1") return new MultiStrainPathFn1();
+  if (tag == "MultiStrainPathFn2") return new MultiStrainPathFn2();
+  if (tag == "MultiStrainPathFn3") return new MultiStrainPathFn3();
+  if (tag == "CornerFn") return new CornerFn();
+  if (tag == "QuadraticFn") return new QuadraticFn();
+  return 0;
+}
+
+
+/*****
+STATIC
+Return a new function that computes the same values as f, made by writing its
+parameters and reading them back into a function of the class named by its
+tag, so the copy shares nothing with f. Return NULL if f can't be captured.
+Client owns the object.
+*****/
+tmDifferentiableFn* tmNLCOProblem::CopyFn(const tmDifferentiableFn* f)
+{
+  const char* tag = f->GetTag();
+  if (!tag) return 0;
+  tmDifferentiableFn* copy = MakeFn(tag);
+  if (!copy) return 0;
+  stringstream ss;
+  ss.precision(17);
+  f->PutParams(ss);
+  copy->GetParams(ss);
+  if (!ss) {
+    delete copy;
+    return 0;
+  }
+  return copy;
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+STATIC
+Return the tag that identifies a kind of constraint in the stream.
+*****/
+const char* tmNLCOProblem::GetKindTag(tmNLCO::ConstraintKind kind)
+{
+  switch (kind) {
+    case tmNLCO::LINEAR_EQUALITY:
+      return "linear_eq";
+    case tmNLCO::NONLINEAR_EQUALITY:
+      return "nonlinear_eq";
+    case tmNLCO::LINEAR_INEQUALITY:
+      return "linear_ineq";
+    case tmNLCO::NONLINEAR_INEQUALITY:
+      return "nonlinear_ineq";
+  }
+  TMFAIL("tmNLCOProblem::GetKindTag(): bad kind");
+  return 0;
+}
+
+
+/*****
+STATIC
+Write a line holding a tag and the elements of a vector.
+*****/
+void tmNLCOProblem::PutVector(ostream& os, const char* tag, 
+  const vector<double>& v)
+{
+  os << tag;
+  for (size_t i = 0; i < v.size(); ++i) os << " " << v[i];
+  os << "\n";
+}
+
+
+/*****
+STATIC
+Read a line written by PutVector() with the given tag and n elements.
+*****/
+void tmNLCOProblem::GetVector(istream& is, const char* tag, size_t n, 
+  vector<double>& v)
+{
+  GetTag(is, tag);
+  v.resize(n);
+  for (size_t i = 0; i < n; ++i) is >> v[i];
+  if (!is) throw EX_BAD_PROBLEM(tag);
+}
+
+
+/*****
+STATIC
+Read the next token and throw EX_BAD_PROBLEM if it isn't tag.
+*****/
+void tmNLCOProblem::GetTag(istream& is, const char* tag)
+{
+  string token;
+  is >> token;
+  if (token != tag) throw EX_BAD_PROBLEM(token);
+}
+
+
+/*****
+STATIC
+Write the tag and parameters of a function, followed by a newline. Throws
+EX_BAD_PROBLEM if the function can't be captured.
+*****/
+void tmNLCOProblem::PutFn(ostream& os, tmDifferentiableFn* f)
+{
+  const char* tag = f->GetTag();
+  if (!tag) throw EX_BAD_PROBLEM("");
+  os << tag << " ";
+  f->PutParams(os);
+  os << "\n";
+}
+
+
+/*****
+STATIC
+Read a function written by PutFn(). Client owns the returned object.
+*****/
+tmDifferentiableFn* tmNLCOProblem::GetFn(istream& is)
+{
+  string tag;
+  is >> tag;
+  tmDifferentiableFn* f = MakeFn(tag);
+  if (!f) throw EX_BAD_PROBLEM(tag);
+  f->GetParams(is);
+  if (!is) {
+    delete f;
+    throw EX_BAD_PROBLEM(tag);
+  }
+  return f;
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+File:         tmNLCOProblem.h
+Project:      TreeMaker 5.x
+Purpose:      Header file for capturing and replaying optimization problems
+Author:       TreeMaker contributors
+Modified by:  
+Created:      2026-10-17
+Copyright:    2026 TreeMaker contributors. All Rights Reserved.
+*******************************************************************************/
+
+#ifndef _TMNLCOPROBLEM_H_
+#define _TMNLCOPROBLEM_H_
+
+#include "tmNLCO.h"
+
+#include <iosfwd>
+#include <string>
+
+/**********
+class tmNLCOProblem
+Writes a fully set-up tmNLCO problem -- its size, bounds, starting point,
+objective, and every constraint with its kind, type, and parameters -- to a
+stream in a compact text form, and sets up another tmNLCO with the same
+problem from that text. This lets a problem taken from a real tree be solved
+again, by any of the compiled-in algorithms, without the tree or the GUI; see
+test/tmNLCOReplay.
+
+Every function in the problem must be capturable (a non-null
+tmDifferentiableFn::GetTag() naming a class that MakeFn() can create). Numbers
+are written with 17 significant digits, so a replayed problem is the same
+problem bit for bit. The state of the optimizer (warm starts, thread counts)
+isn't part of the problem. CopyFn() uses the same round trip to copy a single
+function (see tmDifferentiableFn::MakeCopy()).
+**********/
+class tmNLCOProblem {
+public:
+  // Exception thrown when a problem can't be written or read
+  class EX_BAD_PROBLEM {
+  public:
+    std::string mToken;  // the offending tag or token
+    EX_BAD_PROBLEM(const std::string& token) : mToken(token) {};
+  };
+  
+  static void Put(std::ostream& os, tmNLCO* aNLCO, 
+    const std::vector<double>& x);
+  static void Get(std::istream& is, tmNLCO* aNLCO, std::vector<double>& x);
+  static tmDifferentiableFn* MakeFn(const std::string& tag);
+  static tmDifferentiableFn* CopyFn(const tmDifferentiableFn* f);
+  
+private:
+  static const char* GetKindTag(tmNLCO::ConstraintKind kind);
+  static void PutVector(std::ostream& os, const char* tag, 
+    const std::vector<double>& v);
+  static void GetVector(std::istream& is, const char* tag, std::size_t n, 
+    std::vector<double>& v);
+  static void GetTag(std::istream& is, const char* tag);
+  static void PutFn(std::ostream& os, tmDifferentiableFn* f);
+  static tmDifferentiableFn* GetFn(std::istream& is);
+};
+
+#endif // _TMNLCOPROBLEM_H_
@@ -10,20 +10,54 @@ Copyright:    
 
 #include "tmOptimizer.h"
 #include "tmModel.h"
+#include "tmNLCOProblem.h"
+#include "tmNLCOPresolve.h"
+
+#include <typeinfo>
+#include <cmath>
 
 using namespace std;
 
+/**********
+class tmOptimizer::WarmStart
+Optimizer state saved from the end of one optimization for use in another.
+**********/
+
+/*****
+Discard the state, so that an optimizer given it starts cold.
+*****/
+void tmOptimizer::WarmStart::Clear()
+{
+  mType.clear();
+  mMultipliers.clear();
+  mLowerMultipliers.clear();
+  mUpperMultipliers.clear();
+  mVarKeys.clear();
+  mState.Clear();
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
 /**********
 class tmOptimizer
 Base class for TreeMaker optimizers. Provides two virtual methods that all
 subclasses must support, used for transferring data between optimizer and tree.
 **********/
 
+bool tmOptimizer::sPresolve = true;
+bool tmOptimizer::sSymmetry = true;
+
+
 /*****
 Constructor
 *****/
 tmOptimizer::tmOptimizer(tmTree* aTree, tmNLCO* aNLCO)
-  : tmTreeCleaner(aTree), mInitialized(false), mNLCO(aNLCO)
+  : tmTreeCleaner(aTree), mInitialized(false), mNLCO(aNLCO), 
+    mMinimizingNLCO(aNLCO)
 {
   aTree->PutSelf(mInitialState);
 }
@@ -38,22 +72,443 @@ void tmOptimizer::Revert()
 }
 
 
+/*****
+STATIC
+Turn on or off the elimination of fixed and tied variables in Optimize().
+*****/
+void tmOptimizer::SetPresolve(bool presolve)
+{
+  sPresolve = presolve;
+}
+
+
+/*****
+STATIC
+Turn on or off the elimination of mirror-image nodes and paths in Optimize().
+*****/
+void tmOptimizer::SetSymmetry(bool symmetry)
+{
+  sSymmetry = symmetry;
+}
+
+
 /*****
 Optimize the tree.
 *****/
 void tmOptimizer::Optimize()
 {
-  TMASSERT(mInitialized);
-  
-  // Minimize the merit function subject to the constraints. Exceptions can be
-  // generated either by user cancellation.
-  std::vector<double> scratchState = mCurrentStateVec;
-  int inform = mNLCO->Minimize(scratchState);
-  mCurrentStateVec = scratchState;
+  tmNLCO::Result result = Minimize(false, 0, 0);
   
   // Set status
-  if (inform != 0) throw tmNLCO::EX_BAD_CONVERGENCE(inform);
+  if (result.mStatus != tmNLCO::CONVERGED) 
+    throw tmNLCO::EX_BAD_CONVERGENCE(result.mReason);
   
   // Copy the data into the tree from the state vector
   DataToTree();
 }
+
+
+/*****
+Optimize the tree, stopping at the first check between iterations after the
+wall-clock time given by tmGetWallTime() passes deadline (if deadline > 0) or
+after token (if any) is cancelled. The best point found goes into the tree if
+it's feasible; otherwise the tree is unchanged. Failure to converge is reported
+in the result rather than thrown.
+*****/
+tmNLCO::Result tmOptimizer::OptimizeWithin(double deadline, 
+  const tmNLCOCancelToken* token)
+{
+  tmNLCO::Result result = Minimize(true, deadline, token);
+  if (result.mFeasible) DataToTree();
+  return result;
+}
+
+
+/*****
+Minimize the merit function subject to the constraints, leaving the answer in
+mCurrentStateVec and, if it converged, saving the warm-start state. If budgeted
+is true, use tmNLCO::MinimizeWithin() with the given deadline and token;
+otherwise use tmNLCO::Minimize(), and the result only says whether it
+converged.
+*****/
+tmNLCO::Result tmOptimizer::Minimize(bool budgeted, double deadline, 
+  const tmNLCOCancelToken* token)
+{
+  TMASSERT(mInitialized);
+  
+  // If linear equalities fix or tie any variables, or the tree is symmetric
+  // and we're using symmetry, substitute them out and solve the smaller
+  // problem, whose variables and constraints are keyed by the ones of the
+  // full problem that they came from.
+  tmNLCOPresolve presolve(mNLCO);
+  if (sSymmetry) AddSymmetry(presolve);
+  else KeepSymmetry(presolve);
+  tmNLCO* theNLCO = mNLCO;
+  vector<Key> varKeys, constraintKeys;
+  if (sPresolve && presolve.Reduce()) {
+    theNLCO = presolve.GetReducedNLCO();
+    const vector<size_t>& varMap = presolve.GetVarMap();
+    const vector<size_t>& constraintMap = presolve.GetConstraintMap();
+    if (mVarKeys.size() == mNLCO->GetNumVariables() &&
+      mConstraintKeys.size() == mNLCO->GetConstraints().size()) {
+      for (size_t i = 0; i < varMap.size(); ++i) 
+        varKeys.push_back(mVarKeys[varMap[i]]);
+      for (size_t i = 0; i < constraintMap.size(); ++i) 
+        constraintKeys.push_back(mConstraintKeys[constraintMap[i]]);
+    }
+  }
+  else {
+    varKeys = mVarKeys;
+    constraintKeys = mConstraintKeys;
+  }
+  
+  // Minimize the merit function subject to the constraints. Exceptions can be
+  // generated either by user cancellation. Our objective reports progress
+  // through the NLCO that's doing the minimizing, so that it can stop us when
+  // we're budgeted.
+  ApplyWarmStart(theNLCO, varKeys, constraintKeys);
+  std::vector<double> scratchState, startState;
+  if (theNLCO == mNLCO) scratchState = mCurrentStateVec;
+  else {
+    startState = mCurrentStateVec;
+    presolve.Restrict(mCurrentStateVec, scratchState);
+  }
+  tmNLCO::Result result;
+  mMinimizingNLCO = theNLCO;
+  try {
+    if (budgeted) 
+      result = theNLCO->MinimizeWithin(scratchState, deadline, token);
+    else {
+      result.mReason = theNLCO->Minimize(scratchState);
+      result.mStatus = (result.mReason == 0) ? 
+        tmNLCO::CONVERGED : tmNLCO::NOT_CONVERGED;
+    }
+  }
+  catch(...) {
+    mMinimizingNLCO = mNLCO;
+    throw;
+  }
+  mMinimizingNLCO = mNLCO;
+  if (theNLCO == mNLCO) mCurrentStateVec = scratchState;
+  else {
+    // A variable written in terms of others (e.g., a mirror-image node) can
+    // come back off by a bit even if nothing moved; keep the starting value
+    // then, so that DataToTree() doesn't mark the node as moved.
+    presolve.Expand(scratchState, mCurrentStateVec);
+    for (size_t i = 0; i < mCurrentStateVec.size(); ++i)
+      if (fabs(mCurrentStateVec[i] - startState[i]) <= 
+        1.0e-14 * max(1., fabs(startState[i]))) 
+        mCurrentStateVec[i] = startState[i];
+  }
+  
+  if (result.mStatus == tmNLCO::CONVERGED) 
+    SaveWarmStart(theNLCO, varKeys, constraintKeys);
+  return result;
+}
+
+
+/*****
+If the tree has a line of symmetry, set up the presolve to write the
+coordinates of the second node of each pair of nodes paired across the line as
+the reflection of those of the first, and to drop each path constraint for
+which the mirror-image path has a constraint earlier in the list. Nodes pinned
+to the line are their own mirror images; the presolve ties their coordinates
+through the constraints that pin them.
+*****/
+void tmOptimizer::AddSymmetry(tmNLCOPresolve& presolve)
+{
+  tmTree* theTree = GetTree();
+  if (!theTree->HasSymmetry()) return;
+  size_t nv = mNLCO->GetNumVariables();
+  size_t nc = mNLCO->GetConstraints().size();
+  if (mVarKeys.size() != nv || mConstraintKeys.size() != nc) return;
+  
+  // Find the x variable of each node that has variables; y follows it.
+  map<size_t, size_t> nodeVar;
+  for (size_t i = 0; i + 1 < nv; ++i)
+    if (mVarKeys[i][0] == KEY_NODE_X && mVarKeys[i + 1][0] == KEY_NODE_Y)
+      nodeVar[mVarKeys[i][1]] = i;
+  
+  // Reflection across the line of symmetry
+  double a = 2 * theTree->GetSymAngle() * DEGREES;
+  double c2 = cos(a);
+  double s2 = sin(a);
+  const tmPoint& p = theTree->GetSymLoc();
+  vector<double> xcoefs(2), ycoefs(2);
+  xcoefs[0] = c2;
+  xcoefs[1] = s2;
+  ycoefs[0] = s2;
+  ycoefs[1] = -c2;
+  double xconst = p.x - c2 * p.x - s2 * p.y;
+  double yconst = p.y - s2 * p.x + c2 * p.y;
+  
+  // Pair up mirror-image nodes, ignoring any node that's been paired already.
+  map<size_t, size_t> mirror;
+  tmArrayIterator<tmCondition*> iConditions(theTree->GetConditions());
+  tmCondition* aCondition;
+  while (iConditions.Next(&aCondition)) {
+    tmConditionNodeSymmetric* cs = 
+      dynamic_cast<tmConditionNodeSymmetric*>(aCondition);
+    if (cs) {
+      size_t n = cs->GetNode()->GetIndex();
+      if (!mirror.count(n)) mirror[n] = n;
+      continue;
+    }
+    tmConditionNodesPaired* cp = 
+      dynamic_cast<tmConditionNodesPaired*>(aCondition);
+    if (!cp) continue;
+    size_t n1 = cp->GetNode1()->GetIndex();
+    size_t n2 = cp->GetNode2()->GetIndex();
+    if (n1 == n2 || mirror.count(n1) || mirror.count(n2)) continue;
+    mirror[n1] = n2;
+    mirror[n2] = n1;
+    map<size_t, size_t>::iterator i1 = nodeVar.find(n1);
+    map<size_t, size_t>::iterator i2 = nodeVar.find(n2);
+    if (i1 == nodeVar.end() || i2 == nodeVar.end()) continue;
+    vector<size_t> vars(2);
+    vars[0] = i1->second;
+    vars[1] = i1->second + 1;
+    
+    // The reflection of the bounds of the first node must lie within those
+    // of the second, or the problems wouldn't be equivalent. That's the case
+    // for a line of symmetry along an axis or a diagonal of the paper.
+    if (!IsWithinBounds(vars, xcoefs, xconst, i2->second) ||
+      !IsWithinBounds(vars, ycoefs, yconst, i2->second + 1)) continue;
+    presolve.Substitute(i2->second, vars, xcoefs, xconst);
+    presolve.Substitute(i2->second + 1, vars, ycoefs, yconst);
+  }
+  
+  // Drop the later of each pair of mirror-image path constraints.
+  map<Key, size_t> constraintIndex;
+  for (size_t k = 0; k < nc; ++k) constraintIndex[mConstraintKeys[k]] = k;
+  for (size_t k = 0; k < nc; ++k) {
+    const Key& key = mConstraintKeys[k];
+    if (key[0] != KEY_PATH) continue;
+    map<size_t, size_t>::iterator m1 = mirror.find(key[1]);
+    map<size_t, size_t>::iterator m2 = mirror.find(key[2]);
+    if (m1 == mirror.end() || m2 == mirror.end()) continue;
+    Key mkey = key;
+    mkey[1] = m1->second;
+    mkey[2] = m2->second;
+    map<Key, size_t>::iterator mi = constraintIndex.find(mkey);
+    if (mi == constraintIndex.end()) {
+      swap(mkey[1], mkey[2]);
+      mi = constraintIndex.find(mkey);
+    }
+    if (mi != constraintIndex.end() && mi->second < k)
+      presolve.DropIfSame(k, mi->second);
+  }
+}
+
+
+/*****
+With symmetry turned off, keep the presolve from folding the tree through the
+linear equalities of the symmetry conditions (nodes pinned to the line of
+symmetry or paired across it); they stay in the problem as constraints.
+*****/
+void tmOptimizer::KeepSymmetry(tmNLCOPresolve& presolve)
+{
+  const vector<tmDifferentiableFn*>& flist = mNLCO->GetConstraints();
+  for (size_t k = 0; k < flist.size(); ++k) {
+    tmDifferentiableFn* f = flist[k];
+    if (dynamic_cast<StickToLineFn*>(f) || dynamic_cast<PairFn1A*>(f) ||
+      dynamic_cast<PairFn1B*>(f) || dynamic_cast<PairFn2A*>(f) ||
+      dynamic_cast<PairFn2B*>(f)) presolve.Keep(k);
+  }
+}
+
+
+/*****
+Return true if sum(coefs[j] * x[vars[j]]) + constant is within the bounds of
+variable i for all values of the vars within their bounds.
+*****/
+bool tmOptimizer::IsWithinBounds(const vector<size_t>& vars, 
+  const vector<double>& coefs, double constant, size_t i) const
+{
+  const vector<double>& bl = mNLCO->GetLowerBounds();
+  const vector<double>& bu = mNLCO->GetUpperBounds();
+  double lo = constant;
+  double hi = constant;
+  for (size_t j = 0; j < vars.size(); ++j) {
+    double c = coefs[j];
+    lo += c * (c > 0 ? bl[vars[j]] : bu[vars[j]]);
+    hi += c * (c > 0 ? bu[vars[j]] : bl[vars[j]]);
+  }
+  const double tol = 1.0e-10 * max(1., bu[i] - bl[i]);
+  return lo >= bl[i] - tol && hi <= bu[i] + tol;
+}
+
+
+/*****
+Write the optimization problem, starting from the current state, to the stream
+so that it can be replayed without the tree (see tmNLCOProblem). Must be
+called after Initialize() and before Optimize().
+*****/
+void tmOptimizer::PutProblem(std::ostream& os)
+{
+  TMASSERT(mInitialized);
+  tmNLCOProblem::Put(os, mNLCO, mCurrentStateVec);
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/*****
+Use the given state, typically from GetWarmStart() of an earlier optimizer of
+the same kind, to start the next call to Optimize().
+*****/
+void tmOptimizer::SetWarmStart(const WarmStart& ws)
+{
+  mWarmStartIn = ws;
+}
+
+
+/*****
+STATIC
+Return a key made up of a kind and up to two part indices.
+*****/
+tmOptimizer::Key tmOptimizer::MakeKey(size_t kind, size_t i1, size_t i2)
+{
+  Key key(3);
+  key[0] = kind;
+  key[1] = i1;
+  key[2] = i2;
+  return key;
+}
+
+
+/*****
+Append keys for the x and y coordinates of each of the nodes to mVarKeys.
+*****/
+void tmOptimizer::KeyNodeVars(const tmArray<tmNode*>& nodes)
+{
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    mVarKeys.push_back(MakeKey(KEY_NODE_X, nodes[i]->GetIndex()));
+    mVarKeys.push_back(MakeKey(KEY_NODE_Y, nodes[i]->GetIndex()));
+  }
+}
+
+
+/*****
+Give keys to all constraints added to the NLCO since the last call. Each gets
+the given kind and part indices plus its count among the new constraints, so
+that a part that adds several constraints gives each its own key.
+*****/
+void tmOptimizer::KeyNewConstraints(size_t kind, size_t i1, size_t i2)
+{
+  size_t n = mNLCO->GetConstraints().size();
+  for (size_t k = 0; mConstraintKeys.size() < n; ++k) {
+    Key key = MakeKey(kind, i1, i2);
+    key.push_back(k);
+    mConstraintKeys.push_back(key);
+  }
+}
+
+
+/*****
+Translate the warm start state (if any) to the variables and constraints of
+the problem set up in aNLCO, whose keys are given, and pass it to aNLCO. This
+is either our own problem or the reduced problem from presolve. Multipliers
+of constraints that aren't in the state are zero; rows and columns of the
+inverse Hessian for variables that aren't in the state are those of the
+identity. If the state came from a different kind of optimizer, or matches
+fewer than half of the constraints, we don't use it.
+*****/
+void tmOptimizer::ApplyWarmStart(tmNLCO* aNLCO, const vector<Key>& varKeys,
+  const vector<Key>& constraintKeys)
+{
+  const WarmStart& ws = mWarmStartIn;
+  if (ws.IsEmpty() || ws.mType != typeid(*this).name()) return;
+  size_t nc = aNLCO->GetConstraints().size();
+  size_t nv = aNLCO->GetNumVariables();
+  if (constraintKeys.size() != nc || varKeys.size() != nv) return;
+  
+  // Multipliers of constraints
+  tmNLCOWarmStart state;
+  state.mMultipliers.assign(nc, 0.);
+  size_t nmatched = 0;
+  for (size_t k = 0; k < nc; ++k) {
+    map<Key, double>::const_iterator p =
+      ws.mMultipliers.find(constraintKeys[k]);
+    if (p == ws.mMultipliers.end()) continue;
+    state.mMultipliers[k] = p->second;
+    ++nmatched;
+  }
+  if (2 * nmatched < nc) return;
+  
+  // Multipliers of bounds, and the map from our variables to those of the
+  // stored inverse Hessian.
+  state.mLowerMultipliers.assign(nv, 0.);
+  state.mUpperMultipliers.assign(nv, 0.);
+  map<Key, size_t> oldVars;
+  for (size_t i = 0; i < ws.mVarKeys.size(); ++i) oldVars[ws.mVarKeys[i]] = i;
+  const size_t NO_VAR = size_t(-1);
+  vector<size_t> oldIndex(nv, NO_VAR);
+  for (size_t i = 0; i < nv; ++i) {
+    const Key& key = varKeys[i];
+    map<Key, double>::const_iterator p = ws.mLowerMultipliers.find(key);
+    if (p != ws.mLowerMultipliers.end()) state.mLowerMultipliers[i] = p->second;
+    p = ws.mUpperMultipliers.find(key);
+    if (p != ws.mUpperMultipliers.end()) state.mUpperMultipliers[i] = p->second;
+    map<Key, size_t>::const_iterator q = oldVars.find(key);
+    if (q != oldVars.end()) oldIndex[i] = q->second;
+  }
+  state.mWeight = ws.mState.mWeight;
+  
+  // Inverse Hessian, dense or as L-BFGS pairs
+  const tmMatrix<double>& oldHess = ws.mState.mHessInv;
+  if (oldHess.size() == ws.mVarKeys.size() && !oldHess.empty()) {
+    state.mHessInv.resize(nv, nv);
+    for (size_t i = 0; i < nv; ++i) {
+      size_t oi = oldIndex[i];
+      for (size_t j = 0; j < nv; ++j) {
+        size_t oj = oldIndex[j];
+        if (oi != NO_VAR && oj != NO_VAR)
+          state.mHessInv[i][j] = oldHess[oi][oj];
+        else
+          state.mHessInv[i][j] = (i == j) ? 1.0 : 0.0;
+      }
+    }
+  }
+  size_t np = ws.mState.mSteps.size();
+  state.mSteps.assign(np, vector<double>(nv, 0.));
+  state.mGradSteps.assign(np, vector<double>(nv, 0.));
+  for (size_t j = 0; j < np; ++j)
+    for (size_t i = 0; i < nv; ++i) {
+      if (oldIndex[i] == NO_VAR) continue;
+      state.mSteps[j][i] = ws.mState.mSteps[j][oldIndex[i]];
+      state.mGradSteps[j][i] = ws.mState.mGradSteps[j][oldIndex[i]];
+    }
+  aNLCO->SetWarmStart(state);
+}
+
+
+/*****
+Record the final state of aNLCO, whose variables and constraints have the
+given keys, for GetWarmStart(). If the NLCO doesn't support warm starts, the
+saved state is empty.
+*****/
+void tmOptimizer::SaveWarmStart(tmNLCO* aNLCO, const vector<Key>& varKeys,
+  const vector<Key>& constraintKeys)
+{
+  WarmStart& ws = mWarmStartOut;
+  ws.Clear();
+  size_t nc = aNLCO->GetConstraints().size();
+  size_t nv = aNLCO->GetNumVariables();
+  if (constraintKeys.size() != nc || varKeys.size() != nv) return;
+  if (!aNLCO->GetWarmStart(ws.mState)) return;
+  ws.mType = typeid(*this).name();
+  for (size_t k = 0; k < nc; ++k) 
+    ws.mMultipliers[constraintKeys[k]] = ws.mState.mMultipliers[k];
+  for (size_t i = 0; i < ws.mState.mLowerMultipliers.size(); ++i)
+    ws.mLowerMultipliers[varKeys[i]] = ws.mState.mLowerMultipliers[i];
+  for (size_t i = 0; i < ws.mState.mUpperMultipliers.size(); ++i)
+    ws.mUpperMultipliers[varKeys[i]] = ws.mState.mUpperMultipliers[i];
+  ws.mVarKeys = varKeys;
+  ws.mState.mMultipliers.clear();
+  ws.mState.mLowerMultipliers.clear();
+  ws.mState.mUpperMultipliers.clear();
+}
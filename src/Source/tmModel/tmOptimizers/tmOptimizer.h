@@ -13,13 +13,17 @@ Copyright:    
 
 // Standard libraries
 #include <vector>
+#include <map>
+#include <string>
 #include <sstream>
 
 // TreeMaker model
 #include "tmTreeCleaner.h"
+#include "tmArray.h"
+#include "tmNLCO.h"
 
 // Forward declarations
-class tmNLCO;
+class tmNLCOPresolve;
 
 /**********
 class tmOptimizer
@@ -29,22 +33,125 @@ This class inherits from class tmTreeCleaner, which will delay cleanup until
 the optimizer goes completely out of scope or is destroyed, which means that
 even if we've run the optimizer, we can Revert() and not lose any crease
 patterns, etc.
+
+An optimizer can be warm-started from the state at the end of an earlier
+optimization of the same kind, which makes re-optimizing after a small edit
+much faster. The state (class WarmStart) identifies variables and constraints
+by the tree parts they came from rather than by position, so it carries over
+to a tree that has been edited in the meantime; parts that are new get a cold
+start. If too little of the state matches, it is ignored altogether.
+
+Before minimizing, Optimize() eliminates the variables that linear equalities
+(from conditions such as fixed nodes or edges of equal strain) fix or tie
+together, and minimizes the smaller problem that remains (see tmNLCOPresolve);
+SetPresolve(false) turns this off for all optimizers. If the tree has a line of
+symmetry, the presolve also writes the second node of each pair of nodes that
+are paired across it as the mirror image of the first, which removes the
+pairing equalities, and leaves out each path constraint whose mirror image is
+also in the problem, since it's the same constraint once the mirrored node
+coordinates are written that way. SetSymmetry(false) turns off just this part;
+the symmetry conditions' own equalities then stay in the problem rather than
+being eliminated.
+
+OptimizeWithin() is Optimize() under a deadline and a cancellation token (see
+tmNLCO::MinimizeWithin()). Rather than throwing when it doesn't converge, it
+returns the status, and it copies the best point found into the tree if that
+point is feasible, so a run that's cut short still leaves a valid tree.
 **********/
 
 class tmOptimizer : public tmTreeCleaner {
 public:
+  // Identifies a variable or constraint by the tree parts it came from.
+  typedef std::vector<std::size_t> Key;
+  
+  /**********
+  class WarmStart
+  Optimizer state saved from the end of one optimization for use in another.
+  **********/
+  class WarmStart {
+  public:
+    bool IsEmpty() const {
+      // Return true if there's no state to use.
+      return mType.empty();};
+    void Clear();
+  private:
+    std::string mType;                        // class of the optimizer
+    std::map<Key, double> mMultipliers;       // multiplier by constraint
+    std::map<Key, double> mLowerMultipliers;  // lower bound by variable
+    std::map<Key, double> mUpperMultipliers;  // upper bound by variable
+    std::vector<Key> mVarKeys;                // variables of mState
+    tmNLCOWarmStart mState;                   // weight and inverse Hessian
+    friend class tmOptimizer;
+  };
+  
   tmOptimizer(tmTree* aTree, tmNLCO* aNLCO);
   virtual ~tmOptimizer() {};
   tmNLCO* GetNLCO() { return mNLCO; };
   void Revert();
   virtual void Optimize();
+  tmNLCO::Result OptimizeWithin(double deadline, 
+    const tmNLCOCancelToken* token = 0);
   virtual void DataToTree() = 0;
   virtual void TreeToData() = 0;
+  void PutProblem(std::ostream& os);
+  void ObjectiveUpdateUI() {
+    // Update from the objective through whichever NLCO is minimizing.
+    mMinimizingNLCO->ObjectiveUpdateUI();};
+  
+  static bool GetPresolve() {
+    // Return true if Optimize() eliminates fixed and tied variables.
+    return sPresolve;};
+  static void SetPresolve(bool presolve);
+  static bool GetSymmetry() {
+    // Return true if Optimize() solves for one half of a symmetric tree.
+    return sSymmetry;};
+  static void SetSymmetry(bool symmetry);
+  
+  void SetWarmStart(const WarmStart& ws);
+  const WarmStart& GetWarmStart() const {
+    // Return the state at the end of the last successful Optimize().
+    return mWarmStartOut;};
 protected:
+  // Kinds of keys for variables and constraints
+  enum {
+    KEY_SCALE,
+    KEY_STRAIN,
+    KEY_NODE_X,
+    KEY_NODE_Y,
+    KEY_EDGE,
+    KEY_PATH,
+    KEY_CONDITION
+  };
+  
   bool mInitialized;                    // true if we've been fully initialized
   tmNLCO* mNLCO;                        // object that performs NLCO
   std::vector<double> mCurrentStateVec;    // current state vector
   std::stringstream mInitialState;      // initial tree state (used for reversion)
+  std::vector<Key> mVarKeys;            // key of each variable
+  std::vector<Key> mConstraintKeys;     // key of each constraint
+  
+  static Key MakeKey(std::size_t kind, std::size_t i1 = 0, 
+    std::size_t i2 = 0);
+  void KeyNodeVars(const tmArray<tmNode*>& nodes);
+  void KeyNewConstraints(std::size_t kind, std::size_t i1 = 0, 
+    std::size_t i2 = 0);
+private:
+  static bool sPresolve;                // eliminate fixed and tied variables
+  static bool sSymmetry;                // eliminate mirror-image nodes
+  WarmStart mWarmStartIn;               // state to start from, if any
+  WarmStart mWarmStartOut;              // state at the end of Optimize()
+  tmNLCO* mMinimizingNLCO;              // mNLCO or the presolved NLCO
+  
+  tmNLCO::Result Minimize(bool budgeted, double deadline, 
+    const tmNLCOCancelToken* token);
+  void AddSymmetry(tmNLCOPresolve& presolve);
+  void KeepSymmetry(tmNLCOPresolve& presolve);
+  bool IsWithinBounds(const std::vector<std::size_t>& vars, 
+    const std::vector<double>& coefs, double constant, std::size_t i) const;
+  void ApplyWarmStart(tmNLCO* aNLCO, const std::vector<Key>& varKeys,
+    const std::vector<Key>& constraintKeys);
+  void SaveWarmStart(tmNLCO* aNLCO, const std::vector<Key>& varKeys,
+    const std::vector<Key>& constraintKeys);
 };
 
 
@@ -10,6 +10,7 @@ Copyright:    
 
 #include "tmScaleOptimizer.h"
 #include "tmModel.h"
+#include "tmWorkerPool.h"
 
 using namespace std;
 
@@ -34,8 +35,11 @@ void tmScaleOptimizer::Initialize()
 {
   tmTree* theTree = GetTree(); // to have on hand
   
-  // Make a list of all leaf nodes.
-  theTree->GetLeafNodes(mLeafNodes);
+  // Make a list of all leaf nodes. The tree caches these along with the leaf
+  // paths that need constraints, so back-to-back optimizations of the same
+  // structure don't rebuild them.
+  const tmTree::LeafPathCache& cache = theTree->GetLeafPathCache();
+  mLeafNodes = cache.mLeafNodes;
   
   // Set up our state vector
   size_t n = mLeafNodes.size();
@@ -43,6 +47,8 @@ void tmScaleOptimizer::Initialize()
   mNLCO->SetSize(mNumVars);
   mCurrentStateVec.resize(mNumVars);
   TreeToData();
+  mVarKeys.push_back(MakeKey(KEY_SCALE));
+  KeyNodeVars(mLeafNodes);
   
   // Set the bounds in the optimizer: one bound for each variable (incl. scale
   // & coords)
@@ -66,30 +72,30 @@ void tmScaleOptimizer::Initialize()
   // Add a constraint on the scale to keep it larger than 10% of its present
   // value.
   mNLCO->AddLinearInequality(new OneVarFn(0, -1.0, 0.1 * theTree->GetScale()));
+  KeyNewConstraints(KEY_SCALE);
 
-  // Add a constraint for each leaf path.
-  tmArrayIterator<tmPath*> iOwnedPaths(theTree->GetOwnedPaths());
-  tmPath* aPath;
-  while (iOwnedPaths.Next(&aPath)) {
-    if (aPath->IsLeafPath()) {
+  // Add a constraint for each leaf path. Leaf paths with a path condition
+  // joining their nodes don't need the standard path constraint, so they
+  // aren't in the cache. Only the path lengths are read fresh.
+  for (size_t i = 0; i < cache.mPaths.size(); ++i) {
+    tmPath* aPath = cache.mPaths[i];
     
-      // If there's a path condition joining these nodes, then the
-      // standard path condition is unnecessary. So we won't apply it.
-      if (theTree->IsConditioned<tmConditionPathActive>(aPath)) 
-        continue;
-      
-      // Get indices of the nodes at the end of the paths and add an inequality
-      size_t ix = GetBaseOffset(aPath->GetNodes().front());
-      size_t jx = GetBaseOffset(aPath->GetNodes().back());
-      mNLCO->AddNonlinearInequality(new PathFn1(ix, ix + 1, jx, jx + 1, 
-        aPath->GetMinTreeLength()));
-    }
+    // Get indices of the nodes at the end of the paths and add an inequality
+    size_t ix = 1 + 2 * cache.mNodes1[i];
+    size_t jx = 1 + 2 * cache.mNodes2[i];
+    mNLCO->AddNonlinearInequality(new PathFn1(ix, ix + 1, jx, jx + 1, 
+      aPath->GetMinTreeLength()));
+    KeyNewConstraints(KEY_PATH, aPath->GetFrontNode()->GetIndex(), 
+      aPath->GetBackNode()->GetIndex());
   }
   
   // Go through all Conditions and add constraints for each.
   tmArrayIterator<tmCondition*> iConditions(theTree->GetConditions());
   tmCondition* aCondition;
-  while (iConditions.Next(&aCondition)) aCondition->AddConstraints(this);
+  while (iConditions.Next(&aCondition)) {
+    aCondition->AddConstraints(this);
+    KeyNewConstraints(KEY_CONDITION, aCondition->GetIndex());
+  }
   
   // Ready to go. User might want to compare number of equalities against
   // number of variables.
@@ -104,7 +110,7 @@ tmArray<tmNode*>::BAD_OFFSET if it's not present.
 *****/
 size_t tmScaleOptimizer::GetBaseOffset(tmNode* aNode)
 {
-  size_t i = mLeafNodes.GetOffset(aNode);
+  size_t i = GetTree()->GetLeafPathCache().GetLeafNodePos(aNode);
   if (i == tmArray<tmNode*>::BAD_OFFSET) return tmArray<tmNode*>::BAD_OFFSET;
   else return 1 + 2 * i;
 }
@@ -176,7 +182,7 @@ double tmScaleOptimizerObjective::Func(const std::vector<double>& u)
 {
   IncFuncCalls();
   mScaleOptimizer->mCurrentStateVec = u;
-  mScaleOptimizer->GetNLCO()->ObjectiveUpdateUI();
+  mScaleOptimizer->ObjectiveUpdateUI();
   return -u[0];
 }
 
@@ -191,3 +197,286 @@ void tmScaleOptimizerObjective::Grad(const std::vector<double>&,
   du.assign(du.size(), 0.);
   du[0] = -1;
 }
+
+
+/*****
+Return the value of the function and its gradient together
+*****/
+double tmScaleOptimizerObjective::FuncGrad(const std::vector<double>& u, 
+  std::vector<double>& du)
+{
+  double f = Func(u);
+  IncGradCalls();
+  du.assign(du.size(), 0.);
+  du[0] = -1;
+  return f;
+}
+
+
+/*****
+Write the parameters of the equivalent QuadraticFn, -u[0], for a captured
+problem
+*****/
+void tmScaleOptimizerObjective::PutParams(std::ostream& os) const
+{
+  QuadraticFn q;
+  q.AddTerm(0, -1, 0);
+  q.PutParams(os);
+}
+
+
+/*****
+Return the equivalent QuadraticFn, which computes the same values without
+recording the state or updating the UI
+*****/
+tmDifferentiableFn* tmScaleOptimizerObjective::MakeCopy() const
+{
+  return tmNLCOProblem::CopyFn(this);
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark -
+#endif
+
+
+/**********
+class tmMultiStartScaleOptimizer::StartUpdater
+Receives progress updates from the optimizer of one start, which it uses to
+enforce the deadline and to pass progress on to the client.
+**********/
+class tmMultiStartScaleOptimizer::StartUpdater : public tmNLCOUpdater {
+public:
+  tmMultiStartScaleOptimizer* mOwner;   // the multi-start optimizer
+  std::size_t mStart;                   // which start we're updating
+  tmScaleOptimizer* mOptimizer;         // optimizer of the start, if running
+  
+  StartUpdater(tmMultiStartScaleOptimizer* owner, std::size_t start) :
+    mOwner(owner), mStart(start), mOptimizer(0) {};
+  void UpdateUI() {
+    // Abandon the start if we're past the deadline, else report progress.
+    if (mOwner->mDeadline > 0 && tmGetWallTime() > mOwner->mDeadlineTime)
+      throw EX_DEADLINE();
+    if (mOptimizer) mOwner->Report(mStart, mOptimizer->GetCurrentScale());};
+};
+
+
+/**********
+class tmMultiStartScaleOptimizer::StartTask
+Task that runs every n-th start on each of n threads.
+**********/
+class tmMultiStartScaleOptimizer::StartTask : public tmWorkerPool::Task {
+public:
+  tmMultiStartScaleOptimizer* mOwner;   // the multi-start optimizer
+  
+  StartTask(tmMultiStartScaleOptimizer* owner) : mOwner(owner) {};
+  void Run(std::size_t i, std::size_t n) {
+    // Run starts i, i + n, i + 2n, ...
+    for (std::size_t j = i; j < mOwner->mNumStarts; j += n) 
+      mOwner->RunStart(j);};
+};
+
+
+/**********
+class tmMultiStartScaleOptimizer
+Runs several scale optimizations of a tree at once, each from a different
+starting point, and keeps the best.
+**********/
+
+/*****
+Constructor. By default, we use one thread per processor, move leaf nodes by
+up to 5% of the paper width, and set no deadline.
+*****/
+tmMultiStartScaleOptimizer::tmMultiStartScaleOptimizer(tmTree* aTree, 
+  size_t numStarts)
+  : mTree(aTree), 
+  mNumStarts(numStarts), 
+  mNumThreads(tmWorkerPool::GetNumProcessors()), 
+  mSeed(1), 
+  mPerturbation(0.05 * aTree->GetPaperWidth()), 
+  mDeadline(0), 
+  mDeadlineTime(0), 
+  mProgress(0), 
+  mStatus(numStarts, PENDING), 
+  mScales(numStarts, aTree->GetScale()), 
+  mBestStart(NO_START)
+{
+  TMASSERT(numStarts > 0);
+}
+
+
+/*****
+Set the number of threads shared by the starts. Up to this many starts are
+run at once; if there are fewer starts than threads, the spare threads are
+divided among the optimizers of the starts that are running.
+*****/
+void tmMultiStartScaleOptimizer::SetNumThreads(size_t numThreads)
+{
+  TMASSERT(numThreads > 0);
+  mNumThreads = numThreads;
+}
+
+
+/*****
+Set the seed of the perturbation of start 1; start i uses seed + i - 1.
+*****/
+void tmMultiStartScaleOptimizer::SetSeed(unsigned long seed)
+{
+  mSeed = seed;
+}
+
+
+/*****
+Set the maximum distance (in each direction) that each leaf node is moved
+from its original position in the perturbed starts.
+*****/
+void tmMultiStartScaleOptimizer::SetPerturbation(const tmFloat& perturbation)
+{
+  mPerturbation = perturbation;
+}
+
+
+/*****
+Set the deadline, in seconds of wall-clock time after Optimize() is called.
+Starts that haven't finished by then are abandoned, which happens the next time
+their optimizer reports progress. 0 means no deadline.
+*****/
+void tmMultiStartScaleOptimizer::SetDeadline(const tmFloat& seconds)
+{
+  mDeadline = seconds;
+}
+
+
+/*****
+Set the object that receives progress reports, or 0 for none. We don't take
+ownership of it.
+*****/
+void tmMultiStartScaleOptimizer::SetProgress(Progress* progress)
+{
+  mProgress = progress;
+}
+
+
+/*****
+Run all of the starts, copy the best feasible result into the tree, and return
+the index of that start, or NO_START if no start succeeded (in which case the
+tree is unchanged).
+*****/
+size_t tmMultiStartScaleOptimizer::Optimize()
+{
+  mDeadlineTime = tmGetWallTime() + mDeadline;
+  mBestStart = NO_START;
+  
+  // Make the copies of the tree up front, since reading the original from
+  // several threads at once isn't safe.
+  mCopies.assign(mNumStarts, (tmTree*)(0));
+  for (size_t i = 0; i < mNumStarts; ++i) {
+    mCopies[i] = mTree->Clone();
+#ifdef TMDEBUG
+    // The copies are cleaned up on several threads at once, so they mustn't
+    // record their state in the shared debugging streams.
+    mCopies[i]->SetRecordDumpState(false);
+#endif // TMDEBUG
+    if (i > 0) {
+      tmArray<tmNode*> leafNodes;
+      mCopies[i]->GetLeafNodes(leafNodes);
+      mCopies[i]->PerturbNodes(leafNodes, mSeed + i - 1, mPerturbation);
+    }
+    mStatus[i] = PENDING;
+    mScales[i] = mCopies[i]->GetScale();
+  }
+  
+  // Run the starts.
+  tmWorkerPool pool(min_val(mNumThreads, mNumStarts));
+  StartTask task(this);
+  pool.Run(task);
+  
+  // Pick the successful start with the largest scale; ties go to the lowest
+  // start, so the answer doesn't depend on the order in which starts finished.
+  for (size_t i = 0; i < mNumStarts; ++i) {
+    if (mStatus[i] != SUCCEEDED) continue;
+    if (mBestStart == NO_START || mScales[i] > mScales[mBestStart]) 
+      mBestStart = i;
+  }
+  
+  // Copy the winner's scale and node positions into the tree. The copies have
+  // their nodes in the same order as the original.
+  if (mBestStart != NO_START) {
+    tmTree* bestTree = mCopies[mBestStart];
+    tmArray<const tmNode*> movingNodes;
+    tmArray<tmPoint> newLocs;
+    for (size_t i = 0; i < mTree->GetNodes().size(); ++i) {
+      movingNodes.push_back(mTree->GetNodes()[i]);
+      newLocs.push_back(bestTree->GetNodes()[i]->GetLoc());
+    }
+    tmTreeCleaner tc(mTree);
+    mTree->SetScale(bestTree->GetScale());
+    mTree->SetNodeLocs(movingNodes, newLocs);
+  }
+  
+  for (size_t i = 0; i < mNumStarts; ++i) delete mCopies[i];
+  mCopies.clear();
+  return mBestStart;
+}
+
+
+/*****
+Optimize the scale of the copy of the tree for one start. Called from a worker
+thread, so this mustn't throw, and it mustn't touch any other start's data.
+*****/
+void tmMultiStartScaleOptimizer::RunStart(size_t start)
+{
+  tmTree* theTree = mCopies[start];
+  if (mDeadline > 0 && tmGetWallTime() > mDeadlineTime) {
+    mStatus[start] = TIMED_OUT;
+    try {
+      Report(start, mScales[start]);
+    }
+    catch(...) {
+    }
+    return;
+  }
+  // Each start gets its share of the threads, so that the optimizers of the
+  // starts that run at once don't each start a thread per processor.
+  tmNLCO* theNLCO = tmNLCO::MakeNLCO();
+  theNLCO->SetMaxThreads(mNumThreads / min_val(mNumThreads, mNumStarts));
+  StartUpdater theUpdater(this, start);
+  theNLCO->SetUpdater(&theUpdater);
+  mStatus[start] = RUNNING;
+  try {
+    Report(start, mScales[start]);
+    {
+      // The optimizer cleans up the tree (and computes its feasibility) when
+      // it goes out of scope.
+      tmScaleOptimizer theOptimizer(theTree, theNLCO);
+      theUpdater.mOptimizer = &theOptimizer;
+      theOptimizer.Initialize();
+      theOptimizer.Optimize();
+      theUpdater.mOptimizer = 0;
+    }
+    mStatus[start] = theTree->IsFeasible() ? SUCCEEDED : FAILED;
+  }
+  catch(EX_DEADLINE) {
+    mStatus[start] = TIMED_OUT;
+  }
+  catch(...) {
+    mStatus[start] = FAILED;
+  }
+  delete theNLCO;
+  mScales[start] = theTree->GetScale();
+  try {
+    Report(start, mScales[start]);
+  }
+  catch(...) {
+  }
+}
+
+
+/*****
+Pass the status of a start and its current scale to the client, if there is
+one.
+*****/
+void tmMultiStartScaleOptimizer::Report(size_t start, const tmFloat& scale)
+{
+  if (mProgress) mProgress->Report(start, mStatus[start], scale);
+}
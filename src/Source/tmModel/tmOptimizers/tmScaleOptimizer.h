@@ -28,6 +28,9 @@ public:
   tmScaleOptimizer(tmTree* aTree, tmNLCO* aNLCO);
   void Initialize();
   std::size_t GetBaseOffset(tmNode* aNode);
+  const double& GetCurrentScale() const {
+    // Return the scale at the optimizer's current point.
+    return mCurrentStateVec[0];};
 
   void DataToTree();
   void TreeToData();
@@ -47,6 +50,10 @@ class tmScaleOptimizerObjective : public tmDifferentiableFn
 public:
   double Func(const std::vector<double>& u);
   void Grad(const std::vector<double>& u, std::vector<double>& du);
+  double FuncGrad(const std::vector<double>& u, std::vector<double>& du);
+  const char* GetTag() const {return "QuadraticFn";};
+  void PutParams(std::ostream& os) const;
+  tmDifferentiableFn* MakeCopy() const;
 private:
   tmScaleOptimizer* mScaleOptimizer;
   tmScaleOptimizerObjective(tmScaleOptimizer* aScaleOptimizer);
@@ -56,4 +63,94 @@ private:
 };
 
 
+/**********
+class tmMultiStartScaleOptimizer
+Runs several scale optimizations of a tree at once, each from a different
+starting point, and keeps the best. Each start optimizes its own copy of the
+tree: start 0 starts from the tree as it is, the others from copies whose leaf
+nodes have been perturbed by a seeded random amount. The starts run on
+separate threads, which share the thread budget set by SetNumThreads(), and
+the feasible result with the largest scale is copied back into the original
+tree. Results don't depend on the number of threads, except in the last few
+bits when there are fewer starts than threads, since each start's optimizer
+then gets more than one.
+
+Starts still running at the deadline are abandoned. If a Progress object is
+given, its Report() is called for each start when it begins, periodically as
+it runs, and when it ends; these calls come from the worker threads, possibly
+several at once, so Report() must be thread-safe. If Report() throws, that
+start is abandoned.
+**********/
+class tmMultiStartScaleOptimizer
+{
+public:
+  // State of one start
+  enum Status {
+    PENDING,    // not yet begun
+    RUNNING,    // optimization in progress
+    SUCCEEDED,  // converged to a feasible tree
+    FAILED,     // didn't converge, or the result wasn't feasible
+    TIMED_OUT   // abandoned at the deadline
+  };
+  enum {NO_START = std::size_t(-1)};
+  
+  /**********
+  class Progress
+  Receives reports on the progress of each start.
+  **********/
+  class Progress {
+  public:
+    virtual void Report(std::size_t start, Status status, 
+      const tmFloat& scale) = 0;
+    virtual ~Progress() {};
+  };
+  
+  tmMultiStartScaleOptimizer(tmTree* aTree, std::size_t numStarts);
+  
+  void SetNumThreads(std::size_t numThreads);
+  void SetSeed(unsigned long seed);
+  void SetPerturbation(const tmFloat& perturbation);
+  void SetDeadline(const tmFloat& seconds);
+  void SetProgress(Progress* progress);
+  
+  std::size_t Optimize();
+  
+  std::size_t GetNumStarts() const {
+    // Return the number of starting points.
+    return mNumStarts;};
+  Status GetStatus(std::size_t start) const {
+    // Return the outcome of the given start.
+    return mStatus[start];};
+  const tmFloat& GetScale(std::size_t start) const {
+    // Return the scale the given start reached.
+    return mScales[start];};
+  std::size_t GetBestStart() const {
+    // Return the start that was copied into the tree, or NO_START if none.
+    return mBestStart;};
+  
+private:
+  class EX_DEADLINE {};
+  class StartUpdater;
+  friend class StartUpdater;
+  class StartTask;
+  friend class StartTask;
+  
+  tmTree* mTree;                  // tree that gets the best result
+  std::size_t mNumStarts;         // number of starting points
+  std::size_t mNumThreads;        // threads shared by all the starts
+  unsigned long mSeed;            // seed of the first perturbed start
+  tmFloat mPerturbation;          // max distance each leaf node is moved
+  tmFloat mDeadline;              // seconds allowed, or 0 for no limit
+  double mDeadlineTime;           // wall time at which starts are abandoned
+  Progress* mProgress;            // receives progress reports, if any
+  std::vector<tmTree*> mCopies;   // tree optimized by each start
+  std::vector<Status> mStatus;    // outcome of each start
+  std::vector<tmFloat> mScales;   // scale reached by each start
+  std::size_t mBestStart;         // start copied into mTree, or NO_START
+  
+  void RunStart(std::size_t start);
+  void Report(std::size_t start, const tmFloat& scale);
+};
+
+
 #endif // _TMSCALEOPTIMIZER_H_
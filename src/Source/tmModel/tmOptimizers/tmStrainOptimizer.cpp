@@ -10,8 +10,11 @@ Copyright:    
 
 #include "tmStrainOptimizer.h"
 #include "tmConstraintFns.h"
+#include "tmNLCOProblem.h"
 #include "tmNLCO.h"
 
+#include <algorithm>
+
 using namespace std;
 
 /*****
@@ -51,6 +54,9 @@ void tmStrainOptimizer::Initialize(tmDpptrArray<tmNode>& movingNodes,
   mNLCO->SetSize(mNumVars);
   mCurrentStateVec.resize(mNumVars);
   TreeToData();
+  KeyNodeVars(mMovingNodes);
+  for (size_t i = 0; i < ne; ++i)
+    mVarKeys.push_back(MakeKey(KEY_EDGE, mStretchyEdges[i]->GetIndex()));
   
   // Set up vector of stiffness coefficients, which should be positive.
   mStiffness.resize(ne);
@@ -82,68 +88,104 @@ void tmStrainOptimizer::Initialize(tmDpptrArray<tmNode>& movingNodes,
   // Create our objective function
   mNLCO->SetObjective(new tmStrainOptimizerObjective(this));
 
+  // Map the positions of leaf nodes and edges in the tree's cached structure
+  // to our variables, so that looking up a part doesn't search our lists.
+  const tmTree::LeafPathCache& cache = theTree->GetLeafPathCache();
+  mNodeOffsets.assign(cache.mLeafNodes.size(), tmArray<tmNode*>::BAD_OFFSET);
+  for (size_t i = n; i > 0; --i) {
+    size_t pos = cache.GetLeafNodePos(mMovingNodes[i - 1]);
+    TMASSERT(pos != tmArray<tmNode*>::BAD_OFFSET);
+    mNodeOffsets[pos] = 2 * (i - 1);
+  }
+  mEdgeOffsets.assign(cache.mEdges.size(), tmArray<tmEdge*>::BAD_OFFSET);
+  for (size_t i = ne; i > 0; --i) {
+    size_t pos = cache.GetEdgePos(mStretchyEdges[i - 1]);
+    TMASSERT(pos != tmArray<tmEdge*>::BAD_OFFSET);
+    mEdgeOffsets[pos] = edgeOffset + i - 1;
+  }
+  
+  // Sum the fixed parts of the scaled edge lengths from the root of the tree
+  // down to each node, and link each node to the nearest stretchy edge above
+  // it, so that the lengths of any path can be found from its ends and their
+  // common ancestor without walking the path.
+  const tmTree::PathRoutes& routes = theTree->GetPathRoutes();
+  size_t nr = routes.mNodes.size();
+  mRootFixLen.assign(nr, 0.0);
+  mStretchyAbove.assign(nr, 0);
+  for (size_t k = 1; k < nr; ++k) {
+    tmEdge* aEdge = routes.mEdges[k - 1];
+    size_t kp = routes.mParent[k];
+    if (GetBaseOffset(aEdge) != tmArray<tmEdge*>::BAD_OFFSET) {
+      mRootFixLen[k] = mRootFixLen[kp] + 
+        aEdge->GetLength() * theTree->GetScale();
+      mStretchyAbove[k] = k;
+    }
+    else {
+      mRootFixLen[k] = mRootFixLen[kp] + aEdge->GetStrainedScaledLength();
+      mStretchyAbove[k] = mStretchyAbove[kp];
+    }
+  }
+
   // Go through the leaf paths and add a constraint for each path that includes
-  // one or more moving nodes or stretchy edges.
-  tmArrayIterator<tmPath*> iOwnedPaths(theTree->GetOwnedPaths());
-  tmPath* aPath;
-  while (iOwnedPaths.Next(&aPath)) {
-    if (aPath->IsLeafPath()) {
-      
-      // If there's a path condition joining these nodes, then the
-      // standard path condition is unnecessary. So we won't apply it.      
-      if (theTree->IsConditioned<tmConditionPathActive>(aPath)) 
-        continue;
-      
-      // Get nodes at each end of the path, their indices, and whether they're 
-      // movable.      
-      tmNode* node1 = aPath->GetNodes().front();
-      size_t ix = GetBaseOffset(node1);
-      size_t iy = ix + 1;
-      bool iMovable = (ix != tmArray<tmNode*>::BAD_OFFSET);
-      
-      tmNode* node2 = aPath->GetNodes().back();
-      size_t jx = GetBaseOffset(node2);
-      size_t jy = jx + 1;
-      bool jMovable = (jx != tmArray<tmNode*>::BAD_OFFSET);
-      
-      // Get the fixed and variable lengths for this path.      
-      double lfix;
-      std::vector<size_t> vi;
-      std::vector<double> vf;
-      size_t ni;
-      GetFixVarLengths(aPath, lfix, ni, vi, vf);
-      
-      if (iMovable && jMovable)   // both nodes moving
-        mNLCO->AddNonlinearInequality(
-          new MultiStrainPathFn1(ix, iy, jx, jy, lfix, ni, vi, vf));
-      
-      else if (iMovable)       // only tmNode 1 moving
-        mNLCO->AddNonlinearInequality(
-          new MultiStrainPathFn2(ix, iy, node2->GetLocX(), node2->GetLocY(),
-          lfix, ni, vi, vf));
-      
-      else if (jMovable)       // only tmNode 2 moving
-        mNLCO->AddNonlinearInequality(
-          new MultiStrainPathFn2(jx, jy, node1->GetLocX(), node1->GetLocY(),
-          lfix, ni, vi, vf));
-      
-      else {            // neither tmNode moving
-      
-        // make sure the path contains a stretchy edge (there's a nonzero
-        // variable part); if it doesn't, there's no point in adding a
-        // constraint.        
-        if (ni == 0) continue;
-        mNLCO->AddNonlinearInequality(
-          new MultiStrainPathFn3(node1->GetLocX(), node1->GetLocY(),
-          node2->GetLocX(), node2->GetLocY(), lfix, ni, vi, vf));
-      }
+  // one or more moving nodes or stretchy edges. Leaf paths with a path
+  // condition joining their nodes don't need the standard path constraint, so
+  // they aren't in the cache.
+  for (size_t i = 0; i < cache.mPaths.size(); ++i) {
+    tmPath* aPath = cache.mPaths[i];
+    
+    // Get nodes at each end of the path, their indices, and whether they're 
+    // movable.      
+    tmNode* node1 = aPath->GetFrontNode();
+    size_t ix = mNodeOffsets[cache.mNodes1[i]];
+    size_t iy = ix + 1;
+    bool iMovable = (ix != tmArray<tmNode*>::BAD_OFFSET);
+    
+    tmNode* node2 = aPath->GetBackNode();
+    size_t jx = mNodeOffsets[cache.mNodes2[i]];
+    size_t jy = jx + 1;
+    bool jMovable = (jx != tmArray<tmNode*>::BAD_OFFSET);
+    
+    // Get the fixed and variable lengths for this path.      
+    double lfix;
+    std::vector<size_t> vi;
+    std::vector<double> vf;
+    size_t ni;
+    GetFixVarLengths(aPath, lfix, ni, vi, vf);
+    
+    if (iMovable && jMovable)   // both nodes moving
+      mNLCO->AddNonlinearInequality(
+        new MultiStrainPathFn1(ix, iy, jx, jy, lfix, ni, vi, vf));
+    
+    else if (iMovable)       // only tmNode 1 moving
+      mNLCO->AddNonlinearInequality(
+        new MultiStrainPathFn2(ix, iy, node2->GetLocX(), node2->GetLocY(),
+        lfix, ni, vi, vf));
+    
+    else if (jMovable)       // only tmNode 2 moving
+      mNLCO->AddNonlinearInequality(
+        new MultiStrainPathFn2(jx, jy, node1->GetLocX(), node1->GetLocY(),
+        lfix, ni, vi, vf));
+    
+    else {            // neither tmNode moving
+    
+      // make sure the path contains a stretchy edge (there's a nonzero
+      // variable part); if it doesn't, there's no point in adding a
+      // constraint.        
+      if (ni == 0) continue;
+      mNLCO->AddNonlinearInequality(
+        new MultiStrainPathFn3(node1->GetLocX(), node1->GetLocY(),
+        node2->GetLocX(), node2->GetLocY(), lfix, ni, vi, vf));
     }
+    KeyNewConstraints(KEY_PATH, node1->GetIndex(), node2->GetIndex());
   }
   
   // Go through all Conditions and add Constraints for each.
   tmArrayIterator<tmCondition*> iConditions(theTree->GetConditions());
   tmCondition* aCondition;
-  while (iConditions.Next(&aCondition)) aCondition->AddConstraints(this);
+  while (iConditions.Next(&aCondition)) {
+    aCondition->AddConstraints(this);
+    KeyNewConstraints(KEY_CONDITION, aCondition->GetIndex());
+  }
   
   // Ready to go. User might want to compare number of equality constraints
   // against the number of variables before proceeding.  
@@ -157,9 +199,9 @@ Return BAD_OFFSET if it isn't a moving tmNode.
 *****/
 size_t tmStrainOptimizer::GetBaseOffset(tmNode* aNode)
 {
-  size_t i = mMovingNodes.GetOffset(aNode);
-  if (i == tmArray<tmNode*>::BAD_OFFSET) return tmArray<tmNode*>::BAD_OFFSET;
-  else return 2 * i;
+  size_t i = GetTree()->GetLeafPathCache().GetLeafNodePos(aNode);
+  if (i >= mNodeOffsets.size()) return tmArray<tmNode*>::BAD_OFFSET;
+  else return mNodeOffsets[i];
 }
 
 
@@ -170,37 +212,48 @@ Return BAD_OFFSET if it isn't a moving edge.
 
 size_t tmStrainOptimizer::GetBaseOffset(tmEdge* aEdge)
 {
-  size_t i = mStretchyEdges.GetOffset(aEdge);
-  if (i == tmArray<tmEdge>::BAD_OFFSET) return tmArray<tmEdge>::BAD_OFFSET;
-  else return edgeOffset + i;
+  size_t i = GetTree()->GetLeafPathCache().GetEdgePos(aEdge);
+  if (i >= mEdgeOffsets.size()) return tmArray<tmEdge>::BAD_OFFSET;
+  else return mEdgeOffsets[i];
 }
 
 
 /*****
-Return the fixed and variable parts of the length of this path
+Return the fixed and variable parts of the length of this path. The fixed part
+takes constant time to find from the sums of lengths down from the root, and
+the variable part visits only the stretchy edges along the path.
 *****/
 void tmStrainOptimizer::GetFixVarLengths(tmPath* aPath, double& lfix, 
   size_t& ni,  vector<size_t>& vi, vector<double>& vf)
 {
-  lfix = 0;
-  ni = 0;
-  vi.resize(mStretchyEdges.size());  // initially size to hold all edges
-  vf.resize(mStretchyEdges.size());
+  const tmTree::PathRoutes& routes = GetTree()->GetPathRoutes();
+  size_t i1 = aPath->GetFrontNode()->GetRoutePos();
+  size_t i2 = aPath->GetBackNode()->GetRoutePos();
+  size_t a = routes.GetAncestor(i1, i2);
+  lfix = mRootFixLen[i1] + mRootFixLen[i2] - 2 * mRootFixLen[a];
   
-  tmEdge* aEdge;
-  tmArrayIterator<tmEdge*> iPathEdges(aPath->GetEdges());
-  while (iPathEdges.Next(&aEdge)) {
-    size_t ii = GetBaseOffset(aEdge);
-    if (ii != tmArray<tmEdge*>::BAD_OFFSET) {
-      vi[ni] = ii;
-      vf[ni] = aEdge->GetLength() * GetTree()->GetScale();
-      ni++;
-      lfix += aEdge->GetLength() * GetTree()->GetScale();
-    }
-    else lfix += aEdge->GetStrainedScaledLength();
+  // Stretchy edges from the front node up to the common ancestor, then from
+  // there down to the back node, in order along the path. Going up from either
+  // end, we've reached the ancestor once the position is no longer below its
+  // own, since depth-first positions decrease toward the root.
+  vi.clear();
+  vf.clear();
+  for (size_t k = mStretchyAbove[i1]; k > a; 
+    k = mStretchyAbove[routes.mParent[k]]) {
+    tmEdge* aEdge = routes.mEdges[k - 1];
+    vi.push_back(GetBaseOffset(aEdge));
+    vf.push_back(aEdge->GetLength() * GetTree()->GetScale());
+  }
+  size_t nup = vi.size();
+  for (size_t k = mStretchyAbove[i2]; k > a; 
+    k = mStretchyAbove[routes.mParent[k]]) {
+    tmEdge* aEdge = routes.mEdges[k - 1];
+    vi.push_back(GetBaseOffset(aEdge));
+    vf.push_back(aEdge->GetLength() * GetTree()->GetScale());
   }
-  vi.resize(ni);  // then shrink to fit
-  vf.resize(ni);
+  reverse(vi.begin() + nup, vi.end());
+  reverse(vf.begin() + nup, vf.end());
+  ni = vi.size();
 }
 
 
@@ -274,7 +327,7 @@ double tmStrainOptimizerObjective::Func(const std::vector<double>& u)
 {
   IncFuncCalls();
   mStrainOptimizer->mCurrentStateVec = u;
-  mStrainOptimizer->GetNLCO()->ObjectiveUpdateUI();
+  mStrainOptimizer->ObjectiveUpdateUI();
   
   // Return mean square edge strain, weighted by stiffness
   double ut = 0;
@@ -299,3 +352,53 @@ void tmStrainOptimizerObjective::Grad(const std::vector<double>& u,
   for (size_t i = nn; i < nt; ++i) du[i] = 2 * 
     (mStrainOptimizer->mStiffness[i - nn]) * u[i];
 }
+
+
+/*****
+Return the value of the function and its gradient, computed in a single pass
+over the strains
+*****/
+double tmStrainOptimizerObjective::FuncGrad(const std::vector<double>& u, 
+  std::vector<double>& du)
+{
+  IncFuncCalls();
+  IncGradCalls();
+  mStrainOptimizer->mCurrentStateVec = u;
+  mStrainOptimizer->ObjectiveUpdateUI();
+  
+  double ut = 0;
+  du.assign(du.size(), 0);
+  size_t nn = mStrainOptimizer->edgeOffset;
+  size_t nt = mStrainOptimizer->mNumVars;
+  for (size_t i = nn; i < nt; ++i) {
+    const double& stiffness = mStrainOptimizer->mStiffness[i - nn];
+    ut += stiffness * pow(u[i], 2);
+    du[i] = 2 * stiffness * u[i];
+  }
+  return ut;
+}
+
+
+/*****
+Write the parameters of the equivalent QuadraticFn, the stiffness-weighted sum
+of squared strains, for a captured problem
+*****/
+void tmStrainOptimizerObjective::PutParams(std::ostream& os) const
+{
+  QuadraticFn q;
+  size_t nn = mStrainOptimizer->edgeOffset;
+  size_t nt = mStrainOptimizer->mNumVars;
+  for (size_t i = nn; i < nt; ++i) 
+    q.AddTerm(i, 0, mStrainOptimizer->mStiffness[i - nn]);
+  q.PutParams(os);
+}
+
+
+/*****
+Return the equivalent QuadraticFn, which computes the same values without
+recording the state or updating the UI
+*****/
+tmDifferentiableFn* tmStrainOptimizerObjective::MakeCopy() const
+{
+  return tmNLCOProblem::CopyFn(this);
+}
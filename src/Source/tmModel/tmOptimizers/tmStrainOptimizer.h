@@ -41,6 +41,12 @@ private:
   std::size_t edgeOffset;             // base index for edge strains
   std::size_t mNumVars;               // total number of variables
   std::vector<double> mStiffness;     // vector of stiffness coefficients
+  std::vector<std::size_t> mNodeOffsets;  // by leaf node position in cache
+  std::vector<std::size_t> mEdgeOffsets;  // by edge position in cache
+  std::vector<double> mRootFixLen;    // fixed path length from the root, and
+  std::vector<std::size_t> mStretchyAbove;  // nearest node at or above whose
+                                      //   edge up is stretchy, by position
+                                      //   in the routes (0 if none)
 
   friend class tmStrainOptimizerObjective;
 };
@@ -55,6 +61,10 @@ class tmStrainOptimizerObjective : public tmDifferentiableFn
 public:
   double Func(const std::vector<double>& u);
   void Grad(const std::vector<double>& u, std::vector<double>& du);
+  double FuncGrad(const std::vector<double>& u, std::vector<double>& du);
+  const char* GetTag() const {return "QuadraticFn";};
+  void PutParams(std::ostream& os) const;
+  tmDifferentiableFn* MakeCopy() const;
 private:
   tmStrainOptimizerObjective(tmStrainOptimizer* aStrainOptimizer);
   tmStrainOptimizer* mStrainOptimizer;
@@ -9,16 +9,7 @@ Copyright:    
 *******************************************************************************/
 
 #include "tmStubFinder.h"
-
-#include "tmArray.h"
-#include "tmArrayIterator.h"
-#include "tmTreeCleaner.h"
-#include "tmTree.h"
-#include "tmNode.h"
-#include "tmEdge.h"
-#include "tmPath.h"
-#include "tmPoly.h"
-#include "tmNewtonRaphson.h"
+#include "tmModel.h"
 
 using namespace std;
 
@@ -155,6 +146,10 @@ void tmStubFinder::FindAllStubs(const tmArray<tmNode*>& aNodeList,
   // phase.
   mTree->GetLeafNodes(mLeafNodes);
   
+  // Bring the tree distances up to date, so that path lengths from the split
+  // edge to each node can be looked up in constant time.
+  mTree->GetPathDistances();
+  
   // Go through every possible combination of four nodes in the poly and edge
   // in the poly and look for a valid solution for a stub tmNode that makes
   // four active paths. 
@@ -186,6 +181,7 @@ sInfoList.
 *****/
 void tmStubFinder::TestOneCombo(tmArray<tmStubInfo>& sInfoList)
 {
+  const tmTree::PathRoutes& routes = mTree->GetPathRoutes();
   tmNode* edgeFirstNode = mTrialEdge->mNodes.front();
   for (size_t i = 0; i < 4; ++i) {
     mParms[i][0] = mTrialNodes[i]->mLoc.x;
@@ -195,9 +191,9 @@ void tmStubFinder::TestOneCombo(tmArray<tmStubInfo>& sInfoList)
       mParms[i][3] = 1;
     }
     else {
-      tmPath* aPath = mTree->FindAnyPath(edgeFirstNode, mTrialNodes[i]);
-      mParms[i][2] = aPath->mMinTreeLength;
-      mParms[i][3] = (aPath->mEdges.contains(mTrialEdge)) ? -1 : 1;
+      mParms[i][2] = routes.GetDistance(edgeFirstNode, mTrialNodes[i]);
+      mParms[i][3] = mTree->PathRouteContains(edgeFirstNode, mTrialNodes[i], 
+        mTrialEdge) ? -1 : 1;
     }
   }
   
@@ -252,9 +248,9 @@ void tmStubFinder::TestOneCombo(tmArray<tmStubInfo>& sInfoList)
     tmFloat minDist = u[0];
     if (testNode == edgeFirstNode) minDist += u[1];
     else {
-      tmPath* aPath = mTree->FindAnyPath(edgeFirstNode, testNode);
-      minDist += aPath->mMinTreeLength;
-      if (aPath->mEdges.contains(mTrialEdge)) minDist -= u[1];
+      minDist += routes.GetDistance(edgeFirstNode, testNode);
+      if (mTree->PathRouteContains(edgeFirstNode, testNode, mTrialEdge)) 
+        minDist -= u[1];
       else minDist += u[1];
     }
     minDist *= mScale;
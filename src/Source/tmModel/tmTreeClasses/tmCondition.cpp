@@ -51,7 +51,7 @@ tmCondition::tmCondition(tmTree* aTree)
   // Register with owner
   mConditionOwner = aTree;
   mConditionOwner->mOwnedConditions.push_back(this);
-  
+  aTree->StructureChanged();
 }
 
 
@@ -71,6 +71,14 @@ tmPath*) is used by the condition. Implemented by subclasses.
 // bool tmCondition::Uses(tmPart*) const;
 
 
+/*****
+Append the tmParts used by the condition to partList, so that the tree can
+index its conditions by part; a part appears in the list if and only if Uses()
+returns true for it. Implemented by subclasses.
+*****/
+// void tmCondition::GetUsedParts(tmArray<tmPart*>& partList) const;
+
+
 /*****
 Returns true if the condition is still valid, i.e., if the tmParts it
 references exist. NOTE: this is not the same as saying the condition is
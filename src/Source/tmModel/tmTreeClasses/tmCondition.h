@@ -54,6 +54,7 @@ protected:
 
   // Subclasses must implement these
   virtual bool Uses(tmPart* aPart) const = 0;
+  virtual void GetUsedParts(tmArray<tmPart*>& partList) const = 0;
   virtual bool IsValidCondition() const = 0;
   virtual void CalcFeasibility() = 0;
 private:
@@ -43,8 +43,9 @@ Set the edge whose length is fixed to its unstrained value
 *****/
 void tmConditionEdgeLengthFixed::SetEdge(tmEdge* aEdge)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mEdge = aEdge;
+  mTree->ConditionsChanged();
 }
 
     
@@ -58,6 +59,15 @@ bool tmConditionEdgeLengthFixed::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionEdgeLengthFixed::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mEdge) partList.push_back(mEdge);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/  
@@ -49,6 +49,7 @@ private:
 
   // Miscellaneous utilities
   bool Uses(tmPart* aPart) const;
+  void GetUsedParts(tmArray<tmPart*>& partList) const;
   bool IsValidCondition() const;
   void CalcFeasibility();
   void AddConstraints(tmScaleOptimizer* t);
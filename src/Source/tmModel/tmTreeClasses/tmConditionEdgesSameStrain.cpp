@@ -45,8 +45,9 @@ Set the first edge of a pair with same strain
 *****/
 void tmConditionEdgesSameStrain::SetEdge1(tmEdge* aEdge)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mEdge1 = aEdge;
+  mTree->ConditionsChanged();
 }
 
 
@@ -55,8 +56,9 @@ Set the second edge of a pair with same strain
 *****/
 void tmConditionEdgesSameStrain::SetEdge2(tmEdge* aEdge)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mEdge2 = aEdge;
+  mTree->ConditionsChanged();
 }
 
     
@@ -70,6 +72,16 @@ bool tmConditionEdgesSameStrain::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionEdgesSameStrain::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mEdge1) partList.push_back(mEdge1);
+  if (mEdge2) partList.push_back(mEdge2);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/  
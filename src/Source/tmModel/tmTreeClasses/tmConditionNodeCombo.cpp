@@ -80,7 +80,7 @@ Set whether the x-coordinate is fixed.
 void tmConditionNodeCombo::SetXFixed(bool aXFixed)
 {
   if (aXFixed != mXFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
     mXFixed = aXFixed;
   }
 }
@@ -93,7 +93,7 @@ void tmConditionNodeCombo::SetXFixValue(const tmFloat& aXFixValue)
 {
   mXFixValue = aXFixValue;
   if (mXFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   }
 }
 
@@ -104,7 +104,7 @@ Set whether the y-coordinate is fixed.
 void tmConditionNodeCombo::SetYFixed(bool aYFixed)
 {
   if (aYFixed != mYFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
     mYFixed = aYFixed;
   }
 }
@@ -117,7 +117,7 @@ void tmConditionNodeCombo::SetYFixValue(const tmFloat& aYFixValue)
 {
   mYFixValue = aYFixValue;
   if (mYFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   }
 }
 
@@ -129,9 +129,10 @@ void tmConditionNodeCombo::SetNode(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
   if (aNode != mNode) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
     mNode = aNode;
   }
+  mTree->ConditionsChanged();
 }
 
 
@@ -145,6 +146,15 @@ bool tmConditionNodeCombo::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodeCombo::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode) partList.push_back(mNode);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/  
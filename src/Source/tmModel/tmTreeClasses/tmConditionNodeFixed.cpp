@@ -38,7 +38,7 @@ Set whether the x-coordinate is fixed.
 void tmConditionNodeFixed::SetXFixed(bool aXFixed)
 {
   if (aXFixed != mXFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
     mXFixed = aXFixed;
   }
 }
@@ -50,7 +50,7 @@ Set whether the y-coordinate is fixed.
 void tmConditionNodeFixed::SetYFixed(bool aYFixed)
 {
   if (aYFixed != mYFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
     mYFixed = aYFixed;
   }
 }
@@ -63,7 +63,7 @@ void tmConditionNodeFixed::SetXFixValue(const tmFloat& aXFixValue)
 {
   mXFixValue = aXFixValue;
   if (mXFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   }
 }
 
@@ -75,7 +75,7 @@ void tmConditionNodeFixed::SetYFixValue(const tmFloat& aYFixValue)
 {
   mYFixValue = aYFixValue;
   if (mYFixed) {
-    tmTreeCleaner tc(mTree);
+    tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   }
 }
 
@@ -86,8 +86,9 @@ Set the node that is fixed. Must be a leaf node.
 void tmConditionNodeFixed::SetNode(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode = aNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -101,6 +102,15 @@ bool tmConditionNodeFixed::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodeFixed::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode) partList.push_back(mNode);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/  
@@ -44,8 +44,9 @@ Set the node that is forced to a corner; must be a leaf node.
 void tmConditionNodeOnCorner::SetNode(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode = aNode;
+  mTree->ConditionsChanged();
 }
 
     
@@ -59,6 +60,15 @@ bool tmConditionNodeOnCorner::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodeOnCorner::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode) partList.push_back(mNode);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/    
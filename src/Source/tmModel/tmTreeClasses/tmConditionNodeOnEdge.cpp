@@ -44,8 +44,9 @@ Set the node that is fixed to the edge. Must be a leaf node.
 void tmConditionNodeOnEdge::SetNode(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode = aNode;
+  mTree->ConditionsChanged();
 }
 
     
@@ -59,6 +60,15 @@ bool tmConditionNodeOnEdge::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodeOnEdge::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode) partList.push_back(mNode);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/  
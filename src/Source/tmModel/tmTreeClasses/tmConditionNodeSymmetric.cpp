@@ -43,8 +43,9 @@ Set the node that is fixed to the symmetry line. Must be a leaf node.
 void tmConditionNodeSymmetric::SetNode(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode = aNode;
+  mTree->ConditionsChanged();
 }
 
     
@@ -58,6 +59,15 @@ bool tmConditionNodeSymmetric::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodeSymmetric::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode) partList.push_back(mNode);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/
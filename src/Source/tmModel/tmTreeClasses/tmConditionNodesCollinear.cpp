@@ -42,8 +42,9 @@ Set the first of 3 collinear nodes. Must be a leaf node.
 void tmConditionNodesCollinear::SetNode1(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -53,8 +54,9 @@ Set the second of 3 collinear nodes. Must be a leaf node.
 void tmConditionNodesCollinear::SetNode2(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode2 = aNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -64,8 +66,9 @@ Set the third of 3 collinear nodes. Must be a leaf node.
 void tmConditionNodesCollinear::SetNode3(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode3 = aNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -79,6 +82,17 @@ bool tmConditionNodesCollinear::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodesCollinear::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode1) partList.push_back(mNode1);
+  if (mNode2) partList.push_back(mNode2);
+  if (mNode3) partList.push_back(mNode3);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/
@@ -45,8 +45,9 @@ Set one of the two paired nodes. Must be a leaf node.
 void tmConditionNodesPaired::SetNode1(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -56,8 +57,9 @@ Set the other of the two paired nodes. Must be a leaf node.
 void tmConditionNodesPaired::SetNode2(tmNode* aNode)
 {
   TMASSERT(aNode->IsLeafNode());
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode2 = aNode;
+  mTree->ConditionsChanged();
 }
 
     
@@ -71,6 +73,16 @@ bool tmConditionNodesPaired::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionNodesPaired::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode1) partList.push_back(mNode1);
+  if (mNode2) partList.push_back(mNode2);
+}
+
+
 /*****
 Return true if the referenced parts still exist
 *****/    
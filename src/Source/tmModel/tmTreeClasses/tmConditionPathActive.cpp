@@ -34,8 +34,8 @@ tmConditionPathActive::tmConditionPathActive(tmTree* aTree, tmPath* aPath)
   : tmCondition(aTree)
 {
   mPath = aPath;
-  mNode1 = aPath->mNodes.front();
-  mNode2 = aPath->mNodes.back();
+  mNode1 = aPath->mFrontNode;
+  mNode2 = aPath->mBackNode;
 }
 
 
@@ -46,11 +46,13 @@ void tmConditionPathActive::SetPath(tmPath* aPath)
 {
   TMASSERT(aPath);
   TMASSERT(aPath->mIsLeafPath);
-  if (mPath = aPath) return;
-  tmTreeCleaner tc(mTree);
+  if (mPath == aPath) return;
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mPath = aPath;
-  mNode1 = aPath->mNodes.front();
-  mNode2 = aPath->mNodes.back();
+  mNode1 = aPath->mFrontNode;
+  mNode2 = aPath->mBackNode;
+  mTree->StructureChanged();
+  mTree->ConditionsChanged();
 }
 
 
@@ -65,10 +67,12 @@ void tmConditionPathActive::SetNodes(tmNode* aNode1, tmNode* aNode2)
   TMASSERT(aNode2->IsLeafNode());
   TMASSERT(aNode1 != aNode2);
   if (mNode1 == aNode1 && mNode2 == aNode2) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode1;
   mNode2 = aNode2;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->StructureChanged();
+  mTree->ConditionsChanged();
 }
 
 
@@ -80,9 +84,11 @@ void tmConditionPathActive::SetNode1(tmNode* aNode1)
   TMASSERT(aNode1);
   TMASSERT(aNode1->IsLeafNode());
   if (mNode1 == aNode1) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode1;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->StructureChanged();
+  mTree->ConditionsChanged();
 }
 
 
@@ -94,9 +100,11 @@ void tmConditionPathActive::SetNode2(tmNode* aNode2)
   TMASSERT(aNode2);
   TMASSERT(aNode2->IsLeafNode());
   if (mNode2 == aNode2) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode2 = aNode2;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->StructureChanged();
+  mTree->ConditionsChanged();
 }
 
 
@@ -113,6 +121,17 @@ bool tmConditionPathActive::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionPathActive::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode1) partList.push_back(mNode1);
+  if (mNode2) partList.push_back(mNode2);
+  if (mPath) partList.push_back(mPath);
+}
+
+
 /*****
 Return true if the tmParts referenced by this tmCondition still exist
 *****/  
@@ -52,6 +52,7 @@ protected:
 
   // Further implemented by subclasses
   bool Uses(tmPart* aPart) const;
+  void GetUsedParts(tmArray<tmPart*>& partList) const;
   bool IsValidCondition() const;
   void CalcFeasibility();
 
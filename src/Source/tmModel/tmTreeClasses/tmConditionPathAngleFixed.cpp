@@ -48,7 +48,7 @@ Set the angle to which this path is quantized
 *****/
 void tmConditionPathAngleFixed::SetAngle(const tmFloat& aAngle)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mAngle = aAngle;
 }
 
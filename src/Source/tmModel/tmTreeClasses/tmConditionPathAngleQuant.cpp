@@ -50,7 +50,7 @@ Set the angle quantization.
 *****/
 void tmConditionPathAngleQuant::SetQuant(size_t aQuant)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mQuant = aQuant;
 }
 
@@ -60,7 +60,7 @@ Set the angle quantization offset.
 *****/
 void tmConditionPathAngleQuant::SetQuantOffset(const tmFloat& aQuantOffset)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mQuantOffset = aQuantOffset;
 }
 
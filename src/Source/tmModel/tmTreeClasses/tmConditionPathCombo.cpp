@@ -53,8 +53,8 @@ tmConditionPathCombo::tmConditionPathCombo(tmTree* aTree, tmPath* aPath)
 {
   InitConditionPathCombo();
   mPath = aPath;
-  mNode1 = aPath->mNodes.front();
-  mNode2 = aPath->mNodes.back();
+  mNode1 = aPath->mFrontNode;
+  mNode2 = aPath->mBackNode;
 }
 
 
@@ -65,11 +65,12 @@ void tmConditionPathCombo::SetPath(tmPath* aPath)
 {
   TMASSERT(aPath);
   TMASSERT(aPath->mIsLeafPath);
-  if (mPath = aPath) return;
-  tmTreeCleaner tc(mTree);
+  if (mPath == aPath) return;
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mPath = aPath;
-  mNode1 = aPath->mNodes.front();
-  mNode2 = aPath->mNodes.back();
+  mNode1 = aPath->mFrontNode;
+  mNode2 = aPath->mBackNode;
+  mTree->ConditionsChanged();
 }
 
 
@@ -84,10 +85,11 @@ void tmConditionPathCombo::SetNodes(tmNode* aNode1, tmNode* aNode2)
   TMASSERT(aNode2->IsLeafNode());
   TMASSERT(aNode1 != aNode2);
   if (mNode1 == aNode1 && mNode2 == aNode2) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode1;
   mNode2 = aNode2;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->ConditionsChanged();
 }
 
 
@@ -99,9 +101,10 @@ void tmConditionPathCombo::SetNode1(tmNode* aNode1)
   TMASSERT(aNode1);
   TMASSERT(aNode1->IsLeafNode());
   if (mNode1 == aNode1) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode1 = aNode1;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->ConditionsChanged();
 }
 
 
@@ -113,9 +116,10 @@ void tmConditionPathCombo::SetNode2(tmNode* aNode2)
   TMASSERT(aNode2);
   TMASSERT(aNode2->IsLeafNode());
   if (mNode2 == aNode2) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mNode2 = aNode2;
   mPath = mTree->FindLeafPath(mNode1, mNode2);
+  mTree->ConditionsChanged();
 }
 
 
@@ -125,7 +129,7 @@ angle fixed, we turn off angle quant.
 *****/
 void tmConditionPathCombo::SetAngleFixed(bool aAngleFixed)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mIsAngleFixed = aAngleFixed;
   if (aAngleFixed) 
     mIsAngleQuant = false;
@@ -137,7 +141,7 @@ Set the angle that this path is fixed to.
 *****/
 void tmConditionPathCombo::SetAngle(const tmFloat& aAngle)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mAngle = aAngle;
 }
 
@@ -148,7 +152,7 @@ on angle quant, we turn off angle fixed.
 *****/
 void tmConditionPathCombo::SetAngleQuant(bool aAngleQuant)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mIsAngleQuant = aAngleQuant;
   if (aAngleQuant)
     mIsAngleFixed = false;
@@ -160,7 +164,7 @@ Set the quantization value for the angle of this path
 *****/
 void tmConditionPathCombo::SetQuant(size_t aQuant)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mQuant = aQuant;
 }
 
@@ -170,7 +174,7 @@ Set the quantization offset for the angle of this path
 *****/
 void tmConditionPathCombo::SetQuantOffset(const tmFloat& aQuantOffset)
 {
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::CONDITIONS);
   mQuantOffset = aQuantOffset;
 }
 
@@ -188,6 +192,17 @@ bool tmConditionPathCombo::Uses(tmPart* aPart) const
 }
 
 
+/*****
+Add the parts this condition uses to partList.
+*****/
+void tmConditionPathCombo::GetUsedParts(tmArray<tmPart*>& partList) const
+{
+  if (mNode1) partList.push_back(mNode1);
+  if (mNode2) partList.push_back(mNode2);
+  if (mPath) partList.push_back(mPath);
+}
+
+
 /*****
 Return true if the tmParts referenced by this tmCondition still exist
 *****/  
@@ -73,6 +73,7 @@ private:
   // Miscellaneous utilities
   void InitConditionPathCombo();
   bool Uses(tmPart* aPart) const;
+  void GetUsedParts(tmArray<tmPart*>& partList) const;
   bool IsValidCondition() const;
   void CalcFeasibility();
   void AddConstraints(tmScaleOptimizer* t);
@@ -33,6 +33,7 @@ void tmEdge::InitEdge()
   // Register with tmTree
   mTree->mEdges.push_back(this);
   mIndex = mTree->mEdges.size();
+  mTree->StructureChanged();
   
   // Set settings
   mLength = 0;
@@ -120,7 +121,7 @@ Change the length. Users should range-check the length to be greater than zero.
 void tmEdge::SetLength(const tmFloat& aLength)
 {
   if (mLength == aLength) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::PATH_LENGTHS);
   TMASSERT(aLength > 0);
   mLength = aLength;
 }
@@ -132,7 +133,7 @@ Change the strain.
 void tmEdge::SetStrain(const tmFloat& aStrain)
 {
   if (mStrain == aStrain) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::PATH_LENGTHS);
   mStrain = aStrain;
 }
 
@@ -143,7 +144,7 @@ Change the stiffness.
 void tmEdge::SetStiffness(const tmFloat& aStiffness)
 {
   if (mStiffness == aStiffness) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::DIRTY_PARTS);
   mStiffness = aStiffness;
 }
 
@@ -41,6 +41,9 @@ void tmNode::InitNode()
   mIsJunctionNode = false;
   mIsConditionedNode = false;
   
+  // Not yet part of the tree's path routes
+  mRoutePos = tmArray<tmNode*>::BAD_OFFSET;
+  
   // Clear owner
   mNodeOwner = 0;
 }
@@ -73,6 +76,7 @@ tmNode::tmNode(tmTree* aTree, tmNodeOwner* aNodeOwner, const tmPoint& aLoc)
 
   // Initialize flags
   mIsSubNode = !GetOwnerAsTree();
+  if (!mIsSubNode) mTree->StructureChanged();
 }
 
 
@@ -112,7 +116,8 @@ Change the location of a node.
 void tmNode::SetLoc(const tmPoint& aLoc)
 {
   if (mLoc == aLoc) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::DIRTY_PARTS);
+  mTree->mDirtyParts.MarkNodeMoved(this);
   mLoc = aLoc;
 }
 
@@ -123,7 +128,8 @@ Change the x-location of a node.
 void tmNode::SetLocX(const tmFloat& ax)
 {
   if (mLoc.x == ax) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::DIRTY_PARTS);
+  mTree->mDirtyParts.MarkNodeMoved(this);
   mLoc.x = ax;
 }
 
@@ -134,7 +140,8 @@ Change the y-location of a node.
 void tmNode::SetLocY(const tmFloat& ay)
 {
   if (mLoc.y == ay) return;
-  tmTreeCleaner tc(mTree);
+  tmTreeCleaner tc(mTree, tmTreeCleaner::DIRTY_PARTS);
+  mTree->mDirtyParts.MarkNodeMoved(this);
   mLoc.y = ay;
 }
 
@@ -157,7 +164,9 @@ size_t tmNode::CalcDiscreteDepth() const
 {
   TMASSERT(IsTreeNode());
   if (mTree->GetRootNode() == this) return 0;
-  return mTree->GetPath(mTree->GetRootNode(), this)->GetEdges().size();
+  tmArray<tmEdge*> pathEdges;
+  mTree->GetPath(mTree->GetRootNode(), this)->GetEdges(pathEdges);
+  return pathEdges.size();
 } 
 
 
@@ -214,10 +223,10 @@ void tmNode::CalcIsPinnedNode()
   for (size_t i = 0; i < mLeafPaths.size(); ++i) {
     tmPath* thePath = mLeafPaths[i];
     if (!thePath->IsActivePath()) continue;
-    if (thePath->mNodes.front() == this) 
-      angles.push_back(Angle(thePath->mNodes.back()->mLoc - mLoc));
+    if (thePath->mFrontNode == this) 
+      angles.push_back(Angle(thePath->mBackNode->mLoc - mLoc));
     else
-      angles.push_back(Angle(thePath->mNodes.front()->mLoc - mLoc));
+      angles.push_back(Angle(thePath->mFrontNode->mLoc - mLoc));
   }
   
   // Paper edges have the same effect as active paths, so we'll create
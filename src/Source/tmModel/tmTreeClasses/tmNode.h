@@ -119,6 +119,11 @@ public:
   const tmNodeOwner* GetNodeOwner() const {
     // Return the object that owns this node.
     return mNodeOwner;};
+    
+  std::size_t GetRoutePos() const {
+    // Return the position of this node in tmTree::PathRoutes, which is only
+    // meaningful right after a call to tmTree::GetPathRoutes().
+    return mRoutePos;};
   
   // Coordinate access (these are used by the interface to TTL)
   const tmFloat& x() const {return mLoc.x;};
@@ -166,6 +171,7 @@ private:
   // Structural data
   tmDpptrArray<tmEdge> mEdges;
   tmDpptrArray<tmPath> mLeafPaths;
+  std::size_t mRoutePos;    // position in tmTree::PathRoutes
   
   // owner
   tmNodeOwner* mNodeOwner;
@@ -46,6 +46,7 @@ void tmPath::InitPath()
   mIsConditionedPath = false;
   mIsSubPath = false;
   
+  mPathOwner = 0;
   mOutsetPath = 0;
   mFrontReduction = 0;
   mBackReduction = 0;
@@ -82,9 +83,7 @@ tmPath::tmPath(tmTree* aTree, tmEdge* aEdge) :
   mMinTreeLength = aEdge->mLength;
 
   // Set references
-  mEdges.push_back(aEdge);
-  mNodes.push_back(aEdge->mNodes.front());
-  mNodes.push_back(aEdge->mNodes.back());
+  SetEndNodes(aEdge->mNodes.front(), aEdge->mNodes.back());
 }
 
 
@@ -115,8 +114,7 @@ tmPath::tmPath(tmTree* aTree, tmPath* aPath) :
   mIsSubPath = aPath->mIsSubPath;
   
   // Set references
-  mNodes.merge_with(aPath->mNodes);
-  mEdges.merge_with(aPath->mEdges);
+  SetEndNodes(aPath->mFrontNode, aPath->mBackNode);
 }
 
 
@@ -138,8 +136,7 @@ tmPath::tmPath(tmPoly* aPoly, tmNode* aNode1, tmNode* aNode2)  :
   mIsSubPath = true;
   
   // Set references
-  mNodes.push_back(aNode1);
-  mNodes.push_back(aNode2);
+  SetEndNodes(aNode1, aNode2);
 }
 
 
@@ -160,8 +157,7 @@ tmPath::tmPath(tmTree* aTree, tmNode* aNode1, tmNode* aNode2)
   mIsSubPath = true;
   
   // Set references
-  mNodes.push_back(aNode1);
-  mNodes.push_back(aNode2);
+  SetEndNodes(aNode1, aNode2);
 }
 
 
@@ -171,6 +167,7 @@ were attached to it. We rely on this behavior in many places.
 *****/
 tmPath::~tmPath()
 {
+  if (mPathOwner) mPathOwner->RemovePathFromIndex(this);
   if (mFwdPoly != 0) delete (tmPoly*) mFwdPoly;
   if (mBkdPoly != 0) delete (tmPoly*) mBkdPoly;
 }
@@ -182,7 +179,7 @@ only meaningful for leaf paths.
 *****/
 const tmPoint tmPath::GetVector() const
 {
-  return mNodes.back()->mLoc - mNodes.front()->mLoc;
+  return mBackNode->mLoc - mFrontNode->mLoc;
 }
 
 
@@ -191,7 +188,7 @@ Return the angle of this path in degrees. The value lies within [-180, 180].
 *****/
 const tmFloat tmPath::GetAngle() const
 {
-  return RADIAN * Angle(mNodes.back()->mLoc - mNodes.front()->mLoc);
+  return RADIAN * Angle(mBackNode->mLoc - mFrontNode->mLoc);
 }
 
 
@@ -234,14 +231,66 @@ end or the other or an assertion will fail in debug builds.
 *****/
 tmNode* tmPath::GetOtherNode(const tmNode* aNode) const
 {
-  if (aNode == mNodes.front()) return mNodes.back();
+  if (aNode == mFrontNode) return mBackNode;
   else {
-    TMASSERT(aNode == mNodes.back());
-    return mNodes.front();
+    TMASSERT(aNode == mBackNode);
+    return mFrontNode;
   }
 }
 
 
+/*****
+Put the nodes along this path into nodeList, in order from front to back. For
+a tree path, they're all the nodes along the tree between its ends; for a
+subpath, they're just its two ends.
+*****/
+void tmPath::GetNodes(tmArray<tmNode*>& nodeList) const
+{
+  if (IsTreePath())
+    mTree->GetPathRoute(mFrontNode, mBackNode, &nodeList, 0);
+  else {
+    nodeList.clear();
+    nodeList.push_back(mFrontNode);
+    nodeList.push_back(mBackNode);
+  }
+}
+
+
+/*****
+Put the edges along this path into edgeList, in order from front to back. For
+a subpath, the list is empty.
+*****/
+void tmPath::GetEdges(tmArray<tmEdge*>& edgeList) const
+{
+  if (IsTreePath())
+    mTree->GetPathRoute(mFrontNode, mBackNode, 0, &edgeList);
+  else
+    edgeList.clear();
+}
+
+
+/*****
+Return true if aNode is one of the nodes along this path (see GetNodes()).
+*****/
+bool tmPath::Contains(tmNode* aNode) const
+{
+  if (IsTreePath()) 
+    return mTree->PathRouteContains(mFrontNode, mBackNode, aNode);
+  return StartsOrEndsWith(aNode);
+}
+
+
+/*****
+Return true if aEdge is one of the edges along this path (see GetEdges()).
+*****/
+bool tmPath::Contains(tmEdge* aEdge) const
+{
+  if (IsTreePath()) 
+    return mTree->PathRouteContains(mFrontNode, mBackNode, aEdge);
+  return false;
+}
+
+
 /*****
 STATIC
 Copy all leaf paths from srcList into dstList.
@@ -255,9 +304,23 @@ void tmPath::FilterLeafPaths(tmArray<tmPath*>& dstList,
 }
 
 
+/*****
+Set the end nodes of this path, keeping the path index of our owner current.
+*****/
+void tmPath::SetEndNodes(tmNode* frontNode, tmNode* backNode)
+{
+  TMASSERT(mPathOwner);
+  mPathOwner->RemovePathFromIndex(this);
+  mFrontNode = frontNode;
+  mBackNode = backNode;
+  mPathOwner->AddPathToIndex(this);
+}
+
+
 /*****
 Calculate all of the length-like member variables for this tree path. Also set
-whether the path is valid and/or active based on the calculated lengths.
+whether the path is valid and/or active based on the calculated lengths. The
+tree distances must be current; see tmTree::GetPathDistances().
 *****/
 void tmPath::TreePathCalcLengths()
 {
@@ -266,16 +329,14 @@ void tmPath::TreePathCalcLengths()
   
   // compute the minimum length of each path based on the lengths of its edges 
   // and any strain that is present
-  mMinTreeLength = 0.0;
-  for (size_t i = 0; i < mEdges.size(); ++i)
-    mMinTreeLength += mEdges[i]->GetStrainedLength();
+  mMinTreeLength = mTree->mPathRoutes.GetDistance(mFrontNode, mBackNode);
   mMinPaperLength = mMinTreeLength * mTree->mScale;
   
   // compute the actual length of the path, based on the coordinates of its
   // nodes. this is only meaningful for leaf paths; for non-leaf paths we set
   // the length to an innocuous value, i.e., zero.
-  if (mIsLeafPath && mNodes.size() > 0)
-    mActPaperLength = Mag(mNodes.front()->mLoc - mNodes.back()->mLoc);
+  if (mIsLeafPath)
+    mActPaperLength = Mag(mFrontNode->mLoc - mBackNode->mLoc);
   else
     mActPaperLength = 0;
   mActTreeLength = mActPaperLength / mTree->mScale;
@@ -324,8 +385,8 @@ Return true if this path starts or ends on the given node.
 *****/
 bool tmPath::StartsOrEndsWith(tmNode* aNode) const
 {
-  if (mNodes.front() == aNode) return true;
-  if (mNodes.back() == aNode) return true;
+  if (mFrontNode == aNode) return true;
+  if (mBackNode == aNode) return true;
   return false;
 }
 
@@ -336,8 +397,8 @@ starts or ends with.
 *****/
 bool tmPath::SharesEndNodeWith(tmPath* aPath) const
 {
-  if (StartsOrEndsWith(aPath->mNodes.front())) return true;
-  if (StartsOrEndsWith(aPath->mNodes.back())) return true;
+  if (StartsOrEndsWith(aPath->mFrontNode)) return true;
+  if (StartsOrEndsWith(aPath->mBackNode)) return true;
   return false;
 }
 
@@ -349,10 +410,10 @@ endpoint.
 bool tmPath::IntersectsInterior(tmPath* aPath) const
 {
   if (SharesEndNodeWith(aPath)) return false;
-  const tmPoint& p = mNodes.front()->mLoc;
-  const tmPoint rp = mNodes.back()->mLoc - p;
-  const tmPoint& q = aPath->mNodes.front()->mLoc;
-  const tmPoint rq = aPath->mNodes.back()->mLoc - q;
+  const tmPoint& p = mFrontNode->mLoc;
+  const tmPoint rp = mBackNode->mLoc - p;
+  const tmPoint& q = aPath->mFrontNode->mLoc;
+  const tmPoint rq = aPath->mBackNode->mLoc - q;
   tmFloat tp, tq;
   if (!GetLineIntersectionParms(p, rp, q, rq, tp, tq)) return false;
   if (tp <= 0 || tp >= 1 || tq <= 0 || tq >= 1) return false;
@@ -380,8 +441,8 @@ tmVertex* tmPath::GetOrMakeVertex(const tmPoint& p, tmNode* aTreeNode)
 {
   tmVertex* theVertex = 0;
   
-  tmNode* frontNode = mNodes.front();
-  tmNode* backNode = mNodes.back();
+  tmNode* frontNode = mFrontNode;
+  tmNode* backNode = mBackNode;
   // Check front end of path
   if (tmVertex::VerticesSameLoc(p, frontNode->mLoc))
     theVertex = frontNode->GetOrMakeVertexSelf();
@@ -417,11 +478,12 @@ vertex creation before we create any creases owned by the path.
 tmVertex* tmPath::MakeVertex(const tmPoint& p, tmNode* aTreeNode)
 {
   // Create the new vertex and insert it into the list at the appropriate spot.
-  tmPoint& p1 = mNodes.front()->mLoc;
-  tmPoint& p2 = mNodes.back()->mLoc;
+  tmPoint& p1 = mFrontNode->mLoc;
+  tmPoint& p2 = mBackNode->mLoc;
   tmFloat dist_p = Mag(p - p1);
   tmFloat x = dist_p / Mag(p2 - p1);
-  tmFloat elevation = (1 - x) * mNodes.front()->mElevation + x * mNodes.back()->mElevation;
+  tmFloat elevation = 
+    (1 - x) * mFrontNode->mElevation + x * mBackNode->mElevation;
   tmVertex* theVertex;
   theVertex = new tmVertex(mTree, this, p, elevation, mIsBorderPath, aTreeNode);
   for (size_t i = 0; i < mOwnedVertices.size() - 1; ++i) {
@@ -469,7 +531,7 @@ front node doesn't have a vertex yet.
 *****/
 tmVertex* tmPath::GetFrontVertex() const
 {
-  return mNodes.front()->GetVertex();
+  return mFrontNode->GetVertex();
 }
 
 
@@ -480,7 +542,7 @@ doesn't have a vertex yet.
 *****/
 tmVertex* tmPath::GetBackVertex() const
 {
-  return mNodes.back()->GetVertex();
+  return mBackNode->GetVertex();
 }
 
 
@@ -497,8 +559,8 @@ void tmPath::BuildSelfVertices()
   TMASSERT(IsActivePath() || IsAxialPath());
 
   // Create the vertices at the ends of the path.
-  tmVertex* frontVertex = mNodes.front()->GetOrMakeVertexSelf();
-  tmVertex* backVertex = mNodes.back()->GetOrMakeVertexSelf();
+  tmVertex* frontVertex = mFrontNode->GetOrMakeVertexSelf();
+  tmVertex* backVertex = mBackNode->GetOrMakeVertexSelf();
 
   // If intermediate already exist, we don't need to do it again.
   if (mOwnedVertices.not_empty()) return;
@@ -517,10 +579,14 @@ void tmPath::BuildSelfVertices()
     tmFloat curPos = -maxFrontReduction;
     // Step through the nodes and edges of the path. Only create a vertex if
     // the position falls within the path.
-    TMASSERT(maxOutsetPath->mEdges.not_empty());
-    for (size_t i = 0; i < maxOutsetPath->mEdges.size(); ++i) {
-      tmNode* curNode = maxOutsetPath->mNodes[i + 1];
-      curPos += maxOutsetPath->mEdges[i]->GetStrainedScaledLength();
+    tmArray<tmNode*> outsetNodes;
+    tmArray<tmEdge*> outsetEdges;
+    maxOutsetPath->GetNodes(outsetNodes);
+    maxOutsetPath->GetEdges(outsetEdges);
+    TMASSERT(outsetEdges.not_empty());
+    for (size_t i = 0; i < outsetEdges.size(); ++i) {
+      tmNode* curNode = outsetNodes[i + 1];
+      curPos += outsetEdges[i]->GetStrainedScaledLength();
       if (curPos <= 0.0) continue;
       if (curPos >= mActPaperLength) break;
       GetOrMakeVertex(q1 + qu * curPos, curNode);
@@ -556,8 +622,8 @@ for this path.
 void tmPath::SetVertexDepth(tmVertex* aVertex) const
 {
   tmPoint p = aVertex->mLoc;
-  tmPoint p1 = mNodes.front()->mLoc;
-  tmPoint p2 = mNodes.back()->mLoc;
+  tmPoint p1 = mFrontNode->mLoc;
+  tmPoint p2 = mBackNode->mLoc;
   tmFloat d = Inner(p - p1, p2 - p1) / Mag(p2 - p1);
   if (d < mMinDepthDist)
     aVertex->mDepth = mMinDepth + mMinDepthDist - d;
@@ -609,6 +675,36 @@ void tmPath::GetNextCreaseAndVertex(tmCrease* aCrease, tmVertex* aVertex,
 }  
 
 
+/*****
+Put the nodes and edges along this path. Files still list them all, as they
+did when each path stored them, so that they can be read by any version.
+*****/
+void tmPath::PutRoute(ostream& os)
+{
+  tmArray<tmNode*> nodeList;
+  tmArray<tmEdge*> edgeList;
+  GetNodes(nodeList);
+  GetEdges(edgeList);
+  mTree->PutPtrArray(os, nodeList);
+  mTree->PutPtrArray(os, edgeList);
+}
+
+
+/*****
+Get the nodes and edges along this path, of which we only keep the ends.
+*****/
+void tmPath::GetRoute(istream& is)
+{
+  tmArray<tmNode*> nodeList;
+  tmArray<tmEdge*> edgeList;
+  mTree->GetPtrArray(is, nodeList);
+  mTree->GetPtrArray(is, edgeList);
+  TMASSERT(nodeList.size() >= 2);
+  mFrontNode = nodeList.front();
+  mBackNode = nodeList.back();
+}
+
+
 /*****
 Put a tmPath in version 5 format.
 *****/
@@ -629,8 +725,7 @@ void tmPath::Putv5Self(ostream& os)
   PutPOD(os, mIsConditionedPath);
   mTree->PutPtr(os, mFwdPoly);
   mTree->PutPtr(os, mBkdPoly);
-  mTree->PutPtrArray(os, mNodes);
-  mTree->PutPtrArray(os, mEdges);
+  PutRoute(os);
   mTree->PutPtr(os, mOutsetPath);
   PutPOD(os, mFrontReduction);
   PutPOD(os, mBackReduction);
@@ -662,8 +757,7 @@ void tmPath::Getv5Self(istream& is)
   GetPOD(is, mIsConditionedPath);  
   mTree->GetPtr(is, mFwdPoly, true);
   mTree->GetPtr(is, mBkdPoly, true);  
-  mTree->GetPtrArray(is, mNodes);
-  mTree->GetPtrArray(is, mEdges);
+  GetRoute(is);
   mTree->GetPtr(is, mOutsetPath, true);
   GetPOD(is, mFrontReduction);
   GetPOD(is, mBackReduction);
@@ -694,8 +788,7 @@ void tmPath::Putv4Self(ostream& os)
   PutPOD(os, 0);  // no mOwnedVertices
   PutPOD(os, 0);  // no mFwdPoly
   PutPOD(os, 0);  // no mBkdPoly
-  mTree->PutPtrArray(os, mNodes);
-  mTree->PutPtrArray(os, mEdges);
+  PutRoute(os);
   mTree->PutOwnerPtr(os, mPathOwner);
 }
 
@@ -718,8 +811,7 @@ void tmPath::Getv4Self(istream& is)
   mTree->GetPtrArray(is, mOwnedVertices);  
   mTree->GetPtr(is, mFwdPoly, true);
   mTree->GetPtr(is, mBkdPoly, true);  
-  mTree->GetPtrArray(is, mNodes);
-  mTree->GetPtrArray(is, mEdges);  
+  GetRoute(is);
   mTree->GetOwnerPtr(is, mPathOwner);
 }
 
@@ -762,8 +854,7 @@ void tmPath::Getv3Self(istream& is)
   mFwdPoly = 0;
   mBkdPoly = 0;
   
-  mTree->GetPtrArray(is, mNodes);
-  mTree->GetPtrArray(is, mEdges);
+  GetRoute(is);
   
   // Now create the tmCondition(s), if needed. 
   if (pathFixedLength && (mMinTreeLength == pathFixedLengthValue))
@@ -771,17 +862,19 @@ void tmPath::Getv3Self(istream& is)
   
   if (pathFixedAngle) {
     tmConditionPathAngleFixed* c = new tmConditionPathAngleFixed(mTree);
-    c->mNode1 = mNodes.front();
-    c->mNode2 = mNodes.back();
+    c->mNode1 = mFrontNode;
+    c->mNode2 = mBackNode;
     c->mAngle = pathFixedAngle;
   }
   
   // Calculate new fields of the tmPath  
+  mTree->GetPathDistances();
   TreePathCalcLengths();
   
   // Set ownership  
   mTree->mOwnedPaths.push_back(this);
   mPathOwner = mTree;
+  mPathOwner->AddPathToIndex(this);
 }
 
 
@@ -132,16 +132,18 @@ public:
     // tree length as the check, since the default (for all other values) is 0.
     return mMinTreeLength != 0.0;};
     
-  const tmDpptrArray<tmNode>& GetNodes() const {
-    // Returns the nodes that make up this path. If it's a major path, they're
-    // all the nodes along the tree path. If it's a subpath, then it will just
-    // contain the two endpoints of the path.
-    return mNodes;};
+  tmNode* GetFrontNode() const {
+    // Return the node at the front of this path.
+    return mFrontNode;};
     
-  const tmDpptrArray<tmEdge>& GetEdges() const {
-    // Returns the edges that make up this path in the same order as mNodes. If
-    // it's a subpath, this will be empty.
-    return mEdges;};
+  tmNode* GetBackNode() const {
+    // Return the node at the back of this path.
+    return mBackNode;};
+    
+  void GetNodes(tmArray<tmNode*>& nodeList) const;
+  void GetEdges(tmArray<tmEdge*>& edgeList) const;
+  bool Contains(tmNode* aNode) const;
+  bool Contains(tmEdge* aEdge) const;
     
   const tmDpptr<tmPoly>& GetFwdPoly() const {
     // Return the polygon to the left of this path when it is oriented from
@@ -206,9 +208,10 @@ private:
   bool mIsPolygonPath;
   bool mIsConditionedPath;
   
-  // Structural references
-  tmDpptrArray<tmNode> mNodes;
-  tmDpptrArray<tmEdge> mEdges;
+  // Structural references. Only the ends are stored; the nodes and edges in
+  // between are found from the tree when they're needed.
+  tmDpptr<tmNode> mFrontNode;
+  tmDpptr<tmNode> mBackNode;
   tmDpptr<tmPoly> mFwdPoly;
   tmDpptr<tmPoly> mBkdPoly;
   
@@ -223,6 +226,7 @@ private:
   
   // owner
   tmPathOwner* mPathOwner;
+  std::pair<std::size_t, std::size_t> mIndexKey;  // key in owner's index
 
   // Constructors
   void InitPath();
@@ -242,6 +246,7 @@ private:
   tmPoly* CreaseOwnerAsPoly() {return 0;};
 
   // Miscellaneous utilities
+  void SetEndNodes(tmNode* frontNode, tmNode* backNode);
   void TreePathCalcLengths();
   static bool TestIsFeasible(const tmFloat& actLen, const tmFloat& minLen);
   static bool TestIsActive(const tmFloat& actLen, const tmFloat& minLen);
@@ -261,6 +266,8 @@ private:
     tmCrease*& nextCrease, tmVertex*& nextVertex) const;
   
   // Stream I/O
+  void PutRoute(std::ostream& os);
+  void GetRoute(std::istream& is);
   void Putv5Self(std::ostream& os);
   void Getv5Self(std::istream& is);
   void Putv4Self(std::ostream& os);
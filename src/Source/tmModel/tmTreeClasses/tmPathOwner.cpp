@@ -17,7 +17,8 @@ using namespace std;
 Class tmPathOwner keeps a list of paths that it owns in a list; when this
 object is deleted, it automatically deletes all the objects in the list.
 Similarly, when a path is deleted, it tells its owner, which removes it from
-the list.
+the list. The owner also indexes its paths by their end nodes, so that the
+path between two nodes can be found without a search through the list.
 */
 
 /**********
@@ -32,19 +33,23 @@ Subclasses: tmPoly, tmTree
 
 
 /*****
-Return the path (if any) owned by this tmPathOwner that connects the two given
-nodes. If no path is found, return a null pointer. If we're only looking for
-leaf paths, this routine is more efficient than FindAnyPath(..) below; it's
-O(N).
+Return the leaf path (if any) owned by this tmPathOwner that connects the two
+given nodes. If no path is found, return a null pointer. Lookup goes through
+the path index, so it takes constant time unless node indices have collided
+since the last renumbering.
 *****/
 tmPath* tmPathOwner::FindLeafPath(tmNode* node1, tmNode* node2) const
 {
   TMASSERT(node1);
   TMASSERT(node2);
-  tmArray<tmPath*>& plist = node1->mLeafPaths;
-  for (size_t i = 0; i < plist.size(); ++i) {
-    tmPath* thePath = plist[i];
-    if (thePath->mNodes.front() == node2 || thePath->mNodes.back() == node2)
+  tmPath* thePath = GetIndexedPath(node1, node2);
+  if (thePath && thePath->mIsLeafPath) return thePath;
+  if (mPathIndexOverflow == 0) return 0;
+  for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
+    thePath = mOwnedPaths[i];
+    if (!thePath->mIsLeafPath) continue;
+    if ((thePath->mFrontNode == node1 && thePath->mBackNode == node2) ||
+      (thePath->mFrontNode == node2 && thePath->mBackNode == node1))
       return thePath;
   }
   return 0;
@@ -53,22 +58,24 @@ tmPath* tmPathOwner::FindLeafPath(tmNode* node1, tmNode* node2) const
 
 /*****
 Return the path (if any) owned by this tmPathOwner that connects the two given
-nodes. If no path is found, return a null pointer. This is less efficient than
-FindLeafPath (it's O(N^2) but it works for paths between non-leaf nodes.
-(However, it requires that mOwnedPaths exists, which is not the case during
-stream I/O.)
+nodes, which can be either leaf or branch nodes. If no path is found, return a
+null pointer. Lookup goes through the path index, so it takes constant time
+unless node indices have collided since the last renumbering. (However, during
+stream I/O the index isn't built until mOwnedPaths has been read.)
 *****/
 tmPath* tmPathOwner::FindAnyPath(tmNode* node1, tmNode* node2) const
 {
   TMASSERT(node1);
   TMASSERT(node2);
+  tmPath* thePath = GetIndexedPath(node1, node2);
+  if (thePath || mPathIndexOverflow == 0) return thePath;
   tmArrayIterator<tmPath*> i(mOwnedPaths);
   tmPath* aPath;
   while (i.Next(&aPath)) {
-    if ((aPath->mNodes.front() == node1) &&
-      (aPath->mNodes.back() == node2)) return aPath;
-    if ((aPath->mNodes.front() == node2) &&
-      (aPath->mNodes.back() == node1)) return aPath;
+    if ((aPath->mFrontNode == node1) &&
+      (aPath->mBackNode == node2)) return aPath;
+    if ((aPath->mFrontNode == node2) &&
+      (aPath->mBackNode == node1)) return aPath;
   }
   return 0;
 }
@@ -79,6 +86,15 @@ tmPath* tmPathOwner::FindAnyPath(tmNode* node1, tmNode* node2) const
 #endif
 
 
+/*****
+Constructor
+*****/
+tmPathOwner::tmPathOwner() : 
+  mPathIndexOverflow(0)
+{
+}
+
+
 /*****
 Destructor deletes all owned paths
 *****/
@@ -91,3 +107,81 @@ tmPathOwner::~tmPathOwner()
 #ifdef __MWERKS__
   #pragma mark --PRIVATE--
 #endif
+
+
+/*****
+STATIC
+Return the index key for a path between the two nodes: the higher node index
+first, then the lower. The key doesn't depend on the order of the nodes.
+*****/
+tmPathOwner::PathKey tmPathOwner::MakePathKey(tmNode* node1, tmNode* node2)
+{
+  size_t i1 = node1->GetIndex();
+  size_t i2 = node2->GetIndex();
+  if (i1 < i2) return PathKey(i2, i1);
+  return PathKey(i1, i2);
+}
+
+
+/*****
+Return the path in the index slot for the two nodes, if it connects them, or a
+null pointer otherwise.
+*****/
+tmPath* tmPathOwner::GetIndexedPath(tmNode* node1, tmNode* node2) const
+{
+  PathKey key = MakePathKey(node1, node2);
+  if (key.first >= mPathIndex.size()) return 0;
+  const vector<tmPath*>& row = mPathIndex[key.first];
+  if (key.second >= row.size()) return 0;
+  tmPath* thePath = row[key.second];
+  if (!thePath) return 0;
+  if ((thePath->mFrontNode == node1 && thePath->mBackNode == node2) ||
+    (thePath->mFrontNode == node2 && thePath->mBackNode == node1))
+    return thePath;
+  return 0;
+}
+
+
+/*****
+Add a path to the index under its current end nodes. The path remembers its
+key so that it can be removed even after its end nodes have been deleted. If
+the slot is already taken, the path is left out of the index and found by
+search until the next rebuild.
+*****/
+void tmPathOwner::AddPathToIndex(tmPath* aPath)
+{
+  aPath->mIndexKey = MakePathKey(aPath->mFrontNode, aPath->mBackNode);
+  size_t i1 = aPath->mIndexKey.first;
+  size_t i2 = aPath->mIndexKey.second;
+  if (i1 >= mPathIndex.size()) mPathIndex.resize(i1 + 1);
+  vector<tmPath*>& row = mPathIndex[i1];
+  if (i2 >= row.size()) row.resize(i2 + 1, 0);
+  if (row[i2]) ++mPathIndexOverflow;
+  else row[i2] = aPath;
+}
+
+
+/*****
+Remove a path from the index, if it's there.
+*****/
+void tmPathOwner::RemovePathFromIndex(tmPath* aPath)
+{
+  size_t i1 = aPath->mIndexKey.first;
+  size_t i2 = aPath->mIndexKey.second;
+  if (i1 >= mPathIndex.size()) return;
+  vector<tmPath*>& row = mPathIndex[i1];
+  if (i2 < row.size() && row[i2] == aPath) row[i2] = 0;
+}
+
+
+/*****
+Rebuild the index from scratch. This is needed after stream I/O, which fills
+in mOwnedPaths directly, and after the tree renumbers its nodes.
+*****/
+void tmPathOwner::RebuildPathIndex()
+{
+  mPathIndex.clear();
+  mPathIndexOverflow = 0;
+  for (size_t i = 0; i < mOwnedPaths.size(); ++i)
+    AddPathToIndex(mOwnedPaths[i]);
+}
@@ -14,6 +14,10 @@ Copyright:    
 // Common TreeMaker header
 #include "tmHeader.h"
 
+// Standard libraries
+#include <utility>
+#include <vector>
+
 // TreeMaker classes
 #include "tmModel_fwd.h"
 #include "tmDpptrArray.h"
@@ -35,12 +39,30 @@ public:
   tmPath* FindAnyPath(tmNode* node1, tmNode* node2) const;
   
 protected:
+  tmPathOwner();
   virtual ~tmPathOwner();
   virtual tmTree* PathOwnerAsTree() = 0;
   virtual tmPoly* PathOwnerAsPoly() = 0;
   
 private:
+  // Index of owned paths keyed by the indices of their end nodes, which is
+  // kept up to date as paths are created, deleted, or have their ends moved.
+  // Row i holds the paths whose higher-numbered node has index i; within a
+  // row, a path sits in the slot of its lower-numbered node. Node indices can
+  // collide between an edit and the next renumbering, so a path that finds its
+  // slot taken is counted in mPathIndexOverflow and found by a search instead.
+  typedef std::pair<std::size_t, std::size_t> PathKey;
+  typedef std::vector<std::vector<tmPath*> > PathIndex;
+  
   tmDpptrArray<tmPath> mOwnedPaths;
+  PathIndex mPathIndex;
+  std::size_t mPathIndexOverflow;
+  
+  static PathKey MakePathKey(tmNode* node1, tmNode* node2);
+  tmPath* GetIndexedPath(tmNode* node1, tmNode* node2) const;
+  void AddPathToIndex(tmPath* aPath);
+  void RemovePathFromIndex(tmPath* aPath);
+  void RebuildPathIndex();
   
   friend class tmTree;
   friend class tmPath;
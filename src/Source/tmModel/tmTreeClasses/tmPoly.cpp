@@ -115,8 +115,8 @@ bool tmPoly::ConvexEncloses(tmPoint p) const
   size_t nmax = mRingPaths.size();
   for (size_t i = 0; i < nmax; ++i) {
     tmPath* aPath = mRingPaths[i];
-    tmPoint p1 = aPath->mNodes.front()->mLoc;
-    tmPoint p2 = aPath->mNodes.back()->mLoc;
+    tmPoint p1 = aPath->mFrontNode->mLoc;
+    tmPoint p2 = aPath->mBackNode->mLoc;
     tmPoint q = RotateCCW90(p2 - p1);
     if (Inner(mCentroid - p1, q) < 0) q *= -1;
     if (Inner(p - p1, q) < 0) {
@@ -144,10 +144,12 @@ void tmPoly::GetSubTree(tmArray<tmNode*>& nlist, tmArray<tmEdge*>& elist) const
 {
   nlist.clear();
   elist.clear();
+  tmArray<tmEdge*> pathEdges;
   for (size_t i = 0; i < mRingPaths.size(); ++i) {
     tmPath* thePath = mRingPaths[i];
-    for (size_t j = 0; j < thePath->mEdges.size(); ++j) {
-      tmEdge* theEdge = thePath->mEdges[j];
+    thePath->GetEdges(pathEdges);
+    for (size_t j = 0; j < pathEdges.size(); ++j) {
+      tmEdge* theEdge = pathEdges[j];
       if (!elist.contains(theEdge)) {
         elist.push_back(theEdge);
         nlist.union_with(theEdge->mNodes.front());
@@ -166,7 +168,7 @@ bool tmPoly::SubTreeContains(tmNode* aNode) const
   TMASSERT(aNode->IsTreeNode());
   for (size_t i = 0; i < mRingPaths.size(); ++i) {
     tmPath* thePath = mRingPaths[i];
-    if (thePath->mNodes.contains(aNode)) return true;
+    if (thePath->Contains(aNode)) return true;
   }
   return false;
 }
@@ -179,7 +181,7 @@ bool tmPoly::SubTreeContains(tmEdge* aEdge) const
 {
   for (size_t i = 0; i < mRingPaths.size(); ++i) {
     tmPath* thePath = mRingPaths[i];
-    if (thePath->mEdges.contains(aEdge)) return true;
+    if (thePath->Contains(aEdge)) return true;
   }
   return false;
 }
@@ -579,7 +581,7 @@ Construct a sorted list of the vertices along the ridgeline above the path that
 connects the two given nodes. We specify the nodes, rather than just passing a
 tmPath*, because we need the nodes properly ordered for the call to
 BuildRidgelineNodesAndPaths(); frontNode is not
-necessarily thePath->mNodes.front(). This is used in two places in
+necessarily thePath->mFrontNode. This is used in two places in
 BuildPolyContents(). Note the use of struct SortableRidgeVertex for sorting
 vertices.
 *****/
@@ -653,6 +655,20 @@ bool tmPoly::HasPolyContents()
 }
 
 
+/*****
+Return the minimum paper length of the path between two of our ring nodes. If
+they're tree nodes (as they are in a top-level poly), that's their distance in
+the tree, which takes constant time to find; otherwise they're inset nodes, and
+the reduced length is kept by the inset path between them.
+*****/
+tmFloat tmPoly::GetRingPathLength(tmNode* node1, tmNode* node2) const
+{
+  if (node1->IsTreeNode() && node2->IsTreeNode())
+    return mTree->mPathRoutes.GetDistance(node1, node2) * mTree->mScale;
+  return mPolyOwner->FindAnyPath(node1, node2)->mMinPaperLength;
+}
+
+
 /*****
 Build the contents of this tmPoly and its subPolys. This routine gets called
 after a tmPoly has been created with at least three sides. Note that subpolys
@@ -797,8 +813,7 @@ void tmPoly::BuildPolyContents()
           // Note that if the reduced path length comes out to be negative,
           // we've found a spurious solution; so we have to detect and
           // eliminate that case.
-          tmFloat lij = mPolyOwner->FindAnyPath(mRingNodes[i], 
-            mRingNodes[j])->mMinPaperLength;
+          tmFloat lij = GetRingPathLength(mRingNodes[i], mRingNodes[j]);
           tmPoint u = ni - nj;
           tmPoint v = r[i] - r[j];
           tmFloat w = mr[i] + mr[j];
@@ -907,8 +922,9 @@ void tmPoly::BuildPolyContents()
           if (rni == rnj) continue;
           
           // If a path already exists between the two inset nodes go on to the
-          // next pair.
-          if (FindLeafPath(rni, rnj)) continue;
+          // next pair. At this point the only paths we own are the inset
+          // paths, so any path between them will do.
+          if (FindAnyPath(rni, rnj)) continue;
           
           // if we didn't find it, need to create a new path.
           tmPath* outsetPath = mPolyOwner->FindAnyPath(ni, nj);
@@ -919,7 +935,7 @@ void tmPoly::BuildPolyContents()
           // When we create the new path, we want it in the same orientation as
           // the path from which it is inset, so order of rni, rnj is important.
           tmPath* thePath;
-          if (outsetPath->mNodes.front() == ni) {
+          if (outsetPath->mFrontNode == ni) {
             // rni should be front node
             thePath = new tmPath(this, rni, rnj);
             thePath->mFrontReduction = iReduction;
@@ -938,7 +954,7 @@ void tmPoly::BuildPolyContents()
           
           // Set length-related variables
           thePath->mOutsetPath = outsetPath;
-          thePath->mMinPaperLength = outsetPath->mMinPaperLength -
+          thePath->mMinPaperLength = GetRingPathLength(ni, nj) -
             (thePath->mFrontReduction + thePath->mBackReduction);
           thePath->mActPaperLength = Mag((rni->mLoc) - (rnj->mLoc));
           thePath->mMinTreeLength = thePath->mMinPaperLength / mTree->mScale;
@@ -1027,8 +1043,8 @@ void tmPoly::BuildPolyContents()
         tmVertex* botVertex = thePath->mOwnedVertices[j];
         for (size_t k = 0; k < ridgePaths.size(); ++k) {
           tmPath* ridgePath = ridgePaths[k];
-          tmNode* nq1 = ridgePath->mNodes.front();
-          tmNode* nq2 = ridgePath->mNodes.back();
+          tmNode* nq1 = ridgePath->mFrontNode;
+          tmNode* nq2 = ridgePath->mBackNode;
           tmPoint& q1 = nq1->mLoc;
           tmPoint& q2 = nq2->mLoc;
           tmPoint q;
@@ -1451,6 +1467,7 @@ void tmPoly::Getv5Self(istream& is)
   mTree->GetPtrArray(is, mLocalRootCreases);
   mTree->GetPtrArray(is, mOwnedNodes);
   mTree->GetPtrArray(is, mOwnedPaths);
+  RebuildPathIndex();
   mTree->GetPtrArray(is, mOwnedPolys);
   mTree->GetPtrArray(is, mOwnedCreases);
   mTree->GetPtrArray(is, mOwnedFacets);
@@ -1479,6 +1496,7 @@ void tmPoly::Getv4Self(istream& is)
   GetPOD(is, mIsSubPoly);
   mTree->GetPtrArray(is, mOwnedNodes);
   mTree->GetPtrArray(is, mOwnedPaths);
+  RebuildPathIndex();
   mTree->GetPtrArray(is, mOwnedPolys);
   mTree->GetPtrArray(is, mOwnedCreases);
   mTree->GetPtrArray(is, mRingNodes);
@@ -197,6 +197,7 @@ private:
   void GetRidgelineVertices(tmNode* frontNode, tmNode* backNode, 
     tmArray<tmVertex*>& ridgeVertices);
   bool HasPolyContents();
+  tmFloat GetRingPathLength(tmNode* node1, tmNode* node2) const;
   void BuildPolyContents();
   std::size_t GetNumInactiveBorderPaths();
   void SetFacetCorridorEdge(tmFacet* aFacet, tmEdge* aEdge);
@@ -74,8 +74,8 @@ bool tmPolyOwner::CanStartPolyFwd(tmPath* aPath, const tmPoint& centroid)
 {
   if (aPath->mFwdPoly != 0) return false;
   if (!aPath->IsBorderPath()) return true;
-  return AreCCW(aPath->mNodes.front()->mLoc, 
-    aPath->mNodes.back()->mLoc, centroid);
+  return AreCCW(aPath->mFrontNode->mLoc, 
+    aPath->mBackNode->mLoc, centroid);
 }  
 
 
@@ -87,8 +87,8 @@ bool tmPolyOwner::CanStartPolyBkd(tmPath* aPath, const tmPoint& centroid)
 {
   if (aPath->mBkdPoly != 0) return false;
   if (!aPath->IsBorderPath()) return true;
-  return AreCW(aPath->mNodes.front()->mLoc, 
-    aPath->mNodes.back()->mLoc, centroid);
+  return AreCW(aPath->mFrontNode->mLoc, 
+    aPath->mBackNode->mLoc, centroid);
 }  
 
 
@@ -101,8 +101,8 @@ void tmPolyOwner::GetNextPathAndNode(tmPath* thisPath, tmNode* thisNode,
   tmPath*& nextPath, tmNode*& nextNode)
 {
   // Get the angle of thisPath.
-  tmNode* thatNode = thisPath->mNodes.front();
-  if (thatNode == thisNode) thatNode = thisPath->mNodes.back();
+  tmNode* thatNode = thisPath->mFrontNode;
+  if (thatNode == thisNode) thatNode = thisPath->mBackNode;
   tmFloat thisAngle = Angle(thatNode->mLoc - thisNode->mLoc);
   
   // delta is the increment in angle from thisPath to nextPath. Start with the
@@ -118,8 +118,8 @@ void tmPolyOwner::GetNextPathAndNode(tmPath* thisPath, tmNode* thisNode,
     
     // Get the angle of thatPath and the tmNode at the other end of thatPath
     // (thatNode).
-    thatNode = thatPath->mNodes.front();
-    if (thatNode == thisNode) thatNode = thatPath->mNodes.back();
+    thatNode = thatPath->mFrontNode;
+    if (thatNode == thisNode) thatNode = thatPath->mBackNode;
     tmFloat nextAngle = Angle(thatNode->mLoc - thisNode->mLoc);
     
     // Find the angular increment to the new path. Constrain it to lie
@@ -202,9 +202,9 @@ void tmPolyOwner::BuildPolysFromPaths(tmArray<tmPath*>& aPathList,
     if (CanStartPolyFwd(aPath, centroid)) {
       // build up a poly in the forward direction
       aPath->mFwdPoly = aPoly = new tmPoly(aPath->mTree, this);
-      firstNode = aPath->mNodes.front();
+      firstNode = aPath->mFrontNode;
       thisPath = aPath;
-      thisNode = aPath->mNodes.back();
+      thisNode = aPath->mBackNode;
       aPoly->mRingNodes.push_back(firstNode);
       aPoly->mRingPaths.push_back(thisPath);
       size_t tooMany = 0;
@@ -212,7 +212,7 @@ void tmPolyOwner::BuildPolysFromPaths(tmArray<tmPath*>& aPathList,
         GetNextPathAndNode(thisPath, thisNode, nextPath, nextNode);
         aPoly->mRingNodes.push_back(thisNode);
         aPoly->mRingPaths.push_back(nextPath);
-        if (nextPath->mNodes.front() == thisNode) nextPath->mFwdPoly = aPoly;
+        if (nextPath->mFrontNode == thisNode) nextPath->mFwdPoly = aPoly;
         else nextPath->mBkdPoly = aPoly;
         thisPath = nextPath;
         thisNode = nextNode;
@@ -224,9 +224,9 @@ void tmPolyOwner::BuildPolysFromPaths(tmArray<tmPath*>& aPathList,
     if (CanStartPolyBkd(aPath, centroid)) {
       // build up a poly in the backward direction
       aPath->mBkdPoly = aPoly = new tmPoly(aPath->mTree, this);
-      firstNode = aPath->mNodes.back();
+      firstNode = aPath->mBackNode;
       thisPath = aPath;
-      thisNode = aPath->mNodes.front();
+      thisNode = aPath->mFrontNode;
       aPoly->mRingNodes.push_back(firstNode);
       aPoly->mRingPaths.push_back(thisPath);
       size_t tooMany = 0;
@@ -234,7 +234,7 @@ void tmPolyOwner::BuildPolysFromPaths(tmArray<tmPath*>& aPathList,
         GetNextPathAndNode(thisPath, thisNode, nextPath, nextNode);
         aPoly->mRingNodes.push_back(thisNode);
         aPoly->mRingPaths.push_back(nextPath);
-        if (nextPath->mNodes.front() == thisNode) nextPath->mFwdPoly = aPoly;
+        if (nextPath->mFrontNode == thisNode) nextPath->mFwdPoly = aPoly;
         else nextPath->mBkdPoly = aPoly;
         thisPath = nextPath;
         thisNode = nextNode;
@@ -15,6 +15,7 @@ Copyright:    
   #include <fstream>
 #endif
 #include <algorithm>
+#include <set>
 
 using namespace std;
 
@@ -98,7 +99,7 @@ Change the scale of the tree.
 void tmTree::SetScale(const tmFloat& aScale)
 {
   if (mScale == aScale) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   mScale = aScale;
 }
 
@@ -276,37 +277,38 @@ tmEdge* tmTree::GetEdge(const tmNode* node1, const tmNode* node2) const
 
 /*****
 Return the path that connects these two nodes, which can be either leaf or
-branch nodes. This is not terribly efficient because it requires a search
-through all paths, which is O(N^2).
+branch nodes. Paths between tree nodes are owned by the tree; paths that touch
+an inset node are owned by the poly that owns that node. Either way, it's found
+through the path index of its owner.
 *****/
 tmPath* tmTree::GetPath(const tmNode* node1, const tmNode* node2) const
 {
-  for (size_t i = 0; i < mPaths.size(); ++i) {
-    tmPath* thePath = mPaths[i];
-    if ((thePath->mNodes.front() == node1 && thePath->mNodes.back() == node2) ||
-      (thePath->mNodes.front() == node2 && thePath->mNodes.back() == node1))
-      return thePath;
-  }
+  tmNode* n1 = const_cast<tmNode*>(node1);
+  tmNode* n2 = const_cast<tmNode*>(node2);
+  tmPath* thePath = FindAnyPath(n1, n2);
+  if (thePath) return thePath;
+  tmPoly* thePoly = n1->GetOwnerAsPoly();
+  if (thePoly && (thePath = thePoly->FindAnyPath(n1, n2)) != 0) 
+    return thePath;
+  thePoly = n2->GetOwnerAsPoly();
+  if (thePoly && (thePath = thePoly->FindAnyPath(n1, n2)) != 0) 
+    return thePath;
   TMFAIL("GetPath() failed to find a path between the two nodes.");
   return NULL;
 }
 
 
 /*****
-Return the path that connects these two nodes, which must be leaf nodes. This
-is considerably more efficient than GetPath() because we only search through a
-subset of the total paths, so it's O(N).
+Return the path that connects these two nodes, which must be leaf nodes.
 *****/
 tmPath* tmTree::GetLeafPath(const tmNode* leafNode1, 
   const tmNode* leafNode2) const
 {
   TMASSERT(leafNode1->IsLeafNode());
   TMASSERT(leafNode2->IsLeafNode());
-  const tmArray<tmPath*>& n1paths = leafNode1->mLeafPaths;
-  for (size_t i = 0; i < n1paths.size(); ++i) {
-    tmPath* aPath = n1paths[i];
-    if (aPath->GetOtherNode(leafNode1) == leafNode2) return aPath;
-  }
+  tmPath* aPath = FindLeafPath(const_cast<tmNode*>(leafNode1), 
+    const_cast<tmNode*>(leafNode2));
+  if (aPath) return aPath;
   TMFAIL("GetLeafPath() failed to find a leaf path between the two nodes.");
   return NULL;
 }
@@ -451,21 +453,19 @@ void tmTree::AddNode(tmNode* fromNode, const tmPoint& where,
   fromNode->mLeafPaths.clear();
 
   // Build all new paths that include this tmNode by cloning old ones that end
-  // on fromNode and adding the new tmNode and edge to the end of the cloned
-  // path. We'll also take this opportunity to update the tmNode::mLeafPaths
-  // list of leaf paths for affected nodes. To avoid wasting time checking
-  // newly-created paths, we'll start at the end and work backward toward the
-  // beginning.
+  // on fromNode and moving that end of the cloned path to the new tmNode. We'll
+  // also take this opportunity to update the tmNode::mLeafPaths list of leaf
+  // paths for affected nodes. To avoid wasting time checking newly-created
+  // paths, we'll start at the end and work backward toward the beginning.
   tmArrayIterator<tmPath*> iOwnedPaths(mOwnedPaths, tmArray_END);
   tmPath* newPath;
   tmNode* otherNode;
   tmPath* aPath;
   while (iOwnedPaths.Previous(&aPath)) {
-    if (aPath->mNodes.front() == fromNode) {
+    if (aPath->mFrontNode == fromNode) {
       newPath = new tmPath(this, aPath);
-      newPath->mNodes.push_front(newNode);
-      newPath->mEdges.push_front(newEdge);
-      otherNode = aPath->mNodes.back();
+      otherNode = aPath->mBackNode;
+      newPath->SetEndNodes(newNode, otherNode);
       if (otherNode->IsLeafNode()) {
         if (fromNode->IsLeafNode()) otherNode->mLeafPaths.erase_remove(aPath);
         otherNode->mLeafPaths.push_back(newPath);
@@ -473,11 +473,10 @@ void tmTree::AddNode(tmNode* fromNode, const tmPoint& where,
         newNode->mLeafPaths.push_back(newPath);
       }
     }
-    else if (aPath->mNodes.back() == fromNode) {
+    else if (aPath->mBackNode == fromNode) {
       newPath = new tmPath(this, aPath);
-      newPath->mNodes.push_back(newNode);
-      newPath->mEdges.push_back(newEdge);
-      otherNode = aPath->mNodes.front();
+      otherNode = aPath->mFrontNode;
+      newPath->SetEndNodes(otherNode, newNode);
       if (otherNode->IsLeafNode()) {
         if (fromNode->IsLeafNode()) otherNode->mLeafPaths.erase_remove(aPath);
         otherNode->mLeafPaths.push_back(newPath);
@@ -528,6 +527,23 @@ void tmTree::SplitEdge(tmEdge* aEdge, const tmFloat& splitLoc, tmNode*& newNode)
   if ((splitLoc <= 0) || (splitLoc >= aEdge->GetStrainedLength())) 
     throw EX_BAD_SPLIT_EDGE();
   
+  // Find the paths that start or stop on one of the end nodes and that don't
+  // contain the splitting edge; each of them will be cloned to make a path
+  // that starts or stops on the new tmNode. This has to happen before the new
+  // edges are added, since until aEdge is deleted, there are two routes from
+  // node1 to node2.
+  tmArray<tmPath*> clonedPaths;
+  for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
+    tmPath* aPath = mOwnedPaths[i];
+    tmNode* nodeA = aPath->mFrontNode;
+    tmNode* nodeB = aPath->mBackNode;
+    if ((nodeA == node1) || (nodeA == node2) || (nodeB == node1) || 
+      (nodeB == node2)) {
+      if (aPath->Contains(aEdge)) continue;
+      clonedPaths.push_back(aPath);
+    }
+  }
+  
   // create the tmNode and add it to the tree
   tmPoint where = ((aEdge->GetStrainedLength() - splitLoc) * node1->mLoc +
     splitLoc * node2->mLoc) / aEdge->GetStrainedLength();
@@ -548,38 +564,29 @@ void tmTree::SplitEdge(tmEdge* aEdge, const tmFloat& splitLoc, tmNode*& newNode)
   edge2->mStiffness = aEdge->mStiffness;
   
   // We need to create all of the new paths that start or stop on the new
-  // tmNode. We'll do this by cloning paths that start or stop on one of the
-  // end nodes (and that don't contain the splitting edge), then add the new
-  // tmNode and the appropriate edge to the path.
-  tmArrayIterator<tmPath*> iOwnedPaths(mOwnedPaths);
-  tmPath *aPath, *newPath;
-  while (iOwnedPaths.Next(&aPath)) {
-    tmNode* nodeA = aPath->mNodes.front();
-    tmNode* nodeB = aPath->mNodes.back();
-    if ((nodeA == node1) || (nodeA == node2) || (nodeB == node1) || 
-      (nodeB == node2)) {
-      if (aPath->mEdges.contains(aEdge)) continue;
-      newPath = new tmPath(this, aPath);
-      if (nodeA == node1) {
-        newPath->mNodes.push_front(newNode);
-        newPath->mEdges.push_front(edge1);
-        newPath->mMinTreeLength += edge1->mLength;
-      }
-      else if (nodeA == node2) {
-        newPath->mNodes.push_front(newNode);
-        newPath->mEdges.push_front(edge2);
-        newPath->mMinTreeLength += edge2->mLength;
-      }
-      else if (nodeB == node1) {
-        newPath->mNodes.push_back(newNode);
-        newPath->mEdges.push_back(edge1);
-        newPath->mMinTreeLength += edge1->mLength;
-      }
-      else /* if (nodeB == node2) */ {
-        newPath->mNodes.push_back(newNode);
-        newPath->mEdges.push_back(edge2);
-        newPath->mMinTreeLength += edge2->mLength;
-      }
+  // tmNode. We'll do this by cloning the paths found above, then moving the
+  // end that was on node1 or node2 to the new tmNode.
+  tmPath* newPath;
+  for (size_t i = 0; i < clonedPaths.size(); ++i) {
+    tmPath* aPath = clonedPaths[i];
+    tmNode* nodeA = aPath->mFrontNode;
+    tmNode* nodeB = aPath->mBackNode;
+    newPath = new tmPath(this, aPath);
+    if (nodeA == node1) {
+      newPath->SetEndNodes(newNode, nodeB);
+      newPath->mMinTreeLength += edge1->mLength;
+    }
+    else if (nodeA == node2) {
+      newPath->SetEndNodes(newNode, nodeB);
+      newPath->mMinTreeLength += edge2->mLength;
+    }
+    else if (nodeB == node1) {
+      newPath->SetEndNodes(nodeA, newNode);
+      newPath->mMinTreeLength += edge1->mLength;
+    }
+    else /* if (nodeB == node2) */ {
+      newPath->SetEndNodes(nodeA, newNode);
+      newPath->mMinTreeLength += edge2->mLength;
     }
   }
   
@@ -588,34 +595,9 @@ void tmTree::SplitEdge(tmEdge* aEdge, const tmFloat& splitLoc, tmNode*& newNode)
   newPath = new tmPath(this, edge1);  
   newPath = new tmPath(this, edge2);
   
-  // Now clean up references to nodes and edges in existing paths. In each path, 
-  // we'll replace any occurence of aEdge with the new edges AND we'll insert
-  // the new tmNode into the list of nodes. 
-  iOwnedPaths.ResetTo(tmArray_START);
-  while (iOwnedPaths.Next(&aPath)) {
-    size_t ne = aPath->mEdges.GetIndex(aEdge);
-    if (ne == aPath->mEdges.BAD_INDEX) continue;
-    size_t nn1 = aPath->mNodes.GetIndex(node1);
-    size_t nn2 = aPath->mNodes.GetIndex(node2);
-  
-    // Now, remove the old edge and replace it with the new ones. The order
-    // of replacement depends on the order of the nodes.    
-    aPath->mEdges.erase_remove(aEdge);
-    
-    if (nn2 == nn1 + 1) {
-      aPath->mEdges.InsertItemAt(ne, edge1);
-      aPath->mEdges.InsertItemAt(ne + 1, edge2);
-      aPath->mNodes.InsertItemAt(nn2, newNode);
-    }
-    else /* if (nn1 == nn2 + 1) */ {
-      aPath->mEdges.InsertItemAt(ne, edge2);
-      aPath->mEdges.InsertItemAt(ne + 1, edge1);
-      aPath->mNodes.InsertItemAt(nn1, newNode);
-    }
-  }
-  
   // Now get rid of the old edge. Use of tmDpptr classes automatically removes
-  // potentially dangling references to aEdge.  
+  // potentially dangling references to aEdge. Existing paths that ran along
+  // aEdge now run through the new tmNode, which they get from the tree.
   delete aEdge;
 }
 
@@ -666,22 +648,14 @@ void tmTree::AbsorbNode(tmNode* aNode, tmEdge*& newEdge)
   newEdge = new tmEdge(this, node1, node2);
   newEdge->mLength = edge1->GetStrainedLength() + edge2->GetStrainedLength();
   
-  // Delete all paths that start or stop on the absorbed tmNode
+  // Delete all paths that start or stop on the absorbed tmNode. Paths that ran
+  // through it will run along the new edge once the old ones are gone.
   for (size_t i = mOwnedPaths.size(); i > 0; --i) {
     tmPath* thePath = mOwnedPaths[i - 1];
-    if ((thePath->mNodes.front() == aNode) || (thePath->mNodes.back() == aNode))
+    if (thePath->StartsOrEndsWith(aNode))
       delete thePath;
   }
   
-  // In any paths that contained both edges, replace one of the edges with the
-  // new edge; references to the other edge will be removed (through the magic
-  // of tmDpptrArray<T>) when we delete the two edges and the node.
-  for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
-    tmPath* thePath = mOwnedPaths[i];
-    if ((thePath->mEdges.contains(edge1)) && (thePath->mEdges.contains(edge2)))
-      thePath->mEdges.replace_with(edge1, newEdge);
-  }
-  
   // Delete the absorbed node and associated edges. 
   delete aNode;
   delete edge1;
@@ -770,25 +744,13 @@ void tmTree::AbsorbEdge(tmEdge* aEdge)
   // out any crease pattern).
   KillPolysAndCreasePattern();
   
-  // First, get rid of superfluous paths, working backwards since
-  // we're deleting some items as we go.
+  // First, get rid of superfluous paths, i.e., paths that end on killNode,
+  // working backwards since we're deleting some items as we go. Paths that
+  // ran through killNode or along aEdge will run through keepNode instead.
   for (size_t i = mOwnedPaths.size(); i > 0; --i) {
     tmPath* thePath = mOwnedPaths[i - 1];
-    // Paths that end on killNode are deleted.
     if (thePath->StartsOrEndsWith(killNode))
       delete thePath;
-    else if (thePath->mNodes.contains(killNode))
-      if (thePath->mNodes.contains(keepNode))
-        // Paths that contain killNode and keepNode get the reference to 
-        // killNode removed. 
-        thePath->mNodes.erase_remove(killNode);
-      else
-        // Paths that only contain killNode get the reference replaced by
-        // a reference to keepNode.
-        thePath->mNodes.replace_with(killNode, keepNode);
-    // Remove the edge from the path
-    if (thePath->mEdges.contains(aEdge))
-      thePath->mEdges.erase_remove(aEdge);
   }
   
   // Now for all edges, replace any references to killNode with keepNode.
@@ -817,8 +779,8 @@ void tmTree::AbsorbEdge(tmEdge* aEdge)
     keepNode->mLeafPaths.clear();
   for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
     tmPath* thePath = mOwnedPaths[i];
-    tmNode* frontNode = thePath->mNodes.front();
-    tmNode* backNode = thePath->mNodes.back();
+    tmNode* frontNode = thePath->mFrontNode;
+    tmNode* backNode = thePath->mBackNode;
     if (frontNode == keepNode || backNode == keepNode) {
       thePath->mIsLeafPath = (frontNode->mIsLeafNode && backNode->mIsLeafNode);
       if (thePath->mIsLeafPath)
@@ -969,23 +931,50 @@ void tmTree::KillSomeNodesAndEdges(tmArray<tmNode*>& markedNodes,
     if (!saveNode) delNodes.union_with(theNode);
   }
   
-  // Also make a list of all Paths that get killed. Note: when a tmPath is
+  // Check validity of deletion: we don't allow a deletion that would break the
+  // tree into two or more pieces, i.e., every node that's left must still be
+  // reachable from the first one that's left along edges that are left.
+  vector<tmNode*> sortedDelNodes(delNodes.begin(), delNodes.end());
+  vector<tmEdge*> sortedDelEdges(delEdges.begin(), delEdges.end());
+  sort(sortedDelNodes.begin(), sortedDelNodes.end());
+  sort(sortedDelEdges.begin(), sortedDelEdges.end());
+  size_t nodesLeft = mOwnedNodes.size() - delNodes.size();
+  set<tmNode*> nodesReached;
+  vector<tmNode*> nodesToVisit;
+  for (size_t i = 0; i < mOwnedNodes.size(); ++i) {
+    tmNode* theNode = mOwnedNodes[i];
+    if (binary_search(sortedDelNodes.begin(), sortedDelNodes.end(), theNode))
+      continue;
+    nodesReached.insert(theNode);
+    nodesToVisit.push_back(theNode);
+    break;
+  }
+  while (!nodesToVisit.empty()) {
+    tmNode* theNode = nodesToVisit.back();
+    nodesToVisit.pop_back();
+    for (size_t j = 0; j < theNode->mEdges.size(); ++j) {
+      tmEdge* theEdge = theNode->mEdges[j];
+      if (binary_search(sortedDelEdges.begin(), sortedDelEdges.end(), theEdge))
+        continue;
+      tmNode* nextNode = theEdge->GetOtherNode(theNode);
+      if (nodesReached.insert(nextNode).second)
+        nodesToVisit.push_back(nextNode);
+    }
+  }
+  if (nodesReached.size() != nodesLeft) throw EX_BAD_KILL_PARTS();
+  
+  // Also make a list of all Paths that get killed, which are those that start
+  // or stop on a marked tmNode; since the tree stays in one piece, no other
+  // path runs through a marked tmNode or tmEdge. Note: when a tmPath is
   // killed, it automatically kills any Polys that it's connected to.
   tmArray<tmPath*> delPaths;
-  
-  // If any path contains a marked tmNode or tmEdge, then that path should be
-  // killed.
   for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
     tmPath* thePath = mOwnedPaths[i];
-    if (thePath->mNodes.intersects(delNodes) ||
-      thePath->mEdges.intersects(delEdges)) delPaths.push_back(thePath);
+    if (binary_search(sortedDelNodes.begin(), sortedDelNodes.end(), 
+      (tmNode*) thePath->mFrontNode) ||
+      binary_search(sortedDelNodes.begin(), sortedDelNodes.end(), 
+      (tmNode*) thePath->mBackNode)) delPaths.push_back(thePath);
   }
-
-  // Check validity of deletion: we don't allow a deletion that would break the
-  // tree into two or more pieces.
-  size_t nodesLeft = mOwnedNodes.size() - delNodes.size();
-  size_t pathsLeft = mOwnedPaths.size() - delPaths.size();
-  if ((nodesLeft * (nodesLeft - 1)) / 2 != pathsLeft) throw EX_BAD_KILL_PARTS();
   
   // Delete all of the marked parts.
   for (size_t in = 0; in < delNodes.size(); ++in) delete delNodes[in];
@@ -1001,8 +990,8 @@ void tmTree::KillSomeNodesAndEdges(tmArray<tmNode*>& markedNodes,
   }
   for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
     tmPath* thePath = mOwnedPaths[i];
-    tmNode* frontNode = thePath->mNodes.front();
-    tmNode* backNode = thePath->mNodes.back();
+    tmNode* frontNode = thePath->mFrontNode;
+    tmNode* backNode = thePath->mBackNode;
     thePath->mIsLeafPath = (frontNode->IsLeafNode() && backNode->IsLeafNode());
     if (thePath->mIsLeafPath) {
       frontNode->mLeafPaths.union_with(thePath);
@@ -1021,7 +1010,7 @@ Kill a bunch of conditions.
 *****/
 void tmTree::KillSomeConditions(tmArray<tmCondition*>& markedConditions)
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmCondition*> delConditions(markedConditions);
   for (size_t i = 0; i < delConditions.size(); ++i) delete delConditions[i];
 }
@@ -1032,7 +1021,7 @@ Kill all conditions that apply to nodes.
 *****/
 void tmTree::KillNodeConditions()
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmCondition*> delConditions;
   for (size_t i = 0; i < mConditions.size(); ++i)
     if (mConditions[i]->IsNodeCondition())
@@ -1046,7 +1035,7 @@ Kill all conditions that apply to edges.
 *****/
 void tmTree::KillEdgeConditions()
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmCondition*> delConditions;
   for (size_t i = 0; i < mConditions.size(); ++i)
     if (mConditions[i]->IsEdgeCondition())
@@ -1060,7 +1049,7 @@ Kill all conditions that apply to paths.
 *****/
 void tmTree::KillPathConditions()
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmCondition*> delConditions;
   for (size_t i = 0; i < mConditions.size(); ++i)
     if (mConditions[i]->IsPathCondition())
@@ -1096,7 +1085,7 @@ Kill all elements of the crease pattern.
 *****/
 void tmTree::KillCreasePattern()
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::POLYS);
   mVertices.KillItems();
   mCreases.KillItems();
   mFacets.KillItems();
@@ -1111,7 +1100,7 @@ may be left behind, so we'll have to kill those, too.
 *****/
 void tmTree::KillPolysAndCreasePattern()
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::POLYS);
   KillCreasePattern();
   mPolys.KillItems();
 }
@@ -1168,6 +1157,7 @@ routine SetPartIndex<P>(P*, size_t).
 void tmTree::SetConditionIndex(tmCondition* c, size_t n)
 {
   SetPartIndex(c, n);
+  ConditionsChanged();
 }
 
 
@@ -1182,7 +1172,7 @@ void tmTree::SetNodeLocs(const tmArray<const tmNode*>& movingNodes,
 {
   TMASSERT(movingNodes.size() == newLocs.size());
   if (movingNodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::DIRTY_PARTS);
   for (size_t i = 0; i < movingNodes.size(); ++i) {
     tmNode* theNode = const_cast<tmNode*>(movingNodes[i]);
     theNode->SetLoc(newLocs[i]);
@@ -1196,7 +1186,7 @@ time.
 *****/
 void tmTree::SetEdgeLengths(tmArray<tmEdge*>& aEdgeList, tmFloat aLength)
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   tmArrayIterator<tmEdge*> iEdgeList(aEdgeList);
   tmEdge* aEdge;
   while (iEdgeList.Next(&aEdge)) {
@@ -1214,7 +1204,7 @@ void tmTree::ScaleEdgeLengths(const tmArray<tmEdge*>& aEdgeList,
   const tmFloat& factor)
 {
   TMASSERT(factor > 0.0);
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   for (size_t i = 0; i < aEdgeList.size(); ++i)
     aEdgeList[i]->mLength *= factor;
 }
@@ -1226,7 +1216,7 @@ A utility routine used by the next 3 routines.
 *****/
 void tmTree::ScaleTree(tmFloat scaleFactor)
 {
-  tmTreeCleaner tc(this); 
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   mScale /= scaleFactor;  
   tmArrayIterator<tmEdge*> iEdgeList(mOwnedEdges);
   tmEdge* aEdge;
@@ -1269,7 +1259,7 @@ Set all strains in a list of Edges to zero. Leave the list untouched.
 *****/
 void tmTree::RemoveStrain(tmArray<tmEdge*>& aEdgeList)
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   tmArrayIterator<tmEdge*> iEdgeList(aEdgeList);
   tmEdge* aEdge;
   while (iEdgeList.Next(&aEdge)) aEdge->mStrain = 0;
@@ -1290,7 +1280,7 @@ Relieve all strains in a list of Edges by increasing edge lengths proportionally
 *****/
 void tmTree::RelieveStrain(tmArray<tmEdge*>& aEdgeList)
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::PATH_LENGTHS);
   tmArrayIterator<tmEdge*> iEdgeList(aEdgeList);
   tmEdge* aEdge;
   while (iEdgeList.Next(&aEdge)) {
@@ -1318,7 +1308,7 @@ testing, we'll always re-seed the random number generator for each call.
 void tmTree::PerturbNodes(const tmArray<tmNode*>& aNodeList)
 {
   const tmFloat PERTURBATION_SIZE = 1.0e-2;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::DIRTY_PARTS);
   srand(0);
   for (size_t i = 0; i < aNodeList.size(); ++i) {
     tmNode* theNode = aNodeList[i];
@@ -1326,6 +1316,36 @@ void tmTree::PerturbNodes(const tmArray<tmNode*>& aNodeList)
     theNode->mLoc.x += PERTURBATION_SIZE * mag;
     mag = 2 * (tmFloat(rand()) / RAND_MAX) - 0.5;  // again
     theNode->mLoc.y += PERTURBATION_SIZE * mag;
+    mDirtyParts.MarkNodeMoved(theNode);
+  }
+}
+
+
+/*****
+Perturb the coordinate values of the nodes in the list by up to size in each
+direction, keeping them on the paper. The perturbation is determined entirely
+by seed, and unlike the version above this doesn't touch the C library's
+random number generator, so separate threads can perturb separate trees.
+*****/
+void tmTree::PerturbNodes(const tmArray<tmNode*>& aNodeList, 
+  unsigned long seed, const tmFloat& size)
+{
+  tmTreeCleaner tc(this, tmTreeCleaner::DIRTY_PARTS);
+  // Linear congruential generator, which gives random numbers in [0, 1)
+  const unsigned long MASK = 0x7fffffffUL;
+  const tmFloat RANGE = 2147483648.0;
+  unsigned long state = seed & MASK;
+  for (size_t i = 0; i < aNodeList.size(); ++i) {
+    tmNode* theNode = aNodeList[i];
+    state = (state * 1103515245UL + 12345UL) & MASK;
+    tmFloat mag = 2 * (tmFloat(state) / RANGE) - 1;  // random w/in (-1, 1)
+    theNode->mLoc.x = max_val(tmFloat(0), 
+      min_val(mPaperWidth, theNode->mLoc.x + size * mag));
+    state = (state * 1103515245UL + 12345UL) & MASK;
+    mag = 2 * (tmFloat(state) / RANGE) - 1;  // again
+    theNode->mLoc.y = max_val(tmFloat(0), 
+      min_val(mPaperHeight, theNode->mLoc.y + size * mag));
+    mDirtyParts.MarkNodeMoved(theNode);
   }
 }
 
@@ -1405,10 +1425,13 @@ void tmTree::GetSpanningEdges(const tmArray<tmNode*>& aNodeList,
   // of its Edges to the list.  
   tmArrayIterator<tmPath*> iPaths(mPaths);
   tmPath* aPath;
+  tmArray<tmEdge*> pathEdges;
   while (iPaths.Next(&aPath))
-    if (aNodeList.contains(aPath->mNodes.front()) &&
-      (aNodeList.contains(aPath->mNodes.back())))
-      aEdgeList.union_with(aPath->mEdges);
+    if (aNodeList.contains(aPath->mFrontNode) &&
+      (aNodeList.contains(aPath->mBackNode))) {
+      aPath->GetEdges(pathEdges);
+      aEdgeList.union_with(pathEdges);
+    }
 
 }
 
@@ -1428,9 +1451,409 @@ void tmTree::GetSpanningPaths(const tmArray<tmNode*>& aNodeList,
   tmArrayIterator<tmPath*> iPaths(mPaths);
   tmPath* aPath;
   while (iPaths.Next(&aPath))
-    if (aNodeList.contains(aPath->mNodes.front()) &&
-      (aNodeList.contains(aPath->mNodes.back()))) aPathList.union_with(aPath);
+    if (aNodeList.contains(aPath->mFrontNode) &&
+      (aNodeList.contains(aPath->mBackNode))) aPathList.union_with(aPath);
+
+}
+
+
+/*****
+Return the leaf paths that get a path constraint in the optimizers, with the
+positions of their nodes and edges, rebuilding them first if the structure of
+the tree has changed since they were last built. Building them takes one pass
+over the conditions and one over the owned paths; until nodes, edges, or
+conditions are added or removed, later optimizers get them for free.
+*****/
+const tmTree::LeafPathCache& tmTree::GetLeafPathCache()
+{
+  LeafPathCache& c = mLeafPathCache;
+  if (c.mVersion == mStructureVersion && 
+    c.mLeafNodes.size() == c.mLeafNodePos.size() &&
+    c.mEdges.size() == c.mEdgePos.size() &&
+    c.mPaths.size() == c.mNodes1.size() &&
+    c.mActiveConditions.size() == c.mNumActiveConditions)
+    return c;
+  
+  // Parts were added or deleted, so start over.
+  c.mLeafNodes.clear();
+  c.mEdges.clear();
+  c.mPaths.clear();
+  c.mNodes1.clear();
+  c.mNodes2.clear();
+  c.mEdgeStart.clear();
+  c.mPathEdges.clear();
+  c.mActiveConditions.clear();
+  c.mLeafNodePos.clear();
+  c.mEdgePos.clear();
+  
+  tmArray<tmNode*> leafNodes;
+  GetLeafNodes(leafNodes);
+  for (size_t i = 0; i < leafNodes.size(); ++i) {
+    c.mLeafNodes.push_back(leafNodes[i]);
+    c.mLeafNodePos[leafNodes[i]] = i;
+  }
+  for (size_t i = 0; i < mOwnedEdges.size(); ++i) {
+    c.mEdges.push_back(mOwnedEdges[i]);
+    c.mEdgePos[mOwnedEdges[i]] = i;
+  }
+  
+  // A leaf path with a tmConditionPathActive gets that condition's constraint
+  // instead (the same test as IsConditioned<tmConditionPathActive>(), but
+  // without a pass over the conditions for every path).
+  vector<tmPath*> activePaths;
+  for (size_t i = 0; i < mConditions.size(); ++i) {
+    tmConditionPathActive* pc = 
+      dynamic_cast<tmConditionPathActive*>(mConditions[i]);
+    if (!pc) continue;
+    c.mActiveConditions.push_back(pc);
+    if (pc->GetPath()) activePaths.push_back(pc->GetPath());
+  }
+  c.mNumActiveConditions = c.mActiveConditions.size();
+  sort(activePaths.begin(), activePaths.end());
+  
+  c.mEdgeStart.push_back(0);
+  tmArray<tmEdge*> pathEdges;
+  for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
+    tmPath* aPath = mOwnedPaths[i];
+    if (!aPath->IsLeafPath()) continue;
+    if (binary_search(activePaths.begin(), activePaths.end(), aPath)) continue;
+    c.mPaths.push_back(aPath);
+    c.mNodes1.push_back(c.GetLeafNodePos(aPath->mFrontNode));
+    c.mNodes2.push_back(c.GetLeafNodePos(aPath->mBackNode));
+    aPath->GetEdges(pathEdges);
+    for (size_t j = 0; j < pathEdges.size(); ++j)
+      c.mPathEdges.push_back(c.GetEdgePos(pathEdges[j]));
+    c.mEdgeStart.push_back(c.mPathEdges.size());
+  }
+  c.mVersion = mStructureVersion;
+  return c;
+}
 
+
+/*****
+Return the position of aNode in mLeafNodes, or BAD_OFFSET if it isn't there.
+*****/
+size_t tmTree::LeafPathCache::GetLeafNodePos(tmNode* aNode) const
+{
+  map<tmNode*, size_t>::const_iterator i = mLeafNodePos.find(aNode);
+  if (i == mLeafNodePos.end()) return tmArray<tmNode*>::BAD_OFFSET;
+  return i->second;
+}
+
+
+/*****
+Return the position of aEdge in mEdges, or BAD_OFFSET if it isn't there.
+*****/
+size_t tmTree::LeafPathCache::GetEdgePos(tmEdge* aEdge) const
+{
+  map<tmEdge*, size_t>::const_iterator i = mEdgePos.find(aEdge);
+  if (i == mEdgePos.end()) return tmArray<tmEdge*>::BAD_OFFSET;
+  return i->second;
+}
+
+
+/*****
+Return the tree in rooted form, from which the routes of tree paths are
+computed, rebuilding it first if nodes or edges have been added or removed
+since it was last built. Building it takes one depth-first pass over the owned
+nodes, starting from the first one, plus O(N log N) to fill in the table used
+for ancestor queries; nodes that can't be reached from the first one (which
+only happens partway through an edit) are left out. The distances to the root
+aren't filled in; see GetPathDistances() for those.
+*****/
+const tmTree::PathRoutes& tmTree::GetPathRoutes()
+{
+  PathRoutes& r = mPathRoutes;
+  if (r.mVersion == mStructureVersion &&
+    r.mNodes.size() == r.mParent.size() &&
+    r.mEdges.size() + 1 == max(r.mParent.size(), size_t(1)))
+    return r;
+  
+  // Parts were added or deleted, so start over.
+  const size_t BAD_POS = tmArray<tmNode*>::BAD_OFFSET;
+  r.mNodes.clear();
+  r.mEdges.clear();
+  r.mParent.clear();
+  r.mDepth.clear();
+  r.mEnd.clear();
+  r.mDistance.clear();
+  r.mShallowest.clear();
+  r.mLog2.clear();
+  for (size_t i = 0; i < mOwnedNodes.size(); ++i)
+    mOwnedNodes[i]->mRoutePos = BAD_POS;
+  r.mVersion = mStructureVersion;
+  if (mOwnedNodes.empty()) return r;
+  
+  // Each entry of the stack is the position of a node and the number of its
+  // edges that have been followed so far.
+  tmNode* rootNode = mOwnedNodes.front();
+  rootNode->mRoutePos = 0;
+  r.mNodes.push_back(rootNode);
+  r.mParent.push_back(BAD_POS);
+  r.mDepth.push_back(0);
+  r.mEnd.push_back(0);
+  vector<pair<size_t, size_t> > stack(1, make_pair(size_t(0), size_t(0)));
+  while (!stack.empty()) {
+    size_t i = stack.back().first;
+    tmNode* theNode = r.mNodes[i];
+    if (stack.back().second == theNode->mEdges.size()) {
+      r.mEnd[i] = r.mNodes.size();
+      stack.pop_back();
+      continue;
+    }
+    tmEdge* theEdge = theNode->mEdges[stack.back().second++];
+    tmNode* nextNode = theEdge->GetOtherNode(theNode);
+    if (nextNode->mRoutePos != BAD_POS) continue;
+    size_t j = r.mNodes.size();
+    nextNode->mRoutePos = j;
+    r.mNodes.push_back(nextNode);
+    r.mEdges.push_back(theEdge);
+    r.mParent.push_back(i);
+    r.mDepth.push_back(r.mDepth[i] + 1);
+    r.mEnd.push_back(0);
+    stack.push_back(make_pair(j, size_t(0)));
+  }
+  
+  // Build the sparse table, in which each level doubles the size of the ranges
+  // covered by the level before it.
+  size_t n = r.mNodes.size();
+  r.mDistance.resize(n, 0.0);
+  r.mLog2.resize(n + 1, 0);
+  for (size_t i = 2; i <= n; ++i) r.mLog2[i] = r.mLog2[i / 2] + 1;
+  r.mShallowest.resize(r.mLog2[n] + 1);
+  r.mShallowest[0].resize(n);
+  for (size_t i = 0; i < n; ++i) r.mShallowest[0][i] = i;
+  for (size_t k = 1; k < r.mShallowest.size(); ++k) {
+    size_t half = size_t(1) << (k - 1);
+    const vector<size_t>& prev = r.mShallowest[k - 1];
+    vector<size_t>& cur = r.mShallowest[k];
+    cur.resize(n + 1 - 2 * half);
+    for (size_t i = 0; i < cur.size(); ++i) {
+      size_t a = prev[i];
+      size_t b = prev[i + half];
+      cur[i] = (r.mDepth[b] < r.mDepth[a]) ? b : a;
+    }
+  }
+  return r;
+}
+
+
+/*****
+Return the tree in rooted form with the strained length from each node up to
+the root brought up to date. Since edge lengths and strains are set from many
+places, the distances are recomputed on every call, which takes one pass over
+the nodes; callers should get them once and then query as many paths as they
+like with PathRoutes::GetDistance().
+*****/
+const tmTree::PathRoutes& tmTree::GetPathDistances()
+{
+  GetPathRoutes();
+  PathRoutes& r = mPathRoutes;
+  for (size_t i = 1; i < r.mNodes.size(); ++i)
+    r.mDistance[i] = r.mDistance[r.mParent[i]] + 
+      r.mEdges[i - 1]->GetStrainedLength();
+  return r;
+}
+
+
+/*****
+Return the position of the lowest common ancestor of the nodes at positions i1
+and i2. Positions are in depth-first order, so if i1 < i2, the shallowest node
+in (i1, i2] is a child of the ancestor (or i2 itself, if i1 is above it). Two
+overlapping ranges from the sparse table cover (i1, i2], so this takes constant
+time.
+*****/
+size_t tmTree::PathRoutes::GetAncestor(size_t i1, size_t i2) const
+{
+  TMASSERT(i1 < mNodes.size() && i2 < mNodes.size());
+  if (i1 == i2) return i1;
+  if (i2 < i1) swap(i1, i2);
+  size_t k = mLog2[i2 - i1];
+  size_t a = mShallowest[k][i1 + 1];
+  size_t b = mShallowest[k][i2 + 1 - (size_t(1) << k)];
+  return mParent[(mDepth[b] < mDepth[a]) ? b : a];
+}
+
+
+/*****
+Return the sum of the strained lengths of the edges along the tree from node1
+to node2, as of the last call to tmTree::GetPathDistances(), in constant time.
+*****/
+tmFloat tmTree::PathRoutes::GetDistance(const tmNode* node1, 
+  const tmNode* node2) const
+{
+  size_t i1 = node1->GetRoutePos();
+  size_t i2 = node2->GetRoutePos();
+  TMASSERT(i1 < mNodes.size() && mNodes[i1] == node1);
+  TMASSERT(i2 < mNodes.size() && mNodes[i2] == node2);
+  return mDistance[i1] + mDistance[i2] - 2 * mDistance[GetAncestor(i1, i2)];
+}
+
+
+// What ConditionIndex::GetConditions() returns for parts without conditions
+const tmArray<tmCondition*> tmTree::ConditionIndex::sNoConditions;
+
+
+/*****
+Return the index of conditions by the parts they use, bringing it up to date
+first. Conditions created since it was last brought up to date are simply
+added to it; if any conditions have been deleted, reordered, or given new
+parts, it's rebuilt from scratch, which takes one pass over the conditions.
+*****/
+const tmTree::ConditionIndex& tmTree::GetConditionIndex()
+{
+  ConditionIndex& x = mConditionIndex;
+  if (x.mVersion != mConditionVersion || 
+    x.mConditions.size() != x.mNumConditions) {
+    x.mConditions.clear();
+    x.mPartConditions.clear();
+    x.mVersion = mConditionVersion;
+  }
+  tmArray<tmPart*> usedParts;
+  for (size_t i = x.mConditions.size(); i < mConditions.size(); ++i) {
+    tmCondition* c = mConditions[i];
+    x.mConditions.push_back(c);
+    usedParts.clear();
+    c->GetUsedParts(usedParts);
+    for (size_t j = 0; j < usedParts.size(); ++j)
+      x.mPartConditions[usedParts[j]].push_back(c);
+  }
+  x.mNumConditions = x.mConditions.size();
+  return x;
+}
+
+
+/*****
+Return the conditions that use aPart, or an empty list if there are none.
+*****/
+const tmArray<tmCondition*>& tmTree::ConditionIndex::GetConditions(
+  tmPart* aPart) const
+{
+  map<tmPart*, tmArray<tmCondition*> >::const_iterator i = 
+    mPartConditions.find(aPart);
+  if (i == mPartConditions.end()) return sNoConditions;
+  return i->second;
+}
+
+
+/*****
+Mark everything as changed, so that the next cleanup is a full one.
+*****/
+void tmTree::DirtyParts::MarkAll()
+{
+  mAnyPartChanged = true;
+  mPathLengthsChanged = true;
+  mConditionsChanged = true;
+  mPolysChanged = true;
+  mMovedNodes.clear();
+}
+
+
+/*****
+Record that aNode has moved. Moving a subnode changes the poly that owns it, so
+that calls for a full cleanup.
+*****/
+void tmTree::DirtyParts::MarkNodeMoved(tmNode* aNode)
+{
+  if (mAnyPartChanged) return;
+  if (aNode->IsSubNode()) {
+    MarkAll();
+    return;
+  }
+  mMovedNodes.union_with(aNode);
+}
+
+
+/*****
+Mark nothing as changed; called at the end of each cleanup.
+*****/
+void tmTree::DirtyParts::Clear()
+{
+  mAnyPartChanged = false;
+  mPathLengthsChanged = false;
+  mConditionsChanged = false;
+  mPolysChanged = false;
+  mMovedNodes.clear();
+}
+
+
+/*****
+Return the nodes and edges along the tree from node1 to node2, in order, in
+nodeList and edgeList (either of which may be 0). This takes time proportional
+to the length of the route.
+*****/
+void tmTree::GetPathRoute(tmNode* node1, tmNode* node2, 
+  tmArray<tmNode*>* nodeList, tmArray<tmEdge*>* edgeList)
+{
+  const PathRoutes& r = GetPathRoutes();
+  size_t i1 = node1->mRoutePos;
+  size_t i2 = node2->mRoutePos;
+  TMASSERT(i1 < r.mNodes.size() && r.mNodes[i1] == node1);
+  TMASSERT(i2 < r.mNodes.size() && r.mNodes[i2] == node2);
+  
+  // Find the lowest common ancestor, which tells us how many edges lie on
+  // each side of it, then fill in the front half of the route going up from
+  // node1 and the back half going up from node2.
+  size_t a1 = r.GetAncestor(i1, i2);
+  size_t n1 = r.mDepth[i1] - r.mDepth[a1];
+  size_t n2 = r.mDepth[i2] - r.mDepth[a1];
+  if (nodeList) {
+    nodeList->resize(n1 + n2 + 1);
+    for (size_t k = 0, i = i1; k <= n1; ++k, i = r.mParent[i])
+      (*nodeList)[k] = r.mNodes[i];
+    for (size_t k = n1 + n2, i = i2; k > n1; --k, i = r.mParent[i])
+      (*nodeList)[k] = r.mNodes[i];
+  }
+  if (edgeList) {
+    edgeList->resize(n1 + n2);
+    for (size_t k = 0, i = i1; k < n1; ++k, i = r.mParent[i])
+      (*edgeList)[k] = r.mEdges[i - 1];
+    for (size_t k = n1 + n2, i = i2; k > n1; --k, i = r.mParent[i])
+      (*edgeList)[k - 1] = r.mEdges[i - 1];
+  }
+}
+
+
+/*****
+Return true if aNode lies on the route along the tree from node1 to node2,
+including its ends. That's the case if aNode is above one end but not the
+other, or if it's the lowest common ancestor of both.
+*****/
+bool tmTree::PathRouteContains(tmNode* node1, tmNode* node2, tmNode* aNode)
+{
+  const PathRoutes& r = GetPathRoutes();
+  size_t i1 = node1->mRoutePos;
+  size_t i2 = node2->mRoutePos;
+  size_t k = aNode->mRoutePos;
+  TMASSERT(i1 < r.mNodes.size() && r.mNodes[i1] == node1);
+  TMASSERT(i2 < r.mNodes.size() && r.mNodes[i2] == node2);
+  if (k >= r.mNodes.size() || r.mNodes[k] != aNode) return false;
+  bool above1 = (k <= i1 && i1 < r.mEnd[k]);
+  bool above2 = (k <= i2 && i2 < r.mEnd[k]);
+  if (above1 != above2) return true;
+  if (!above1) return false;
+  return r.GetAncestor(i1, i2) == k;
+}
+
+
+/*****
+Return true if aEdge lies on the route along the tree from node1 to node2.
+That's the case if exactly one end of the route lies in the subtree below the
+edge, which takes constant time to check.
+*****/
+bool tmTree::PathRouteContains(tmNode* node1, tmNode* node2, tmEdge* aEdge)
+{
+  const PathRoutes& r = GetPathRoutes();
+  size_t i1 = node1->mRoutePos;
+  size_t i2 = node2->mRoutePos;
+  TMASSERT(i1 < r.mNodes.size() && r.mNodes[i1] == node1);
+  TMASSERT(i2 < r.mNodes.size() && r.mNodes[i2] == node2);
+  size_t k = max(aEdge->mNodes.front()->mRoutePos, 
+    aEdge->mNodes.back()->mRoutePos);
+  if (k == 0 || k >= r.mNodes.size() || r.mEdges[k - 1] != aEdge) return false;
+  bool below1 = (k <= i1 && i1 < r.mEnd[k]);
+  bool below2 = (k <= i2 && i2 < r.mEnd[k]);
+  return below1 != below2;
 }
 
 
@@ -1482,7 +1905,7 @@ Turn on fixed to symmetry line for the given list of nodes.
 void tmTree::SetNodesFixedToSymmetryLine(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < nodes.size(); ++i) {
     tmConditionNodeCombo* c = 
       GetOrMakeOnePartCondition<tmConditionNodeCombo, tmNode>(nodes[i]);
@@ -1497,7 +1920,7 @@ Turn on fixed to paper edge for the given list of nodes.
 void tmTree::SetNodesFixedToPaperEdge(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < nodes.size(); ++i) {
     tmConditionNodeCombo* c = 
       GetOrMakeOnePartCondition<tmConditionNodeCombo, tmNode>(nodes[i]);
@@ -1512,7 +1935,7 @@ Turn on fixed to paper corner for the given list of nodes.
 void tmTree::SetNodesFixedToPaperCorner(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < nodes.size(); ++i) {
     tmConditionNodeCombo* c = 
       GetOrMakeOnePartCondition<tmConditionNodeCombo, tmNode>(nodes[i]);
@@ -1528,7 +1951,7 @@ void tmTree::SetNodesFixedToPosition(const tmArray<tmNode*>& nodes, bool xFixed,
   tmFloat xFixValue, bool yFixed, tmFloat yFixValue)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < nodes.size(); ++i) {
     tmConditionNodeCombo* c = 
       GetOrMakeOnePartCondition<tmConditionNodeCombo, tmNode>(nodes[i]);
@@ -1548,7 +1971,7 @@ Turn on fixed to symmetry line (v4) for the given list of nodes.
 void tmTree::SetNodesFixedToSymmetryLinev4(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmConditionNodeSymmetric*> clist;
   GetOrMakeOnePartCondition<tmConditionNodeSymmetric, tmNode>(nodes, clist);
 }
@@ -1560,7 +1983,7 @@ Turn on fixed to paper edge (v4) for the given list of nodes.
 void tmTree::SetNodesFixedToPaperEdgev4(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmConditionNodeOnEdge*> clist;
   GetOrMakeOnePartCondition<tmConditionNodeOnEdge, tmNode>(nodes, clist);
 }
@@ -1572,7 +1995,7 @@ Turn on fixed to paper corner (v4) for the given list of nodes.
 void tmTree::SetNodesFixedToPaperCornerv4(const tmArray<tmNode*>& nodes)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   tmArray<tmConditionNodeOnCorner*> clist;
   GetOrMakeOnePartCondition<tmConditionNodeOnCorner, tmNode>(nodes, clist);
 }
@@ -1585,7 +2008,7 @@ void tmTree::SetNodesFixedToPositionv4(const tmArray<tmNode*>& nodes, bool xFixe
   tmFloat xFixValue, bool yFixed, tmFloat yFixValue)
 {
   if (nodes.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < nodes.size(); ++i) {
     tmConditionNodeFixed* c = 
       GetOrMakeOnePartCondition<tmConditionNodeFixed, tmNode>(nodes[i]);
@@ -1605,7 +2028,7 @@ Set all of the edges in the list to have the same strain.
 void tmTree::SetEdgesSameStrain(const tmArray<tmEdge*>& edges)
 {
   if (edges.size() < 2) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 1; i < edges.size(); ++i)
     mTree->GetOrMakeTwoPartCondition<tmConditionEdgesSameStrain, tmEdge>(
       edges[0], edges[i]);
@@ -1618,7 +2041,7 @@ Set all of the paths in the list to be active.
 void tmTree::SetPathsActive(const tmArray<tmPath*>& paths)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i)
     GetOrMakeOnePartCondition<tmConditionPathCombo, tmPath>(paths[i]);
 }
@@ -1630,7 +2053,7 @@ Set all of the paths in the list to have fixed path angle
 void tmTree::SetPathsAngleFixed(const tmArray<tmPath*>& paths, tmFloat angle)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i) {
     tmConditionPathCombo* c = 
       GetOrMakeOnePartCondition<tmConditionPathCombo, tmPath>(paths[i]);
@@ -1647,7 +2070,7 @@ void tmTree::SetPathsAngleQuant(const tmArray<tmPath*>& paths, size_t quant,
   tmFloat quantOffset)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i) {
     tmConditionPathCombo* c =
       GetOrMakeOnePartCondition<tmConditionPathCombo, tmPath>(paths[i]);
@@ -1664,7 +2087,7 @@ Set all of the paths in the list to be active (v4).
 void tmTree::SetPathsActivev4(const tmArray<tmPath*>& paths)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i)
     GetOrMakeOnePartCondition<tmConditionPathActive, tmPath>(paths[i]);
 }
@@ -1676,7 +2099,7 @@ Set all of the paths in the list to have fixed path angle (v4)
 void tmTree::SetPathsAngleFixedv4(const tmArray<tmPath*>& paths, tmFloat angle)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i) {
     tmConditionPathAngleFixed* c =
       GetOrMakeOnePartCondition<tmConditionPathAngleFixed, tmPath>(paths[i]);
@@ -1692,7 +2115,7 @@ void tmTree::SetPathsAngleQuantv4(const tmArray<tmPath*>& paths, size_t quant,
   tmFloat quantOffset)
 {
   if (paths.empty()) return;
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (size_t i = 0; i < paths.size(); ++i) {
     tmConditionPathCombo* c =
       GetOrMakeOnePartCondition<tmConditionPathCombo, tmPath>(paths[i]);
@@ -1720,7 +2143,7 @@ void tmTree::BuildTreePolys()
   // called for clean Trees (ones for which CleanupAfterEdit() has been
   // executed).
   TMASSERT(!mNeedsCleanup);
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::POLYS);
 
   // Build new polygons from the network of leaf paths. 
   tmArray<tmPath*> leafPaths;
@@ -1754,8 +2177,10 @@ void tmTree::BuildPolysAndCreasePattern()
   // Debug builds record tree state at the beginning of this call for dumping
   // in case of assertion.
   extern stringstream& DbgPreBuildCreasesStringStream();
-  DbgPreBuildCreasesStringStream().str("");
-  Putv5Self(DbgPreBuildCreasesStringStream());
+  if (mRecordDumpState) {
+    DbgPreBuildCreasesStringStream().str("");
+    Putv5Self(DbgPreBuildCreasesStringStream());
+  }
 #endif // TMDEBUG
 
   // Like BuildTreePolys(), this should only be called for clean trees.
@@ -1776,7 +2201,7 @@ void tmTree::BuildPolysAndCreasePattern()
   // Build all subpolys for the polys that remain. This will also build
   // vertices, facets, and creases. We'll create a new tmTreeCleaner so that
   // we clean up again.
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::POLYS);
   for (size_t i = 0; i < mOwnedPolys.size(); ++i)
     mOwnedPolys[i]->BuildPolyContents();
 }
@@ -1906,10 +2331,21 @@ void tmTree::InitTree()
   mIsFacetDataValid = false;
   mIsLocalRootConnectable = false;
   mNeedsCleanup = false;
+  mStructureVersion = 1;
+  mConditionVersion = 1;
+  mNumInfeasiblePaths = 0;
   
 #ifdef TMDEBUG
   mQuitCleanupEarly = false;
+  mCheckIncrementalCleanup = false;
+  mRecordDumpState = true;
 #endif // TMDEBUG
+
+#if TM_PROFILE_CLEANUP
+  mCurCleanupStage = NUM_CLEANUP_STAGES;
+  mCurCleanupStageStart = 0.0;
+  mCurCleanupStart = 0.0;
+#endif // TM_PROFILE_CLEANUP
 }
 
 /*****
@@ -1978,8 +2414,8 @@ TBD: use this one routine in all of the structural editing methods.
 //   // their lists of leaf paths.
 //   for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
 //     tmPath* thePath = mOwnedPaths[i];
-//     tmNode* frontNode = thePath->mNodes.front();
-//     tmNode* backNode = thePath->mNodes.back();
+//     tmNode* frontNode = thePath->mFrontNode;
+//     tmNode* backNode = thePath->mBackNode;
 //     thePath->mIsLeafPath = (frontNode->IsLeafNode() && backNode->IsLeafNode());
 //     if (thePath->mIsLeafPath) {
 //       frontNode->mLeafPaths.union_with(thePath);
@@ -2108,19 +2544,22 @@ void tmTree::CalcPinnedNodesAndEdges(tmArray<tmNode*>& leafNodes,
   
   // Now identify pinned edges, which are edges that are part of active paths
   // between pinned nodes. We only need to search through the leaf paths.
+  tmArray<tmEdge*> pathEdges;
   for (size_t i = 0; i < leafPaths.size(); ++i) {
     tmPath* aPath = leafPaths[i];
-    if ((aPath->IsActivePath()) && (aPath->mNodes.front()->mIsPinnedNode) &&
-      (aPath->mNodes.back()->mIsPinnedNode))
-      for (size_t j = 0; j < aPath->mEdges.size(); ++j)
-        aPath->mEdges[j]->mIsPinnedEdge = true;
+    if ((aPath->IsActivePath()) && (aPath->mFrontNode->mIsPinnedNode) &&
+      (aPath->mBackNode->mIsPinnedNode)) {
+      aPath->GetEdges(pathEdges);
+      for (size_t j = 0; j < pathEdges.size(); ++j)
+        pathEdges[j]->mIsPinnedEdge = true;
+    }
   }
 }
 
 
 /*****
-Construct the network of polygon nodes, polygon paths, and build the polygons
-therefrom; delete polygons that have become invalidated.
+Construct the network of polygon nodes and polygon paths, from which the
+polygons are built.
 *****/
 void tmTree::CalcPolygonNetwork(tmArray<tmNode*>& leafNodes, 
   tmArray<tmPath*>& leafPaths)
@@ -2150,9 +2589,9 @@ void tmTree::CalcPolygonNetwork(tmArray<tmNode*>& leafNodes,
   // polygon nodes (or pinned, for that matter).  
   iLeafPaths.ResetTo(tmArray_START);
   while (iLeafPaths.Next(&aPath)) if (!aPath->IsFeasiblePath()) {
-    aNode = aPath->mNodes.front();
+    aNode = aPath->mFrontNode;
     aNode->mIsPolygonNode = aNode->mIsPinnedNode = false;
-    aNode = aPath->mNodes.back();
+    aNode = aPath->mBackNode;
     aNode->mIsPolygonNode = aNode->mIsPinnedNode = false;
   }
     
@@ -2168,8 +2607,8 @@ void tmTree::CalcPolygonNetwork(tmArray<tmNode*>& leafNodes,
     iLeafPaths.ResetTo(tmArray_START);
     while (iLeafPaths.Next(&aPath)) {
       if (!aPath->IsPolygonPath()) continue;
-      if (!(aPath->mNodes.front()->IsPolygonNode() &&
-        aPath->mNodes.back()->IsPolygonNode())) {
+      if (!(aPath->mFrontNode->IsPolygonNode() &&
+        aPath->mBackNode->IsPolygonNode())) {
         aPath->mIsPolygonPath = false;
         somethingChanged = true;
       }
@@ -2188,17 +2627,49 @@ void tmTree::CalcPolygonNetwork(tmArray<tmNode*>& leafNodes,
       }
     }
   } while (somethingChanged);
+}
 
-  // Check to see if any tmPoly has become invalid; if so, kill it. Note that
-  // this will also kill all vertices, facets, and creases interior to the
-  // poly, but not the vertices and creases on the border of the poly. Note
-  // that deletion of a poly will also delete its subpolys, changing the list,
-  // so we first collect the doomed, then delete.
+
+/*****
+Kill the polys that have become invalid. Note that this will also kill all
+vertices, facets, and creases interior to each poly, but not the vertices and
+creases on the border of the poly. If movedLeafNodes is non-null, the only
+leaf nodes that have moved since the last cleanup are the ones in the list and
+no parts have been created or destroyed, so a poly that doesn't have a moved
+node in its ring is still valid unless a ring path is no longer a polygon path
+or it now encloses one of the moved nodes.
+*****/
+void tmTree::KillInvalidPolys(const tmArray<tmNode*>* movedLeafNodes)
+{
+  // Note that deletion of a poly will also delete its subpolys, changing the
+  // list, so we first collect the doomed, then delete.
   tmArray<tmPoly*> doomedPolys;
-  for (size_t i = 0; i < mPolys.size(); ++i) {
-    tmPoly* thePoly = mPolys[i];
-    if (!thePoly->CalcPolyIsValid()) {
-      doomedPolys.push_back(thePoly);
+  if (!movedLeafNodes) {
+    for (size_t i = 0; i < mPolys.size(); ++i) {
+      tmPoly* thePoly = mPolys[i];
+      if (!thePoly->CalcPolyIsValid()) {
+        doomedPolys.push_back(thePoly);
+      }
+    }
+  }
+  else {
+    // Subpolys are always valid, so we only need to look at the tree polys.
+    tmArray<tmNode*> movedNodes(*movedLeafNodes);
+    sort(movedNodes.begin(), movedNodes.end());
+    for (size_t i = 0; i < mOwnedPolys.size(); ++i) {
+      tmPoly* thePoly = mOwnedPolys[i];
+      bool isValid = true;
+      for (size_t j = 0; j < thePoly->mRingNodes.size(); ++j)
+        if (binary_search(movedNodes.begin(), movedNodes.end(), 
+          thePoly->mRingNodes[j])) {
+          isValid = thePoly->CalcPolyIsValid();
+          break;
+        }
+      for (size_t j = 0; isValid && j < thePoly->mRingPaths.size(); ++j)
+        if (!thePoly->mRingPaths[j]->IsPolygonPath()) isValid = false;
+      if (isValid && thePoly->CalcPolyEnclosesNode(movedNodes)) 
+        isValid = false;
+      if (!isValid) doomedPolys.push_back(thePoly);
     }
   }
   for (size_t i = 0; i < doomedPolys.size(); ++i) {
@@ -2311,6 +2782,19 @@ void tmTree::CalcPartIndices()
   RenumberParts<tmCrease>();
   RenumberParts<tmFacet>();
   RenumberParts<tmCondition>();
+  RebuildPathIndices();
+}
+
+
+/*****
+Rebuild the path indices of the tree and all of its polys, which are keyed by
+node index and so must follow any renumbering of the nodes.
+*****/
+void tmTree::RebuildPathIndices()
+{
+  RebuildPathIndex();
+  for (size_t i = 0; i < mPolys.size(); ++i)
+    mPolys[i]->RebuildPathIndex();
 }
 
 
@@ -2349,10 +2833,10 @@ void tmTree::CalcDepthAndBend()
   for (size_t i = 0; i < mOwnedPaths.size(); ++i) {
     tmPath* thePath = mOwnedPaths[i];
     tmNode* theNode;
-    if (thePath->mNodes.front() == rootNode) 
-      theNode = thePath->mNodes.back();
-    else if (thePath->mNodes.back() == rootNode) 
-      theNode = thePath->mNodes.front();
+    if (thePath->mFrontNode == rootNode) 
+      theNode = thePath->mBackNode;
+    else if (thePath->mBackNode == rootNode) 
+      theNode = thePath->mFrontNode;
     else continue;
     theNode->mDepth = thePath->GetMinPaperLength();
   }
@@ -2367,19 +2851,23 @@ void tmTree::CalcDepthAndBend()
   // For each leaf path set mMinDepth and mMinDepthDist. This establishes a
   // local depth metric whenever the path, or an inset version of it, becomes
   // active, so we can determine the depth of any point relative to the path.
+  tmArray<tmNode*> pathNodes;
+  tmArray<tmEdge*> pathEdges;
   for (size_t i = 0; i < mPaths.size(); ++i) {
     tmPath* thePath = mPaths[i];
 //    if (thePath->mIsSubPath && thePath->mIsLeafPath) {
     if (thePath->IsLeafPath()) {
-      thePath->mMinDepth = thePath->mNodes.front()->mDepth;
+      thePath->mMinDepth = thePath->mFrontNode->mDepth;
       thePath->mMinDepthDist = 0;
-      for (size_t j = 1; j < thePath->mNodes.size(); ++j) {
-        tmNode* pathNode = thePath->mNodes[j];
+      thePath->GetNodes(pathNodes);
+      thePath->GetEdges(pathEdges);
+      for (size_t j = 1; j < pathNodes.size(); ++j) {
+        tmNode* pathNode = pathNodes[j];
         tmFloat nodeDepth = pathNode->mDepth;
         if (thePath->mMinDepth > nodeDepth) {
           thePath->mMinDepth = nodeDepth;
           thePath->mMinDepthDist += 
-            thePath->mEdges[j - 1]->GetStrainedScaledLength();
+            pathEdges[j - 1]->GetStrainedScaledLength();
         }
       }
     }
@@ -2588,6 +3076,152 @@ void tmTree::CalcFoldDirections()
 }
 
 
+#ifdef __MWERKS__
+#pragma mark -
+#endif
+
+
+#if TM_PROFILE_CLEANUP
+/*****
+STATIC
+Return a short name for the given cleanup stage, for reporting.
+*****/
+const char* tmTree::GetCleanupStageName(CleanupStage stage)
+{
+  switch (stage) {
+    case CLEANUP_CONDITIONS:          return "conditions";
+    case CLEANUP_NODES_AND_EDGES:     return "nodes and edges";
+    case CLEANUP_PATH_LENGTHS:        return "path lengths";
+    case CLEANUP_FEASIBILITY:         return "feasibility";
+    case CLEANUP_CONDITIONED_FLAGS:   return "conditioned flags";
+    case CLEANUP_BORDER:              return "border";
+    case CLEANUP_PINNED:              return "pinned";
+    case CLEANUP_POLYGON_NETWORK:     return "polygon network";
+    case CLEANUP_POLYGON_VALIDITY:    return "polygon validity";
+    case CLEANUP_ORPHANS:             return "orphans";
+    case CLEANUP_PART_INDICES:        return "part indices";
+    case CLEANUP_POLYGON_FILLED:      return "polygon filled";
+    case CLEANUP_DEPTH_AND_BEND:      return "depth and bend";
+    case CLEANUP_VERTEX_DEPTH:        return "vertex depth";
+    case CLEANUP_FACET_DATA:          return "facet data";
+    case CLEANUP_CORRIDOR_EDGES:      return "corridor edges";
+    case CLEANUP_FACET_ORDER:         return "facet order";
+    case CLEANUP_FACET_COLOR:         return "facet color";
+    case CLEANUP_FOLD_DIRECTIONS:     return "fold directions";
+    default:
+      return "total";
+  }
+}
+
+
+/*****
+Clear the cumulative cleanup statistics.
+*****/
+void tmTree::ResetCleanupStats()
+{
+  for (size_t i = 0; i <= NUM_CLEANUP_STAGES; ++i)
+    mTotalCleanupStats[i] = CleanupStats();
+}
+
+
+/*****
+Dump the statistics of the last cleanup and the cumulative statistics to the
+log, one line per stage.
+*****/
+void tmTree::LogCleanupStats() const
+{
+  TMLOG("Cleanup profile: stage, last (calls, ms, parts), "
+    "total (calls, ms, parts)");
+  for (size_t i = 0; i <= NUM_CLEANUP_STAGES; ++i) {
+    const CleanupStats& last = mLastCleanupStats[i];
+    const CleanupStats& total = mTotalCleanupStats[i];
+    stringstream info;
+    info.setf(ios_base::fixed);
+    info.precision(3);
+    info << "  " << GetCleanupStageName(CleanupStage(i)) << ": (" << 
+      last.mNumCalls << ", " << 1000.0 * last.mTime << ", " << 
+      last.mNumParts << "), (" << total.mNumCalls << ", " << 
+      1000.0 * total.mTime << ", " << total.mNumParts << ")";
+    TMLOG(info.str());
+  }
+}
+
+
+/*****
+Begin profiling a cleanup. Statistics from the previous cleanup are cleared.
+*****/
+void tmTree::StartCleanupProfile()
+{
+  for (size_t i = 0; i <= NUM_CLEANUP_STAGES; ++i)
+    mLastCleanupStats[i] = CleanupStats();
+  mCurCleanupStage = NUM_CLEANUP_STAGES;
+  mCurCleanupStart = tmGetWallTime();
+}
+
+
+/*****
+Begin timing a stage of cleanup, ending the stage in progress, if any. numParts
+is the number of parts (or part combinations) that the stage will process.
+*****/
+void tmTree::StartCleanupStage(CleanupStage stage, size_t numParts)
+{
+  StopCleanupStage();
+  mCurCleanupStage = stage;
+  mLastCleanupStats[stage].mNumCalls++;
+  mLastCleanupStats[stage].mNumParts += numParts;
+  mTotalCleanupStats[stage].mNumCalls++;
+  mTotalCleanupStats[stage].mNumParts += numParts;
+  mCurCleanupStageStart = tmGetWallTime();
+}
+
+
+/*****
+End timing the stage of cleanup in progress, if any.
+*****/
+void tmTree::StopCleanupStage()
+{
+  if (mCurCleanupStage == NUM_CLEANUP_STAGES) return;
+  double dt = tmGetWallTime() - mCurCleanupStageStart;
+  mLastCleanupStats[mCurCleanupStage].mTime += dt;
+  mTotalCleanupStats[mCurCleanupStage].mTime += dt;
+  mCurCleanupStage = NUM_CLEANUP_STAGES;
+}
+
+
+/*****
+Finish profiling a cleanup, ending the last stage and recording the totals.
+*****/
+void tmTree::StopCleanupProfile()
+{
+  StopCleanupStage();
+  double dt = tmGetWallTime() - mCurCleanupStart;
+  size_t numParts = mNodes.size() + mEdges.size() + mPaths.size() + 
+    mPolys.size() + mVertices.size() + mCreases.size() + mFacets.size() + 
+    mConditions.size();
+  CleanupStats& last = mLastCleanupStats[NUM_CLEANUP_STAGES];
+  last.mNumCalls = 1;
+  last.mTime = dt;
+  last.mNumParts = numParts;
+  CleanupStats& total = mTotalCleanupStats[NUM_CLEANUP_STAGES];
+  total.mNumCalls++;
+  total.mTime += dt;
+  total.mNumParts += numParts;
+}
+#endif // TM_PROFILE_CLEANUP
+
+
+/*****
+TM_CLEANUP_STAGE(stage, numParts)
+Marks the start of a stage of CleanupAfterEdit() in profiling builds; the stage
+runs until the next mark or until cleanup returns.
+*****/
+#if TM_PROFILE_CLEANUP
+  #define TM_CLEANUP_STAGE(stage, numParts) StartCleanupStage(stage, numParts)
+#else
+  #define TM_CLEANUP_STAGE(stage, numParts)
+#endif // TM_PROFILE_CLEANUP
+
+
 /*****
 This gets called by the tmTreeCleaner class after any changes to the tree
 topology or changes to part attributes. It does the following:
@@ -2599,6 +3233,8 @@ Delete parts that have become invalid (polys and their sub-structure, vertices,
 creases, and conditions with invalid references)
 Renumber all the indices of all the tmParts
 Recalculate the depth for nodes and vertices.
+Only the parts of this that depend on what has changed since the last cleanup,
+as recorded in mDirtyParts, are actually redone; see CleanupDirtyParts().
 *****/
 void tmTree::CleanupAfterEdit()
 {
@@ -2606,8 +3242,10 @@ void tmTree::CleanupAfterEdit()
   // Debug builds record tree state at the beginning of this call for dumping
   // in case of assertion.
   extern stringstream& DbgPreCleanupStringStream();
-  DbgPreCleanupStringStream().str("");
-  Putv5Self(DbgPreCleanupStringStream());
+  if (mRecordDumpState) {
+    DbgPreCleanupStringStream().str("");
+    Putv5Self(DbgPreCleanupStringStream());
+  }
   
   // A first consistency check compares number of owned nodes against owned
   // paths.
@@ -2615,145 +3253,298 @@ void tmTree::CleanupAfterEdit()
   size_t numOwnedPaths = mOwnedPaths.size();
   if (numOwnedNodes > 0)
     TMASSERT(numOwnedPaths == (numOwnedNodes * (numOwnedNodes - 1)) / 2);
+  bool isIncremental = !mDirtyParts.mAnyPartChanged;
+#endif // TMDEBUG
+
+#if TM_PROFILE_CLEANUP
+  CleanupProfiler profiler(this);
+#endif // TM_PROFILE_CLEANUP
+
+  CleanupDirtyParts();
+  mDirtyParts.Clear();
+  
+#ifdef TMDEBUG
+  // If we're checking incremental cleanups, a full cleanup of the tree that an
+  // incremental one left behind should change nothing at all.
+  if (mCheckIncrementalCleanup && isIncremental) {
+    stringstream incrementalStream;
+    Putv5Self(incrementalStream);
+    mDirtyParts.MarkAll();
+    CleanupDirtyParts();
+    mDirtyParts.Clear();
+    stringstream fullStream;
+    Putv5Self(fullStream);
+    TMASSERT(incrementalStream.str() == fullStream.str());
+  }
 #endif // TMDEBUG
+}
+
 
+/*****
+Do the work of CleanupAfterEdit(), skipping what doesn't depend on anything in
+mDirtyParts. After a full cleanup, the cleanup after an edit that only moved a
+few nodes recomputes the lengths, feasibility, and activity of just their leaf
+paths and the feasibility of just their conditions, and only fully checks the
+validity of the polys that they are part of. The hull, pinned, and polygon
+network stages remain passes over all leaf nodes and paths.
+*****/
+void tmTree::CleanupDirtyParts()
+{
+  DirtyParts& dp = mDirtyParts;
+  bool cleanAll = dp.mAnyPartChanged;
+  bool lengthsChanged = cleanAll || dp.mPathLengthsChanged;
+  bool conditionsChanged = cleanAll || dp.mConditionsChanged;
+  bool polysChanged = cleanAll || dp.mPolysChanged;
+  
   // Clear flags that should get set later in this routine but might not if
-  // we bail out early.
+  // we bail out early. The flags of the crease pattern only get cleared when
+  // we're going to recompute the crease pattern.
   mIsFeasible = false;
   mIsPolygonValid = false;
-  mIsPolygonFilled = false;
-  mIsVertexDepthValid = false;
-  mIsFacetDataValid = false;
+  if (cleanAll) {
+    mIsPolygonFilled = false;
+    mIsVertexDepthValid = false;
+    mIsFacetDataValid = false;
+  }
   
   // Clear any Conditions that have become invalid (e.g., because the parts
   // they refer to were deleted). Since deleting removes elements from the
   // list, we'll work from a copy of mConditions.
-  tmArray<tmCondition*> clist(mConditions);
-  for (size_t ic = 0; ic < clist.size(); ic++)
-    if (!clist[ic]->IsValidCondition()) delete clist[ic];
+  if (conditionsChanged) {
+    TM_CLEANUP_STAGE(CLEANUP_CONDITIONS, mConditions.size());
+    tmArray<tmCondition*> clist(mConditions);
+    for (size_t ic = 0; ic < clist.size(); ic++)
+      if (!clist[ic]->IsValidCondition()) delete clist[ic];
+  }
     
   // if there are no nodes, there's nothing else to check.
   if (mOwnedNodes.empty()) return;
+    
+  // Nodes created after others were deleted can share an index until the parts
+  // are renumbered below, which leaves paths between them out of the path
+  // index. If that has happened, renumber the nodes now so that path lookups
+  // during cleanup don't have to search.
+  if (mPathIndexOverflow != 0) {
+    RenumberParts<tmNode>();
+    RebuildPathIndices();
+  }
   
   // Make a list of all leaf nodes
+  TM_CLEANUP_STAGE(CLEANUP_NODES_AND_EDGES, 
+    mOwnedNodes.size() + mOwnedEdges.size());
   tmArray<tmNode*> leafNodes;
   GetLeafNodes(leafNodes);
   
-  // Clamp the location of each tmNode to be within the square
-  // and clear all the dimensional flags on nodes.
-  for (size_t in = 0; in < mOwnedNodes.size(); in++) {
-    tmNode* theNode = mOwnedNodes[in];  
+  // Clamp the location of each tmNode that could have moved to be within the
+  // square, and clear the dimensional flags on all nodes. The mIsConditioned
+  // flags only need clearing if they're going to be recalculated.
+  const tmArray<tmNode*>& movedNodes = cleanAll ? mOwnedNodes : dp.mMovedNodes;
+  for (size_t in = 0; in < movedNodes.size(); in++) {
+    tmNode* theNode = movedNodes[in];  
     if (theNode->mLoc.x < 0) theNode->mLoc.x = 0;
     if (theNode->mLoc.y < 0) theNode->mLoc.y = 0;
     if (theNode->mLoc.x > mPaperWidth) theNode->mLoc.x = mPaperWidth;
     if (theNode->mLoc.y > mPaperHeight) theNode->mLoc.y = mPaperHeight;
+  }
+  for (size_t in = 0; in < mOwnedNodes.size(); in++) {
+    tmNode* theNode = mOwnedNodes[in];  
     theNode->mIsBorderNode = false;
     theNode->mIsPinnedNode = false;
     theNode->mIsPolygonNode = false;
-    theNode->mIsConditionedNode = false;
+    if (conditionsChanged) theNode->mIsConditionedNode = false;
   }
   
   // Clear all dimensional flags on edges.
   for (size_t ie = 0; ie < mOwnedEdges.size(); ie++) {
     tmEdge* theEdge = mOwnedEdges[ie];
     theEdge->mIsPinnedEdge = false;
-    theEdge->mIsConditionedEdge = false;
+    if (conditionsChanged) theEdge->mIsConditionedEdge = false;
   }
     
   // make a list of all the leaf paths  
   tmArray<tmPath*> leafPaths;
   GetLeafPaths(leafPaths);
   
+  // Make a list of the leaf nodes that moved, and of their leaf paths, each
+  // path listed once; if no path lengths changed, these are the only paths
+  // whose actual length could have changed.
+  tmArray<tmNode*> movedLeafNodes;
+  tmArray<tmPath*> movedPaths;
+  for (size_t i = 0; i < dp.mMovedNodes.size(); ++i) {
+    tmNode* theNode = dp.mMovedNodes[i];
+    if (!theNode->IsLeafNode()) continue;
+    movedLeafNodes.push_back(theNode);
+    movedPaths.insert(movedPaths.end(), theNode->mLeafPaths.begin(), 
+      theNode->mLeafPaths.end());
+  }
+  sort(movedPaths.begin(), movedPaths.end());
+  movedPaths.erase(unique(movedPaths.begin(), movedPaths.end()), 
+    movedPaths.end());
+  
   // Go through all paths and set which paths are feasible and active. Feasible
   // paths are paths whose actual length is greater or equal to their minimum
   // length. Active paths are those for which equality holds. Only need to do 
   // this for owned paths, because polys will set the relevant flags for their
   // subpolys at construction (and any change to a poly wipes its contents).
-  tmArrayIterator<tmPath*> iOwnedPaths(mOwnedPaths);
-  tmPath* aPath;
-  while (iOwnedPaths.Next(&aPath)) {
-  
-    // compute the length of each path based on its edges and any strain that
-    // is present; also set the flags for validity and activity, which depend
-    // on these lengths.
-    aPath->TreePathCalcLengths();
+  // If only nodes moved, we only need to do this for their leaf paths, and
+  // we keep the count of infeasible leaf paths up to date as we go.
+  if (lengthsChanged) {
+    TM_CLEANUP_STAGE(CLEANUP_PATH_LENGTHS, mOwnedPaths.size());
+    GetPathDistances();
+    tmArrayIterator<tmPath*> iOwnedPaths(mOwnedPaths);
+    tmPath* aPath;
+    while (iOwnedPaths.Next(&aPath)) {
     
-    // Also clear flags we'll be setting shortly    
-    aPath->mIsBorderPath = false;
-    aPath->mIsPolygonPath = false;
-    aPath->mIsConditionedPath = false;
+      // compute the length of each path from the tree distance between its
+      // ends, which takes constant time; also set the flags for validity and
+      // activity, which depend on these lengths.
+      aPath->TreePathCalcLengths();
+      
+      // Also clear flags we'll be setting shortly    
+      aPath->mIsBorderPath = false;
+      aPath->mIsPolygonPath = false;
+      if (conditionsChanged) aPath->mIsConditionedPath = false;
+    }
+    mNumInfeasiblePaths = 0;
+    for (size_t i = 0; i < leafPaths.size(); ++i)
+      if (!leafPaths[i]->IsFeasiblePath()) ++mNumInfeasiblePaths;
+  }
+  else {
+    TM_CLEANUP_STAGE(CLEANUP_PATH_LENGTHS, movedPaths.size());
+    GetPathDistances();
+    for (size_t i = 0; i < movedPaths.size(); ++i) {
+      tmPath* thePath = movedPaths[i];
+      if (!thePath->IsFeasiblePath()) --mNumInfeasiblePaths;
+      thePath->TreePathCalcLengths();
+      if (!thePath->IsFeasiblePath()) ++mNumInfeasiblePaths;
+    }
+    
+    // Only leaf paths can be border or polygon paths, and CalcPolygonNetwork()
+    // sets the polygon flag of every leaf path.
+    for (size_t i = 0; i < leafPaths.size(); ++i)
+      leafPaths[i]->mIsBorderPath = false;
   }
   
   // With path feasibility set, we can now set the feasibility of the entire
   // tree, which basically requires that all leaf paths and conditions be
-  // feasible.
-  mIsFeasible = true;
-  for (size_t i = 0; i < leafPaths.size(); ++i) {
-    tmPath* thePath = leafPaths[i];
-    mIsFeasible &= thePath->IsFeasiblePath();
-    if (!mIsFeasible) break;
+  // feasible. A condition's feasibility only depends on its own parts, so if
+  // only nodes moved, we only need to recalculate the feasibility of the
+  // conditions on them and their leaf paths.
+  if (lengthsChanged || conditionsChanged) {
+    TM_CLEANUP_STAGE(CLEANUP_FEASIBILITY, mOwnedConditions.size());
+    for (size_t i = 0; i < mOwnedConditions.size(); ++i)
+      mOwnedConditions[i]->CalcFeasibility();
   }
-  for (size_t i = 0; i < mOwnedConditions.size(); ++i) {
-    tmCondition* theCondition = mOwnedConditions[i];
-    theCondition->CalcFeasibility();
-    mIsFeasible &= theCondition->IsFeasibleCondition();
+  else {
+    TM_CLEANUP_STAGE(CLEANUP_FEASIBILITY, 
+      movedLeafNodes.size() + movedPaths.size());
+    const ConditionIndex& index = GetConditionIndex();
+    for (size_t i = 0; i < movedLeafNodes.size(); ++i) {
+      tmNode* theNode = movedLeafNodes[i];
+      const tmArray<tmCondition*>& clist = index.GetConditions(theNode);
+      for (size_t j = 0; j < clist.size(); ++j)
+        if (clist[j]->Uses(theNode)) clist[j]->CalcFeasibility();
+    }
+    for (size_t i = 0; i < movedPaths.size(); ++i) {
+      tmPath* thePath = movedPaths[i];
+      const tmArray<tmCondition*>& clist = index.GetConditions(thePath);
+      for (size_t j = 0; j < clist.size(); ++j)
+        if (clist[j]->Uses(thePath)) clist[j]->CalcFeasibility();
+    }
   }
+  mIsFeasible = (mNumInfeasiblePaths == 0);
+  for (size_t i = 0; i < mOwnedConditions.size(); ++i)
+    mIsFeasible &= mOwnedConditions[i]->IsFeasibleCondition();
   
-  // Set the mIsConditioned flags by going through all tmParts and Conditions
-  // and checking to see if the tmCondition uses the tmPart.
-  for (size_t ic = 0; ic < mConditions.size(); ic++) {
-    tmCondition* c = mConditions[ic];
+  // Set the mIsConditioned flags by looking up the conditions attached to
+  // each tmPart and checking to see if any of them still uses the tmPart.
+  if (conditionsChanged) {
+    TM_CLEANUP_STAGE(CLEANUP_CONDITIONED_FLAGS, 
+      mOwnedNodes.size() + mOwnedEdges.size() + mOwnedPaths.size());
     for (size_t in = 0; in < mOwnedNodes.size(); in++)
-      mOwnedNodes[in]->mIsConditionedNode |= (c->Uses(mOwnedNodes[in]));
+      mOwnedNodes[in]->mIsConditionedNode = 
+        IsConditioned<tmCondition, tmNode>(mOwnedNodes[in]);
     for (size_t ie = 0; ie < mOwnedEdges.size(); ie++)
-      mOwnedEdges[ie]->mIsConditionedEdge |= (c->Uses(mOwnedEdges[ie]));
+      mOwnedEdges[ie]->mIsConditionedEdge = 
+        IsConditioned<tmCondition, tmEdge>(mOwnedEdges[ie]);
     for (size_t ip = 0; ip < mOwnedPaths.size(); ip++)
-      mOwnedPaths[ip]->mIsConditionedPath |= (c->Uses(mOwnedPaths[ip]));
+      mOwnedPaths[ip]->mIsConditionedPath = 
+        IsConditioned<tmCondition, tmPath>(mOwnedPaths[ip]);
   }
       
   // Find the border nodes, which comprise the convex hull of the set of nodes,
   // and the border paths, which connect them.
+  TM_CLEANUP_STAGE(CLEANUP_BORDER, leafNodes.size());
   CalcBorderNodesAndPaths(leafNodes);
 
   // Compute pinned status for nodes and edges.
+  TM_CLEANUP_STAGE(CLEANUP_PINNED, leafNodes.size() + leafPaths.size());
   CalcPinnedNodesAndEdges(leafNodes, leafPaths);
   
-  // Construct the polygon network and associated flags on nodes and paths.
+  // Construct the polygon network and associated flags on nodes and paths,
+  // and kill any polys that have become invalid. Unless polys were built or
+  // killed, only the polys that the moved nodes are part of can have become
+  // invalid in any but the simplest ways.
+  TM_CLEANUP_STAGE(CLEANUP_POLYGON_NETWORK, leafPaths.size());
   CalcPolygonNetwork(leafNodes, leafPaths);
+  size_t numPolys = mPolys.size();
+  KillInvalidPolys(polysChanged ? 0 : &movedLeafNodes);
+  bool polysKilled = (mPolys.size() < numPolys);
     
   // Calculate polygon validity; basically, insuring that the convex hull of the
   // nodes is entirely filled with valid polygons.
+  TM_CLEANUP_STAGE(CLEANUP_POLYGON_VALIDITY, mOwnedPolys.size());
   CalcPolygonValidity(leafNodes);
   
   // Seek out and kill any "orphan" vertices. These would be vertices owned
   // by tree nodes or by axial paths that aren't needed by any filled polygon.
-  KillOrphanVerticesAndCreases();
+  // There can only be new orphans if polys were built or killed.
+  if (polysChanged || polysKilled) {
+    TM_CLEANUP_STAGE(CLEANUP_ORPHANS, mVertices.size() + mCreases.size());
+    KillOrphanVerticesAndCreases();
+  }
   
   // Depth and bend will require that the root node be a tree node. No matter
   // what the user may have done with SetPartIndex<tmNode>(..), we'll move the
   // tree node with the lowest index to the first position in mNodes so that it
-  // will end up as the root node in what follows and after renumbering.
-  for (size_t i = 0; i < mNodes.size(); ++i) {
-    tmNode* theNode = mNodes[i];
-    if (theNode->IsTreeNode()) {
-      if (i == 0) break;
-      mNodes.MoveItem(i + 1, 1);
-      break;
+  // will end up as the root node in what follows and after renumbering. Part
+  // indices only change when parts are created or destroyed.
+  if (conditionsChanged || polysChanged || polysKilled) {
+    TM_CLEANUP_STAGE(CLEANUP_PART_INDICES, mNodes.size() + mEdges.size() + 
+      mPaths.size() + mPolys.size() + mVertices.size() + mCreases.size() + 
+      mFacets.size() + mConditions.size());
+    for (size_t i = 0; i < mNodes.size(); ++i) {
+      tmNode* theNode = mNodes[i];
+      if (theNode->IsTreeNode()) {
+        if (i == 0) break;
+        mNodes.MoveItem(i + 1, 1);
+        break;
+      }
     }
-  }
 
-  // Part construction/destruction is done. Renumber all part indices.
-  CalcPartIndices();
+    // Part construction/destruction is done. Renumber all part indices.
+    CalcPartIndices();
+  }
+  
+  // The crease pattern depends on path lengths, on the polys and their
+  // contents, and (through vertex depth) on the locations of nodes. If none of
+  // those changed, the crease pattern data from the last cleanup still holds.
+  if (!(lengthsChanged || polysChanged || polysKilled || 
+    dp.mMovedNodes.not_empty())) return;
   
   // Clear crease pattern data that will get recalculated later on if we don't
   // bail out first.
+  TM_CLEANUP_STAGE(CLEANUP_POLYGON_FILLED, mVertices.size() + 
+    mCreases.size() + mFacets.size() + mOwnedPolys.size());
+  mIsPolygonFilled = false;
+  mIsVertexDepthValid = false;
+  mIsFacetDataValid = false;
   for (size_t i = 0; i < mVertices.size(); ++i)
     mVertices[i]->ClearCleanupData();
   for (size_t i = 0; i < mCreases.size(); ++i)
     mCreases[i]->ClearCleanupData();
   for (size_t i = 0; i < mFacets.size(); ++i)
     mFacets[i]->ClearCleanupData();
-  // Our own flags were already cleared (up at the beginning of the routine).
   
   // Make sure that *all* tree polygons have contents (subpolys and creases);
   // if not, there's no point to trying to compute depth, bend, or any of the
@@ -2763,15 +3554,19 @@ void tmTree::CleanupAfterEdit()
   
   // Recalculate depth for all nodes and vertices and bend for all vertices and
   // creases.
+  TM_CLEANUP_STAGE(CLEANUP_DEPTH_AND_BEND, 
+    mPaths.size() + mVertices.size() + mCreases.size());
   CalcDepthAndBend();
   
   // Calculate vertex depth validity. If it's not valid, then we're done.
+  TM_CLEANUP_STAGE(CLEANUP_VERTEX_DEPTH, mVertices.size());
   CalcVertexDepthValidity();
   if (!mIsVertexDepthValid) return;
   
   // Check that all facets are well-formed and the crease pattern is
   // two-colorable. If not, then we can't proceed any farther with computing
   // facet ordering, color, or crease assignment.
+  TM_CLEANUP_STAGE(CLEANUP_FACET_DATA, mFacets.size());
   CalcFacetDataValidity();
   if (!mIsFacetDataValid) return;
 
@@ -2785,21 +3580,25 @@ void tmTree::CleanupAfterEdit()
 
   // For every facet, find the edge corresponding to the corridor that this
   // facet is part of.
+  TM_CLEANUP_STAGE(CLEANUP_CORRIDOR_EDGES, mFacets.size());
   CalcFacetCorridorEdges();
     
   // Once we have depth and bend and assurance that the facets are well-formed
   // and the crease pattern is two-colorable, we can proceed with the
   // construction of the facet ordering graph and the calculation of facet
   // order values.
+  TM_CLEANUP_STAGE(CLEANUP_FACET_ORDER, mFacets.size());
   CalcFacetOrder();
   if (!mIsLocalRootConnectable) return;
 
   // Compute the color orientation of all of the facets. This needs facet order
   // only to get the identity of the source facet in the facet ordering graph.
+  TM_CLEANUP_STAGE(CLEANUP_FACET_COLOR, mFacets.size());
   CalcFacetColor();
   
   // Compute the fold direction for all of the creases. This information comes
   // from the facet color and the facet order for the facets on either side of
   // each crease.
+  TM_CLEANUP_STAGE(CLEANUP_FOLD_DIRECTIONS, mCreases.size());
   CalcFoldDirections();
 }
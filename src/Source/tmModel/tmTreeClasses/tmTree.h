@@ -16,6 +16,8 @@ Copyright:    
 
 // Standard libraries
 #include <iostream>
+#include <vector>
+#include <map>
 
 // TreeMaker classes
 #include "tmModel_fwd.h"
@@ -29,6 +31,23 @@ Copyright:    
 #include "tmArray.h"
 #include "tmArrayIterator.h"
 #include "tmCondition.h"
+#include "tmTreeCleaner.h"
+
+
+/*
+The tree can record how long each stage of CleanupAfterEdit() takes, how many
+times it ran, and how many parts it processed, both for the most recent cleanup
+and cumulatively, so that we can see which stage dominates on large designs.
+#define TM_PROFILE_CLEANUP = 1 to include this support, 0 to disable it. It's on
+in profiling builds only, since debugging builds do extra work in cleanup that
+would distort the numbers.
+*/
+
+#if defined(TMPROFILE)
+  #define TM_PROFILE_CLEANUP 1
+#else
+  #define TM_PROFILE_CLEANUP 0
+#endif // defined(TMPROFILE)
 
 
 /**********
@@ -81,6 +100,159 @@ public:
       EX_IO_BAD_TOKEN(token) {};
   };    
 
+  // Parameters for MakeTreeRandom()
+  class RandomTreeSpec {
+    public:
+    unsigned long mSeed;            // seed of the generator
+    std::size_t mNumLeafNodes;      // number of leaf nodes (>= 2)
+    std::size_t mMinBranching;      // fewest children of a branch node (>= 1)
+    std::size_t mMaxBranching;      // most children of a branch node (>= 2)
+    tmFloat mMinEdgeLength;         // edge lengths are uniform in
+    tmFloat mMaxEdgeLength;         //   [mMinEdgeLength, mMaxEdgeLength]
+    tmFloat mStrainFraction;        // fraction of edges given a strain
+    tmFloat mMaxStrain;             // strains are uniform in +/-mMaxStrain
+    tmFloat mOnEdgeFraction;        // fraction of leaves on the paper edge
+    tmFloat mFixedFraction;         // fraction of leaves fixed in place
+    bool mSymmetric;                // mirror the tree about x = 0.5
+    bool mOptimizeScale;            // run the scale optimizer when done
+    bool mBuildCreasePattern;       // build polys and creases when done
+    RandomTreeSpec(std::size_t numLeafNodes = 16, unsigned long seed = 1) :
+      mSeed(seed), mNumLeafNodes(numLeafNodes), 
+      mMinBranching(2), mMaxBranching(4), 
+      mMinEdgeLength(0.5), mMaxEdgeLength(1.5), 
+      mStrainFraction(0.0), mMaxStrain(0.1), 
+      mOnEdgeFraction(0.0), mFixedFraction(0.0), 
+      mSymmetric(false), mOptimizeScale(false), 
+      mBuildCreasePattern(false) {};
+  };
+  
+  // The leaf paths that get a path constraint in the optimizers (those not
+  // made active by a tmConditionPathActive), with the positions of their end
+  // nodes and edges, so that back-to-back optimizations of the same structure
+  // don't have to work them out again. Only the structure is cached; lengths
+  // and locations should still be read from the parts. See GetLeafPathCache().
+  class LeafPathCache {
+  public:
+    tmDpptrArray<tmNode> mLeafNodes;    // leaf nodes, as from GetLeafNodes()
+    tmDpptrArray<tmEdge> mEdges;        // all owned edges
+    tmDpptrArray<tmPath> mPaths;        // constrained leaf paths, in order
+    std::vector<std::size_t> mNodes1;   // mLeafNodes position of front nodes
+    std::vector<std::size_t> mNodes2;   // mLeafNodes position of back nodes
+    std::vector<std::size_t> mEdgeStart;  // path i's edges are mPathEdges[
+    std::vector<std::size_t> mPathEdges;  //   mEdgeStart[i..i+1]) in mEdges
+    LeafPathCache() : mVersion(0), mNumActiveConditions(0) {};
+    std::size_t GetLeafNodePos(tmNode* aNode) const;
+    std::size_t GetEdgePos(tmEdge* aEdge) const;
+  private:
+    std::size_t mVersion;               // mStructureVersion when built
+    tmDpptrArray<tmCondition> mActiveConditions;  // tmConditionPathActives
+    std::size_t mNumActiveConditions;   // size of mActiveConditions when built
+    std::map<tmNode*, std::size_t> mLeafNodePos;  // position in mLeafNodes
+    std::map<tmEdge*, std::size_t> mEdgePos;      // position in mEdges
+    friend class tmTree;
+  };
+  
+  // The tree in rooted form, from which the routes of tree paths are computed
+  // on demand rather than stored in each path. Nodes are in depth-first order
+  // from the root, so that the subtree of a node occupies a contiguous range of
+  // positions and every parent comes before its children; each node records
+  // its own position in mRoutePos. A sparse table of the shallowest node in
+  // each power-of-two range of positions gives the lowest common ancestor of
+  // any two nodes, and with it the tree distance between them, in constant
+  // time. See GetPathRoutes() and GetPathDistances().
+  class PathRoutes {
+  public:
+    tmDpptrArray<tmNode> mNodes;        // owned nodes, depth-first from root
+    tmDpptrArray<tmEdge> mEdges;        // mEdges[i - 1] joins mNodes[i] and
+    std::vector<std::size_t> mParent;   //   its parent mNodes[mParent[i]]
+    std::vector<std::size_t> mDepth;    // number of edges up to the root
+    std::vector<std::size_t> mEnd;      // subtree of i is at [i, mEnd[i])
+    std::vector<tmFloat> mDistance;     // strained length up to the root
+    PathRoutes() : mVersion(0) {};
+    std::size_t GetAncestor(std::size_t i1, std::size_t i2) const;
+    tmFloat GetDistance(const tmNode* node1, const tmNode* node2) const;
+  private:
+    std::size_t mVersion;               // mStructureVersion when built
+    std::vector<std::vector<std::size_t> > mShallowest;  // [k][i]: least
+                                        //   depth in [i, i + 2^k)
+    std::vector<std::size_t> mLog2;     // floor(log2(n)) for range sizes n
+    friend class tmTree;
+  };
+  
+  // The conditions attached to each node, edge, and path, so that queries
+  // about the conditions on a part only look at that part's conditions rather
+  // than at every condition in the tree. Built from each condition's
+  // GetUsedParts(), in the order of mConditions. A part that has been deleted
+  // may linger in the index until it is next rebuilt, so callers should still
+  // confirm a match with Uses(). See GetConditionIndex().
+  class ConditionIndex {
+  public:
+    ConditionIndex() : mVersion(0), mNumConditions(0) {};
+    const tmArray<tmCondition*>& GetConditions(tmPart* aPart) const;
+  private:
+    std::size_t mVersion;               // mConditionVersion when built
+    tmDpptrArray<tmCondition> mConditions;  // the conditions indexed
+    std::size_t mNumConditions;         // size of mConditions when indexed
+    std::map<tmPart*, tmArray<tmCondition*> > mPartConditions;
+    static const tmArray<tmCondition*> sNoConditions;
+    friend class tmTree;
+  };
+
+  // What has changed since the last cleanup, so that CleanupAfterEdit() only
+  // recomputes what depends on it. Each tmTreeCleaner marks the kind of edit
+  // that it brackets (see tmTreeCleaner::Scope), and edits that move nodes also
+  // record the nodes that moved. Edge lengths and the scale aren't recorded
+  // part by part, since a change to either one changes the length of every
+  // path that runs through it. mAnyPartChanged calls for a full cleanup.
+  class DirtyParts {
+  public:
+    DirtyParts() {MarkAll();};
+    void MarkAll();
+    void MarkNodeMoved(tmNode* aNode);
+    void Clear();
+  private:
+    bool mAnyPartChanged;               // anything at all, e.g., topology
+    bool mPathLengthsChanged;           // scale, edge lengths or strains
+    bool mConditionsChanged;            // conditions made, killed, or edited
+    bool mPolysChanged;                 // polys built or killed
+    tmDpptrArray<tmNode> mMovedNodes;   // nodes whose location changed
+    friend class tmTree;
+    friend class tmTreeCleaner;
+  };
+
+#if TM_PROFILE_CLEANUP
+  // Cleanup profiling
+  enum CleanupStage {
+    CLEANUP_CONDITIONS,         // delete invalid conditions
+    CLEANUP_NODES_AND_EDGES,    // clamp nodes, clear node and edge flags
+    CLEANUP_PATH_LENGTHS,       // TreePathCalcLengths() for all owned paths
+    CLEANUP_FEASIBILITY,        // leaf path and condition feasibility
+    CLEANUP_CONDITIONED_FLAGS,  // mark conditioned nodes, edges, and paths
+    CLEANUP_BORDER,             // CalcBorderNodesAndPaths()
+    CLEANUP_PINNED,             // CalcPinnedNodesAndEdges()
+    CLEANUP_POLYGON_NETWORK,    // CalcPolygonNetwork(), KillInvalidPolys()
+    CLEANUP_POLYGON_VALIDITY,   // CalcPolygonValidity()
+    CLEANUP_ORPHANS,            // KillOrphanVerticesAndCreases()
+    CLEANUP_PART_INDICES,       // CalcPartIndices()
+    CLEANUP_POLYGON_FILLED,     // clearing CP data and CalcPolygonFilled()
+    CLEANUP_DEPTH_AND_BEND,     // CalcDepthAndBend()
+    CLEANUP_VERTEX_DEPTH,       // CalcVertexDepthValidity()
+    CLEANUP_FACET_DATA,         // CalcFacetDataValidity()
+    CLEANUP_CORRIDOR_EDGES,     // CalcFacetCorridorEdges()
+    CLEANUP_FACET_ORDER,        // CalcFacetOrder()
+    CLEANUP_FACET_COLOR,        // CalcFacetColor()
+    CLEANUP_FOLD_DIRECTIONS,    // CalcFoldDirections()
+    NUM_CLEANUP_STAGES
+  };
+  class CleanupStats {
+  public:
+    std::size_t mNumCalls;      // number of times the stage ran
+    double mTime;               // wall-clock time in the stage, in seconds
+    std::size_t mNumParts;      // number of parts the stage processed
+    CleanupStats() : mNumCalls(0), mTime(0.0), mNumParts(0) {};
+  };
+#endif // TM_PROFILE_CLEANUP
+
   // Ctor/dtor
   void InitTree();
   tmTree();
@@ -248,8 +420,45 @@ public:
     // without attempting facet order and not have to rebuild in between.
     return mQuitCleanupEarly;
   }
+  bool GetCheckIncrementalCleanup() const {
+    // In debugging builds, we can set the mCheckIncrementalCleanup flag, which
+    // tells tmTree::CleanupAfterEdit() to follow each cleanup that only redid
+    // part of its work with a full one and assert that the two agree.
+    return mCheckIncrementalCleanup;
+  }
+  bool GetRecordDumpState() const {
+    // In debugging builds, the tree records its state in global streams at
+    // the start of each cleanup and crease pattern build, for dumping if an
+    // assertion fails. Trees that are cleaned up on several threads at once
+    // should clear this flag, since the streams are shared.
+    return mRecordDumpState;
+  }
 #endif // TMDEBUG
 
+  // Cleanup profiling
+#if TM_PROFILE_CLEANUP
+  static const char* GetCleanupStageName(CleanupStage stage);
+  const CleanupStats& GetLastCleanupStats(CleanupStage stage) const {
+    // Return the statistics of the given stage from the most recent cleanup.
+    return mLastCleanupStats[stage];
+  };
+  const CleanupStats& GetTotalCleanupStats(CleanupStage stage) const {
+    // Return the statistics of the given stage summed over all cleanups since
+    // construction or the last call to ResetCleanupStats().
+    return mTotalCleanupStats[stage];
+  };
+  const CleanupStats& GetLastCleanupStats() const {
+    // Return the statistics of the most recent cleanup as a whole.
+    return mLastCleanupStats[NUM_CLEANUP_STAGES];
+  };
+  const CleanupStats& GetTotalCleanupStats() const {
+    // Return the statistics of all cleanups as a whole.
+    return mTotalCleanupStats[NUM_CLEANUP_STAGES];
+  };
+  void ResetCleanupStats();
+  void LogCleanupStats() const;
+#endif // TM_PROFILE_CLEANUP
+
   // Named queries about size
   std::size_t GetNumNodes() const {return mNodes.size();};
   std::size_t GetNumEdges() const {return mEdges.size();};
@@ -276,6 +485,12 @@ public:
   void SetQuitCleanupEarly(bool quitCleanupEarly) {
     mQuitCleanupEarly = quitCleanupEarly;
   }
+  void SetCheckIncrementalCleanup(bool checkIncrementalCleanup) {
+    mCheckIncrementalCleanup = checkIncrementalCleanup;
+  }
+  void SetRecordDumpState(bool recordDumpState) {
+    mRecordDumpState = recordDumpState;
+  }
 #endif // TMDEBUG
 
   // Misc queries
@@ -305,6 +520,7 @@ public:
   static tmTree* MakeTreeOptimized();
   static tmTree* MakeTreeGusset();
   static tmTree* MakeTreeConditioned();
+  static tmTree* MakeTreeRandom(const RandomTreeSpec& spec);
 
   // Topological modification
   void AddNode(tmNode* fromNode, const tmPoint& where, 
@@ -358,6 +574,8 @@ public:
   void RelieveStrain(tmArray<tmEdge*>& aEdgeList);
   void RelieveAllStrain();
   void PerturbNodes(const tmArray<tmNode*>& aNodeList);
+  void PerturbNodes(const tmArray<tmNode*>& aNodeList, unsigned long seed,
+    const tmFloat& size);
   bool CanPerturbAllNodes() const;
   void PerturbAllNodes();
   
@@ -369,6 +587,10 @@ public:
     tmArray<tmEdge*>& aEdgeList);
   void GetSpanningPaths(const tmArray<tmNode*>& aNodeList, 
     tmArray<tmPath*>& aPathList);
+  const LeafPathCache& GetLeafPathCache();
+  const PathRoutes& GetPathRoutes();
+  const PathRoutes& GetPathDistances();
+  const ConditionIndex& GetConditionIndex();
   template <class C, class P>
     void GetAffectingConditions(P* const p, 
       tmArray<C*>& aConditionList);
@@ -462,6 +684,38 @@ private:
   bool mIsFacetDataValid;
   bool mIsLocalRootConnectable;
   bool mNeedsCleanup;
+  
+  // Structure cached for the optimizers. mStructureVersion counts additions of
+  // nodes, edges, and conditions; deletions show up as parts disappearing
+  // from the dangle-proof arrays of the cache.
+  std::size_t mStructureVersion;
+  LeafPathCache mLeafPathCache;
+  void StructureChanged() {
+    // Invalidate the structure cached for the optimizers.
+    ++mStructureVersion;};
+  
+  // Conditions indexed by part. mConditionVersion counts changes to the parts
+  // that conditions use and to their order; new conditions are indexed as they
+  // show up at the end of mConditions, and deletions show up as conditions
+  // disappearing from the dangle-proof array of the index.
+  std::size_t mConditionVersion;
+  ConditionIndex mConditionIndex;
+  void ConditionsChanged() {
+    // Invalidate the index of conditions by part.
+    ++mConditionVersion;};
+  
+  // What has changed since the last cleanup, and the number of infeasible leaf
+  // paths as of the last cleanup, which lets a cleanup after moving a few
+  // nodes update the feasibility of the tree from just their leaf paths.
+  DirtyParts mDirtyParts;
+  std::size_t mNumInfeasiblePaths;
+  
+  // Routes of tree paths, which are only rebuilt when the topology changes
+  PathRoutes mPathRoutes;
+  void GetPathRoute(tmNode* node1, tmNode* node2, tmArray<tmNode*>* nodeList,
+    tmArray<tmEdge*>* edgeList);
+  bool PathRouteContains(tmNode* node1, tmNode* node2, tmNode* aNode);
+  bool PathRouteContains(tmNode* node1, tmNode* node2, tmEdge* aEdge);
 
   // Ownership
   tmTree* NodeOwnerAsTree() {return this;};
@@ -474,7 +728,37 @@ private:
   // Debugging flags (used for runtime switching)
 #ifdef TMDEBUG
   bool mQuitCleanupEarly;
+  bool mCheckIncrementalCleanup;
+  bool mRecordDumpState;
 #endif // TMDEBUG
+
+  // Cleanup profiling. The extra element at the end of each array holds the
+  // statistics for the cleanup as a whole.
+#if TM_PROFILE_CLEANUP
+  CleanupStats mLastCleanupStats[NUM_CLEANUP_STAGES + 1];
+  CleanupStats mTotalCleanupStats[NUM_CLEANUP_STAGES + 1];
+  std::size_t mCurCleanupStage;   // stage in progress, or NUM_CLEANUP_STAGES
+  double mCurCleanupStageStart;   // time the stage in progress started
+  double mCurCleanupStart;        // time the cleanup in progress started
+  void StartCleanupProfile();
+  void StartCleanupStage(CleanupStage stage, std::size_t numParts);
+  void StopCleanupStage();
+  void StopCleanupProfile();
+  class CleanupProfiler {
+    // Stack object that brackets a call to CleanupAfterEdit(), so that the
+    // profile gets closed out no matter where cleanup returns.
+  public:
+    CleanupProfiler(tmTree* aTree) : mTree(aTree) {
+      mTree->StartCleanupProfile();
+    };
+    ~CleanupProfiler() {
+      mTree->StopCleanupProfile();
+    };
+  private:
+    tmTree* mTree;
+  };
+  friend class CleanupProfiler;
+#endif // TM_PROFILE_CLEANUP
   
   // Instantaneous index of a part -- only used in debugging
 #ifdef TMDEBUG
@@ -546,9 +830,11 @@ template <class P>
     tmArray<tmPath*>& leafPaths);
   void CalcPolygonNetwork(tmArray<tmNode*>& leafNodes, 
     tmArray<tmPath*>& leafPaths);
+  void KillInvalidPolys(const tmArray<tmNode*>* movedLeafNodes);
   void CalcPolygonValidity(tmArray<tmNode*>& leafNodes);
   void KillOrphanVerticesAndCreases();
   void CalcPartIndices();
+  void RebuildPathIndices();
   void CalcPolygonFilled();
   void CalcDepthAndBend();
   void CalcVertexDepthValidity();
@@ -561,6 +847,11 @@ template <class P>
   void CalcFacetOrder();
   void CalcFoldDirections();
   void CleanupAfterEdit();
+  void CleanupDirtyParts();
+  
+  // Random test trees
+  void AddRandomLeafConditions(const tmArray<tmRandomTreeNode>& recs, 
+    const tmArray<tmNode*>& nodes);
   
   // Hide ancestor functions
   void ClearAllParts();
@@ -658,17 +949,22 @@ void tmTree::SetPartIndex(P* p, std::size_t n)
 
 
 /*****
-Return a list of all conditions of type C that affect the given part.
+Return a list of all conditions of type C that affect the given part. Only the
+conditions attached to the part are examined.
 *****/
 template <class C, class P>
 void tmTree::GetAffectingConditions(P* const p, 
   tmArray<C*>& aConditionList)
 {
   aConditionList.clear();
-  C* aCondition;
-  tmArrayIterator<C*> iConditions(mConditions);
-  while (iConditions.Next(&aCondition))
-    if (aCondition->Uses(p)) aConditionList.push_back(aCondition);
+  const tmArray<tmCondition*>& partConditions = 
+    GetConditionIndex().GetConditions(p);
+  for (std::size_t i = 0; i < partConditions.size(); ++i) {
+    tmCondition* c = partConditions[i];
+    if (!c->Uses(p)) continue;
+    C* cc = dynamic_cast<C*>(c);
+    if (cc) aConditionList.push_back(cc);
+  }
 }
 
 
@@ -678,10 +974,12 @@ Return true if this part has a condition of type C.
 template <class C, class P>
 bool tmTree::IsConditioned(P* p) 
 {
-  tmCondition* aCondition;
-  tmArrayIterator<tmCondition*> iConditions(mConditions);
-  while (iConditions.Next(&aCondition))
-    if (dynamic_cast<C*>(aCondition) && aCondition->Uses(p)) return true;
+  const tmArray<tmCondition*>& partConditions = 
+    GetConditionIndex().GetConditions(p);
+  for (std::size_t i = 0; i < partConditions.size(); ++i) {
+    tmCondition* c = partConditions[i];
+    if (dynamic_cast<C*>(c) && c->Uses(p)) return true;
+  }
   return false;
 }
 
@@ -692,7 +990,7 @@ Create a tmCondition on a tmPart.
 template <class C, class P>
 C* tmTree::MakeOnePartCondition(P* p)
 {
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   return new C(this, p);
 }
 
@@ -703,8 +1001,10 @@ Either find or create a condition of the given type on the specified part.
 template <class C, class P>
 C* tmTree::GetOrMakeOnePartCondition(P* p)
 {
-  for (size_t i = 0; i < mConditions.size(); ++i) {
-    tmCondition* c = mConditions[i];
+  const tmArray<tmCondition*>& partConditions = 
+    GetConditionIndex().GetConditions(p);
+  for (std::size_t i = 0; i < partConditions.size(); ++i) {
+    tmCondition* c = partConditions[i];
     if (c->Uses(p)) {
       C* cc = dynamic_cast<C*>(c);
       if (cc)
@@ -724,7 +1024,7 @@ void tmTree::MakeOnePartCondition(const tmArray<P*>& plist, tmArray<C*>& clist)
 {
   if (plist.empty()) return;
   clist.clear();
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (std::size_t i = 0; i < plist.size(); ++i)
     clist.push_back(MakeOnePartCondition<C, P>(plist[i]));
 }
@@ -741,7 +1041,7 @@ void tmTree::GetOrMakeOnePartCondition(const tmArray<P*>& plist,
 {
   if (plist.empty()) return;
   clist.clear();
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   for (std::size_t i = 0; i < plist.size(); ++i)
     clist.push_back(GetOrMakeOnePartCondition<C, P>(plist[i]));
 }
@@ -754,7 +1054,7 @@ template <class C, class P>
 C* tmTree::MakeTwoPartCondition(P* p1, P* p2)
 {
   TMASSERT(p1 != p2);
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   return new C(this, p1, p2);
 }
 
@@ -766,8 +1066,10 @@ template <class C, class P>
 C* tmTree::GetOrMakeTwoPartCondition(P* p1, P* p2)
 {
   TMASSERT(p1 != p2);
-  for (size_t i = 0; i < mConditions.size(); ++i) {
-    tmCondition* c = mConditions[i];
+  const tmArray<tmCondition*>& partConditions = 
+    GetConditionIndex().GetConditions(p1);
+  for (std::size_t i = 0; i < partConditions.size(); ++i) {
+    tmCondition* c = partConditions[i];
     if (c->Uses(p1) && c->Uses(p2)) {
       C* cc = dynamic_cast<C*>(c);
       if (cc)
@@ -785,7 +1087,7 @@ template <class C, class P>
 C* tmTree::MakeThreePartCondition(P* p1, P* p2, P* p3)
 {
   TMASSERT((p1 != p2) && (p2 != p3));
-  tmTreeCleaner tc(this);
+  tmTreeCleaner tc(this, tmTreeCleaner::CONDITIONS);
   return new C(this, p1, p2, p3);
 }
 
@@ -797,8 +1099,10 @@ template <class C, class P>
 C* tmTree::GetOrMakeThreePartCondition(P* p1, P* p2, P* p3)
 {
   TMASSERT((p1 != p2) && (p2 != p3));
-  for (size_t i = 0; i < mConditions.size(); ++i) {
-    tmCondition* c = mConditions[i];
+  const tmArray<tmCondition*>& partConditions = 
+    GetConditionIndex().GetConditions(p1);
+  for (std::size_t i = 0; i < partConditions.size(); ++i) {
+    tmCondition* c = partConditions[i];
     if (c->Uses(p1) && c->Uses(p2) && c->Uses(p3)) {
       C* cc = dynamic_cast<C*>(c);
       if (cc)
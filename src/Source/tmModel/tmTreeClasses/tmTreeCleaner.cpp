@@ -38,6 +38,16 @@ only called once when the outermost tmTreeCleaner is destructed.
 
 Consequently, you should NEVER create a tmTreeCleaner on the heap (via new()),
 because that circumvents the entire system and Bad Things Will Happen.
+
+The optional Scope argument tells the cleanup how much of the tree the edits
+within the scope of the tmTreeCleaner could have changed. The default,
+ANY_PART, makes CleanupAfterEdit() recompute everything. Edits that only
+affect conditions, polys, or the lengths of paths say so, and edits that move
+nodes use DIRTY_PARTS and record the nodes they moved in the tree (see
+tmTree::DirtyParts), so that the cleanup only recomputes what depends on those
+nodes. Since scopes accumulate until the cleanup, a tmTreeCleaner with a narrow
+scope nested inside one with a broader scope (or vice versa) still gets
+everything cleaned up that needs it.
   
 HOW IT WORKS
 
@@ -57,13 +67,31 @@ A stack class that handles cleaning up a tmTree after editing
 **********/
   
 /*****
-Record the tmTree and its state of dirty
+Record the tmTree and its state of dirty, and mark what the edits within our
+scope can change.
 *****/
-tmTreeCleaner::tmTreeCleaner(tmTree* aTree)
+tmTreeCleaner::tmTreeCleaner(tmTree* aTree, Scope aScope)
 {
   mTree = aTree;
   mTreeNeededCleanup = mTree->mNeedsCleanup;
   mTree->mNeedsCleanup = true;
+  tmTree::DirtyParts& dp = mTree->mDirtyParts;
+  switch (aScope) {
+    case ANY_PART:
+      dp.MarkAll();
+      break;
+    case CONDITIONS:
+      dp.mConditionsChanged = true;
+      break;
+    case POLYS:
+      dp.mPolysChanged = true;
+      break;
+    case PATH_LENGTHS:
+      dp.mPathLengthsChanged = true;
+      break;
+    case DIRTY_PARTS:
+      break;
+  }
 }
 
 
@@ -24,7 +24,19 @@ A stack class that handles cleaning up a tmTree after editing
 **********/
 class tmTreeCleaner {
 public:
-  tmTreeCleaner(tmTree* aTree);
+  // What the edits made within the scope of the cleaner can change, which
+  // tells the cleanup what it has to recompute
+  enum Scope {
+    ANY_PART,     // anything at all, so everything gets recomputed
+    CONDITIONS,   // conditions are created, deleted, or edited
+    POLYS,        // polys and crease pattern are built or killed
+    PATH_LENGTHS, // the scale or edge lengths or strains, and with them the
+                  //   length of every path
+    DIRTY_PARTS   // only the parts that the edits mark as dirty, i.e., moved
+                  //   nodes, or nothing at all
+  };
+  
+  tmTreeCleaner(tmTree* aTree, Scope aScope = ANY_PART);
   ~tmTreeCleaner();
   
   tmTree* GetTree() const {
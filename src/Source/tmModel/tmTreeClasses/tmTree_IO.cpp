@@ -139,6 +139,9 @@ void tmTree::GetSelf(istream& is)
       KillAllParts();
     }
     Getv5Self(is);
+    // Getv5Self() reads the results of a cleanup that we didn't do ourselves,
+    // so the next cleanup has to be a full one.
+    mDirtyParts.MarkAll();
   }
   else throw EX_IO_BAD_TREE_VERSION(version);
 }
@@ -325,6 +328,7 @@ void tmTree::Getv5Self(istream& is)
   GetPtrArray(is, mOwnedEdges);
   GetPtrArray(is, mOwnedPaths);
   GetPtrArray(is, mOwnedPolys);
+  RebuildPathIndex();
   
   // Eat remaining newlines/whitespace. We don't set eof because we'll not care
   // about extra characters, and we want to be able to re-use is if it's a
@@ -526,6 +530,12 @@ void tmTree::Getv4Self(istream& is)
   for (size_t i = 0; i < numVertices; ++i) mVertices[i]->Getv4Self(is);
   for (size_t i = 0; i < numCreases; ++i) mCreases[i]->Getv4Self(is);
   
+  // Version 4 conditions look up their paths by their nodes, but the list of
+  // owned paths comes later in the stream, so we index our paths now from
+  // their owner pointers.
+  for (size_t i = 0; i < numPaths; ++i)
+    if (mPaths[i]->mPathOwner == this) AddPathToIndex(mPaths[i]);
+  
   // Conditions are special; some might have been ignored
   for (size_t i = 0; i < numConditions; ++i) Makev4Condition(is);
 
@@ -534,6 +544,7 @@ void tmTree::Getv4Self(istream& is)
   GetPtrArray(is, mOwnedEdges);
   GetPtrArray(is, mOwnedPaths);
   GetPtrArray(is, mOwnedPolys);
+  RebuildPathIndex();
   
   // Eat remaining newlines/whitespace
   ConsumeTrailingSpace(is);
@@ -20,6 +20,159 @@ This file contains several routines for creating various
 dummy trees that can be used for debugging.
 */
 
+
+#ifdef __MWERKS__
+  #pragma mark --PRIVATE--
+#endif
+
+
+/**********
+class tmRandomGen
+Simple linear congruential generator, used instead of rand() so that random
+trees come out the same on every platform for a given seed.
+**********/
+class tmRandomGen {
+public:
+  tmRandomGen(unsigned long seed) : mState(seed & 0x7fffffffUL) {};
+  tmFloat Uniform() {
+    // Return a random number in [0, 1).
+    mState = (mState * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return tmFloat(mState) / 2147483648.0;};
+  tmFloat Uniform(const tmFloat& a, const tmFloat& b) {
+    // Return a random number in [a, b).
+    return a + (b - a) * Uniform();};
+  size_t Index(size_t n) {
+    // Return a random index in [0, n).
+    return size_t(Uniform() * n) % n;};
+  bool Chance(const tmFloat& p) {
+    // Return true with probability p.
+    return Uniform() < p;};
+private:
+  unsigned long mState;
+};
+
+
+/**********
+class tmRandomTreeNode
+Description of one node of a randomly-generated subtree, recorded before any
+nodes are created so that the same subtree can be built more than once (e.g.,
+as the two halves of a symmetric tree).
+**********/
+class tmRandomTreeNode {
+public:
+  size_t mParent;             // index of parent record, or NO_PARENT
+  tmPoint mLoc;               // location of the node
+  tmFloat mLength;            // length of the edge to the parent
+  tmFloat mStrain;            // strain of the edge to the parent
+  bool mIsLeaf;               // true if no other record has this as parent
+  bool mOnEdge;               // true = give a leaf a tmConditionNodeOnEdge
+  bool mFixed;                // true = give a leaf a tmConditionNodeFixed
+  enum {NO_PARENT = size_t(-1)};
+};
+
+
+/*****
+Append to recs a random subtree with exactly numLeaves leaf nodes, hanging
+from an existing node (NO_PARENT). Branch nodes get between mMinBranching and
+mMaxBranching children, except where fewer are needed to hit numLeaves. Node x
+coordinates are drawn from [xmin, xmax).
+*****/
+static void GrowRandomSubtree(tmRandomGen& rng, 
+  const tmTree::RandomTreeSpec& spec, size_t numLeaves, const tmFloat& xmin, 
+  const tmFloat& xmax, tmArray<tmRandomTreeNode>& recs)
+{
+  size_t start = recs.size();
+  tmArray<size_t> frontier;    // records that are currently leaves
+  size_t curLeaves = 0;
+  size_t firstChildren = (numLeaves == 1) ? 1 : 0;
+  tmRandomTreeNode rec;
+  rec.mParent = tmRandomTreeNode::NO_PARENT;
+  for (;;) {
+    // Decide how many children the next node gets. The first pass hangs a
+    // single edge off of the existing node unless more than one leaf is
+    // needed, in which case it hangs a whole fan.
+    size_t numKids;
+    if (curLeaves == 0) {
+      numKids = firstChildren;
+      if (numKids == 0) {
+        numKids = spec.mMinBranching + 
+          rng.Index(spec.mMaxBranching - spec.mMinBranching + 1);
+        if (numKids < 2) numKids = 2;
+        if (numKids > numLeaves) numKids = numLeaves;
+      }
+      curLeaves = numKids;
+    }
+    else {
+      if (curLeaves >= numLeaves) break;
+      size_t fi = rng.Index(frontier.size());
+      rec.mParent = frontier[fi];
+      frontier.erase(frontier.begin() + fi);
+      numKids = spec.mMinBranching + 
+        rng.Index(spec.mMaxBranching - spec.mMinBranching + 1);
+      if (numKids > numLeaves - curLeaves + 1) 
+        numKids = numLeaves - curLeaves + 1;
+      curLeaves += numKids - 1;
+    }
+    for (size_t i = 0; i < numKids; ++i) {
+      tmRandomTreeNode kid;
+      kid.mParent = rec.mParent;
+      kid.mLoc.x = rng.Uniform(xmin, xmax);
+      kid.mLoc.y = rng.Uniform();
+      kid.mLength = rng.Uniform(spec.mMinEdgeLength, spec.mMaxEdgeLength);
+      kid.mStrain = rng.Chance(spec.mStrainFraction) ? 
+        rng.Uniform(-spec.mMaxStrain, spec.mMaxStrain) : 0.0;
+      kid.mIsLeaf = false;
+      kid.mOnEdge = false;
+      kid.mFixed = false;
+      frontier.push_back(recs.size());
+      recs.push_back(kid);
+    }
+    if (firstChildren == 1) break;
+  }
+  
+  // The frontier is now exactly the set of leaves; assign leaf conditions.
+  TMASSERT(frontier.size() == numLeaves);
+  for (size_t i = 0; i < frontier.size(); ++i)
+    recs[frontier[i]].mIsLeaf = true;
+  for (size_t i = start; i < recs.size(); ++i) {
+    if (!recs[i].mIsLeaf) continue;
+    recs[i].mOnEdge = rng.Chance(spec.mOnEdgeFraction);
+    recs[i].mFixed = !recs[i].mOnEdge && rng.Chance(spec.mFixedFraction);
+  }
+}
+
+
+/*****
+Create the nodes and edges described by recs, hanging the top-level records
+from fromNode. If mirror is true, x coordinates are reflected about x = 0.5.
+The new nodes are returned in the same order as recs. Leaf conditions are left
+to the caller, since only tmTree can create conditions.
+*****/
+static void BuildRandomSubtree(tmTree* theTree, tmNode* fromNode, 
+  const tmArray<tmRandomTreeNode>& recs, bool mirror, 
+  tmArray<tmNode*>& newNodes)
+{
+  newNodes.clear();
+  for (size_t i = 0; i < recs.size(); ++i) {
+    const tmRandomTreeNode& rec = recs[i];
+    tmPoint loc = rec.mLoc;
+    if (mirror) loc.x = 1.0 - loc.x;
+    tmNode* parent = (rec.mParent == tmRandomTreeNode::NO_PARENT) ? 
+      fromNode : newNodes[rec.mParent];
+    tmNode* newNode;
+    tmEdge* newEdge;
+    theTree->AddNode(parent, loc, newNode, newEdge);
+    newEdge->SetLength(rec.mLength);
+    newEdge->SetStrain(rec.mStrain);
+    newNodes.push_back(newNode);
+  }
+}
+
+
+#ifdef __MWERKS__
+  #pragma mark --PUBLIC--
+#endif
+
 /*****
 tmTree* tmTree::MakeTreeBlank()
 Create a new blank tree (no nodes or edges)
@@ -29,6 +182,7 @@ tmTree* tmTree::MakeTreeBlank()
   tmTree* theTree = new tmTree();
   TMASSERT(theTree);
   theTree->mScale = 0.1;
+  theTree->mDirtyParts.MarkAll();
   theTree->CleanupAfterEdit();
   return theTree;
 }
@@ -101,6 +255,7 @@ tmTree* tmTree::MakeTreeUnoptimized()
   
   // Set the scale to a small enough value that insures all paths are valid.
   theTree->mScale = 0.1;
+  theTree->mDirtyParts.MarkAll();
   theTree->CleanupAfterEdit();
   
   return theTree;
@@ -171,6 +326,7 @@ tmTree* tmTree::MakeTreeOptimized()
   strcpy(aEdge7->mLabel, "edge7");
   
   theTree->mScale = 0.266949;
+  theTree->mDirtyParts.MarkAll();
   theTree->CleanupAfterEdit();
   return theTree;
 }
@@ -219,6 +375,7 @@ tmTree* tmTree::MakeTreeGusset()
   aEdge4->mLength = 0.6;
 
   theTree->mScale = 1.0;
+  theTree->mDirtyParts.MarkAll();
   theTree->CleanupAfterEdit();
   return theTree;
 }
@@ -287,6 +444,133 @@ tmTree* tmTree::MakeTreeConditioned()
   
   // Set the scale to something that makes tmNode circles visible
   theTree->mScale = 0.1;
+  theTree->mDirtyParts.MarkAll();
   theTree->CleanupAfterEdit();
   return theTree;
 }
+
+
+/*****
+tmTree* tmTree::MakeTreeRandom(const RandomTreeSpec& spec)
+Create a random tree as described by spec, for testing how the model scales
+with tree size. The same spec (including the seed) always produces the same
+tree. Nodes are scattered at random over a unit square and the scale is set to
+the largest value for which every leaf path is feasible, so the tree starts
+out in a state that the optimizers can work from. If the spec is symmetric,
+the two halves of the tree are mirror images of each other about x = 0.5;
+mirrored leaf nodes are paired and an odd leaf is placed on the symmetry line.
+Optionally, the scale optimizer is run and the crease pattern is built; if
+the optimizer fails, the tree is returned as it was before the attempt.
+*****/
+tmTree* tmTree::MakeTreeRandom(const RandomTreeSpec& spec)
+{
+  TMASSERT(spec.mNumLeafNodes >= 2);
+  TMASSERT(spec.mMinBranching >= 1);
+  TMASSERT(spec.mMaxBranching >= 2);
+  TMASSERT(spec.mMinBranching <= spec.mMaxBranching);
+  TMASSERT(spec.mMinEdgeLength > 0);
+  TMASSERT(spec.mMinEdgeLength <= spec.mMaxEdgeLength);
+  
+  tmTree* theTree = new tmTree();
+  TMASSERT(theTree);
+  tmRandomGen rng(spec.mSeed);
+  {
+    // Do all of the construction inside one tmTreeCleaner so that the tree
+    // only gets cleaned up once.
+    tmTreeCleaner tc(theTree);
+    tmNode* rootNode;
+    tmEdge* rootEdge;
+    tmArray<tmRandomTreeNode> recs;
+    tmArray<tmNode*> newNodes;
+    if (!spec.mSymmetric) {
+      theTree->AddNode(NULL, tmPoint(rng.Uniform(), rng.Uniform()), 
+        rootNode, rootEdge);
+      GrowRandomSubtree(rng, spec, spec.mNumLeafNodes, 0.0, 1.0, recs);
+      BuildRandomSubtree(theTree, rootNode, recs, false, newNodes);
+      theTree->AddRandomLeafConditions(recs, newNodes);
+    }
+    else {
+      theTree->mHasSymmetry = true;
+      theTree->mSymLoc = tmPoint(0.5, 0.5);
+      theTree->mSymAngle = 90.0;
+      theTree->AddNode(NULL, tmPoint(0.5, rng.Uniform()), rootNode, 
+        rootEdge);
+      
+      // An odd leaf goes on the symmetry line.
+      if (spec.mNumLeafNodes % 2 == 1) {
+        tmNode* axialNode;
+        tmEdge* axialEdge;
+        theTree->AddNode(rootNode, tmPoint(0.5, rng.Uniform()), axialNode, 
+          axialEdge);
+        axialEdge->SetLength(
+          rng.Uniform(spec.mMinEdgeLength, spec.mMaxEdgeLength));
+        new tmConditionNodeSymmetric(theTree, axialNode);
+      }
+      
+      // Build the left half, then its mirror image, and pair up the leaves.
+      GrowRandomSubtree(rng, spec, spec.mNumLeafNodes / 2, 0.0, 0.5, recs);
+      tmArray<tmNode*> leftNodes;
+      BuildRandomSubtree(theTree, rootNode, recs, false, leftNodes);
+      BuildRandomSubtree(theTree, rootNode, recs, true, newNodes);
+      theTree->AddRandomLeafConditions(recs, leftNodes);
+      theTree->AddRandomLeafConditions(recs, newNodes);
+      for (size_t i = 0; i < recs.size(); ++i)
+        if (recs[i].mIsLeaf)
+          new tmConditionNodesPaired(theTree, leftNodes[i], newNodes[i]);
+    }
+  }
+  
+  // Now that path lengths are known, pick the largest feasible scale.
+  tmFloat newScale = 0.0;
+  for (size_t i = 0; i < theTree->mPaths.size(); ++i) {
+    tmPath* thePath = theTree->mPaths[i];
+    if (!thePath->IsLeafPath() || thePath->mMinTreeLength <= 0) continue;
+    tmFloat pathScale = thePath->mActPaperLength / thePath->mMinTreeLength;
+    if (newScale == 0.0 || pathScale < newScale) newScale = pathScale;
+  }
+  if (newScale > 0.0) theTree->SetScale(0.999 * newScale);
+  
+  if (spec.mOptimizeScale) {
+    tmNLCO* theNLCO = tmNLCO::MakeNLCO();
+    tmArray<tmPoint> oldLocs;
+    for (size_t i = 0; i < theTree->mNodes.size(); ++i)
+      oldLocs.push_back(theTree->mNodes[i]->mLoc);
+    tmFloat oldScale = theTree->mScale;
+    try {
+      tmScaleOptimizer theOptimizer(theTree, theNLCO);
+      theOptimizer.Initialize();
+      theOptimizer.Optimize();
+    }
+    catch(...) {
+      tmTreeCleaner tc(theTree);
+      for (size_t i = 0; i < theTree->mNodes.size(); ++i)
+        theTree->mNodes[i]->mLoc = oldLocs[i];
+      theTree->mScale = oldScale;
+    }
+    delete theNLCO;
+  }
+  if (spec.mBuildCreasePattern)
+    theTree->BuildPolysAndCreasePattern();
+  return theTree;
+}
+
+
+/*****
+void tmTree::AddRandomLeafConditions(const tmArray<tmRandomTreeNode>& recs, 
+  const tmArray<tmNode*>& nodes)
+Add the leaf conditions called for by recs to the corresponding nodes, which
+were created from recs by MakeTreeRandom().
+*****/
+void tmTree::AddRandomLeafConditions(const tmArray<tmRandomTreeNode>& recs, 
+  const tmArray<tmNode*>& nodes)
+{
+  TMASSERT(recs.size() == nodes.size());
+  for (size_t i = 0; i < recs.size(); ++i) {
+    tmNode* theNode = nodes[i];
+    if (recs[i].mOnEdge)
+      new tmConditionNodeOnEdge(this, theNode);
+    if (recs[i].mFixed)
+      new tmConditionNodeFixed(this, theNode, true, theNode->mLoc.x, 
+        true, theNode->mLoc.y);
+  }
+}
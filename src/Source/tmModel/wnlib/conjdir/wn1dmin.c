@@ -41,22 +41,24 @@ void wn_minimize_1d(pval_min,px_min,x_start,pfunction)
 #define BUF_MID_INDEX (BUF_RADIUS-1)
 
 
-/* function data known so far */
-local double xs_buf[BUF_SIZE];
-local double fs_buf[BUF_SIZE];
-local double low_x_max_offshifted_f,high_x_max_offshifted_f;
-local double low_x,high_x;
+/* function data known so far; per-thread, so that line searches on
+  different threads don't share it */
+local WN_THREAD_LOCAL double xs_buf[BUF_SIZE];
+local WN_THREAD_LOCAL double fs_buf[BUF_SIZE];
+local WN_THREAD_LOCAL double low_x_max_offshifted_f,high_x_max_offshifted_f;
+local WN_THREAD_LOCAL double low_x,high_x;
 
-local double *xs = xs_buf+BUF_MID_INDEX;
-local double *fs = fs_buf+BUF_MID_INDEX;
-local int num_low_data,num_high_data;
+/* a thread-local address isn't a constant, so these can't be variables */
+#define xs (xs_buf+BUF_MID_INDEX)
+#define fs (fs_buf+BUF_MID_INDEX)
+local WN_THREAD_LOCAL int num_low_data,num_high_data;
 
-local double f_goal;
-local double (*pfunction)(double x);
+local WN_THREAD_LOCAL double f_goal;
+local WN_THREAD_LOCAL double (*pfunction)(double x);
 
-local bool terminate;
+local WN_THREAD_LOCAL bool terminate;
 
-local double sqrt_tolerance;
+local WN_THREAD_LOCAL double sqrt_tolerance;
 
 
 double wn_clip_f(double f)
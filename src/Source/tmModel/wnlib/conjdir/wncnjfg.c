@@ -64,7 +64,7 @@ Last modified: 5/28/03 by bogdan
 /* max increase in step length allowed when starting new line search */
 #define MAX_STEP_LENGTH_INCREASE   8.0
 
-extern bool wn_force_optimize_stop_flag;
+extern WN_THREAD_LOCAL bool wn_force_optimize_stop_flag;
 
 
 /* data for slow linesearch */
@@ -91,6 +91,9 @@ typedef struct context_struct
   double *vect;  /* from caller */
   int num_vars;
   double (*pfuncgrad)(double grad[],double vect[]);
+/* reentrant callers pass their context to the function instead */
+  double (*pfuncgrad_r)(double grad[],double vect[],ptr client_data);
+  ptr client_data;
   bool (*pterminate)(double vect[],double best_f,int iteration);
   double first_step_len;
   int iteration,max_iterations;
@@ -401,6 +404,18 @@ local void backward_shift_state(cntxt c)
 }
 
 
+/* evaluate the function and gradient through whichever callback we got */
+local double call_funcgrad(cntxt c,double grad[],double vect[])
+{
+  if(c->pfuncgrad_r != NULL)
+  {
+    return((*(c->pfuncgrad_r))(grad,vect,c->client_data));
+  }
+
+  return((*(c->pfuncgrad))(grad,vect));
+}
+
+
 local bool default_terminate(double vect[],double best_f,int iteration)
 {
   return(FALSE);
@@ -465,7 +480,7 @@ local void do_first_funcgrad_call(cntxt c)
 {
   int i;
  
-  c->f0 = wn_clip_f((*(c->pfuncgrad))(c->grad0,c->vect));
+  c->f0 = wn_clip_f(call_funcgrad(c,c->grad0,c->vect));
   update_best_f(c,c->vect,c->f0);
 
   for(i=0;i<NUM_BEST_F;++i)
@@ -1107,7 +1122,7 @@ local void determine_how_far_to_backout(cntxt c,bool *psuccess0,bool *psuccess1)
   }
   else  /* !(c->isreal0) */
   {
-    c->f0 = wn_clip_f((*(c->pfuncgrad))(c->grad0,c->vect0));
+    c->f0 = wn_clip_f(call_funcgrad(c,c->grad0,c->vect0));
     c->isreal0 = TRUE;
     update_best_f(c,c->vect0,c->f0);
     c->dot_grad0_dir1 = wn_dot_vects_par(c->pc,c->grad0,c->dir1,c->num_vars);
@@ -1193,7 +1208,7 @@ local void do_fast_linesearch0(cntxt c, bool *psuccess0, bool *psuccess1)
 
   wn_add_vect_and_scaled_vect_par(c->pc,c->vect,c->vect0,c->dir0,
           c->x0s,c->num_vars);
-  c->f0s = wn_clip_f((*(c->pfuncgrad))(c->grad0s,c->vect));
+  c->f0s = wn_clip_f(call_funcgrad(c,c->grad0s,c->vect));
   c->dot_grad0s_dir0 = wn_dot_vects_par(c->pc,c->grad0s,c->dir0,c->num_vars);
 
   /* test if sample result consistent with quadratic convergence */
@@ -1295,7 +1310,7 @@ local void do_fast_linesearch0(cntxt c, bool *psuccess0, bool *psuccess1)
   /* test to see if true f0opt is enough improvement */
   wn_add_vect_and_scaled_vect_par(c->pc,c->vect,c->vect0,c->dir0,
           c->x0opt,c->num_vars);
-  c->f0opt = wn_clip_f((*(c->pfuncgrad))(c->grad0opt,c->vect));
+  c->f0opt = wn_clip_f(call_funcgrad(c,c->grad0opt,c->vect));
   c->norm2_grad0opt = wn_norm2_vect_par(c->pc, c->grad0opt, c->num_vars);
   c->dot_grad0opt_dir0 = 
     wn_dot_vects_par(c->pc,c->grad0opt,c->dir0,c->num_vars);
@@ -1428,7 +1443,7 @@ local void advance_to_new_linesearch(cntxt c)
 
   if((c->norm2_grad0 == 0.0)&&(!(c->isreal0)))
   {
-    c->f0 = wn_clip_f((*(c->pfuncgrad))(c->grad0,c->vect0));
+    c->f0 = wn_clip_f(call_funcgrad(c,c->grad0,c->vect0));
     update_best_f(c,c->vect0,c->f0);
 
     c->isreal0 = TRUE;    /* this is real data, we just got it */
@@ -1578,7 +1593,7 @@ local void funcgrad_at_x(cntxt c,double x)
   c->x0s = x;
   wn_add_vect_and_scaled_vect_par(c->pc,c->vect,c->vect0,c->dir0,c->x0s,
           c->num_vars);
-  c->f0s = wn_clip_f((*(c->pfuncgrad))(c->grad0s,c->vect));
+  c->f0s = wn_clip_f(call_funcgrad(c,c->grad0s,c->vect));
   c->dot_grad0s_dir0 = wn_dot_vects_par(c->pc,c->grad0s,c->dir0,
           c->num_vars);
 }
@@ -3182,7 +3197,7 @@ local void finish(cntxt c,int *pcode,double *pval_min)
 
 #if DEBUG
   /* printf("Checking returned minimum value of f...\n"); */
-  wn_assert(wn_clip_f((*(c->pfuncgrad))(c->grad0,c->vect)) == *pval_min);
+  wn_assert(wn_clip_f(call_funcgrad(c,c->grad0,c->vect)) == *pval_min);
 #endif
 
   wn_gppush(c->this_group);
@@ -3190,13 +3205,17 @@ local void finish(cntxt c,int *pcode,double *pval_min)
 }
 
 
-EXTERN void wn_conj_funcgrad_method_parallel
+/* common body of the public entry points, which pass either pfuncgrad
+  or pfuncgrad_r */
+local void conj_funcgrad_method
 (
   int *pcode,
   double *pval_min,
   double vect[],
   int num_vars,
   double (*pfuncgrad)(double grad[],double vect[]),
+  double (*pfuncgrad_r)(double grad[],double vect[],ptr client_data),
+  ptr client_data,
   bool (*pterminate)(double vect[],double best_f,int iteration),
   double first_step_len,
   int no_reset_run_len,
@@ -3217,6 +3236,8 @@ EXTERN void wn_conj_funcgrad_method_parallel
   c->vect = vect;
   c->num_vars = num_vars;
   c->pfuncgrad = pfuncgrad;
+  c->pfuncgrad_r = pfuncgrad_r;
+  c->client_data = client_data;
   if(pterminate == NULL)
   {
     c->pterminate = &default_terminate;
@@ -3304,6 +3325,54 @@ EXTERN void wn_conj_funcgrad_method_parallel
 }
 
 
+EXTERN void wn_conj_funcgrad_method_parallel
+(
+  int *pcode,
+  double *pval_min,
+  double vect[],
+  int num_vars,
+  double (*pfuncgrad)(double grad[],double vect[]),
+  bool (*pterminate)(double vect[],double best_f,int iteration),
+  double first_step_len,
+  int no_reset_run_len,
+  double reset_expand_factor,
+  int max_iterations,
+  wn_parallel_callback par_cb,
+  int num_threads
+)
+{
+  conj_funcgrad_method(pcode, pval_min, vect, num_vars, pfuncgrad,
+                       NULL, NULL, pterminate, first_step_len,
+                       no_reset_run_len, reset_expand_factor,
+                       max_iterations, par_cb, num_threads);
+}
+
+
+/* same as wn_conj_funcgrad_method, but passes client_data through to
+  pfuncgrad; keeps no global state of its own, so separate threads may run
+  it at the same time */
+EXTERN void wn_conj_funcgrad_method_r
+(
+  int *pcode,
+  double *pval_min,
+  double vect[],
+  int num_vars,
+  double (*pfuncgrad)(double grad[],double vect[],ptr client_data),
+  ptr client_data,
+  bool (*pterminate)(double vect[],double best_f,int iteration),
+  double first_step_len,
+  int no_reset_run_len,
+  double reset_expand_factor,
+  int max_iterations
+)
+{
+  conj_funcgrad_method(pcode, pval_min, vect, num_vars, NULL,
+                       pfuncgrad, client_data, pterminate, first_step_len,
+                       no_reset_run_len, reset_expand_factor,
+                       max_iterations, /*par_cb*/NULL, /*num_threads*/1);
+}
+
+
 EXTERN void wn_conj_funcgrad_method
 (
   int *pcode,
@@ -85,6 +85,20 @@ EXTERN void wn_conj_funcgrad_method_parallel
   wn_parallel_callback par_cb,
   int num_threads
 );
+EXTERN void wn_conj_funcgrad_method_r
+(
+  int *pcode,
+  double *pval_min,
+  double vect[],
+  int num_vars,
+  double (*pfuncgrad)(double grad[],double vect[],ptr client_data),
+  ptr client_data,
+  bool (*pterminate)(double vect[],double best_f,int iteration),
+  double first_step_len,
+  int no_reset_run_len,
+  double reset_expand_factor,
+  int max_iterations
+);
 EXTERN void wn_lbfgs_funcgrad_method
 (
   int *pcode,
@@ -33,13 +33,15 @@ void conj_gradient_method(pcode,pval_min,vect,
 
 
 
-bool wn_force_optimize_stop_flag;
+/* one flag per thread, so stopping one optimization doesn't stop others */
+WN_THREAD_LOCAL bool wn_force_optimize_stop_flag;
 
-local wn_memgp old_group;
+/* the state of a line search is per-thread too */
+local WN_THREAD_LOCAL wn_memgp old_group;
 
-double *buffer_vect;
+WN_THREAD_LOCAL double *buffer_vect;
 
-local double dy1,last_dy1;
+local WN_THREAD_LOCAL double dy1,last_dy1;
 
 
 
@@ -120,9 +122,9 @@ local void eval_function
 }
 
 
-local double *save_vect,*save_direction;
-local int save_len;
-local double (*save_pfunction)(double vect[]);
+local WN_THREAD_LOCAL double *save_vect,*save_direction;
+local WN_THREAD_LOCAL int save_len;
+local WN_THREAD_LOCAL double (*save_pfunction)(double vect[]);
 
 local double simple_eval_function(double x)
 {
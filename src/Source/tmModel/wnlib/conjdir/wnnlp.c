@@ -6,6 +6,7 @@
 #include "wnabs.h"
 #include "wnmax.h"
 #include "wnmem.h"
+#include "wnmemb.h"
 #include "wnsll.h"
 #include "wnvect.h"
 #include "wnmat.h"
@@ -16,19 +17,28 @@
 
 
 
-int wn_nlp_verbose;
+/* wn_nlp_verbose is per-thread, and the state of an optimization lives
+  in a context that is passed to every routine rather than in static
+  variables, so that wn_nlp_conj_method_r can be run by several threads at
+  once. */
+WN_THREAD_LOCAL int wn_nlp_verbose;
 
 
-local int count;
-local int num_vars;
-local double *solution_vect;
-local double *delta_vect;
-local double *values,*grad_buffer;
-local wn_nonlinear_constraint_type objective;
-local wn_sll constraint_list;
-
-
-local void check_nonlinear_constraint(wn_nonlinear_constraint_type constraint)
+typedef struct nlp_context_struct
+{
+  int verbose;
+  int count;
+  int num_vars;
+  double *solution_vect;
+  double *delta_vect;
+  double *values,*grad_buffer;
+  wn_nonlinear_constraint_type objective;
+  wn_sll constraint_list;
+} nlp_context_s,*nlp_context;
+
+
+local void check_nonlinear_constraint(nlp_context c,
+                                      wn_nonlinear_constraint_type constraint)
 {
   int i,var;
 
@@ -37,12 +47,13 @@ local void check_nonlinear_constraint(wn_nonlinear_constraint_type constraint)
     var = (constraint->vars)[i];
 
     wn_assert(var >= 0);
-    wn_assert(var < num_vars);
+    wn_assert(var < c->num_vars);
   }
 }
 
 
-local void check_linear_constraint(wn_linear_constraint_type constraint)
+local void check_linear_constraint(nlp_context c,
+                                   wn_linear_constraint_type constraint)
 {
   int i,var;
 
@@ -51,12 +62,13 @@ local void check_linear_constraint(wn_linear_constraint_type constraint)
     var = (constraint->vars)[i];
 
     wn_assert(var >= 0);
-    wn_assert(var < num_vars);
+    wn_assert(var < c->num_vars);
   }
 }
 
 
-local void check_constraint(wn_nonlinear_constraint_type constraint)
+local void check_constraint(nlp_context c,
+                             wn_nonlinear_constraint_type constraint)
 {
   switch(constraint->type)
   {
@@ -64,40 +76,40 @@ local void check_constraint(wn_nonlinear_constraint_type constraint)
       wn_assert_notreached();
       break;
     case(WN_NONLINEAR_CONSTRAINT):
-      check_nonlinear_constraint(constraint);
+      check_nonlinear_constraint(c,constraint);
       break;
     case(WN_LINEAR_CONSTRAINT):
-      check_linear_constraint((wn_linear_constraint_type)constraint);
+      check_linear_constraint(c,(wn_linear_constraint_type)constraint);
       break;
   }
 }
 
 
-local void check_inputs(void)
+local void check_inputs(nlp_context c)
 {
   wn_sll el;
   wn_nonlinear_constraint_type constraint;
 
-  check_constraint(objective);
+  check_constraint(c,c->objective);
 
-  for(el=constraint_list;el!=NULL;el=el->next)
+  for(el=c->constraint_list;el!=NULL;el=el->next)
   {
     constraint = (wn_nonlinear_constraint_type)(el->contents);
 
-    check_constraint(constraint);
+    check_constraint(c,constraint);
   }
 }
 
 
-local void initialize(void)
+local void initialize(nlp_context c)
 {
   wn_sll el;
   wn_nonlinear_constraint_type constraint;
 
-  values = (double *)wn_zalloc(num_vars*sizeof(double));
-  grad_buffer = (double *)wn_zalloc(num_vars*sizeof(double));
+  c->values = (double *)wn_zalloc(c->num_vars*sizeof(double));
+  c->grad_buffer = (double *)wn_zalloc(c->num_vars*sizeof(double));
 
-  for(el=constraint_list;el!=NULL;el=el->next)
+  for(el=c->constraint_list;el!=NULL;el=el->next)
   {
     constraint = (wn_nonlinear_constraint_type)(el->contents);
 
@@ -108,6 +120,7 @@ local void initialize(void)
 
 local void compute_diff_nonlinear
 (
+  nlp_context c,
   double *pdiff,
   double vect[],
   wn_nonlinear_constraint_type constraint
@@ -123,10 +136,10 @@ local void compute_diff_nonlinear
 
   for(i=0;i<size;++i)
   {
-    values[i] = vect[vars[i]];
+    c->values[i] = vect[vars[i]];
   }
 
-  *pdiff = (*(constraint->pfunction))(size,values,constraint->client_data);
+  *pdiff = (*(constraint->pfunction))(size,c->values,constraint->client_data);
 }
 
 
@@ -161,6 +174,7 @@ local void compute_diff_linear
 
 local void compute_diff
 (
+  nlp_context c,
   double *pdiff,
   double vect[],
   wn_nonlinear_constraint_type constraint
@@ -172,7 +186,7 @@ local void compute_diff
       wn_assert_notreached();
       break;
     case(WN_NONLINEAR_CONSTRAINT):
-      compute_diff_nonlinear(pdiff,vect,constraint);
+      compute_diff_nonlinear(c,pdiff,vect,constraint);
       break;
     case(WN_LINEAR_CONSTRAINT):
       compute_diff_linear(pdiff,vect,(wn_linear_constraint_type)constraint);
@@ -181,12 +195,12 @@ local void compute_diff
 }
 
 
-local double function_1_constraint(double vect[],
+local double function_1_constraint(nlp_context c,double vect[],
            wn_nonlinear_constraint_type constraint)
 {
   double diff,offset;
 
-  compute_diff(&diff,vect,constraint);
+  compute_diff(c,&diff,vect,constraint);
   offset = constraint->offset;
 
   diff -= offset; 
@@ -254,6 +268,7 @@ local void increment_gradient_for_linear_constraint
 
 local void inc_grad_numerical_for_nonlinear_constraint
 (
+  nlp_context c,
   double grad[],
   double vect[],
   wn_nonlinear_constraint_type constraint,
@@ -273,20 +288,22 @@ local void inc_grad_numerical_for_nonlinear_constraint
 
   for(i=0;i<size;++i)
   {
-    values[i] = vect[vars[i]];
+    c->values[i] = vect[vars[i]];
   }
 
   for(i=0;i<size;++i)
   {
-    delta = delta_vect[vars[i]];
+    delta = c->delta_vect[vars[i]];
 
-    values[i] = vect[vars[i]] - delta;
-    fminus = (*(constraint->pfunction))(size,values,constraint->client_data);
+    c->values[i] = vect[vars[i]] - delta;
+    fminus = (*(constraint->pfunction))(size,c->values,
+                                        constraint->client_data);
 
-    values[i] = vect[vars[i]] + delta;
-    fplus = (*(constraint->pfunction))(size,values,constraint->client_data);
+    c->values[i] = vect[vars[i]] + delta;
+    fplus = (*(constraint->pfunction))(size,c->values,
+                                       constraint->client_data);
 
-    values[i] = vect[vars[i]];
+    c->values[i] = vect[vars[i]];
 
     df_dxi = (fplus-fminus)/(2.0*delta);
 
@@ -297,6 +314,7 @@ local void inc_grad_numerical_for_nonlinear_constraint
 
 local void inc_grad_symbolic_for_nonlinear_constraint
 (
+  nlp_context c,
   double grad[],
   double vect[],
   wn_nonlinear_constraint_type constraint,
@@ -315,20 +333,22 @@ local void inc_grad_symbolic_for_nonlinear_constraint
 
   for(i=0;i<size;++i)
   {
-    values[i] = vect[vars[i]];
+    c->values[i] = vect[vars[i]];
   }
 
-  (*(constraint->pgradient))(grad_buffer,size,values,constraint->client_data);
+  (*(constraint->pgradient))(c->grad_buffer,size,c->values,
+                             constraint->client_data);
 
   for(i=0;i<size;++i)
   {
-    grad[vars[i]] += diff*grad_buffer[i];
+    grad[vars[i]] += diff*c->grad_buffer[i];
   }
 }
 
 
 local void increment_gradient_for_nonlinear_constraint
 (
+  nlp_context c,
   double grad[],
   double vect[],
   wn_nonlinear_constraint_type constraint,
@@ -337,17 +357,18 @@ local void increment_gradient_for_nonlinear_constraint
 {
   if(constraint->pgradient == NULL)
   {
-    inc_grad_numerical_for_nonlinear_constraint(grad,vect,constraint,diff);
+    inc_grad_numerical_for_nonlinear_constraint(c,grad,vect,constraint,diff);
   }
   else
   {
-    inc_grad_symbolic_for_nonlinear_constraint(grad,vect,constraint,diff);
+    inc_grad_symbolic_for_nonlinear_constraint(c,grad,vect,constraint,diff);
   }
 }
 
 
 local void increment_gradient_for_constraint
 (
+  nlp_context c,
   double grad[],
   double vect[],
   wn_nonlinear_constraint_type constraint,
@@ -360,7 +381,7 @@ local void increment_gradient_for_constraint
       wn_assert_notreached();
       break; 
     case(WN_NONLINEAR_CONSTRAINT):
-      increment_gradient_for_nonlinear_constraint(grad,vect,constraint,diff);
+      increment_gradient_for_nonlinear_constraint(c,grad,vect,constraint,diff);
       break;
     case(WN_LINEAR_CONSTRAINT):
       increment_gradient_for_linear_constraint(
@@ -370,13 +391,13 @@ local void increment_gradient_for_constraint
 }
 
 
-local void gradient_1_constraint(double grad[],
+local void gradient_1_constraint(nlp_context c,double grad[],
          double vect[],
          wn_nonlinear_constraint_type constraint)
 {
   double diff,offset;
 
-  compute_diff(&diff,vect,constraint);
+  compute_diff(c,&diff,vect,constraint);
   offset = constraint->offset;
 
   diff -= offset; 
@@ -388,42 +409,42 @@ local void gradient_1_constraint(double grad[],
       break;
 
     case(WN_EQ_COMPARISON):
-      increment_gradient_for_constraint(grad,vect,constraint,diff);      
+      increment_gradient_for_constraint(c,grad,vect,constraint,diff);      
       break;
 
     case(WN_GT_COMPARISON):
       if(diff < 0.0)
       {
-        increment_gradient_for_constraint(grad,vect,constraint,diff);      
+        increment_gradient_for_constraint(c,grad,vect,constraint,diff);      
       }
       break;
 
     case(WN_LT_COMPARISON):
       if(diff > 0.0)
       {
-        increment_gradient_for_constraint(grad,vect,constraint,diff);      
+        increment_gradient_for_constraint(c,grad,vect,constraint,diff);      
       }
       break;
   }
 }
 
 
-local double function(double vect[])
+local double function(nlp_context c,double vect[])
 {
   double sum;
   wn_nonlinear_constraint_type constraint;
   wn_sll el;
 
-  compute_diff(&sum,vect,objective);
+  compute_diff(c,&sum,vect,c->objective);
 
-  for(el=constraint_list;el!=NULL;el=el->next)
+  for(el=c->constraint_list;el!=NULL;el=el->next)
   {
     constraint = (wn_nonlinear_constraint_type)(el->contents);
 
-    sum += function_1_constraint(vect,constraint);
+    sum += function_1_constraint(c,vect,constraint);
   }
 
-  if(wn_nlp_verbose >= 2)
+  if(c->verbose >= 2)
   {
     printf("ob = %20.20lf\n",sum);
     fflush(stdout);
@@ -433,43 +454,44 @@ local double function(double vect[])
 }
 
 
-local void gradient(double grad[],double vect[])
+local void gradient(nlp_context c,double grad[],double vect[])
 {
   wn_nonlinear_constraint_type constraint;
   wn_sll el;
 
-  if(wn_nlp_verbose >= 2)
+  if(c->verbose >= 2)
   {
-    printf("gradient. count = %d\n",count);
+    printf("gradient. count = %d\n",c->count);
     fflush(stdout);
   }
-  ++count;
+  ++(c->count);
 
-  wn_zero_vect(grad,num_vars);
+  wn_zero_vect(grad,c->num_vars);
 
-  increment_gradient_for_constraint(grad,vect,objective,0.5);      
+  increment_gradient_for_constraint(c,grad,vect,c->objective,0.5);      
 
-  for(el=constraint_list;el!=NULL;el=el->next)
+  for(el=c->constraint_list;el!=NULL;el=el->next)
   {
     constraint = (wn_nonlinear_constraint_type)(el->contents);
 
-    gradient_1_constraint(grad,vect,constraint);
+    gradient_1_constraint(c,grad,vect,constraint);
   }
 }
 
 
-local double funcgrad(double grad[],double vect[])
+local double funcgrad(double grad[],double vect[],ptr client_data)
 {
+  nlp_context c = (nlp_context)client_data;
   double func;
 
-  func = function(vect);
-  gradient(grad,vect);
+  func = function(c,vect);
+  gradient(c,grad,vect);
 
   return(func);
 }
 
 
-local void adjust_offsets(double offset_adjust_rate)
+local void adjust_offsets(nlp_context c,double offset_adjust_rate)
 {
   wn_sll el;
   wn_nonlinear_constraint_type constraint;
@@ -478,11 +500,11 @@ local void adjust_offsets(double offset_adjust_rate)
   sum_adiff = 0.0;
   max_adiff = 0.0;
 
-  for(el=constraint_list;el!=NULL;el=el->next)
+  for(el=c->constraint_list;el!=NULL;el=el->next)
   {
     constraint = (wn_nonlinear_constraint_type)(el->contents);
 
-    compute_diff(&diff,solution_vect,constraint);
+    compute_diff(c,&diff,c->solution_vect,constraint);
 
     adiff = 0.0;
 
@@ -526,79 +548,97 @@ local void adjust_offsets(double offset_adjust_rate)
     sum_adiff += adiff;
   }
 
-  if(wn_nlp_verbose >= 1)
+  if(c->verbose >= 1)
   {
     printf("max_adiff = %lf,mean_adiff = %lf\n",
-     max_adiff,sum_adiff/wn_sllcount(constraint_list));
+     max_adiff,sum_adiff/wn_sllcount(c->constraint_list));
     fflush(stdout);
   }
 }
 
 
-void wn_nlp_conj_method
+/* reentrant version of wn_nlp_conj_method; verbose replaces the global
+  wn_nlp_verbose */
+void wn_nlp_conj_method_r
 (
   int *pcode,double *pval_min,double passed_solution_vect[],
   double passed_delta_vect[],
   wn_nonlinear_constraint_type passed_objective,wn_sll passed_constraint_list,
   int passed_num_vars,int conj_iterations,int offset_iterations,
-  double offset_adjust_rate
+  double offset_adjust_rate,int verbose
 )
 {
+  nlp_context_s context_mem,*c;
   int i;
 
+  c = &context_mem;
+  wn_memzero((ptr)c,sizeof(nlp_context_s));
+
   wn_gpmake("no_free");
 
-  solution_vect = passed_solution_vect;
-  delta_vect = passed_delta_vect;
-  objective = passed_objective;
-  constraint_list = passed_constraint_list;
-  num_vars = passed_num_vars;
+  c->verbose = verbose;
+  c->solution_vect = passed_solution_vect;
+  c->delta_vect = passed_delta_vect;
+  c->objective = passed_objective;
+  c->constraint_list = passed_constraint_list;
+  c->num_vars = passed_num_vars;
 
-  check_inputs();
+  check_inputs(c);
 
-  initialize();
+  initialize(c);
 
   for(i=0;i<offset_iterations;++i) 
   {
-    count = 0;
-
-    /*
-    wn_conj_gradient_method(pcode,pval_min,
-                solution_vect,num_vars,(function),(gradient),
-          conj_iterations);
-    */
-    wn_conj_funcgrad_method(pcode,pval_min,
-                            solution_vect,num_vars,
-                            &funcgrad,
-                            (bool (*)(double *,double,int))NULL,
-                            1.0,
-          0.0,
-                            0.0,
-          conj_iterations); 
+    c->count = 0;
+
+    wn_conj_funcgrad_method_r(pcode,pval_min,
+                              c->solution_vect,c->num_vars,
+                              &funcgrad,(ptr)c,
+                              (bool (*)(double *,double,int))NULL,
+                              1.0,
+                              0,
+                              0.0,
+                              conj_iterations); 
     if((*pcode != WN_SUCCESS)&&(*pcode != WN_SUBOPTIMAL))
     {
       break;
     }
 
-    compute_diff(pval_min,solution_vect,objective);
+    compute_diff(c,pval_min,c->solution_vect,c->objective);
 
-    if(wn_nlp_verbose >= 3)
+    if(c->verbose >= 3)
     {
-      wn_print_vect(solution_vect,num_vars);
+      wn_print_vect(c->solution_vect,c->num_vars);
     }
-    if(wn_nlp_verbose >= 1)
+    if(c->verbose >= 1)
     {
       printf("iteration=%d,real ob = %lf\n",i,*pval_min);
       fflush(stdout);
     }
 
-    adjust_offsets(offset_adjust_rate);
+    adjust_offsets(c,offset_adjust_rate);
   }
 
   wn_gpfree();
 }
 
 
+void wn_nlp_conj_method
+(
+  int *pcode,double *pval_min,double passed_solution_vect[],
+  double passed_delta_vect[],
+  wn_nonlinear_constraint_type passed_objective,wn_sll passed_constraint_list,
+  int passed_num_vars,int conj_iterations,int offset_iterations,
+  double offset_adjust_rate
+)
+{
+  wn_nlp_conj_method_r(pcode,pval_min,passed_solution_vect,passed_delta_vect,
+                       passed_objective,passed_constraint_list,passed_num_vars,
+                       conj_iterations,offset_iterations,offset_adjust_rate,
+                       wn_nlp_verbose);
+}
+
+
 void wn_make_linear_constraint(wn_linear_constraint_type *pconstraint,
                    int size,double rhs,int comparison_type)
 {
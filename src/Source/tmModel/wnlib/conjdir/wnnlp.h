@@ -48,6 +48,14 @@ EXTERN void wn_nlp_conj_method
   int passed_num_vars,int conj_iterations,int offset_iterations,
   double offset_adjust_rate
 );
+EXTERN void wn_nlp_conj_method_r
+(
+  int *pcode,double *pval_min,double passed_solution_vect[],
+  double passed_delta_vect[],
+  wn_nonlinear_constraint_type passed_objective,wn_sll passed_constraint_list,
+  int passed_num_vars,int conj_iterations,int offset_iterations,
+  double offset_adjust_rate,int verbose
+);
 EXTERN 
 void wn_make_linear_constraint(wn_linear_constraint_type *pconstraint,
                    int size,double rhs,int comparison_type);
@@ -56,7 +64,7 @@ void wn_make_nonlinear_constraint(wn_nonlinear_constraint_type *pconstraint,
                       int size,int comparison_type);
 
 
-extern int wn_nlp_verbose;
+extern WN_THREAD_LOCAL int wn_nlp_verbose;
 
 
 #endif
@@ -58,6 +58,19 @@ AUTHOR:
 #endif
 
 
+/* storage class for library state that must be private to each thread,
+  so that independent optimizations can run concurrently on different threads */
+#ifndef WN_THREAD_LOCAL
+#  if defined(_MSC_VER)
+#    define WN_THREAD_LOCAL __declspec(thread)
+#  elif defined(__GNUC__) || defined(__clang__)
+#    define WN_THREAD_LOCAL __thread
+#  else
+#    define WN_THREAD_LOCAL
+#  endif
+#endif
+
+
 #if defined(sparc64)
 # define WN_SIZEOF_PTR  8
 # define WN_SIZEOF_LONG  8
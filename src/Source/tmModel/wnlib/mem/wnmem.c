@@ -93,12 +93,14 @@ AUTHOR:
 #define BEGIN_MAGIC      1122112211
 #define END_MAGIC        1221122112
 
-local bool initialized = FALSE;
+/* each thread has its own group stack, so threads can't pop or free
+  each other's groups */
+local WN_THREAD_LOCAL bool initialized = FALSE;
 
-local wn_gpstack current_gpstack = NULL;
+local WN_THREAD_LOCAL wn_gpstack current_gpstack = NULL;
 
-local wn_memgp group_list = NULL;
-local wn_memgp default_group = NULL;
+local WN_THREAD_LOCAL wn_memgp group_list = NULL;
+local WN_THREAD_LOCAL wn_memgp default_group = NULL;
 
 bool wn_gp_fill_flag=FALSE,
      wn_gp_pad_flag=FALSE,
@@ -92,6 +92,7 @@ EXTERN void wn_free(ptr p);
 EXTERN void wn_realloc(ptr *pp,int old_size,int new_size);
 EXTERN void wn_zrealloc(ptr *pp,int old_size,int new_size);
 
+EXTERN void wn_make_gpstack(wn_gpstack *pstack);
 EXTERN void wn_get_current_gpstack(wn_gpstack *pstack);
 EXTERN void wn_set_current_gpstack(wn_gpstack stack);
 
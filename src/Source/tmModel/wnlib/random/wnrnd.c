@@ -38,14 +38,16 @@ AUTHOR:
 #define NUM_MUNGE_FUNCS  283  /* prime number */
 #define OUT_OFFSET       113
 
-local int pointer=1656;
-local int munge_pointer=70;  
-local int munge_pointer_out=(70+OUT_OFFSET)%NUM_MUNGE_FUNCS;  
+/* generator state is per-thread, so concurrent optimizations each get
+  a reproducible sequence */
+local WN_THREAD_LOCAL int pointer=1656;
+local WN_THREAD_LOCAL int munge_pointer=70;  
+local WN_THREAD_LOCAL int munge_pointer_out=(70+OUT_OFFSET)%NUM_MUNGE_FUNCS;  
 
-local int saved_bits;
-local int number_of_saved_bits;
+local WN_THREAD_LOCAL int saved_bits;
+local WN_THREAD_LOCAL int number_of_saved_bits;
 
-local int state[BUFFER_SIZE] =  /* for seed 0 */
+local WN_THREAD_LOCAL int state[BUFFER_SIZE] =  /* for seed 0 */
 {(int)0x2c1b1e0e,(int)0x841386a,(int)0xc55aca14,(int)0x2c1c3c53,(int)0xc9a2cb47,
 (int)0x3574a50e,(int)0x51f0083f,(int)0xa67c732e,(int)0x7409311d,(int)0xe198093e,(int)0xa4a3535c,
 (int)0xcab5dea5,(int)0x641be6da,(int)0x5056c2a,(int)0xdf31d8ba,(int)0x2cd49038,(int)0x579e65a6,
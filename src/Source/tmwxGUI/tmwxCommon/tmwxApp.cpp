@@ -1418,6 +1418,7 @@ tmwxPrefsDialog::tmwxPrefsDialog()
   wxString choices[tmNLCO::NUM_ALGORITHMS];
 #ifdef tmUSE_ALM
   choices[tmNLCO::ALM] = wxT("ALM (slowest but most robust)");
+  choices[tmNLCO::ALM_LBFGS] = wxT("ALM L-BFGS (robust, for large trees)");
 #endif
 #ifdef tmUSE_WNLIB
   choices[tmNLCO::WNLIB] = wxT("WNLIB (medium speed, medium robustness)");
@@ -1428,6 +1429,10 @@ tmwxPrefsDialog::tmwxPrefsDialog()
 #ifdef tmUSE_RFSQP
   choices[tmNLCO::RFSQP] = wxT("RFSQP (fastest, sometimes crashes)");
 #endif
+#ifdef tmUSE_PORTFOLIO
+  choices[tmNLCO::PORTFOLIO] = 
+    wxT("Portfolio (races ALM and WNLIB, fastest of both)");
+#endif
 
   // Popup menu giving the algorithm choices
   wxStaticBox* algorithmBox = new wxStaticBox(this, wxID_ANY, 
@@ -806,8 +806,8 @@ This is also the point used for tmCondition attachment.
 template <>
 tmPoint tmwxDesignCanvas::CalcLoc<tmPath>(const tmPath* aPath)
 {
-  tmPoint p1 = CalcLoc(aPath->GetNodes().front());
-  tmPoint p2 = CalcLoc(aPath->GetNodes().back());
+  tmPoint p1 = CalcLoc(aPath->GetFrontNode());
+  tmPoint p2 = CalcLoc(aPath->GetBackNode());
   return 0.50 * p1 + 0.50 * p2;
 }
 
@@ -1380,8 +1380,8 @@ void tmwxDesignCanvas::DrawPart<tmwxDesignCanvas::Lines, tmPath>(
       !isSelected ? STD_WIDTH : STD_WIDTH + DELTA_WIDTH;
     dc.SetPen(wxPen(theColor, theWidth, wxSOLID));
     wxPoint pts[2];
-    pts[0] = TreeToDC(CalcLoc(aPath->GetNodes().front()));
-    pts[1] = TreeToDC(CalcLoc(aPath->GetNodes().back()));
+    pts[0] = TreeToDC(CalcLoc(aPath->GetFrontNode()));
+    pts[1] = TreeToDC(CalcLoc(aPath->GetBackNode()));
     dc.DrawLines(2, pts);
   }
 }
@@ -2571,8 +2571,8 @@ tmPath* tmwxDesignCanvas::ClickOn<tmPath>(const wxPoint& where)
   tmPath* clickedPath;
   while (iPaths.Next(&clickedPath))
     if (IsVisible(clickedPath) && 
-      ClickOnLine(where, clickedPath->GetNodes().front()->GetLoc(),
-      clickedPath->GetNodes().back()->GetLoc())) return clickedPath;
+      ClickOnLine(where, clickedPath->GetFrontNode()->GetLoc(),
+      clickedPath->GetBackNode()->GetLoc())) return clickedPath;
   return NULL;
 }
 
@@ -14,6 +14,7 @@ Copyright:    
 #include "tmHeader.h"
 
 #include "tmCluster.h"
+#include "tmOptimizer.h"
 
 #include "wx/docview.h"
 
@@ -34,6 +35,9 @@ public:
   tmTree* mTree;
   std::stringstream mCleanState;  // unmodified tree state, serialized
   tmwxView* mView;
+  tmOptimizer::WarmStart mScaleWarmStart;   // state of last scale optimization
+  tmOptimizer::WarmStart mEdgeWarmStart;    // state of last edge optimization
+  tmOptimizer::WarmStart mStrainWarmStart;  // state of last strain optimization
   
   // Constructor/destructor
   tmwxDoc();
@@ -56,6 +56,7 @@ void tmwxDoc::OnScaleEverything(wxCommandEvent&)
     return;
   }
   // The actual calculation takes place during the modal dialog event loop
+  theOptimizer->SetWarmStart(mScaleWarmStart);
   tmwxOptimizerDialog theDialog(this, theOptimizer, 
     wxT("Maximizing scale...")); 
   theNLCO->SetUpdater(&theDialog);
@@ -65,6 +66,7 @@ void tmwxDoc::OnScaleEverything(wxCommandEvent&)
   switch(ret) {
     case tmwxOptimizerDialog::NORMAL_TERMINATION: {
       ::wxBell();
+      mScaleWarmStart = theOptimizer->GetWarmStart();
       cmd = wxT("scale optimization");
       break;
     }
@@ -154,6 +156,7 @@ void tmwxDoc::OnScaleSelection(wxCommandEvent&)
     delete theNLCO;
     return;
   }
+  theOptimizer->SetWarmStart(mEdgeWarmStart);
   tmwxOptimizerDialog theDialog(this, theOptimizer, 
     wxT("Maximizing strain...")); 
   theNLCO->SetUpdater(&theDialog);
@@ -163,6 +166,7 @@ void tmwxDoc::OnScaleSelection(wxCommandEvent&)
   switch(ret) {
     case tmwxOptimizerDialog::NORMAL_TERMINATION: {
       ::wxBell();
+      mEdgeWarmStart = theOptimizer->GetWarmStart();
       cmd = wxT("edge optimization");
       break;
     }
@@ -251,6 +255,7 @@ void tmwxDoc::OnMinimizeStrain(wxCommandEvent&)
     delete theNLCO;
     return;
   }
+  theOptimizer->SetWarmStart(mStrainWarmStart);
   tmwxOptimizerDialog theDialog(this, theOptimizer, 
     wxT("Minimizing RMS strain...")); 
   theNLCO->SetUpdater(&theDialog);
@@ -260,6 +265,7 @@ void tmwxDoc::OnMinimizeStrain(wxCommandEvent&)
   switch(ret) {
     case tmwxOptimizerDialog::NORMAL_TERMINATION: {
       ::wxBell();
+      mStrainWarmStart = theOptimizer->GetWarmStart();
       cmd = wxT("strain optimization");
       break;
     }
@@ -601,6 +607,7 @@ int tmwxDoc::QueryBadConvergenceRevert(int nlco, int reason)
 #endif
 #ifdef tmUSE_ALM
     case tmNLCO::ALM:
+    case tmNLCO::ALM_LBFGS:
     preamble = wxT("Bad convergence in ALM optimizer. ");
     switch(reason) {
       case tmNLCO_alm::ERROR_TOO_MANY_ITERATIONS:
@@ -611,6 +618,18 @@ int tmwxDoc::QueryBadConvergenceRevert(int nlco, int reason)
     }
     break;
 #endif
+#ifdef tmUSE_PORTFOLIO
+    case tmNLCO::PORTFOLIO:
+    preamble = wxT("Bad convergence in portfolio optimizer. ");
+    switch(reason) {
+      case tmNLCO_portfolio::ERROR_NONE_CONVERGED:
+        msg = wxT("None of the raced solvers converged to a feasible point. ");
+        break;
+      default:
+        TMFAIL("unknown return value encountered from portfolio optimization");
+    }
+    break;
+#endif
 #ifdef tmUSE_WNLIB
     case tmNLCO::WNLIB:
     preamble = wxT("Bad convergence in WNLIB optmizer. ");
@@ -83,8 +83,8 @@ void tmwxPathPanel::Fill()
 {
   if (!mPath) return;
   wxString title = wxString::Format(wxT("Path %s (Node %s - Node %s)"),
-    tmwxStr(mPath).c_str(), tmwxStr(mPath->GetNodes().front()).c_str(), 
-    tmwxStr(mPath->GetNodes().back()).c_str());
+    tmwxStr(mPath).c_str(), tmwxStr(mPath->GetFrontNode()).c_str(), 
+    tmwxStr(mPath->GetBackNode()).c_str());
   mPanelBox->SetLabel(title);
   mMinTreeLength->SetLabelFormatted(wxT("Min Tree Length: %.4f"), 
     mPath->GetMinTreeLength());
@@ -114,10 +114,12 @@ void tmwxPathPanel::Fill()
     mPath->IsPolygonPath());
   mIsConditionedPath->SetLabelFormatted(wxT("Conditioned: %s"), 
     mPath->IsConditionedPath());
-  mNodes->SetLabelFormatted(wxT("Nodes: %s"), 
-    mPath->GetNodes());
-  mEdges->SetLabelFormatted(wxT("Edges: %s"), 
-    mPath->GetEdges());
+  tmArray<tmNode*> pathNodes;
+  tmArray<tmEdge*> pathEdges;
+  mPath->GetNodes(pathNodes);
+  mPath->GetEdges(pathEdges);
+  mNodes->SetLabelFormatted(wxT("Nodes: %s"), pathNodes);
+  mEdges->SetLabelFormatted(wxT("Edges: %s"), pathEdges);
   mFwdPoly->SetLabelFormatted(wxT("Fwd Poly: %s"), 
     mPath->GetFwdPoly());
   mBkdPoly->SetLabelFormatted(wxT("Bkd Poly: %s"), 